@@ -86,6 +86,12 @@ int genavb_stream_create(struct genavb_handle *genavb, struct genavb_stream_hand
 		goto err_genavb_handle_null;
 	}
 
+	/* Mmap ring mode is not supported */
+	if (flags & AVTP_MMAP_RING) {
+		rc = -GENAVB_ERR_INVALID_PARAMS;
+		goto err_flags;
+	}
+
 	/*
 	* allocate new stream
 	*/
@@ -151,6 +157,7 @@ err_connect:
 	vPortFree(*stream);
 
 err_alloc:
+err_flags:
 err_genavb_handle_null:
 	*stream = NULL;
 
@@ -200,6 +207,27 @@ int genavb_stream_enable_callback(struct genavb_stream_handle const *handle)
 	return GENAVB_SUCCESS;
 }
 
+int genavb_stream_set_wakeup(struct genavb_stream_handle *handle, struct genavb_stream_wakeup const *wakeup)
+{
+	if (!handle->mqueue.id)
+		return -GENAVB_ERR_STREAM_INVALID;
+
+	if (media_api_set_wakeup(&handle->mqueue, wakeup) < 0)
+		return -GENAVB_ERR_INVALID_PARAMS;
+
+	return GENAVB_SUCCESS;
+}
+
+int genavb_stream_get_stats(struct genavb_stream_handle const *handle, struct genavb_stream_stats *stats)
+{
+	if (!handle->mqueue.id)
+		return -GENAVB_ERR_STREAM_INVALID;
+
+	media_api_get_stats((struct media_queue *)&handle->mqueue, stats);
+
+	return GENAVB_SUCCESS;
+}
+
 int genavb_stream_send(struct genavb_stream_handle const *handle, void const *data,
 	unsigned int data_len, struct genavb_event const *event, unsigned int event_len)
 {
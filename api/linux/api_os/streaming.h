@@ -35,6 +35,13 @@ struct genavb_stream_handle {
 	unsigned int partial_iovec;
 	int expect_new_frame;
 	unsigned int batch;		/* Transmit batch (in packet units) */
+
+	struct media_ring *ring;	/* Ring mapping, NULL if the stream is not in mmap ring mode */
+	char *ring_slot;		/* Payload slots, in the ring mapping */
+	unsigned long ring_size;	/* Ring mapping size */
+	unsigned int ring_read;		/* Ring entries acquired */
+	unsigned int ring_done;		/* Ring entries committed (talker) or released (listener) */
+	unsigned int ring_pending;	/* Ring entries committed but not yet passed to the stack (talker) */
 };
 
 #endif /* _LINUX_PRIVATE_STREAMING_H_ */
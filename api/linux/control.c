@@ -25,18 +25,47 @@
 #include <errno.h>
 #include <sys/poll.h>
 #include <pthread.h>
+#include <time.h>
 
 #include "common/ipc.h"
 
 #include "api/control.h"
 
+/* Remaining time (in milliseconds) before deadline, for a poll() timeout */
+static int timeout_remaining(struct timespec *deadline)
+{
+	struct timespec now;
+	long long ms;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	ms = (deadline->tv_sec - now.tv_sec) * 1000LL + (deadline->tv_nsec - now.tv_nsec) / 1000000;
+	if (ms < 0)
+		ms = 0;
+
+	return ms;
+}
+
 int avb_ipc_receive_sync(struct ipc_rx const *rx, unsigned int *msg_type, void *msg, unsigned int *msg_len, int timeout)
 {
 	struct pollfd sync_poll;
+	struct timespec deadline;
 	int rc;
 
+	if (timeout > 0) {
+		clock_gettime(CLOCK_MONOTONIC, &deadline);
+		deadline.tv_sec += timeout / 1000;
+		deadline.tv_nsec += (timeout % 1000) * 1000000;
+		if (deadline.tv_nsec >= 1000000000) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000;
+		}
+	}
+
 	sync_poll.fd = rx->fd;
 	sync_poll.events = POLLIN;
+
+retry:
 	rc = poll(&sync_poll, 1, timeout);
 	while (rc == -1) {
 		if (errno == EINTR)
@@ -48,9 +77,20 @@ int avb_ipc_receive_sync(struct ipc_rx const *rx, unsigned int *msg_type, void *
 	}
 
 	if (rc != 0) {
-		if (sync_poll.revents & POLLIN)
+		if (sync_poll.revents & POLLIN) {
 			rc = avb_ipc_receive(rx, msg_type, msg, msg_len);
-		else
+
+			/* IPC notifications may be spurious (shared memory IPC), wait for the next one */
+			if (rc == -GENAVB_ERR_CTRL_RX) {
+				if (timeout > 0)
+					timeout = timeout_remaining(&deadline);
+
+				if (timeout)
+					goto retry;
+
+				rc = -GENAVB_ERR_CTRL_TIMEOUT;
+			}
+		} else
 			rc = -GENAVB_ERR_CTRL_RX;
 	} else
 		rc = -GENAVB_ERR_CTRL_TIMEOUT;
@@ -25,10 +25,13 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <pthread.h>
 
+#include "common/types.h"
+
 #include "modules/media.h"
 
 #include "common/ipc.h"
@@ -40,6 +43,7 @@
 #include "api/control.h"
 
 #include "genavb/streaming.h"
+#include "genavb/media.h"
 
 #define MEDIA_QUEUE_API_FILE "/dev/media_queue_api"
 #define API_SYNC_POLL_TIMEOUT 1000
@@ -47,10 +51,52 @@
 extern pthread_mutex_t avb_mutex;
 extern struct genavb_handle *genavb_handle;
 
+static int stream_ring_map(struct genavb_stream_handle *handle)
+{
+	long page_size = sysconf(_SC_PAGESIZE);
+	unsigned long slot_offset, size;
+
+	/* Ring followed by the payload slots, see media_ring_alloc() */
+	slot_offset = (sizeof(struct media_ring) + page_size - 1) & ~(page_size - 1);
+	size = slot_offset + MEDIA_RING_SIZE * MEDIA_RING_SLOT_SIZE;
+
+	handle->ring = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, handle->fd, 0);
+	if (handle->ring == MAP_FAILED)
+		goto err_mmap;
+
+	if ((handle->ring->slot_offset != slot_offset) || (handle->ring->slot_size != MEDIA_RING_SLOT_SIZE))
+		goto err_layout;
+
+	handle->ring_slot = (char *)handle->ring + slot_offset;
+	handle->ring_size = size;
+
+	return 0;
+
+err_layout:
+	munmap(handle->ring, size);
+
+err_mmap:
+	handle->ring = NULL;
+
+	return -1;
+}
+
+static void stream_ring_unmap(struct genavb_stream_handle *handle)
+{
+	if (!handle->ring)
+		return;
+
+	munmap(handle->ring, handle->ring_size);
+
+	handle->ring = NULL;
+}
+
 int __avb_stream_destroy(struct genavb_stream_handle *handle)
 {
 	disconnect_avtp(handle->genavb, &handle->params);
 
+	stream_ring_unmap(handle);
+
 	if (handle->fd >= 0)
 		close(handle->fd);
 
@@ -198,7 +244,9 @@ int genavb_stream_create(struct genavb_handle *genavb, struct genavb_stream_hand
 		/*
 		* open device file and attach to the stream
 		*/
-		if (params->direction == AVTP_DIRECTION_LISTENER)
+		if (flags & AVTP_MMAP_RING)
+			fd = open(MEDIA_QUEUE_API_FILE, O_RDWR | O_CLOEXEC);
+		else if (params->direction == AVTP_DIRECTION_LISTENER)
 			fd = open(MEDIA_QUEUE_API_FILE, O_RDONLY | O_CLOEXEC);
 		else
 			fd = open(MEDIA_QUEUE_API_FILE, O_WRONLY | O_CLOEXEC);
@@ -242,6 +290,7 @@ int genavb_stream_create(struct genavb_handle *genavb, struct genavb_stream_hand
 		msg.frame_size = avtp_fmt_sample_size(params->subtype, &params->format);
 		msg.queue_size = 0;
 		msg.flags = flags;
+		msg.direction = params->direction;
 
 		if (ioctl(fd, MEDIA_IOC_API_BIND, &msg) < 0) {
 			rc = -GENAVB_ERR_STREAM_BIND;
@@ -263,6 +312,13 @@ int genavb_stream_create(struct genavb_handle *genavb, struct genavb_stream_hand
 
 	(*stream)->fd = fd;
 
+	if ((flags & AVTP_MMAP_RING) && (fd >= 0)) {
+		if (stream_ring_map(*stream) < 0) {
+			rc = -GENAVB_ERR_STREAM_BIND;
+			goto err_ring_map;
+		}
+	}
+
 
 	(*stream)->genavb = genavb;
 
@@ -272,6 +328,7 @@ int genavb_stream_create(struct genavb_handle *genavb, struct genavb_stream_hand
 
 	return GENAVB_SUCCESS;
 
+err_ring_map:
 err_ioctl:
 err_subtype_mode:
 	if (fd >= 0)
@@ -303,6 +360,30 @@ int genavb_stream_fd(struct genavb_stream_handle const *handle)
 }
 
 
+int genavb_stream_set_wakeup(struct genavb_stream_handle *handle, struct genavb_stream_wakeup const *wakeup)
+{
+	if (handle->fd < 0)
+		return -GENAVB_ERR_STREAM_INVALID;
+
+	if (ioctl(handle->fd, MEDIA_IOC_SET_WAKEUP, wakeup) < 0)
+		return -GENAVB_ERR_INVALID_PARAMS;
+
+	return GENAVB_SUCCESS;
+}
+
+
+int genavb_stream_get_stats(struct genavb_stream_handle const *handle, struct genavb_stream_stats *stats)
+{
+	if (handle->fd < 0)
+		return -GENAVB_ERR_STREAM_INVALID;
+
+	if (ioctl(handle->fd, MEDIA_IOC_GET_STATS, stats) < 0)
+		return -GENAVB_ERR_STREAM_INVALID;
+
+	return GENAVB_SUCCESS;
+}
+
+
 int genavb_stream_receive(struct genavb_stream_handle const *handle, void *data, unsigned int data_len,
 				struct genavb_event *event, unsigned int *event_len)
 {
@@ -689,6 +770,313 @@ exit:
 }
 
 
+int genavb_stream_receive_multi(struct genavb_stream_receive_entry *entry, unsigned int n)
+{
+	struct media_queue_rx_multi_entry msg_entry[MEDIA_MULTI_MAX];
+	struct media_queue_multi msg;
+	struct genavb_stream_receive_entry *e;
+	unsigned int i, n_now;
+	int fd, rc;
+
+	if (!entry && n)
+		return -GENAVB_ERR_INVALID;
+
+	while (n) {
+		n_now = n;
+		if (n_now > MEDIA_MULTI_MAX)
+			n_now = MEDIA_MULTI_MAX;
+
+		/* Any media queue file descriptor can be used for the system call */
+		fd = -1;
+
+		for (i = 0; i < n_now; i++) {
+			e = &entry[i];
+
+			msg_entry[i].fd = e->stream ? e->stream->fd : -1;
+			msg_entry[i].rx.data_iov = e->data_iov;
+			msg_entry[i].rx.data_iov_len = e->data_iov_len;
+			msg_entry[i].rx.event_iov = e->event_iov;
+			msg_entry[i].rx.event_iov_len = e->event_iov_len;
+			msg_entry[i].rx.data_read = 0;
+			msg_entry[i].rx.event_read = 0;
+			msg_entry[i].rc = -EBADF;
+
+			if (fd < 0)
+				fd = msg_entry[i].fd;
+		}
+
+		msg.entry = msg_entry;
+		msg.n = n_now;
+
+		if (fd < 0)
+			rc = 0;
+		else
+			rc = ioctl(fd, MEDIA_IOC_RX_MULTI, &msg);
+
+		for (i = 0; i < n_now; i++) {
+			e = &entry[i];
+
+			e->event_len = 0;
+
+			if (msg_entry[i].fd < 0)
+				e->rc = -GENAVB_ERR_STREAM_INVALID;
+			else if ((rc < 0) || (msg_entry[i].rc < 0))
+				e->rc = -GENAVB_ERR_STREAM_RX;
+			else {
+				e->rc = msg_entry[i].rx.data_read;
+				e->event_len = msg_entry[i].rx.event_read;
+			}
+		}
+
+		entry += n_now;
+		n -= n_now;
+	}
+
+	return GENAVB_SUCCESS;
+}
+
+int genavb_stream_send_multi(struct genavb_stream_send_entry *entry, unsigned int n)
+{
+	struct media_queue_tx_multi_entry msg_entry[MEDIA_MULTI_MAX];
+	struct media_queue_multi msg;
+	struct genavb_stream_send_entry *e;
+	unsigned int i, n_now;
+	int fd, rc;
+
+	if (!entry && n)
+		return -GENAVB_ERR_INVALID;
+
+	while (n) {
+		n_now = n;
+		if (n_now > MEDIA_MULTI_MAX)
+			n_now = MEDIA_MULTI_MAX;
+
+		/* Any media queue file descriptor can be used for the system call */
+		fd = -1;
+
+		for (i = 0; i < n_now; i++) {
+			e = &entry[i];
+
+			msg_entry[i].fd = e->stream ? e->stream->fd : -1;
+			msg_entry[i].tx.data_iov = e->data_iov;
+			msg_entry[i].tx.data_iov_len = e->data_iov_len;
+			msg_entry[i].tx.event = e->event;
+			msg_entry[i].tx.event_len = e->event_len;
+			msg_entry[i].rc = -EBADF;
+
+			if (fd < 0)
+				fd = msg_entry[i].fd;
+		}
+
+		msg.entry = msg_entry;
+		msg.n = n_now;
+
+		if (fd < 0)
+			rc = 0;
+		else
+			rc = ioctl(fd, MEDIA_IOC_TX_MULTI, &msg);
+
+		for (i = 0; i < n_now; i++) {
+			e = &entry[i];
+
+			if (msg_entry[i].fd < 0)
+				e->rc = -GENAVB_ERR_STREAM_INVALID;
+			else if (rc < 0)
+				e->rc = -GENAVB_ERR_STREAM_TX;
+			else if (msg_entry[i].rc < 0) {
+				if ((msg_entry[i].rc == -EAGAIN) || (msg_entry[i].rc == -EINTR))
+					e->rc = 0;
+				else
+					e->rc = -GENAVB_ERR_STREAM_TX;
+			} else
+				e->rc = msg_entry[i].rc;
+		}
+
+		entry += n_now;
+		n -= n_now;
+	}
+
+	return GENAVB_SUCCESS;
+}
+
+static int stream_ring_sync(struct genavb_stream_handle *handle)
+{
+	handle->ring_pending = 0;
+
+	return ioctl(handle->fd, MEDIA_IOC_RING_SYNC);
+}
+
+static struct media_ring_entry *stream_ring_entry(struct genavb_stream_handle *handle, unsigned int index)
+{
+	return &handle->ring->entry[index & (MEDIA_RING_SIZE - 1)];
+}
+
+static void *stream_ring_slot(struct genavb_stream_handle *handle, unsigned int index)
+{
+	return handle->ring_slot + (index & (MEDIA_RING_SIZE - 1)) * MEDIA_RING_SLOT_SIZE;
+}
+
+static int stream_ring_check(struct genavb_stream_handle *handle, unsigned int direction)
+{
+	if (!handle || !handle->ring || (handle->params.direction != direction))
+		return -1;
+
+	return 0;
+}
+
+int genavb_stream_tx_acquire(struct genavb_stream_handle *handle, struct genavb_stream_buf *buf)
+{
+	struct media_ring *ring;
+
+	if (stream_ring_check(handle, AVTP_DIRECTION_TALKER) < 0)
+		return -GENAVB_ERR_STREAM_INVALID;
+
+	ring = handle->ring;
+
+	if (handle->ring_read == __atomic_load_n(&ring->write, __ATOMIC_ACQUIRE)) {
+		if (stream_ring_sync(handle) < 0)
+			return -GENAVB_ERR_STREAM_TX;
+
+		if (handle->ring_read == __atomic_load_n(&ring->write, __ATOMIC_ACQUIRE))
+			return 0;
+	}
+
+	buf->data = stream_ring_slot(handle, handle->ring_read);
+	buf->len = ring->max_payload_size;
+	buf->priv = stream_ring_entry(handle, handle->ring_read);
+
+	handle->ring_read++;
+	__atomic_store_n(&ring->read, handle->ring_read, __ATOMIC_RELAXED);
+
+	return 1;
+}
+
+int genavb_stream_tx_commit(struct genavb_stream_handle *handle, struct genavb_stream_buf const *buf, unsigned int len,
+				struct genavb_event const *event, unsigned int event_len)
+{
+	struct media_ring *ring;
+	struct media_ring_entry *entry;
+	unsigned int i, event_mask = 0;
+
+	if (stream_ring_check(handle, AVTP_DIRECTION_TALKER) < 0)
+		return -GENAVB_ERR_STREAM_INVALID;
+
+	ring = handle->ring;
+
+	/* Buffers are committed in acquire order */
+	if ((handle->ring_done == handle->ring_read) || (buf->priv != stream_ring_entry(handle, handle->ring_done)))
+		return -GENAVB_ERR_STREAM_INVALID;
+
+	if (len > ring->max_payload_size)
+		return -GENAVB_ERR_STREAM_PARAMS;
+
+	entry = buf->priv;
+
+	entry->ts_n = 0;
+
+	for (i = 0; i < event_len; i++) {
+		event_mask |= event[i].event_mask;
+
+		if ((event[i].event_mask & AVTP_SYNC) && (event[i].index < len) && (entry->ts_n < MEDIA_TS_PER_PACKET)) {
+			entry->ts[entry->ts_n].val = event[i].ts;
+			entry->ts[entry->ts_n].offset = event[i].index;
+			entry->ts_n++;
+		}
+	}
+
+	entry->len = len;
+	entry->flags = 0;
+
+	if (event_mask & AVTP_FRAME_END)
+		entry->flags |= NET_TX_FLAGS_END_FRAME;
+
+	handle->ring_done++;
+	__atomic_store_n(&ring->done, handle->ring_done, __ATOMIC_RELEASE);
+
+	handle->ring_pending++;
+
+	if ((handle->ring_pending >= ring->batch) || (event_mask & (AVTP_FLUSH | AVTP_FRAME_END))) {
+		if (stream_ring_sync(handle) < 0)
+			return -GENAVB_ERR_STREAM_TX;
+	}
+
+	return GENAVB_SUCCESS;
+}
+
+int genavb_stream_rx_acquire(struct genavb_stream_handle *handle, struct genavb_stream_buf *buf, struct genavb_event *event, unsigned int *event_len)
+{
+	struct media_ring *ring;
+	struct media_ring_entry *entry;
+	unsigned int i, n = 0;
+
+	if (stream_ring_check(handle, AVTP_DIRECTION_LISTENER) < 0)
+		return -GENAVB_ERR_STREAM_INVALID;
+
+	ring = handle->ring;
+
+	if (handle->ring_read == __atomic_load_n(&ring->write, __ATOMIC_ACQUIRE)) {
+		if (event_len)
+			*event_len = 0;
+
+		return 0;
+	}
+
+	entry = stream_ring_entry(handle, handle->ring_read);
+	if (entry->len > MEDIA_RING_SLOT_SIZE)
+		return -GENAVB_ERR_STREAM_RX;
+
+	if (event && event_len) {
+		for (i = 0; (i < entry->ts_n) && (i < MEDIA_TS_PER_PACKET) && (n < *event_len); i++, n++) {
+			event[n].index = entry->ts[i].offset;
+			event[n].event_mask = MEDIA_DESC_FLAGS_TO_AVTP(entry->ts[i].flags);
+
+			if (!(event[n].event_mask & AVTP_TIMESTAMP_INVALID))
+				event[n].ts = entry->ts[i].val;
+			else
+				event[n].ts = 0;
+
+			/* Copy packet-level flags for the first event of the packet */
+			if (!i) {
+				event[n].event_mask |= entry->flags;
+				event[n].event_data = entry->bytes_lost;
+			} else
+				event[n].event_data = 0;
+		}
+
+		*event_len = n;
+	}
+
+	buf->data = stream_ring_slot(handle, handle->ring_read);
+	buf->len = entry->len;
+	buf->priv = entry;
+
+	handle->ring_read++;
+	__atomic_store_n(&ring->read, handle->ring_read, __ATOMIC_RELAXED);
+
+	return 1;
+}
+
+int genavb_stream_rx_release(struct genavb_stream_handle *handle, struct genavb_stream_buf const *buf)
+{
+	struct media_ring *ring;
+
+	if (stream_ring_check(handle, AVTP_DIRECTION_LISTENER) < 0)
+		return -GENAVB_ERR_STREAM_INVALID;
+
+	ring = handle->ring;
+
+	/* Buffers are released in acquire order */
+	if ((handle->ring_done == handle->ring_read) || (buf->priv != stream_ring_entry(handle, handle->ring_done)))
+		return -GENAVB_ERR_STREAM_INVALID;
+
+	/* Ring entries are reclaimed by the kernel on the next received packet, no system call needed */
+	handle->ring_done++;
+	__atomic_store_n(&ring->done, handle->ring_done, __ATOMIC_RELEASE);
+
+	return GENAVB_SUCCESS;
+}
+
+
 int genavb_stream_destroy(struct genavb_stream_handle *handle)
 {
 	struct list_head *entry, *next;
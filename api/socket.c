@@ -23,6 +23,30 @@
 #include "genavb/error.h"
 #include "os/stdlib.h"
 
+static void socket_rx_buf_init(struct genavb_socket_rx *sock, struct genavb_socket_buf *buf, struct net_rx_desc *desc)
+{
+	if (sock->flags & GENAVB_SOCKF_RAW) {
+		buf->data = (uint8_t *)desc + desc->l2_offset;
+		buf->len = desc->len;
+	} else {
+		buf->data = (uint8_t *)desc + desc->l3_offset;
+		buf->len = desc->len - (desc->l3_offset - desc->l2_offset);
+	}
+
+	buf->ts = desc->ts64;
+	buf->priv = desc;
+}
+
+/* Backend batch receive callback, hands the frames over to the genavb_socket_rx_multi() caller */
+static void socket_rx_multi_cb(struct net_rx *rx, struct net_rx_desc **desc, unsigned int n)
+{
+	struct genavb_socket_rx *sock = container_of(rx, struct genavb_socket_rx, net);
+	int i;
+
+	for (i = 0; i < n; i++)
+		socket_rx_buf_init(sock, &sock->multi_buf[sock->multi_n++], desc[i]);
+}
+
 int genavb_socket_rx_open(struct genavb_socket_rx **sock, genavb_sock_f_t flags,
 			  struct genavb_socket_rx_params *params)
 {
@@ -59,12 +83,12 @@ int genavb_socket_rx_open(struct genavb_socket_rx **sock, genavb_sock_f_t flags,
 		goto out_free_socket;
 	}
 
-	if (net_rx_init(&(*sock)->net, &params->addr, NULL, (*sock)->priv) < 0) {
+	if (net_rx_init_multi(&(*sock)->net, &params->addr, socket_rx_multi_cb, 0, 0, (*sock)->priv) < 0) {
 		rc = -GENAVB_ERR_SOCKET_INIT;
 		goto out_event_exit;
 	}
 
-	if (MAC_IS_MCAST(params->addr.u.l2.dst_mac)) {
+	if ((params->addr.ptype == PTYPE_L2) && MAC_IS_MCAST(params->addr.u.l2.dst_mac)) {
 		if (net_add_multi(&(*sock)->net, params->addr.port,
 				  params->addr.u.l2.dst_mac) < 0)
 			goto out_rx_exit;
@@ -138,6 +162,16 @@ int genavb_socket_tx_open(struct genavb_socket_tx **sock, genavb_sock_f_t flags,
 			}
 		}
 		addr = &params->addr;
+	} else if (params->addr.ptype == PTYPE_AVTP) {
+		/*
+		 * AVTP stream address (subtype, stream id, class), there is no
+		 * destination MAC to build the L2 header from.
+		 */
+		if (!(flags & GENAVB_SOCKF_RAW)) {
+			rc = -GENAVB_ERR_SOCKET_PARAMS;
+			goto out_free_socket;
+		}
+		addr = &params->addr;
 	} else {
 		rc = -GENAVB_ERR_INVALID;
 		goto out_free_socket;
@@ -242,7 +276,7 @@ int genavb_socket_tx(struct genavb_socket_tx *sock, void *buf, unsigned int len)
 	else
 		data_len = len + sock->header_len;
 
-	desc = net_tx_alloc(data_len);
+	desc = net_tx_ctx_alloc(&sock->net, data_len);
 	if (!desc) {
 		rc = -GENAVB_ERR_NO_MEMORY;
 		goto out;
@@ -274,6 +308,298 @@ out:
 	return rc;
 }
 
+int genavb_socket_rx_borrow(struct genavb_socket_rx *sock, struct genavb_socket_buf *buf)
+{
+	struct net_rx_desc *desc;
+	int rc;
+
+	if (!sock) {
+		rc = -GENAVB_ERR_INVALID;
+		goto out;
+	}
+
+	if (!buf) {
+		rc = -GENAVB_ERR_SOCKET_FAULT;
+		goto out;
+	}
+
+	if (socket_rx_event_check(sock) < 0) {
+		rc = -GENAVB_ERR_SOCKET_INTR;
+		goto out;
+	}
+
+	desc = __net_rx(&sock->net);
+	if (!desc) {
+		rc = -GENAVB_ERR_SOCKET_AGAIN;
+		goto out_rearm;
+	}
+
+	socket_rx_buf_init(sock, buf, desc);
+
+	rc = GENAVB_SUCCESS;
+
+out_rearm:
+	socket_rx_event_rearm(sock);
+
+out:
+	return rc;
+}
+
+void genavb_socket_rx_release(struct genavb_socket_rx *sock, struct genavb_socket_buf *buf)
+{
+	if (!buf || !buf->priv)
+		return;
+
+	net_rx_free(buf->priv);
+
+	buf->priv = NULL;
+}
+
+int genavb_socket_tx_get_buf(struct genavb_socket_tx *sock, struct genavb_socket_buf *buf, unsigned int len)
+{
+	struct net_tx_desc *desc;
+	int rc;
+	unsigned int data_len;
+
+	if (!sock) {
+		rc = -GENAVB_ERR_INVALID;
+		goto out;
+	}
+
+	if (!buf) {
+		rc = -GENAVB_ERR_SOCKET_FAULT;
+		goto out;
+	}
+
+	if (sock->flags & GENAVB_SOCKF_RAW)
+		data_len = len;
+	else
+		data_len = len + sock->header_len;
+
+	desc = net_tx_ctx_alloc(&sock->net, data_len);
+	if (!desc) {
+		rc = -GENAVB_ERR_NO_MEMORY;
+		goto out;
+	}
+
+	if (sock->flags & GENAVB_SOCKF_RAW)
+		buf->data = (uint8_t *)desc + desc->l2_offset;
+	else {
+		os_memcpy((uint8_t *)desc + desc->l2_offset,
+			  sock->header_template, sock->header_len);
+
+		buf->data = (uint8_t *)desc + desc->l2_offset + sock->header_len;
+	}
+
+	/* Allocated length, checked on commit */
+	desc->len = data_len;
+
+	buf->len = len;
+	buf->priv = desc;
+
+	return GENAVB_SUCCESS;
+
+out:
+	return rc;
+}
+
+/* Finalizes a buffer returned by genavb_socket_tx_get_buf(), or frees it if it can't be transmitted */
+static int socket_tx_buf_commit(struct genavb_socket_tx *sock, struct net_tx_desc *desc, unsigned int len)
+{
+	unsigned int data_len;
+	int rc;
+
+	if (sock->flags & GENAVB_SOCKF_RAW)
+		data_len = len;
+	else
+		data_len = len + sock->header_len;
+
+	if (data_len > desc->len) {
+		rc = -GENAVB_ERR_SOCKET_BUFLEN;
+		goto err;
+	}
+
+	desc->len = data_len;
+	desc->port = sock->params.addr.port;
+
+	return 0;
+
+err:
+	net_tx_free(desc);
+
+	return rc;
+}
+
+int genavb_socket_tx_commit(struct genavb_socket_tx *sock, struct genavb_socket_buf *buf, unsigned int len)
+{
+	struct net_tx_desc *desc;
+	int rc;
+
+	if (!buf || !buf->priv) {
+		rc = -GENAVB_ERR_SOCKET_FAULT;
+		goto out;
+	}
+
+	desc = buf->priv;
+	buf->priv = NULL;
+
+	if (!sock) {
+		rc = -GENAVB_ERR_INVALID;
+		goto out_free_desc;
+	}
+
+	if (!len) {
+		rc = GENAVB_SUCCESS;
+		goto out_free_desc;
+	}
+
+	rc = socket_tx_buf_commit(sock, desc, len);
+	if (rc < 0)
+		goto out;
+
+	if (net_tx(&sock->net, desc) < 0) {
+		rc = -GENAVB_ERR_SOCKET_TX;
+		goto out_free_desc;
+	}
+
+	return GENAVB_SUCCESS;
+
+out_free_desc:
+	net_tx_free(desc);
+
+out:
+	return rc;
+}
+
+static int socket_rx_multi(struct genavb_socket_rx *sock, struct genavb_socket_buf *buf, unsigned int n)
+{
+	unsigned int batch, received;
+
+	if (!sock)
+		return -GENAVB_ERR_INVALID;
+
+	if (!buf && n)
+		return -GENAVB_ERR_SOCKET_FAULT;
+
+	/* Blocking sockets wait on a per socket event, which doesn't fit a receive over several sockets */
+	if (!(sock->flags & GENAVB_SOCKF_NONBLOCK))
+		return -GENAVB_ERR_SOCKET_PARAMS;
+
+	sock->multi_buf = buf;
+	sock->multi_n = 0;
+
+	while (sock->multi_n < n) {
+		batch = n - sock->multi_n;
+		if (batch > NET_RX_BATCH)
+			batch = NET_RX_BATCH;
+
+		/* Never receive more frames than the caller has buffers for */
+		sock->net.batch = batch;
+
+		received = sock->multi_n;
+
+		net_rx_multi(&sock->net);
+
+		if ((sock->multi_n - received) < batch)
+			break;
+	}
+
+	return sock->multi_n;
+}
+
+int genavb_socket_rx_multi(struct genavb_socket_rx_entry *entry, unsigned int n)
+{
+	int i, total = 0;
+
+	if (!entry && n)
+		return -GENAVB_ERR_INVALID;
+
+	for (i = 0; i < n; i++) {
+		entry[i].rc = socket_rx_multi(entry[i].sock, entry[i].buf, entry[i].buf_len);
+		if (entry[i].rc > 0)
+			total += entry[i].rc;
+	}
+
+	return total;
+}
+
+static int socket_tx_multi(struct genavb_socket_tx *sock, struct genavb_socket_buf *buf, unsigned int n)
+{
+	struct net_tx_desc *desc[NET_TX_BATCH];
+	struct net_tx_desc *desc_now;
+	unsigned int i = 0, n_now, written = 0;
+	int rc = 0;
+
+	if (!buf)
+		return n ? -GENAVB_ERR_SOCKET_FAULT : 0;
+
+	if (!sock) {
+		rc = -GENAVB_ERR_INVALID;
+		goto out_free;
+	}
+
+	while (i < n) {
+		n_now = 0;
+
+		while ((i < n) && (n_now < NET_TX_BATCH)) {
+			desc_now = buf[i].priv;
+			buf[i].priv = NULL;
+
+			/* Frames that don't fit their buffer are dropped */
+			if (desc_now && !socket_tx_buf_commit(sock, desc_now, buf[i].len))
+				desc[n_now++] = desc_now;
+
+			i++;
+		}
+
+		if (!n_now)
+			continue;
+
+		/* On error, the backend frees the descriptors not transmitted */
+		rc = net_tx_multi(&sock->net, desc, n_now);
+		if (rc < (int)n_now) {
+			if (rc > 0)
+				written += rc;
+
+			rc = -GENAVB_ERR_SOCKET_TX;
+			goto out_free;
+		}
+
+		written += n_now;
+	}
+
+	return written;
+
+out_free:
+	for (; i < n; i++) {
+		if (buf[i].priv) {
+			net_tx_free(buf[i].priv);
+			buf[i].priv = NULL;
+		}
+	}
+
+	if (written)
+		return written;
+	else
+		return rc;
+}
+
+int genavb_socket_tx_multi(struct genavb_socket_tx_entry *entry, unsigned int n)
+{
+	int i, total = 0;
+
+	if (!entry && n)
+		return -GENAVB_ERR_INVALID;
+
+	for (i = 0; i < n; i++) {
+		entry[i].rc = socket_tx_multi(entry[i].sock, entry[i].buf, entry[i].buf_len);
+		if (entry[i].rc > 0)
+			total += entry[i].rc;
+	}
+
+	return total;
+}
+
 void genavb_socket_rx_close(struct genavb_socket_rx *sock)
 {
 	struct net_address *addr;
@@ -283,7 +609,7 @@ void genavb_socket_rx_close(struct genavb_socket_rx *sock)
 
 	addr = &sock->params.addr;
 
-	if (MAC_IS_MCAST(addr->u.l2.dst_mac)) {
+	if ((addr->ptype == PTYPE_L2) && MAC_IS_MCAST(addr->u.l2.dst_mac)) {
 		net_del_multi(&sock->net, addr->port,
 			      addr->u.l2.dst_mac);
 	}
@@ -331,6 +657,36 @@ int genavb_socket_tx(struct genavb_socket_tx *sock, void *buf, unsigned int len)
 	return -1;
 }
 
+int genavb_socket_rx_borrow(struct genavb_socket_rx *sock, struct genavb_socket_buf *buf)
+{
+	return -1;
+}
+
+void genavb_socket_rx_release(struct genavb_socket_rx *sock, struct genavb_socket_buf *buf)
+{
+	return;
+}
+
+int genavb_socket_tx_get_buf(struct genavb_socket_tx *sock, struct genavb_socket_buf *buf, unsigned int len)
+{
+	return -1;
+}
+
+int genavb_socket_tx_commit(struct genavb_socket_tx *sock, struct genavb_socket_buf *buf, unsigned int len)
+{
+	return -1;
+}
+
+int genavb_socket_rx_multi(struct genavb_socket_rx_entry *entry, unsigned int n)
+{
+	return -1;
+}
+
+int genavb_socket_tx_multi(struct genavb_socket_tx_entry *entry, unsigned int n)
+{
+	return -1;
+}
+
 void genavb_socket_rx_close(struct genavb_socket_rx *sock)
 {
 	return;
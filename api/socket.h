@@ -31,6 +31,9 @@ struct genavb_socket_rx {
 	struct net_rx net;
 	struct genavb_socket_rx_params params;
 	unsigned long priv;
+
+	struct genavb_socket_buf *multi_buf;	/* genavb_socket_rx_multi() buffers being filled */
+	unsigned int multi_n;
 };
 
 struct genavb_socket_tx {
@@ -27,6 +27,7 @@
 
 #include "common/types.h"
 #include "common/log.h"
+#include "linux/log.h"
 #include "common/ipc.h"
 
 #include "os/string.h"
@@ -77,6 +78,8 @@ void *avdecc_thread_main(void *arg)
 	};
 	int rc;
 
+	log_thread_register();
+
 	rc = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
 	if (rc) {
 		os_log(LOG_ERR, "pthread_setschedparam(), %s\n", strerror(rc));
@@ -34,6 +34,7 @@
 #include "common/avtp.h"
 #include "common/timer.h"
 #include "common/log.h"
+#include "linux/log.h"
 
 #include "os/sys_types.h"
 #include "os/clock.h"
@@ -69,6 +70,8 @@ static void *stats_thread_main(void *arg)
 	};
 	int rc;
 
+	log_thread_register();
+
 	rc = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
 	if (rc) {
 		os_log(LOG_ERR, "pthread_setschedparam(), %s\n", strerror(rc));
@@ -170,6 +173,8 @@ void *avtp_thread_main(void *arg)
 	struct process_stats stats;
 	int rc;
 
+	log_thread_register();
+
 	rc = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
 	if (rc) {
 		os_log(LOG_ERR, "pthread_setschedparam(), %s\n", strerror(rc));
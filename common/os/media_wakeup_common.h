@@ -0,0 +1,201 @@
+/*
+ * Copyright 2021 NXP
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *    Neither the name of NXP Semiconductors nor the
+ *    names of its contributors may be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _MEDIA_WAKEUP_COMMON_H_
+#define _MEDIA_WAKEUP_COMMON_H_
+
+/**
+ * DOC: Listener media queue wakeup policy
+ *
+ * OS independent part of the listener wakeup policy (see struct genavb_stream_wakeup), shared by all the OS specific media queue
+ * implementations. The OS specific code tracks pending data and received packets, and handles stream groups, since
+ * these require walking its own media queue lists under its own locks.
+ */
+
+/* Data received since the last media application read */
+struct media_wakeup_rx {
+	unsigned int packets;
+	unsigned int ts_valid;
+	uint32_t first_ts;		/* oldest valid AVTP timestamp */
+	uint32_t last_ts;		/* newest valid AVTP timestamp */
+};
+
+struct media_wakeup {
+	struct genavb_stream_wakeup policy;
+	struct media_wakeup_rx rx;
+	uint64_t wakeups;
+};
+
+static inline void media_wakeup_rx_init(struct media_wakeup_rx *rx)
+{
+	rx->packets = 0;
+	rx->ts_valid = 0;
+}
+
+static inline void media_wakeup_init(struct media_wakeup *w)
+{
+	w->policy.mode = GENAVB_STREAM_WAKEUP_BATCH;
+	media_wakeup_rx_init(&w->rx);
+	w->wakeups = 0;
+}
+
+static inline int media_wakeup_check(struct genavb_stream_wakeup const *policy)
+{
+	switch (policy->mode) {
+	case GENAVB_STREAM_WAKEUP_BATCH:
+		break;
+
+	case GENAVB_STREAM_WAKEUP_PACKETS:
+		if (!policy->packets)
+			return -1;
+		break;
+
+	case GENAVB_STREAM_WAKEUP_TIME:
+		if (!policy->time || (policy->time >= 0x80000000))
+			return -1;
+		break;
+
+	case GENAVB_STREAM_WAKEUP_GROUP:
+		if (!policy->group || (policy->group > GENAVB_STREAM_WAKEUP_GROUP_MAX))
+			return -1;
+		break;
+
+	default:
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Accounts one packet enqueued for the media application. May be called on a local media_wakeup_rx,
+ * to keep the per packet processing outside of the OS specific lock, and then merged.
+ */
+static inline void media_wakeup_rx(struct media_wakeup_rx *rx, struct media_desc *desc)
+{
+	int i;
+
+	rx->packets++;
+
+	for (i = 0; i < desc->n_ts; i++) {
+		if (desc->avtp_ts[i].flags & AVTP_FLAGS_TO_MEDIA_DESC(AVTP_TIMESTAMP_INVALID))
+			continue;
+
+		if (!rx->ts_valid) {
+			rx->first_ts = desc->avtp_ts[i].val;
+			rx->ts_valid = 1;
+		}
+
+		rx->last_ts = desc->avtp_ts[i].val;
+	}
+}
+
+static inline void media_wakeup_rx_merge(struct media_wakeup *w, struct media_wakeup_rx *rx)
+{
+	w->rx.packets += rx->packets;
+
+	if (rx->ts_valid) {
+		if (!w->rx.ts_valid) {
+			w->rx.first_ts = rx->first_ts;
+			w->rx.ts_valid = 1;
+		}
+
+		w->rx.last_ts = rx->last_ts;
+	}
+}
+
+/* Returns 1 and the oldest valid AVTP timestamp of a descriptor, starting at event index first, 0 if none */
+static inline int media_wakeup_desc_ts(struct media_desc *desc, unsigned int first, uint32_t *ts)
+{
+	unsigned int i;
+
+	for (i = first; i < desc->n_ts; i++) {
+		if (desc->avtp_ts[i].flags & AVTP_FLAGS_TO_MEDIA_DESC(AVTP_TIMESTAMP_INVALID))
+			continue;
+
+		*ts = desc->avtp_ts[i].val;
+
+		return 1;
+	}
+
+	return 0;
+}
+
+/* Returns 1 and the oldest valid AVTP timestamp of the data not read yet (partial descriptor, from its next event, then
+ * the queued descriptors), 0 if none. Must be called from the media application read side, which owns the queued
+ * descriptors.
+ */
+static inline int media_wakeup_pending_ts(struct queue *q, struct media_desc *partial, unsigned int partial_idx, uint32_t *ts)
+{
+	unsigned int n = queue_pending(q);
+	u32 read;
+
+	if (partial && media_wakeup_desc_ts(partial, partial_idx, ts))
+		return 1;
+
+	queue_dequeue_init(q, &read);
+
+	while (n--)
+		if (media_wakeup_desc_ts((struct media_desc *)queue_dequeue_next(q, &read), 0, ts))
+			return 1;
+
+	return 0;
+}
+
+/* Called each time the media application reads data, with ts_valid set and the oldest valid AVTP timestamp of the data
+ * still pending in first_ts (see media_wakeup_pending_ts()). The TIME mode span restarts from that data, not from data
+ * already read.
+ */
+static inline void media_wakeup_read(struct media_wakeup *w, int ts_valid, uint32_t first_ts)
+{
+	w->rx.packets = 0;
+
+	if (ts_valid) {
+		if (!w->rx.ts_valid)
+			w->rx.last_ts = first_ts;
+
+		w->rx.first_ts = first_ts;
+		w->rx.ts_valid = 1;
+	} else {
+		w->rx.ts_valid = 0;
+	}
+}
+
+static inline int media_wakeup_ready(struct media_wakeup *w, unsigned int avail, unsigned int batch_size)
+{
+	switch (w->policy.mode) {
+	case GENAVB_STREAM_WAKEUP_PACKETS:
+		return w->rx.packets >= w->policy.packets;
+
+	case GENAVB_STREAM_WAKEUP_TIME:
+		return w->rx.ts_valid && ((int32_t)(w->rx.last_ts - w->rx.first_ts) >= (int32_t)w->policy.time);
+
+	default:
+		return avail >= batch_size;
+	}
+}
+
+#endif /* _MEDIA_WAKEUP_COMMON_H_ */
@@ -0,0 +1,448 @@
+/*
+ * Copyright 2014-2015 Freescale Semiconductor, Inc.
+ * Copyright 2017-2021 NXP
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *    Neither the name of NXP Semiconductors nor the
+ *    names of its contributors may be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * DOC: Transmit QoS (FQTSS)
+ *
+ * ** Shaper logic **
+ *
+ * One shaper per stream
+ * One shaper per SR class
+ *
+ * Shaper uses credit, credit_min, rate, pending variables.
+ * credit_min is an optimization, and allows us to know if the credit would become positive sometime in
+ * the current scheduling interval. If so, the stream can still transmit.
+ *
+ * Pending - packets are available
+ * Scheduled - packets are available and credit is >= credit_min
+ *
+ * Stream can transmit if associated shaper credit is >= credit_min
+ * Credit is decremented by amount of bytes transmitted
+ * Credit increments based on SR class interval timer and shaper rate
+ * Credit is incremented once, at the start of the interval
+ * If packets are pending, credit can go above zero
+ * If packets are not pending, maximum credit is 0
+ * Transitions between pending/!pending need to be tracked to correctly account positive credit
+ * We only care about detecting !pending -> pending transitions, since the credit is not used otherwise
+ *
+ * Class shapping, similar to above, but class is pending only if at least one of it's streams is scheduled.
+ * !pending -> pending transitions can happen not only when packets are enqueued/dequeued, but also
+ * when timer increases queue credits. We should also determine precisely when the first queue of a class
+ * becomes active.
+ *
+ * ** Scheduler logic **
+ *
+ * Queues from the same class are scheduled in round-robin order
+ *
+ * Queues from different classes are scheduled in strict priority order
+ *
+ * ** Design details **
+ *
+ * To avoid too much overhead, in a single interval we make several scheduling decisions based
+ * on the state of the different queues/shapers/schedulers at the beginning of the interval. The only
+ * limit is to not queue more than 125us worth of data. This is done by using a minimal credit per shaper
+ * such that all possible packets are scheduled in the interval.
+ *
+ * This introduces two type of errors:
+ * - If new packets arrive during the 125us period they will not be taken into account in the schedule
+ * decisions.
+ * - Packets are not transmitted uniformly in the interval. All packets that would be scheduled inside the interval
+ * (by a prefect shaper with byte granularity) are transmitted in a burst.
+ *
+ */
+
+/* OS specific, implemented by the code including this file */
+static inline unsigned int queue_tx_ready(struct sr_class *class, struct stream_queue *stream);
+static int sr_class_tx(struct port_qos *port, struct traffic_class *tc, struct qos_queue *qos_q);
+static int traffic_class_tx(struct port_qos *port, struct traffic_class *tc, struct qos_queue *qos_q);
+static void sr_class_interval_start(struct traffic_class *tc);	/* called at the start of each SR class interval */
+
+/* Return number of leading zeros in a BITS_PER_LONG-bit word */
+static inline unsigned long leading_zeros(unsigned long x)
+{
+#if defined(__arm__) || defined(__aarch64__)
+	unsigned long ret;
+
+	__asm("clz\t%0, %1" : "=r" (ret) : "r" (x));
+
+	return ret;
+#else
+	if (!x)
+		return BITS_PER_LONG;
+
+	return __builtin_clzl(x);
+#endif
+}
+
+static inline void incr_credit(int *credit, unsigned int dt, unsigned int rate)
+{
+	/* Given a maximum rate of ~15625 bytes/125us, this guarantees the credit never overflows */
+	if ((dt > 0x10000) || (*credit >= 0x40000000))
+		*credit = 0x40000000;
+	else
+		*credit += dt * rate;
+}
+
+static inline void stream_incr_credit(struct stream_queue *stream, unsigned int tnow)
+{
+	incr_credit(&stream->shaper.credit, tnow - stream->shaper.tlast, stream->shaper.rate);
+
+	stream->shaper.tlast = tnow;
+}
+
+static inline struct qos_queue *round_robin_scheduler(struct traffic_class *tc)
+{
+	unsigned long smask = tc->scheduled_mask;
+	unsigned long slast = tc->slast;
+	unsigned long i;
+
+	if (likely(slast)) {
+		smask <<= BITS_PER_LONG - slast;
+		i = leading_zeros(smask);
+		if (i < BITS_PER_LONG) {
+			i = slast - i - 1;
+			goto found;
+		}
+	}
+
+	smask = tc->scheduled_mask >> slast;
+	i = leading_zeros(smask);
+	if (i < BITS_PER_LONG) {
+		i = slast + (BITS_PER_LONG - i - 1);
+		goto found;
+	}
+
+	return NULL;
+
+found:
+	tc->slast = i;
+
+	return &tc->qos_queue[i];
+}
+
+/* Port credit acccounting */
+static inline void port_incr_credit(struct port_qos *port, unsigned int tnow)
+{
+	if (port->shaper.credit < 0) {
+		incr_credit(&port->shaper.credit, tnow - port->shaper.tlast, port->shaper.rate);
+		if (port->shaper.credit > 0)
+			port->shaper.credit = 0;
+	}
+
+	port->shaper.tlast = tnow;
+}
+
+static inline void port_dec_credit(struct port_qos *port, unsigned int len)
+{
+	if (unlikely(len < (ETHER_MIN_FRAME_SIZE - FCS_LEN)))
+		len = ETHER_MIN_FRAME_SIZE - FCS_LEN;
+
+	port->shaper.credit -= (len + PORT_OVERHEAD) * BITS_PER_BYTE; /* bits */
+	port->tx++;
+}
+
+static inline void shaper_init(struct shaper *s, unsigned int rate)
+{
+	s->credit = 0;
+	s->tlast = 0;
+	s->rate = rate;
+	s->credit_min = -rate;
+}
+
+static inline void shaper_add(struct shaper *s, int rate)
+{
+	s->rate += rate;
+	s->credit_min -= rate;
+}
+
+static inline void shaper_set(struct shaper *s, unsigned int rate)
+{
+	s->rate = rate;
+	s->credit_min = -rate;
+}
+
+static inline int shaper_ready(struct shaper *s)
+{
+	return (s->credit >= s->credit_min);
+}
+
+static inline void sr_class_incr_credit(struct sr_class *class, unsigned int tnow)
+{
+	incr_credit(&class->shaper.credit, tnow - class->shaper.tlast, class->shaper.rate);
+
+	class->shaper.tlast = tnow;
+}
+
+static inline void sr_class_dec_credit(struct traffic_class *tc, struct qos_queue *qos_q, unsigned int len)
+{
+	struct sr_class *class = tc->sr_class;
+	struct stream_queue *stream = qos_q->stream;
+	struct queue *queue = qos_q->queue;
+
+	if (unlikely(len < (ETHER_MIN_FRAME_SIZE - FCS_LEN)))
+		len = ETHER_MIN_FRAME_SIZE - FCS_LEN;
+
+	stream->shaper.credit -= (len + PORT_OVERHEAD) * class->scale * BITS_PER_BYTE;
+	class->shaper.credit -= (len + PORT_OVERHEAD) * class->scale * BITS_PER_BYTE;
+
+	qos_q->tx++;
+	tc->tx++;
+
+	/* Modifying shared_pending_mask races with queueing code and it may leave the bit clear with packets pending */
+	/* To work around this race we clear the bit first and then _re-check_ for pending packets. If any are pending
+	 * we set the bit again */
+	clear_bit(qos_q->index, &tc->shared_pending_mask);
+	if (!queue_tx_ready(class, stream)) {
+		if (queue_pending(queue))
+			set_bit(qos_q->index, &tc->shared_pending_mask);
+
+		class->pending_mask &= ~(1UL << qos_q->index);
+		tc->scheduled_mask &= ~(1UL << qos_q->index);
+	} else {
+		set_bit(qos_q->index, &tc->shared_pending_mask);
+
+		if (!shaper_ready(&stream->shaper))
+			tc->scheduled_mask &= ~(1UL << qos_q->index);
+	}
+}
+
+static void inline sr_class_update(struct traffic_class *tc, unsigned int tnow)
+{
+	struct sr_class *class = tc->sr_class;
+	struct qos_queue *qos_q;
+	struct stream_queue *stream;
+	unsigned long mask;
+	int i;
+
+	/* Update the status of all pending SR streams. We are interested in:
+	 * - skipping streams that are no longer connected
+	 * - correctly account for stream idle time when updating it's credit
+	 * - correctly account for class idle time when updating it's credit
+	 */
+
+	sr_class_interval_start(tc);
+
+	if (tc->scheduled_mask) {
+		/* Class was never idle */
+
+		/* Update all new pending streams */
+		mask = tc->shared_pending_mask & (~class->pending_mask);
+
+		/* loop over all streams with corresponding bit set in mask */
+		while ((i = leading_zeros(mask)) < BITS_PER_LONG) {
+			qos_q = &tc->qos_queue[BITS_PER_LONG - 1 - i];
+			stream = qos_q->stream;
+			mask &= ~(1UL << (BITS_PER_LONG - 1 - i));
+
+			if (queue_tx_ready(class, stream)) {
+				class->pending_mask |= (1UL << qos_q->index);
+
+				stream_incr_credit(stream, tnow);
+
+				if (stream->shaper.credit > 0)
+					stream->shaper.credit = 0;
+
+				if (shaper_ready(&stream->shaper))
+					tc->scheduled_mask |= (1UL << qos_q->index);
+			}
+		}
+
+		/* Update all streams already pending, but not scheduled yet */
+		mask = class->pending_mask & (~tc->scheduled_mask);
+
+		/* loop over all streams with corresponding bit set in mask */
+		while ((i = leading_zeros(mask)) < BITS_PER_LONG) {
+			qos_q = &tc->qos_queue[BITS_PER_LONG - 1 - i];
+			stream = qos_q->stream;
+			mask &= ~(1UL << (BITS_PER_LONG - 1 - i));
+
+			stream_incr_credit(stream, tnow);
+
+			if (shaper_ready(&stream->shaper))
+				tc->scheduled_mask |= (1UL << qos_q->index);
+		}
+
+		sr_class_incr_credit(class, tnow);
+
+	} else {
+		/* Complex case, the class was idle for a while
+		 * need to determine when the first stream became active */
+
+		/* Update all new pending streams */
+		mask = tc->shared_pending_mask & (~class->pending_mask);
+
+		/* loop over all streams with corresponding bit set in mask */
+		while ((i = leading_zeros(mask)) < BITS_PER_LONG) {
+			qos_q = &tc->qos_queue[BITS_PER_LONG - 1 - i];
+			stream = qos_q->stream;
+			mask &= ~(1UL << (BITS_PER_LONG - 1 - i));
+
+			if (queue_tx_ready(class, stream)) {
+				class->pending_mask |= (1UL << qos_q->index);
+
+				stream_incr_credit(stream, tnow);
+
+				if (stream->shaper.credit > 0)
+					stream->shaper.credit = 0;
+
+				if (shaper_ready(&stream->shaper))
+					tc->scheduled_mask |= (1UL << qos_q->index);
+			}
+		}
+
+		/* Update all streams already pending, but not scheduled yet */
+		mask = class->pending_mask & (~tc->scheduled_mask);
+
+		/* loop over all streams with corresponding bit set in mask */
+		while ((i = leading_zeros(mask)) < BITS_PER_LONG) {
+			qos_q = &tc->qos_queue[BITS_PER_LONG - 1 - i];
+			stream = qos_q->stream;
+			mask &= ~(1UL << (BITS_PER_LONG - 1 - i));
+
+			stream_incr_credit(stream, tnow);
+
+			if (shaper_ready(&stream->shaper))
+				tc->scheduled_mask |= (1UL << qos_q->index);
+		}
+
+		/* Update class credit, if it's no longer idle */
+		if (tc->scheduled_mask) {
+			sr_class_incr_credit(class, tnow);
+
+			if (class->shaper.credit > 0)
+				class->shaper.credit = 0;
+		}
+	}
+}
+
+static int sr_class_scheduler(struct port_qos *port, struct traffic_class *tc, unsigned int tnow)
+{
+	struct sr_class *class = tc->sr_class;
+	struct qos_queue *qos_q;
+	int rc = 0;
+
+	if (rational_int_cmp(tnow, &class->tnext) < 0)
+		goto exit;
+
+	class->sched_offset = (tnow - class->tnext.i);
+	class->tnext_gptp = port->ptp_grid.now - class->sched_offset + rational_int_mul(port->ptp_grid.period, &class->interval_ratio);
+
+	/* Credits are only incremented once per scheduling interval */
+	sr_class_update(tc, class->interval_n);
+
+	/* Transmit sr class traffic, highest priority first */
+	while (shaper_ready(&port->shaper) && shaper_ready(&class->shaper) && tc->scheduled_mask) {
+
+		qos_q = round_robin_scheduler(tc);
+
+		/* Stream credit hasn't been updated since the stream was scheduled, do it now */
+		stream_incr_credit(qos_q->stream, class->interval_n);
+
+		rc = sr_class_tx(port, tc, qos_q);
+		if (rc < 0)
+			break;
+	}
+
+	rational_add(&class->tnext, &class->tnext, &class->interval);
+	class->interval_n++;
+
+exit:
+	return rc;
+}
+
+static void inline traffic_class_update(struct traffic_class *tc)
+{
+	struct qos_queue *qos_q;
+	unsigned long mask;
+	int i;
+
+	/* Update all new pending queues */
+	mask = tc->shared_pending_mask & (~tc->scheduled_mask);
+
+	/* loop over all queues with corresponding bit set in mask */
+	while ((i = leading_zeros(mask)) < BITS_PER_LONG) {
+		qos_q = &tc->qos_queue[BITS_PER_LONG - 1 - i];
+		mask &= ~(1UL << (BITS_PER_LONG - 1 - i));
+
+		if (queue_pending(qos_q->queue))
+			tc->scheduled_mask |= (1UL << qos_q->index);
+	}
+}
+
+
+static int traffic_class_scheduler(struct port_qos *port, struct traffic_class *tc, unsigned int tnow)
+{
+	struct qos_queue *qos_q;
+	int rc = 0;
+
+	traffic_class_update(tc);
+
+	/* Transmit traffic class traffic in round robin */
+	while (shaper_ready(&port->shaper) && tc->scheduled_mask) {
+
+		qos_q = round_robin_scheduler(tc);
+
+		rc = traffic_class_tx(port, tc, qos_q);
+		if (rc < 0)
+			break;
+	}
+
+	return rc;
+}
+
+/**
+ * port_qos_schedule() - runs one port scheduling interval
+ * @port - pointer to port QoS structure
+ *
+ * Must be called once per port scheduling interval, after the port ptp grid has been updated.
+ * Transmits, in strict priority order, the traffic classes frames allowed by the port and
+ * SR class/stream shapers.
+ */
+static inline void port_qos_schedule(struct port_qos *port)
+{
+	struct traffic_class *tc;
+	unsigned int tnow = port->tnow;
+	int i;
+
+	port_incr_credit(port, port->interval_n);
+
+	port->transmit_event = 0;
+
+	/* priority scheduler */
+	for (i = CFG_TRAFFIC_CLASS_MAX - 1; i >= 0; i--) {
+		tc = &port->traffic_class[i];
+
+		if (tc->sr_class)
+			sr_class_scheduler(port, tc, tnow);
+		else
+			traffic_class_scheduler(port, tc, tnow);
+	}
+
+	port->tnow += port->interval;
+	port->interval_n++;
+}
@@ -0,0 +1,142 @@
+/*
+ * Copyright 2014-2015 Freescale Semiconductor, Inc.
+ * Copyright 2017-2021 NXP
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *    Neither the name of NXP Semiconductors nor the
+ *    names of its contributors may be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _NET_TX_COMMON_H_
+#define _NET_TX_COMMON_H_
+
+/**
+ * DOC: Transmit QoS scheduler (FQTSS)
+ *
+ * OS independent scheduler core, shared by all the OS specific network transmit implementations.
+ *
+ * OS specific code must define struct port_qos, with at least the following members:
+ * tnow, interval, interval_n, transmit_event, shaper, tx, traffic_class[] and ptp_grid (now and period),
+ * and implement, after including net_tx_common.c, the functions declared at the top of that file.
+ */
+
+#define FCS_LEN		4
+#define IFG_LEN		12
+#define PREAMBLE_LEN	8
+#define PORT_OVERHEAD	(IFG_LEN + PREAMBLE_LEN + FCS_LEN)
+
+struct shaper {
+	int credit;		/* bits x scale */
+	int credit_min;		/* bits x scale */
+	unsigned int tlast;	/* in interval units */
+	unsigned int rate;	/* bits/interval */
+};
+
+
+#define QOS_QUEUE_FLAG_CONNECTED	(1 << 0)
+#define QOS_QUEUE_FLAG_ENABLED		(1 << 1)
+
+struct qos_queue {
+	struct traffic_class *tc;
+
+	struct stream_queue *stream;
+
+	unsigned int index;
+
+	struct queue *queue;
+
+	unsigned int flags;
+	unsigned long atomic_flags;
+
+	unsigned int tx;
+	unsigned int dropped;
+	unsigned int full;
+	unsigned int disabled;
+};
+
+#define STREAM_FLAGS_CONNECTED	(1 << 0)
+#define STREAM_FLAGS_CONFIGURED	(1 << 1)
+#define STREAM_FLAGS_USED	(STREAM_FLAGS_CONNECTED | STREAM_FLAGS_CONFIGURED)
+
+struct stream_queue {
+	struct shaper shaper;
+	unsigned int idle_slope;		/* bits/s */
+	struct sr_class *sr_class;
+	struct qos_queue *qos_queue;
+
+	u16 vlan_label;		/* In Big Endian */
+	u8 id[8];
+	unsigned int flags;
+
+#ifdef PORT_TRACE
+	unsigned int burst;
+	unsigned int burst_max;
+#endif
+};
+
+struct sr_class {
+	/* Private to tx context */
+	struct shaper shaper;
+
+	unsigned int flags;
+
+	sr_class_t class;
+	struct traffic_class *tc;
+	unsigned int stream_max;
+	unsigned int streams;
+
+	unsigned int idle_slope;		/* bits/s */
+
+	struct rational interval;		/* class scheduling interval (in nanoseconds) */
+	struct rational interval_ratio;		/* class to port scheduling interval ratio */
+	struct rational tnext;			/* class next scheduling interval (in nanoseconds) */
+	unsigned int tnext_gptp;
+	unsigned int sched_offset;
+	unsigned int interval_n;		/* class interval count */
+	unsigned int scale;			/* class subintervals, for software scheduling */
+
+	unsigned long int pending_mask;
+
+	struct stream_queue stream[CFG_SR_CLASS_STREAM_MAX];
+};
+
+
+struct traffic_class {
+	struct sr_class *sr_class;		/* Set only if the traffic class is an SR class */
+
+	unsigned int index;
+	unsigned int hw_queue_id;
+	unsigned int flags;
+
+	struct qos_queue qos_queue[CFG_TRAFFIC_CLASS_QUEUE_MAX];	/* array of queues assigned to this traffic class */
+
+	unsigned long scheduled_mask;		/* bit mask of queues that can transmit packets */
+	unsigned long disabled_mask;		/* bit mask of queues whose packets must be dropped */
+	unsigned long slast;
+
+	unsigned int tx;
+
+	/* Shared with enqueue code */
+	unsigned long shared_pending_mask;	/* bit mask of queues with pending packets */
+};
+
+#endif /* _NET_TX_COMMON_H_ */
@@ -0,0 +1,141 @@
+/*
+ * Copyright 2014-2015 Freescale Semiconductor, Inc.
+ * Copyright 2021 NXP
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *    Neither the name of NXP Semiconductors nor the
+ *    names of its contributors may be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * DOC: Rational number handling functions
+ *
+ * OS specific code must define, before including this file:
+ * rational_err() - error logging, printf() like arguments
+ * rational_do_div(n, base) - divides the 64bit n by the 32bit base, stores the quotient in n and returns the remainder
+ */
+
+/* rational_reduce() - makes sure p/q < 1
+ *
+ */
+static inline void rational_reduce(struct rational *r)
+{
+	if (r->p >= r->q) {
+		/* Optimize the common case */
+		r->i++;
+		r->p -= r->q;
+
+		if (r->p >= r->q) {
+			unsigned int n = r->p / r->q;
+
+			r->i += n;
+			r->p -= n * r->q;
+		}
+	}
+}
+
+/**
+ * rational_init() -
+ */
+void rational_init(struct rational *r, unsigned long long p, unsigned int q)
+{
+	if (!q) {
+		rational_err("0 denominator (%llu/%u)\n", p, q);
+		q = 1;
+	}
+
+	r->p = rational_do_div(p, q);
+
+	if (p > 0xffffffff)
+		rational_err("32bit integer overflow (%llu)\n", p);
+
+	r->i = p;
+	r->q = q;
+
+	rational_reduce(r);
+}
+
+/**
+ * rational_add() - adds two rational numbers r = r1 + r2
+ */
+void rational_add(struct rational *r, struct rational *r1, struct rational *r2)
+{
+	r->i = r1->i + r2->i;
+
+	if (r1->q == r2->q) {
+		r->p = r1->p + r2->p;
+		r->q = r1->q;
+	} else {
+		/* Slow path, may overflow */
+		r->p = r1->p * r2->q + r2->p * r1->q;
+		r->q = r1->q * r2->q;
+	}
+
+	rational_reduce(r);
+}
+
+
+/**
+ * rational_div() - divides two rational numbers r = r1 / r2
+ * Fast but overflow easily.
+ */
+void rational_div(struct rational *r, struct rational *r1, struct rational *r2)
+{
+	unsigned int p, q;
+
+	p = (r1->i * r1->q + r1->p) * r2->q;
+	q = (r2->i * r2->q + r2->p) * r1->q;
+
+	rational_init(r, p, q);
+}
+
+/**
+ * rational_cmp() - compares two rational numbers in reduced form
+ */
+int rational_cmp(struct rational *r1, struct rational *r2)
+{
+	if (((int)r1->i - (int)r2->i) > 0)
+		return 1;
+	else if (((int)r1->i - (int)r2->i) < 0)
+		return -1;
+	else {
+		if (r1->q == r2->q) {
+			if (r1->p > r2->p)
+				return 1;
+			else if (r1->p == r2->p)
+				return 0;
+			else
+				return -1;
+		} else {
+			/* Slow path, may overflow */
+			unsigned int r1p = r1->p * r2->q;
+			unsigned int r2p = r2->p * r1->q;
+
+			if (r1p > r2p)
+				return 1;
+			else if (r1p == r2p)
+				return 0;
+			else
+				return -1;
+		}
+	}
+}
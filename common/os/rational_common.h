@@ -0,0 +1,96 @@
+/*
+ * Copyright 2014-2015 Freescale Semiconductor, Inc.
+ * Copyright 2021 NXP
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *    Neither the name of NXP Semiconductors nor the
+ *    names of its contributors may be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _RATIONAL_COMMON_H_
+#define _RATIONAL_COMMON_H_
+
+struct rational {
+	/* Stores a positive rational number in the form: a = i + p/q, with p/q < 1 */
+	unsigned int i; /* integer part */
+	unsigned int p; /* fractional part numerator */
+	unsigned int q; /* fractional part denominator */
+};
+
+void rational_init(struct rational *r, unsigned long long p, unsigned int q);
+void rational_add(struct rational *r, struct rational *r1, struct rational *r2);
+void rational_div(struct rational *r, struct rational *r1, struct rational *r2);
+int rational_cmp(struct rational *r1, struct rational *r2);
+
+/**
+ * rational_int_mul() - multiplies an unsigned integer by a rational
+ */
+static inline unsigned int rational_int_mul(unsigned int i, struct rational *r)
+{
+	return (i * r->i) + (i * r->p) / r->q;
+}
+
+/**
+ * rational_int_mul2() - multiplies a rational by an unsigned integer
+ */
+static inline void rational_int_mul2(struct rational *r, struct rational *r1, unsigned int i)
+{
+	rational_init(r, i * ((unsigned long long)r1->i * r1->q + r1->p), r1->q);
+}
+
+/**
+ * rational_int_div() - divides a rational by an unsigned integer
+ */
+static inline void rational_int_div(struct rational *r, struct rational *r1, unsigned int i)
+{
+	rational_init(r, (unsigned long long)r1->i * r1->q + r1->p, i * r1->q);
+}
+
+
+/**
+ * rational_int_cmp() - compares an unsigned integer and a rational
+ */
+static inline int rational_int_cmp(unsigned int i, struct rational *r)
+{
+	if (((int)i - (int)r->i) > 0)
+		return 1;
+	else if (((int)i - (int)r->i) < 0)
+		return -1;
+	else if (r->p == 0)
+		return 0;
+	else
+		return -1;
+}
+
+
+/**
+ * rational_int_add() - adds an unsigned integer with a rational
+ */
+static inline void rational_int_add(struct rational *r, unsigned int i, struct rational *r1)
+{
+	r->i = i + r1->i;
+	r->p = r1->p;
+	r->q = r1->q;
+}
+
+
+#endif /* _RATIONAL_COMMON_H_ */
@@ -88,29 +88,37 @@ err:
 	return -1;
 }
 
+static int hr_timer_less(struct pheap_node *a, struct pheap_node *b)
+{
+	return container_of(a, struct hr_timer, node)->next_event < container_of(b, struct hr_timer, node)->next_event;
+}
+
 static void hr_timer_task_run(struct hr_timer_task_ctx *timer_task)
 {
 	int i;
 	uint64_t expires_next = UINT64_MAX;
 
 	for (i = 0; i < OS_CLOCK_MAX; i++) {
-		struct slist_node *entry, *next;
-		struct slist_head *head;
+		struct pheap_head *head;
+		struct pheap_node *reload = NULL;
 		struct hr_timer *t;
 		uint64_t now, next_event, expire;
 
 		head = &timer_task->pending[i];
 
-		if (slist_empty(head))
+		if (pheap_empty(head))
 			continue;
 
-		slist_for_each_safe(head, entry, next) {
-			t = container_of(entry, struct hr_timer, node);
+		t = container_of(pheap_first(head), struct hr_timer, node);
 
-			if (os_clock_gettime64(i, &now) < 0) {
-				t->stats.err_clock++;
-				continue;
-			}
+		if (os_clock_gettime64(i, &now) < 0) {
+			t->stats.err_clock++;
+			continue;
+		}
+
+		/* Only the timers in the ratio window are programmed, the others expire later */
+		while (!pheap_empty(head)) {
+			t = container_of(pheap_first(head), struct hr_timer, node);
 
 			next_event = t->next_event;
 
@@ -119,44 +127,75 @@ static void hr_timer_task_run(struct hr_timer_task_ctx *timer_task)
 			else
 				expire = HR_TIMER_MIN_DELTA_NS;
 
-			if (expire <= HR_TIMER_RATIO_WND_NS) {
-				if (expire <= HR_TIMER_MIN_DELTA_NS)
-					next_event = now + HR_TIMER_MIN_DELTA_NS;
+			if (expire > HR_TIMER_RATIO_WND_NS)
+				break;
+
+			pheap_pop(head);
 
-				atomic_set(&t->irq_pending, 1);
+			if (expire <= HR_TIMER_MIN_DELTA_NS)
+				next_event = now + HR_TIMER_MIN_DELTA_NS;
 
-				if (hr_timer_program_next_event(t, next_event) < 0)
-					os_log(LOG_ERR, "timer(%p) error programming next event\n", t);
+			atomic_set(&t->irq_pending, 1);
 
-				os_log(LOG_DEBUG, "timer(%p) next event programmed: %llu, %llu, %llu\n",
-									t, expire, next_event, now);
+			if (hr_timer_program_next_event(t, next_event) < 0)
+				os_log(LOG_ERR, "timer(%p) error programming next event\n", t);
 
-				if (!t->period || t->irq_reload) {
-					atomic_set(&t->enqueued, 0);
-					slist_del(head, &t->node);
-					continue;
-				} else {
-					t->next_event += t->period;
-					expire += t->period;
-				}
+			os_log(LOG_DEBUG, "timer(%p) next event programmed: %llu, %llu, %llu\n",
+								t, expire, next_event, now);
+
+			if (!t->period || t->irq_reload) {
+				atomic_set(&t->enqueued, 0);
+			} else {
+				/* Queued again once all the timers of the clock are processed (node is free until then) */
+				t->next_event += t->period;
+				t->node.next = reload;
+				reload = &t->node;
 			}
+		}
 
-			if (expire < expires_next)
-				expires_next = expire;
+		while (reload) {
+			struct pheap_node *node = reload;
+
+			reload = node->next;
+			pheap_insert(head, node);
 		}
+
+		if (pheap_empty(head))
+			continue;
+
+		t = container_of(pheap_first(head), struct hr_timer, node);
+
+		if (likely(now < t->next_event))
+			expire = t->next_event - now;
+		else
+			expire = HR_TIMER_MIN_DELTA_NS;
+
+		if (expire < expires_next)
+			expires_next = expire;
 	}
 
-	if (expires_next != UINT64_MAX)
-		hr_timer_task_schedule(timer_task, expires_next - HR_TIMER_RATIO_WND_NS / 8);
+	if (expires_next != UINT64_MAX) {
+		if (expires_next > HR_TIMER_RATIO_WND_NS / 8)
+			expires_next -= HR_TIMER_RATIO_WND_NS / 8;
+		else
+			expires_next = 0;
+
+		hr_timer_task_schedule(timer_task, expires_next);
+	}
 
 	timer_task->stats.run++;
 }
 
 static void hr_timer_task_enqueue(struct hr_timer_task_ctx *timer_task, struct hr_timer *t)
 {
+	struct pheap_head *head = &timer_task->pending[t->clk_id];
+
 	os_log(LOG_DEBUG, "enqueue t(%p) clk_id: %d\n", t, t->clk_id);
 
-	slist_add_head(&timer_task->pending[t->clk_id], &t->node);
+	if (atomic_read(&t->enqueued))
+		pheap_del(head, &t->node);
+
+	pheap_insert(head, &t->node);
 
 	atomic_set(&t->enqueued, 1);
 
@@ -171,20 +210,11 @@ static void hr_timer_task_enqueue(struct hr_timer_task_ctx *timer_task, struct h
 
 static void hr_timer_task_cancel(struct hr_timer_task_ctx *timer_task, struct hr_timer *t)
 {
-	struct slist_node *entry, *next;
-	struct slist_head *head = &timer_task->pending[t->clk_id];
-	struct hr_timer *timer_pending;
-
 	os_log(LOG_DEBUG, "cancel t(%p) clk_id: %d\n", t, t->clk_id);
 
 	if (atomic_read(&t->enqueued)) {
-		slist_for_each_safe(head, entry, next) {
-			timer_pending = container_of(entry, struct hr_timer, node);
-			if (timer_pending == t) {
-				slist_del(head, &timer_pending->node);
-				break;
-			}
-		}
+		pheap_del(&timer_task->pending[t->clk_id], &t->node);
+		atomic_set(&t->enqueued, 0);
 	}
 
 	xEventGroupSetBits(t->event_group_handle, HR_TIMER_SUCCESS);
@@ -233,12 +263,15 @@ static void hr_timer_task(void *pvParameters)
 
 __init int hr_timer_init(void)
 {
-	int rc;
+	int i, rc;
 	struct hr_timer_task_ctx *task_ctx;
 
 	hr_timer_drv_h = &hr_timer_drv;
 	task_ctx = &hr_timer_drv_h->task_ctx;
 
+	for (i = 0; i < OS_CLOCK_MAX; i++)
+		pheap_head_init(&task_ctx->pending[i], hr_timer_less);
+
 	hr_timer_drv_h->lock = xSemaphoreCreateMutexStatic(&hr_timer_drv_h->lock_buffer);
 	if (!hr_timer_drv_h->lock) {
 		os_log(LOG_ERR, "xSemaphoreCreateMutexStatic failed\n");
@@ -407,9 +440,10 @@ int hr_timer_start(struct hr_timer *t, u64 value, u64 interval_p, u64 interval_q
 			t->irq_reload = 1;
 		else
 			t->irq_reload = 0;
-	}
-	else
+	} else {
 		t->period = 0;
+		t->irq_reload = 0;
+	}
 
 	if (hr_timer_enqueue(&hr_timer_drv_h->task_ctx, t) < 0)
 		goto err;
@@ -22,6 +22,7 @@
 #include "os/clock.h"
 #include "os/sys_types.h"
 #include "slist.h"
+#include "pairing_heap.h"
 
 #include "FreeRTOS.h"
 #include "timers.h"
@@ -52,7 +53,7 @@ struct hr_timer {
 	os_clock_id_t clk_id;
 
 	struct hw_timer *hw_timer;
-	struct slist_node node;
+	struct pheap_node node;
 	struct slist_node node_drv;
 
 	void (*func)(void *data, int count);
@@ -89,7 +90,7 @@ struct hr_timer_task_ctx {
 	TimerHandle_t timeout_handle;
 	StaticTimer_t timeout_buffer;
 
-	struct slist_head pending[OS_CLOCK_MAX];
+	struct pheap_head pending[OS_CLOCK_MAX];	/* per clock pending timers, ordered by next_event */
 
 	struct hr_timer_task_stats stats;
 };
@@ -53,7 +53,9 @@
  * 	IPC message queue is on reader side.
  * 	When a reader exits, it's message queue is flushed/free.
  * 	Writer can send messages to all readers (indications) or one in particular (responses).
- * 	When sending to all readers, one new message is allocated for each and the original message is copied and finally free.
+ * 	When sending to all readers, the original message is shared by all readers (read only) and freed by the last one.
+ * 	Each reader is still accounted for the message, as if it was allocated from its slot.
+ * 	If too many shared messages are in flight, one new message is allocated for each reader and the original message is copied and finally free.
  * 	When sending to a specific reader, message slot is moved from writer to reader
  *
  * IPC_TYPE_MANY_WRITERS
@@ -68,6 +70,8 @@
 
 #define IPC_MAX_PENDING		20
 
+#define IPC_MAX_SHARED		IPC_MAX_PENDING
+
 /*
  * To avoid excessive memory fragmentation define ipc memory allocation
  * sizes same as for net_tx/net_rx
@@ -106,6 +110,11 @@ struct ipc_dst_map {
 	struct ipc_slot *dst_slot;
 };
 
+struct ipc_shared_desc {
+	struct ipc_desc *desc;
+	uint16_t holders;	/* bitmask of reader slots holding the message */
+};
+
 struct ipc_channel {
 	unsigned int type;
 
@@ -117,6 +126,9 @@ struct ipc_channel {
 	struct ipc_dst_map dst_map[IPC_MAX_READER_WRITERS + 1];
 
 	unsigned int last;
+
+	struct ipc_shared_desc shared[IPC_MAX_SHARED];
+	unsigned int shared_count;
 };
 
 static struct ipc_channel ipc_channel[IPC_ID_MAX] = {
@@ -216,13 +228,45 @@ struct ipc_desc *ipc_alloc(struct ipc_tx const *tx, unsigned int size)
 	return __ipc_alloc(tx->ipc_slot, size);
 }
 
+/* Must be called with interrupts disabled */
+static struct ipc_shared_desc *ipc_shared_find(struct ipc_channel *ipc, struct ipc_desc *desc)
+{
+	int i;
+
+	if (!ipc->shared_count)
+		return NULL;
+
+	for (i = 0; i < IPC_MAX_SHARED; i++)
+		if (ipc->shared[i].desc == desc)
+			return &ipc->shared[i];
+
+	return NULL;
+}
+
 static void __ipc_free(struct ipc_slot *slot, struct ipc_desc *desc)
 {
+	struct ipc_shared_desc *shared;
+
 	taskENTER_CRITICAL();
 
 	if (slot && slot->count)
 		slot->count--;
 
+	/* Shared broadcast message, only free it when the last reader releases it */
+	if (slot && slot->index && (slot->ipc->type == IPC_TYPE_MANY_READERS)) {
+		shared = ipc_shared_find(slot->ipc, desc);
+		if (shared) {
+			shared->holders &= ~(1 << slot->index);
+			if (shared->holders) {
+				taskEXIT_CRITICAL();
+				return;
+			}
+
+			shared->desc = NULL;
+			slot->ipc->shared_count--;
+		}
+	}
+
 	taskEXIT_CRITICAL();
 
 	vPortFree(desc);
@@ -233,6 +277,47 @@ void ipc_free(void const *ipc, struct ipc_desc *desc)
 	__ipc_free(((struct ipc_tx *)ipc)->ipc_slot, desc);
 }
 
+void ipc_free_multi(void const *ipc, struct ipc_desc **desc, unsigned int n)
+{
+	unsigned int i;
+
+	for (i = 0; i < n; i++)
+		__ipc_free(((struct ipc_tx *)ipc)->ipc_slot, desc[i]);
+}
+
+
+/**
+ * ipc_shared_release() - Drops the references of an exiting reader to shared broadcast messages
+ * @ipc: pointer to the IPC channel
+ * @index: reader slot index
+ *
+ * Covers the messages the reader dequeued but never freed. Messages no longer referenced by any reader are freed.
+ */
+static void ipc_shared_release(struct ipc_channel *ipc, unsigned int index)
+{
+	struct ipc_desc *desc;
+	int i;
+
+	for (i = 0; i < IPC_MAX_SHARED; i++) {
+		desc = NULL;
+
+		taskENTER_CRITICAL();
+
+		if (ipc->shared[i].desc && (ipc->shared[i].holders & (1 << index))) {
+			ipc->shared[i].holders &= ~(1 << index);
+			if (!ipc->shared[i].holders) {
+				desc = ipc->shared[i].desc;
+				ipc->shared[i].desc = NULL;
+				ipc->shared_count--;
+			}
+		}
+
+		taskEXIT_CRITICAL();
+
+		if (desc)
+			vPortFree(desc);
+	}
+}
 
 static int ipc_is_free_slot(struct ipc_channel *ipc, unsigned int i)
 {
@@ -337,6 +422,79 @@ err:
 	return -1;
 }
 
+/*
+ * Queues the same message to all the readers of an IPC_TYPE_MANY_READERS channel, without any copy.
+ * Must be called with the channel mutex held. On success the message is owned by the readers.
+ * Returns -1 if too many shared messages are in flight.
+ */
+static int ipc_tx_shared(struct ipc_channel *ipc, struct ipc_slot *slot, struct ipc_desc *desc, unsigned int *wakeup)
+{
+	struct ipc_shared_desc *shared = NULL;
+	struct ipc_slot *rx_slot;
+	uint16_t holders = 0;
+	int rc;
+	int i;
+
+	taskENTER_CRITICAL();
+
+	for (i = 0; i < IPC_MAX_SHARED; i++) {
+		if (!ipc->shared[i].desc) {
+			shared = &ipc->shared[i];
+			break;
+		}
+	}
+
+	if (!shared) {
+		taskEXIT_CRITICAL();
+		return -1;
+	}
+
+	/* Take one message credit per reader, as a per reader copy would */
+	for (i = 1; i <= IPC_MAX_READER_WRITERS; i++) {
+		rx_slot = ipc->slot[i];
+
+		if (ipc_is_disabled_slot(rx_slot) || (rx_slot->count >= IPC_MAX_PENDING))
+			continue;
+
+		rx_slot->count++;
+		holders |= 1 << i;
+	}
+
+	if (holders) {
+		shared->desc = desc;
+		shared->holders = holders;
+		ipc->shared_count++;
+	}
+
+	/* Message moves from the writer to the readers */
+	if (slot->count)
+		slot->count--;
+
+	taskEXIT_CRITICAL();
+
+	if (!holders) {
+		vPortFree(desc);
+		return 0;
+	}
+
+	desc->src = 0;
+
+	for (i = 1; i <= IPC_MAX_READER_WRITERS; i++) {
+		if (!(holders & (1 << i)))
+			continue;
+
+		rx_slot = ipc->slot[i];
+
+		rc = ipc_tx_slot(rx_slot, rx_slot, desc);
+		if (rc < 0)
+			__ipc_free(rx_slot, desc);
+		else
+			*wakeup |= rc;
+	}
+
+	return 0;
+}
+
 int ipc_rx_init(struct ipc_rx *rx, 
 		ipc_id_t id, void (*func)(struct ipc_rx const *, struct ipc_desc *), unsigned long priv)
 {
@@ -450,9 +608,15 @@ void ipc_rx_exit(struct ipc_rx *rx)
 	rx->func = NULL;
 	rx->priv = 0;
 
+	/* Release the shared messages with the channel still locked, so that the slot index is not reused in the meantime */
+	if (ipc->type == IPC_TYPE_MANY_READERS) {
+		ipc_flush_queue(slot);
+		ipc_shared_release(ipc, slot->index);
+	}
+
 	xSemaphoreGive(ipc->mutex);
 
-	if (ipc->type != IPC_TYPE_MANY_WRITERS)
+	if (ipc->type == IPC_TYPE_SINGLE_READER_WRITER)
 		ipc_flush_queue(slot);
 
 	vPortFree(slot);
@@ -675,6 +839,9 @@ int ipc_tx(struct ipc_tx const *tx, struct ipc_desc *desc)
 	case IPC_TYPE_MANY_READERS:
 		if (desc->dst == IPC_DST_ALL) {
 
+			if (!ipc_tx_shared(ipc, slot, desc, &wakeup))
+				break;
+
 			for (i = 1; i <= IPC_MAX_READER_WRITERS; i++) {
 				rx_slot = ipc->slot[i];
 
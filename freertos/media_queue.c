@@ -45,6 +45,9 @@
 
 #define MEDIA_QUEUE_MAX	12
 
+#define MEDIA_WAKEUP_READ		1	/* no valid AVTP timestamp in the data not read yet */
+#define MEDIA_WAKEUP_READ_TS		2	/* oldest valid AVTP timestamp not read yet in wakeup_first_ts */
+
 struct media_queue_table {
 	struct media_queue *mqueue;
 	uint8_t	stream_id[8];
@@ -92,9 +95,77 @@ static inline unsigned int media_queue_eofs(struct media_queue *mqueue)
 	return atomic_read(&mqueue->eofs);
 }
 
+static inline int media_queue_wakeup_ready(struct media_queue *mqueue)
+{
+	return media_wakeup_ready(&mqueue->wakeup, media_queue_avail(mqueue), mqueue->batch_size);
+}
+
+static inline int media_queue_wakeup_group_member(struct media_queue *mqueue, unsigned int group)
+{
+	return mqueue && (mqueue->wakeup.policy.mode == GENAVB_STREAM_WAKEUP_GROUP) && (mqueue->wakeup.policy.group == group);
+}
+
+/* Called with table mutex held */
+static int media_queue_wakeup_group_ready(unsigned int group)
+{
+	int i;
+
+	for (i = 0; i < MEDIA_QUEUE_MAX; i++) {
+		struct media_queue *member = mqueue_table[i].mqueue;
+
+		if (media_queue_wakeup_group_member(member, group) && !media_queue_wakeup_ready(member))
+			return 0;
+	}
+
+	return 1;
+}
+
+/* Called with table mutex held. Media application reads are lockless, so they are only accounted here. */
+static void media_queue_wakeup_update(struct media_queue *mqueue)
+{
+	unsigned int read = atomic_xchg(&mqueue->wakeup_read, 0);
+
+	if (read)
+		media_wakeup_read(&mqueue->wakeup, read == MEDIA_WAKEUP_READ_TS, mqueue->wakeup_first_ts);
+}
+
+/* Called with table mutex held */
 static inline int need_to_wake_up_listener_queue(struct media_queue *mqueue)
 {
-	return (media_queue_avail(mqueue) >= mqueue->batch_size) || queue_full(&mqueue->queue) || media_queue_eofs(mqueue);
+	if (queue_full(&mqueue->queue) || media_queue_eofs(mqueue))
+		return 1;
+
+	if (mqueue->wakeup.policy.mode == GENAVB_STREAM_WAKEUP_GROUP)
+		return media_queue_wakeup_group_ready(mqueue->wakeup.policy.group);
+
+	return media_queue_wakeup_ready(mqueue);
+}
+
+/* Called with table mutex held */
+static void media_queue_api_wake_up(struct media_queue *mqueue)
+{
+	if (mqueue->callback_enabled) {
+		mqueue->wakeup.wakeups++;
+		mqueue->callback(mqueue->callback_data);
+		mqueue->callback_enabled = false;
+	}
+}
+
+/* Called with table mutex held. In group mode, the last stream to become ready wakes up all the streams of the group. */
+static void media_queue_listener_wake_up(struct media_queue *mqueue)
+{
+	int i;
+
+	if (queue_full(&mqueue->queue) || media_queue_eofs(mqueue)) {
+		media_queue_api_wake_up(mqueue);
+	} else if (mqueue->wakeup.policy.mode == GENAVB_STREAM_WAKEUP_GROUP) {
+		if (media_queue_wakeup_group_ready(mqueue->wakeup.policy.group))
+			for (i = 0; i < MEDIA_QUEUE_MAX; i++)
+				if (media_queue_wakeup_group_member(mqueue_table[i].mqueue, mqueue->wakeup.policy.group))
+					media_queue_api_wake_up(mqueue_table[i].mqueue);
+	} else if (media_queue_wakeup_ready(mqueue)) {
+		media_queue_api_wake_up(mqueue);
+	}
 }
 
 static void mqueue_flush_partial(struct media_queue *mqueue)
@@ -341,6 +412,9 @@ int media_api_open(struct media_queue *mqueue, struct media_queue_api_params *pa
 	atomic_set(&mqueue->available, 0);
 	atomic_set(&mqueue->eofs, 0);
 
+	media_wakeup_init(&mqueue->wakeup);
+	atomic_set(&mqueue->wakeup_read, 0);
+
 	mqueue->id = entry;
 
 	xSemaphoreGive(table_mutex);
@@ -729,7 +803,14 @@ exit:
 	}
 
 early_exit:
-	atomic_sub(total_read, &mqueue->available);
+	if (total_read) {
+		atomic_sub(total_read, &mqueue->available);
+
+		if (media_wakeup_pending_ts(&mqueue->queue, mqueue->partial_desc, mqueue->event_src_idx, &mqueue->wakeup_first_ts))
+			atomic_set(&mqueue->wakeup_read, MEDIA_WAKEUP_READ_TS);
+		else
+			atomic_set(&mqueue->wakeup_read, MEDIA_WAKEUP_READ);
+	}
 
 	if (event_len)
 		*event_len = event_info.total_read;
@@ -1047,8 +1128,12 @@ int media_api_enable_callback(struct media_queue *mqueue)
 			if (media_queue_remaining(mqueue) >= mqueue->batch_size)
 				mqueue->callback(mqueue->callback_data);
 		} else {
-			if (need_to_wake_up_listener_queue(mqueue))
+			media_queue_wakeup_update(mqueue);
+
+			if (need_to_wake_up_listener_queue(mqueue)) {
+				mqueue->wakeup.wakeups++;
 				mqueue->callback(mqueue->callback_data);
+			}
 		}
 	}
 
@@ -1059,6 +1144,41 @@ out:
 	return rc;
 }
 
+int media_api_set_wakeup(struct media_queue *mqueue, struct genavb_stream_wakeup const *wakeup)
+{
+	struct media_queue_table *entry = mqueue->id;
+	int rc = 0;
+
+	/* Wakeup policies only apply to listener streams */
+	if (entry->flags & MEDIA_QUEUE_FLAGS_TALKER) {
+		rc = -1;
+		goto out;
+	}
+
+	if (media_wakeup_check(wakeup) < 0) {
+		rc = -1;
+		goto out;
+	}
+
+	xSemaphoreTake(table_mutex, portMAX_DELAY);
+
+	mqueue->wakeup.policy = *wakeup;
+
+	xSemaphoreGive(table_mutex);
+
+out:
+	return rc;
+}
+
+void media_api_get_stats(struct media_queue *mqueue, struct genavb_stream_stats *stats)
+{
+	xSemaphoreTake(table_mutex, portMAX_DELAY);
+
+	stats->wakeups = mqueue->wakeup.wakeups;
+
+	xSemaphoreGive(table_mutex);
+}
+
 int media_net_open(struct media_queue_net_params *params, unsigned int talker)
 {
 	struct media_queue_table *entry;
@@ -1120,6 +1240,7 @@ int media_net_write(int id, struct media_desc **desc_array, unsigned int n)
 {
 	struct media_queue *mqueue;
 	struct media_desc *desc;
+	struct media_wakeup_rx wakeup_rx;
 	unsigned int desc_len, written = 0;
 	uint32_t qa, write;
 	int i;
@@ -1136,6 +1257,8 @@ int media_net_write(int id, struct media_desc **desc_array, unsigned int n)
 
 	queue_enqueue_init(&mqueue->queue, &write);
 
+	media_wakeup_rx_init(&wakeup_rx);
+
 	for (i = 0; i < n; i++) {
 		desc = desc_array[i];
 
@@ -1160,6 +1283,8 @@ int media_net_write(int id, struct media_desc **desc_array, unsigned int n)
 		if (desc->n_ts && (desc->avtp_ts[desc->n_ts - 1].flags & AVTP_FLAGS_TO_MEDIA_DESC(AVTP_END_OF_FRAME)))
 			atomic_inc(&mqueue->eofs);
 
+		media_wakeup_rx(&wakeup_rx, desc);
+
 		written += desc_len;
 	}
 
@@ -1168,10 +1293,10 @@ int media_net_write(int id, struct media_desc **desc_array, unsigned int n)
 	if (written) {
 		atomic_add(written, &mqueue->available);
 
-		if (mqueue->callback_enabled && need_to_wake_up_listener_queue(mqueue)) {
-			mqueue->callback(mqueue->callback_data);
-			mqueue->callback_enabled = false;
-		}
+		media_queue_wakeup_update(mqueue);
+		media_wakeup_rx_merge(&mqueue->wakeup, &wakeup_rx);
+
+		media_queue_listener_wake_up(mqueue);
 	}
 
 	xSemaphoreGive(table_mutex);
@@ -1228,10 +1353,8 @@ int media_net_read(int id, struct media_rx_desc **desc_array, unsigned int n)
 
 	queue_dequeue_done(&mqueue->queue, read);
 
-	if (mqueue->callback_enabled && (media_queue_remaining(mqueue) >= mqueue->batch_size) /* || queue_empty(&mqueue->queue) */) {
-		mqueue->callback(mqueue->callback_data);
-		mqueue->callback_enabled = false;
-	}
+	if ((media_queue_remaining(mqueue) >= mqueue->batch_size) /* || queue_empty(&mqueue->queue) */)
+		media_queue_api_wake_up(mqueue);
 
 	xSemaphoreGive(table_mutex);
 
@@ -27,6 +27,10 @@
 #include "os/clock.h"
 
 #include "genavb/media.h"
+#include "genavb/avtp.h"
+#include "genavb/streaming.h"
+
+#include "common/os/media_wakeup_common.h"
 
 #define MEDIA_QUEUE_LENGTH	32
 
@@ -65,6 +69,10 @@ struct media_queue {
 	void *callback_data;
 	bool callback_enabled;
 
+	struct media_wakeup wakeup;		/* Protected by the media queue table mutex */
+	unsigned int wakeup_read;		/* Media application read status, reported to the wakeup policy under the table mutex */
+	uint32_t wakeup_first_ts;		/* Oldest valid AVTP timestamp not read yet, reported along with wakeup_read */
+
 	void *id;
 
 	unsigned int max_payload_size;
@@ -99,6 +107,8 @@ int media_api_write(struct media_queue *mqueue, struct genavb_iovec const *data_
 				struct genavb_event const *event, unsigned int event_len);
 void media_api_set_callback(struct media_queue *mqueue, int (*callback)(void *), void *data);
 int media_api_enable_callback(struct media_queue *mqueue);
+int media_api_set_wakeup(struct media_queue *mqueue, struct genavb_stream_wakeup const *wakeup);
+void media_api_get_stats(struct media_queue *mqueue, struct genavb_stream_stats *stats);
 
 int media_net_open(struct media_queue_net_params *params, unsigned int talker);
 void media_net_close(int id);
@@ -83,6 +83,11 @@ exit:
 	return desc;
 }
 
+struct net_tx_desc *net_tx_ctx_alloc(struct net_tx *tx, unsigned int size)
+{
+	return net_tx_alloc(size);
+}
+
 int net_tx_alloc_multi(struct net_tx_desc **desc, unsigned int n, unsigned int size)
 {
 	int i;
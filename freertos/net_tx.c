@@ -148,120 +148,13 @@ void port_jitter_stats_init(struct jitter_stats *s) {}
 void port_jitter_stats(struct jitter_stats *s, unsigned int ptp_now) {}
 #endif
 
-/* Return number of leading zeros in a BITS_PER_LONG-bit word */
-static inline unsigned long leading_zeros(unsigned long x)
-{
-	unsigned long ret;
-
-	__asm("clz\t%0, %1" : "=r" (ret) : "r" (x));
-
-	return ret;
-}
-
-static inline void incr_credit(int *credit, unsigned int dt, unsigned int rate)
-{
-	/* Given a maximum rate of ~15625 bytes/125us, this guarantees the credit never overflows */
-	if ((dt > 0x10000) || (*credit >= 0x40000000))
-		*credit = 0x40000000;
-	else
-		*credit += dt * rate;
-}
-
-static void stream_incr_credit(struct stream_queue *stream, unsigned int tnow)
-{
-	incr_credit(&stream->shaper.credit, tnow - stream->shaper.tlast, stream->shaper.rate);
-
-	stream->shaper.tlast = tnow;
-}
-
-static inline struct qos_queue *round_robin_scheduler(struct traffic_class *tc)
-{
-	unsigned long smask = tc->scheduled_mask;
-	unsigned long slast = tc->slast;
-	unsigned long i;
-
-	if (likely(slast)) {
-		smask <<= BITS_PER_LONG - slast;
-		i = leading_zeros(smask);
-		if (i < BITS_PER_LONG) {
-			i = slast - i - 1;
-			goto found;
-		}
-	}
-
-	smask = tc->scheduled_mask >> slast;
-	i = leading_zeros(smask);
-	if (i < BITS_PER_LONG) {
-		i = slast + (BITS_PER_LONG - i - 1);
-		goto found;
-	}
-
-	return NULL;
-
-found:
-	tc->slast = i;
-
-	return &tc->qos_queue[i];
-}
-
-/* Port credit acccounting */
-static void port_incr_credit(struct port_qos *port, unsigned int tnow)
-{
-	if (port->shaper.credit < 0) {
-		incr_credit(&port->shaper.credit, tnow - port->shaper.tlast, port->shaper.rate);
-		if (port->shaper.credit > 0)
-			port->shaper.credit = 0;
-	}
-
-	port->shaper.tlast = tnow;
-}
-
-static void port_dec_credit(struct port_qos *port, unsigned int len)
-{
-	if (unlikely(len < (ETHER_MIN_FRAME_SIZE - FCS_LEN)))
-		len = ETHER_MIN_FRAME_SIZE - FCS_LEN;
-
-	port->shaper.credit -= (len + PORT_OVERHEAD) * BITS_PER_BYTE; /* bits */
-	port->tx++;
-}
-
-static void shaper_init(struct shaper *s, unsigned int rate)
-{
-	s->credit = 0;
-	s->tlast = 0;
-	s->rate = rate;
-	s->credit_min = -rate;
-}
-
-static void shaper_add(struct shaper *s, int rate)
-{
-	s->rate += rate;
-	s->credit_min -= rate;
-}
-
-static void shaper_set(struct shaper *s, unsigned int rate)
-{
-	s->rate = rate;
-	s->credit_min = -rate;
-}
-
-static inline int shaper_ready(struct shaper *s)
-{
-	return (s->credit >= s->credit_min);
-}
+#include "common/os/net_tx_common.c"
 
 static unsigned int sr_class_scale_idle_slope(struct sr_class *sr_class, unsigned int idle_slope)
 {
 	return ((uint64_t)idle_slope * sr_class_interval_p(sr_class->class)) / ((uint64_t)NSECS_PER_SEC * sr_class_interval_q(sr_class->class));
 }
 
-static inline void sr_class_incr_credit(struct sr_class *class, unsigned int tnow)
-{
-	incr_credit(&class->shaper.credit, tnow - class->shaper.tlast, class->shaper.rate);
-
-	class->shaper.tlast = tnow;
-}
-
 static inline unsigned int queue_tx_ready(struct sr_class *class, struct stream_queue *stream)
 {
 	struct queue *queue = stream->qos_queue->queue;
@@ -281,39 +174,6 @@ static inline unsigned int queue_tx_ready(struct sr_class *class, struct stream_
 	return 1;
 }
 
-static void sr_class_dec_credit(struct traffic_class *tc, struct qos_queue *qos_q, unsigned int len)
-{
-	struct sr_class *class = tc->sr_class;
-	struct stream_queue *stream = qos_q->stream;
-	struct queue *queue = qos_q->queue;
-
-	if (unlikely(len < (ETHER_MIN_FRAME_SIZE - FCS_LEN)))
-		len = ETHER_MIN_FRAME_SIZE - FCS_LEN;
-
-	stream->shaper.credit -= (len + PORT_OVERHEAD) * class->scale * BITS_PER_BYTE;
-	class->shaper.credit -= (len + PORT_OVERHEAD) * class->scale * BITS_PER_BYTE;
-
-	qos_q->tx++;
-	tc->tx++;
-
-	/* Modifying shared_pending_mask races with queueing code and it may leave the bit clear with packets pending */
-	/* To work around this race we clear the bit first and then _re-check_ for pending packets. If any are pending
-	 * we set the bit again */
-	clear_bit(qos_q->index, &tc->shared_pending_mask);
-	if (!queue_tx_ready(class, stream)) {
-		if (queue_pending(queue))
-			set_bit(qos_q->index, &tc->shared_pending_mask);
-
-		class->pending_mask &= ~(1UL << qos_q->index);
-		tc->scheduled_mask &= ~(1UL << qos_q->index);
-	} else {
-		set_bit(qos_q->index, &tc->shared_pending_mask);
-
-		if (!shaper_ready(&stream->shaper))
-			tc->scheduled_mask &= ~(1UL << qos_q->index);
-	}
-}
-
 static int sr_class_tx(struct port_qos *port, struct traffic_class *tc, struct qos_queue *qos_q)
 {
 	struct queue *queue = qos_q->queue;
@@ -342,6 +202,11 @@ static int sr_class_tx(struct port_qos *port, struct traffic_class *tc, struct q
 	port_dec_credit(port, len);
 	sr_class_dec_credit(tc, qos_q, len);
 
+	if (!port->transmit_event) {
+		if (/*test_bit(SOCKET_ATOMIC_FLAGS_SOCKET_WAITING_EVENT, &qos_q->atomic_flags) && */(queue_available(qos_q->queue) >= (qos_q->queue->size >> 2)))
+			port->transmit_event = 1;
+	}
+
 out:
 	return rc;
 }
@@ -378,154 +243,10 @@ static void inline qos_queue_flush_disabled(struct traffic_class *tc)
 	}
 }
 
-static void inline sr_class_update(struct traffic_class *tc, unsigned int tnow)
+/* Disabled SR queues are flushed once per SR class interval */
+static void sr_class_interval_start(struct traffic_class *tc)
 {
-	struct sr_class *class = tc->sr_class;
-	struct qos_queue *qos_q;
-	struct stream_queue *stream;
-	unsigned long mask;
-	int i;
-
-	/* Update the status of all pending SR streams. We are interested in:
-	 * - skipping streams that are no longer connected
-	 * - correctly account for stream idle time when updating it's credit
-	 * - correctly account for class idle time when updating it's credit
-	 */
-
 	qos_queue_flush_disabled(tc);
-
-	if (tc->scheduled_mask) {
-		/* Class was never idle */
-
-		/* Update all new pending streams */
-		mask = tc->shared_pending_mask & (~class->pending_mask);
-
-		/* loop over all streams with corresponding bit set in mask */
-		while ((i = leading_zeros(mask)) < BITS_PER_LONG) {
-			qos_q = &tc->qos_queue[BITS_PER_LONG - 1 - i];
-			stream = qos_q->stream;
-			mask &= ~(1UL << (BITS_PER_LONG - 1 - i));
-
-			if (queue_tx_ready(class, stream)) {
-				class->pending_mask |= (1UL << qos_q->index);
-
-				stream_incr_credit(stream, tnow);
-
-				if (stream->shaper.credit > 0)
-					stream->shaper.credit = 0;
-
-				if (shaper_ready(&stream->shaper))
-					tc->scheduled_mask |= (1UL << qos_q->index);
-			}
-		}
-
-		/* Update all streams already pending, but not scheduled yet */
-		mask = class->pending_mask & (~tc->scheduled_mask);
-
-		/* loop over all streams with corresponding bit set in mask */
-		while ((i = leading_zeros(mask)) < BITS_PER_LONG) {
-			qos_q = &tc->qos_queue[BITS_PER_LONG - 1 - i];
-			stream = qos_q->stream;
-			mask &= ~(1UL << (BITS_PER_LONG - 1 - i));
-
-			stream_incr_credit(stream, tnow);
-
-			if (shaper_ready(&stream->shaper))
-				tc->scheduled_mask |= (1UL << qos_q->index);
-		}
-
-		sr_class_incr_credit(class, tnow);
-
-	} else {
-		/* Complex case, the class was idle for a while
-		 * need to determine when the first stream became active */
-
-		/* Update all new pending streams */
-		mask = tc->shared_pending_mask & (~class->pending_mask);
-
-		/* loop over all streams with corresponding bit set in mask */
-		while ((i = leading_zeros(mask)) < BITS_PER_LONG) {
-			qos_q = &tc->qos_queue[BITS_PER_LONG - 1 - i];
-			stream = qos_q->stream;
-			mask &= ~(1UL << (BITS_PER_LONG - 1 - i));
-
-			if (queue_tx_ready(class, stream)) {
-				class->pending_mask |= (1UL << qos_q->index);
-
-				stream_incr_credit(stream, tnow);
-
-				if (stream->shaper.credit > 0)
-					stream->shaper.credit = 0;
-
-				if (shaper_ready(&stream->shaper))
-					tc->scheduled_mask |= (1UL << qos_q->index);
-			}
-		}
-
-		/* Update all streams already pending, but not scheduled yet */
-		mask = class->pending_mask & (~tc->scheduled_mask);
-
-		/* loop over all streams with corresponding bit set in mask */
-		while ((i = leading_zeros(mask)) < BITS_PER_LONG) {
-			qos_q = &tc->qos_queue[BITS_PER_LONG - 1 - i];
-			stream = qos_q->stream;
-			mask &= ~(1UL << (BITS_PER_LONG - 1 - i));
-
-			stream_incr_credit(stream, tnow);
-
-			if (shaper_ready(&stream->shaper))
-				tc->scheduled_mask |= (1UL << qos_q->index);
-		}
-
-		/* Update class credit, if it's no longer idle */
-		if (tc->scheduled_mask) {
-			sr_class_incr_credit(class, tnow);
-
-			if (class->shaper.credit > 0)
-				class->shaper.credit = 0;
-		}
-	}
-}
-
-static int sr_class_scheduler(struct port_qos *port, struct traffic_class *tc, unsigned int tnow)
-{
-	struct sr_class *class = tc->sr_class;
-	struct qos_queue *qos_q;
-	int rc = 0;
-
-	if (rational_int_cmp(tnow, &class->tnext) < 0)
-		goto exit;
-
-	class->sched_offset = (tnow - class->tnext.i);
-	class->tnext_gptp = port->ptp_grid.now - class->sched_offset + rational_int_mul(port->ptp_grid.period, &class->interval_ratio);
-
-	/* Credits are only incremented once per scheduling interval */
-	sr_class_update(tc, class->interval_n);
-
-	/* Transmit sr class traffic, highest priority first */
-	while (shaper_ready(&port->shaper) && shaper_ready(&class->shaper) && tc->scheduled_mask) {
-
-		qos_q = round_robin_scheduler(tc);
-
-		/* Stream credit hasn't been updated since the stream was scheduled, do it now */
-		stream_incr_credit(qos_q->stream, class->interval_n);
-
-		rc = sr_class_tx(port, tc, qos_q);
-
-		if (rc < 0)
-			break;
-
-		if (!port->transmit_event) {
-			if (/*test_bit(SOCKET_ATOMIC_FLAGS_SOCKET_WAITING_EVENT, &qos_q->atomic_flags) && */(queue_available(qos_q->queue) >= (qos_q->queue->size >> 2)))
-				port->transmit_event = 1;
-		}
-	}
-
-	rational_add(&class->tnext, &class->tnext, &class->interval);
-	class->interval_n++;
-
-exit:
-	return rc;
 }
 
 static void traffic_class_update_queue(struct traffic_class *tc,
@@ -605,74 +326,14 @@ out:
 	return rc;
 }
 
-static void inline traffic_class_update(struct traffic_class *tc)
-{
-	struct qos_queue *qos_q;
-	unsigned long mask;
-	int i;
-
-	/* Update all new pending queues */
-	mask = tc->shared_pending_mask & (~tc->scheduled_mask);
-
-	/* loop over all queues with corresponding bit set in mask */
-	while ((i = leading_zeros(mask)) < BITS_PER_LONG) {
-		qos_q = &tc->qos_queue[BITS_PER_LONG - 1 - i];
-		mask &= ~(1UL << (BITS_PER_LONG - 1 - i));
-
-		if (queue_pending(qos_q->queue)) {
-			tc->scheduled_mask |= (1UL << qos_q->index);
-		}
-	}
-}
-
-static int traffic_class_scheduler(struct port_qos *port, struct traffic_class *tc, unsigned int tnow)
-{
-	struct qos_queue *qos_q;
-	int rc = 0;
-
-	traffic_class_update(tc);
-
-	/* Transmit traffic class traffic in round robin */
-	while (shaper_ready(&port->shaper) && tc->scheduled_mask) {
-
-		qos_q = round_robin_scheduler(tc);
-
-		rc = traffic_class_tx(port, tc, qos_q);
-
-		if (rc < 0)
-			break;
-	}
-
-	return rc;
-}
-
 static unsigned int port_scheduler(struct port_qos *port, unsigned int ptp_now)
 {
-	struct traffic_class *tc;
-	unsigned int tnow = port->tnow;
-	int i;
-
 	port_ptp_grid_update(&port->ptp_grid, ptp_now);
 #if 0
 	port_jitter_stats(&port->jitter_stats, ptp_now);
 #endif
 
-	port_incr_credit(port, port->interval_n);
-
-	port->transmit_event = 0;
-
-	/* priority scheduler */
-	for (i = CFG_TRAFFIC_CLASS_MAX - 1; i >= 0; i--) {
-		tc = &port->traffic_class[i];
-
-		if (tc->sr_class)
-			sr_class_scheduler(port, tc, tnow);
-		else
-			traffic_class_scheduler(port, tc, tnow);
-	}
-
-	port->tnow += port->interval;
-	port->interval_n++;
+	port_qos_schedule(port);
 
 	return port->transmit_event;
 }
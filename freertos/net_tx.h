@@ -34,10 +34,7 @@
 #include "pi.h"
 #include "avb_queue.h"
 
-#define FCS_LEN		4
-#define IFG_LEN		12
-#define PREAMBLE_LEN	8
-#define PORT_OVERHEAD	(IFG_LEN + PREAMBLE_LEN + FCS_LEN)
+#include "common/os/net_tx_common.h"
 
 #define NET_TX_EVENT_QUEUE_LENGTH	16
 #define PTP_TX_TS_QUEUE_LENGTH		16
@@ -92,104 +89,9 @@ struct ptp_grid {
 #endif
 };
 
-struct shaper {
-	int credit;		/* bits x scale */
-	int credit_min;		/* bits x scale */
-	unsigned int tlast;	/* in interval units */
-	unsigned int rate;	/* bits/interval */
-};
-
-
-#define QOS_QUEUE_FLAG_CONNECTED	(1 << 0)
-#define QOS_QUEUE_FLAG_ENABLED		(1 << 1)
-
-struct qos_queue {
-	struct traffic_class *tc;
-
-	struct stream_queue *stream;
-
-	unsigned int index;
-
-	struct queue *queue;
-
-	unsigned int flags;
-	unsigned long atomic_flags;
-
-	unsigned int tx;
-	unsigned int dropped;
-	unsigned int full;
-	unsigned int disabled;
-};
-
-#define STREAM_FLAGS_CONNECTED	(1 << 0)
-#define STREAM_FLAGS_CONFIGURED	(1 << 1)
-#define STREAM_FLAGS_USED	(STREAM_FLAGS_CONNECTED | STREAM_FLAGS_CONFIGURED)
-
-struct stream_queue {
-	struct shaper shaper;
-	unsigned int idle_slope;		/* bits/s */
-	struct sr_class *sr_class;
-	struct qos_queue *qos_queue;
-
-	uint16_t vlan_label;		/* In Big Endian */
-	uint8_t id[8];
-	unsigned int flags;
-
-#ifdef PORT_TRACE
-	unsigned int burst;
-	unsigned int burst_max;
-#endif
-};
-
 #define TC_FLAGS_HW_CBS	(1 << 0) /* HW CBS queue */
 #define TC_FLAGS_HW_SP	(1 << 1) /* dedicated HW queue */
 
-struct sr_class {
-	/* Private to tx context */
-	struct shaper shaper;
-
-	unsigned int flags;
-
-	sr_class_t class;
-	struct traffic_class *tc;
-	unsigned int stream_max;
-	unsigned int streams;
-
-	unsigned int idle_slope;		/* bits/s */
-
-	struct rational interval;		/* class scheduling interval (in nanoseconds) */
-	struct rational interval_ratio;		/* class to port scheduling interval ratio */
-	struct rational tnext;			/* class next scheduling interval (in nanoseconds) */
-	unsigned int tnext_gptp;
-	unsigned int sched_offset;
-	unsigned int interval_n;		/* class interval count */
-	unsigned int scale;			/* class subintervals, for software scheduling */
-
-	unsigned long int pending_mask;
-
-	struct stream_queue stream[CFG_SR_CLASS_STREAM_MAX];
-};
-
-
-struct traffic_class {
-	struct sr_class *sr_class;		/* Set only if the traffic class is an SR class */
-
-	unsigned int index;
-	unsigned int hw_queue_id;
-	unsigned int flags;
-
-	struct qos_queue qos_queue[CFG_TRAFFIC_CLASS_QUEUE_MAX];	/* array of queues assigned to this traffic class */
-
-	unsigned long scheduled_mask;		/* bit mask of queues that can transmit packets */
-	unsigned long disabled_mask;
-	unsigned long slast;
-
-	unsigned int tx;
-
-	/* Shared with enqueue code */
-	unsigned long shared_pending_mask;	/* bit mask of queues with pending packets */
-};
-
 struct port_qos {
 	struct net_qos *net;
 
@@ -0,0 +1,158 @@
+/*
+* Copyright 2021 NXP
+*
+* NXP Confidential. This software is owned or controlled by NXP and may only
+* be used strictly in accordance with the applicable license terms.  By expressly
+* accepting such terms or by downloading, installing, activating and/or otherwise
+* using the software, you are agreeing that you have read, and that you agree to
+* comply with and are bound by, such license terms.  If you do not agree to be
+* bound by the applicable license terms, then you may not retain, install, activate
+* or otherwise use the software.
+*/
+
+/**
+ @file
+ @brief Pairing heap implementation
+ @details Intrusive min-heap, ordered by a user provided comparison function.
+ Insertion and access to the minimum are O(1), removal of the minimum or of an arbitrary
+ node is O(log n) amortized. No memory allocation is required.
+*/
+
+#ifndef _PAIRING_HEAP_H_
+#define _PAIRING_HEAP_H_
+
+#include "common/types.h"
+
+struct pheap_node {
+	struct pheap_node *child;	/* leftmost child */
+	struct pheap_node *next;	/* right sibling */
+	struct pheap_node *prev;	/* left sibling, or parent for the leftmost child, NULL for the root */
+};
+
+struct pheap_head {
+	struct pheap_node *root;
+	int (*less)(struct pheap_node *a, struct pheap_node *b);
+};
+
+static inline void pheap_head_init(struct pheap_head *head, int (*less)(struct pheap_node *a, struct pheap_node *b))
+{
+	head->root = NULL;
+	head->less = less;
+}
+
+static inline struct pheap_node *__pheap_meld(struct pheap_head *head, struct pheap_node *a, struct pheap_node *b)
+{
+	struct pheap_node *tmp;
+
+	if (!a)
+		return b;
+
+	if (!b)
+		return a;
+
+	if (head->less(b, a)) {
+		tmp = a;
+		a = b;
+		b = tmp;
+	}
+
+	/* b becomes the leftmost child of a */
+	b->prev = a;
+	b->next = a->child;
+	if (a->child)
+		a->child->prev = b;
+
+	a->child = b;
+	a->next = NULL;
+	a->prev = NULL;
+
+	return a;
+}
+
+/* Two pass merge of a sibling list: meld pairs left to right, then meld the results right to left */
+static inline struct pheap_node *__pheap_merge_pairs(struct pheap_head *head, struct pheap_node *first)
+{
+	struct pheap_node *a, *b, *next, *pairs = NULL, *root = NULL;
+
+	while (first) {
+		a = first;
+		b = a->next;
+		next = b ? b->next : NULL;
+
+		a->next = a->prev = NULL;
+		if (b)
+			b->next = b->prev = NULL;
+
+		a = __pheap_meld(head, a, b);
+
+		/* stack of melded pairs, linked through next */
+		a->next = pairs;
+		pairs = a;
+
+		first = next;
+	}
+
+	while (pairs) {
+		next = pairs->next;
+		pairs->next = NULL;
+
+		root = __pheap_meld(head, root, pairs);
+
+		pairs = next;
+	}
+
+	return root;
+}
+
+#define pheap_first(head)	((head)->root)
+#define pheap_empty(head)	((head)->root == NULL)
+
+static inline void pheap_insert(struct pheap_head *head, struct pheap_node *node)
+{
+	node->child = NULL;
+	node->next = NULL;
+	node->prev = NULL;
+
+	head->root = __pheap_meld(head, head->root, node);
+}
+
+static inline struct pheap_node *pheap_pop(struct pheap_head *head)
+{
+	struct pheap_node *root = head->root;
+
+	if (root) {
+		head->root = __pheap_merge_pairs(head, root->child);
+		root->child = NULL;
+	}
+
+	return root;
+}
+
+/* node must be in the heap */
+static inline void pheap_del(struct pheap_head *head, struct pheap_node *node)
+{
+	struct pheap_node *sub;
+
+	if (node == head->root) {
+		pheap_pop(head);
+		return;
+	}
+
+	if (node->prev->child == node)
+		node->prev->child = node->next;
+	else
+		node->prev->next = node->next;
+
+	if (node->next)
+		node->next->prev = node->prev;
+
+	sub = __pheap_merge_pairs(head, node->child);
+
+	node->child = NULL;
+	node->next = NULL;
+	node->prev = NULL;
+
+	head->root = __pheap_meld(head, head->root, sub);
+}
+
+#endif /* _PAIRING_HEAP_H_ */
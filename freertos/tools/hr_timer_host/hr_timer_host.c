@@ -0,0 +1,493 @@
+/*
+* Copyright 2021 NXP
+*
+* NXP Confidential. This software is owned or controlled by NXP and may only
+* be used strictly in accordance with the applicable license terms.  By expressly
+* accepting such terms or by downloading, installing, activating and/or otherwise
+* using the software, you are agreeing that you have read, and that you agree to
+* comply with and are bound by, such license terms.  If you do not agree to be
+* bound by the applicable license terms, then you may not retain, install, activate
+* or otherwise use the software.
+*/
+
+/**
+ @file
+ @brief hr_timer host harness
+ @details Runs freertos/hr_timer.c on a plain Linux host, with stubbed FreeRTOS, clock and hardware timer layers,
+ on a simulated time base (see stub/). The FreeRTOS queue is replaced by a direct call of the timer task handlers,
+ the task timeout and the hardware timers expire when the simulated time reaches them.
+ Default mode: timers are started and stopped randomly, from the timer callbacks, on two clocks, and the harness
+ checks no timer expires early, no stopped timer expires and no running timer is missed.
+ Benchmark mode (-b): measures the cost of a timer task run and of a timer stop + start, with all timers pending.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <getopt.h>
+#include <time.h>
+
+#include "hr_timer.c"
+
+#define HOST_TIMERS_MAX		4096
+#define HOST_BENCH_LOOPS	10000
+
+static uint64_t sim_now;
+static uint64_t sim_task_wake = UINT64_MAX;
+static TickType_t sim_task_period;
+
+static struct hw_timer sim_hw_timer[HOST_TIMERS_MAX];
+static unsigned int sim_hw_timer_n;
+
+static struct event sim_event;
+static int sim_event_pending;
+
+static struct hr_timer *timer[HOST_TIMERS_MAX];
+static uint64_t timer_due[HOST_TIMERS_MAX];
+static uint64_t timer_period[HOST_TIMERS_MAX];
+static int timer_active[HOST_TIMERS_MAX];
+
+static unsigned long fired, early, bad;
+static uint64_t late_max;
+
+/*
+ * Stubs
+ */
+log_level_t log_component_lvl[max_COMPONENT_ID];
+const char *log_lvl_string[] = { "CRIT", "ERR", "INIT", "INFO", "DBG" };
+
+void _os_log(const char *level, const char *func, const char *component, const char *format, ...)
+{
+}
+
+void *pvPortMalloc(size_t size)
+{
+	return malloc(size);
+}
+
+void vPortFree(void *p)
+{
+	free(p);
+}
+
+static int sim_handle;
+
+QueueHandle_t xQueueCreateStatic(int length, int size, uint8_t *buffer, StaticQueue_t *queue)
+{
+	return &sim_handle;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t wait)
+{
+	memcpy(&sim_event, item, sizeof(sim_event));
+	sim_event_pending = 1;
+
+	return pdTRUE;
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void *item, TickType_t wait)
+{
+	return xQueueSend(queue, item, wait);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t wait)
+{
+	return pdFALSE;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *semaphore)
+{
+	return &sim_handle;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t wait)
+{
+	return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+	return pdTRUE;
+}
+
+TimerHandle_t xTimerCreateStatic(const char *name, TickType_t period, BaseType_t reload, void *id,
+				 void (*callback)(TimerHandle_t), StaticTimer_t *timer)
+{
+	return id;
+}
+
+BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t period, TickType_t wait)
+{
+	sim_task_period = period;
+
+	return pdTRUE;
+}
+
+BaseType_t xTimerStart(TimerHandle_t timer, TickType_t wait)
+{
+	sim_task_wake = sim_now + (uint64_t)sim_task_period * NSECS_PER_MS;
+
+	return pdTRUE;
+}
+
+void *pvTimerGetTimerID(TimerHandle_t timer)
+{
+	return timer;
+}
+
+BaseType_t xTaskCreate(void (*task)(void *), const char *name, int depth, void *param, int priority, TaskHandle_t *handle)
+{
+	return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t handle)
+{
+}
+
+/* Timer task, processes the pending event synchronously */
+static void sim_task_dispatch(void)
+{
+	struct hr_timer_task_ctx *timer_task = &hr_timer_drv_h->task_ctx;
+
+	if (!sim_event_pending)
+		return;
+
+	sim_event_pending = 0;
+
+	switch (sim_event.type) {
+	case EVENT_HR_TIMER_ENQUEUE:
+		hr_timer_task_enqueue(timer_task, sim_event.data);
+		break;
+
+	case EVENT_HR_TIMER_CANCEL:
+		hr_timer_task_cancel(timer_task, sim_event.data);
+		break;
+
+	case EVENT_HR_TIMER_TIMEOUT:
+		hr_timer_task_run(timer_task);
+		break;
+
+	default:
+		break;
+	}
+}
+
+EventGroupHandle_t xEventGroupCreateStatic(StaticEventGroup_t *group)
+{
+	return group;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear, BaseType_t all, TickType_t wait)
+{
+	sim_task_dispatch();
+
+	return HR_TIMER_SUCCESS;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits)
+{
+	return bits;
+}
+
+int os_clock_gettime64(os_clock_id_t clk_id, uint64_t *ns)
+{
+	*ns = sim_now;
+
+	return 0;
+}
+
+int clock_time_to_cycles(os_clock_id_t clk_id, uint64_t time, uint64_t *cycles)
+{
+	*cycles = time;
+
+	return 0;
+}
+
+int clock_time_to_cycles_isr(os_clock_id_t clk_id, uint64_t time, uint64_t *cycles)
+{
+	*cycles = time;
+
+	return 0;
+}
+
+hw_clock_id_t clock_to_hw_clock(os_clock_id_t clk_id)
+{
+	return 0;
+}
+
+struct hw_timer *hw_timer_request(hw_clock_id_t id, bool pps, void (*func)(void *data), void *data)
+{
+	struct hw_timer *t;
+
+	if (sim_hw_timer_n >= HOST_TIMERS_MAX)
+		return NULL;
+
+	t = &sim_hw_timer[sim_hw_timer_n++];
+	t->func = func;
+	t->data = data;
+
+	return t;
+}
+
+void hw_timer_free(struct hw_timer *t)
+{
+}
+
+int hw_timer_set_next_event(struct hw_timer *t, uint64_t cycles)
+{
+	t->event = cycles;
+	t->armed = 1;
+
+	return 0;
+}
+
+void hw_timer_cancel(struct hw_timer *t)
+{
+	t->armed = 0;
+}
+
+/*
+ * Harness
+ */
+static uint64_t host_time(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t)now.tv_sec * NSECS_PER_SEC + now.tv_nsec;
+}
+
+static void host_timer_callback(void *data, int count)
+{
+	int i = (int)(long)data;
+
+	if (!timer_active[i]) {
+		bad++;
+		return;
+	}
+
+	if (sim_now < timer_due[i])
+		early++;
+	else if ((sim_now - timer_due[i]) > late_max)
+		late_max = sim_now - timer_due[i];
+
+	fired++;
+
+	if (timer_period[i])
+		timer_due[i] += timer_period[i];
+	else
+		timer_active[i] = 0;
+}
+
+static void host_timer_start(int i)
+{
+	uint64_t value = (1 + rand() % 2000) * NSECS_PER_MS + rand() % 1000;
+
+	/* One timer out of four is periodic, with periods below and above the ratio window */
+	if (!(rand() % 4))
+		timer_period[i] = (1 + rand() % 400) * NSECS_PER_MS;
+	else
+		timer_period[i] = 0;
+
+	timer_due[i] = sim_now + value + timer_period[i];
+	timer_active[i] = 1;
+
+	if (hr_timer_start(timer[i], value, timer_period[i], 1, 0) < 0)
+		bad++;
+}
+
+static int host_timer_create(int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++) {
+		timer[i] = hr_timer_create(OS_CLOCK_MEDIA_HW_0 + (i & 1), 0, host_timer_callback, (void *)(long)i);
+		if (!timer[i])
+			return -1;
+	}
+
+	return 0;
+}
+
+static int host_simulation(int n, unsigned int duration)
+{
+	uint64_t end, next, start;
+	unsigned long missed = 0;
+	int i, k, w;
+
+	if (host_timer_create(n) < 0)
+		return -1;
+
+	sim_now = NSECS_PER_SEC;
+
+	for (i = 0; i < n; i++)
+		host_timer_start(i);
+
+	end = sim_now + (uint64_t)duration * NSECS_PER_SEC;
+
+	start = host_time();
+
+	while (sim_now < end) {
+		/* Next event: earliest armed hardware timer or timer task timeout */
+		next = sim_task_wake;
+		w = -1;
+
+		for (k = 0; k < sim_hw_timer_n; k++) {
+			if (sim_hw_timer[k].armed && (sim_hw_timer[k].event < next)) {
+				next = sim_hw_timer[k].event;
+				w = k;
+			}
+		}
+
+		if (next == UINT64_MAX)
+			break;
+
+		if (next > sim_now)
+			sim_now = next;
+
+		if (w < 0) {
+			sim_task_wake = UINT64_MAX;
+			hr_timer_task_timeout(hr_timer_drv_h->task_ctx.timeout_handle);
+			sim_task_dispatch();
+			continue;
+		}
+
+		sim_hw_timer[w].armed = 0;
+		sim_hw_timer[w].func(sim_hw_timer[w].data);
+
+		/* Random control activity, from the callback context */
+		i = rand() % n;
+		if (!(rand() % 3)) {
+			hr_timer_stop(timer[i]);
+			timer_active[i] = 0;
+		} else if (!timer_active[i]) {
+			host_timer_start(i);
+		}
+	}
+
+	for (i = 0; i < n; i++)
+		if (timer_active[i] && (timer_due[i] < sim_now))
+			missed++;
+
+	printf("%d timers, %u s: %lu expirations, %lu early, %lu missed, %lu bad, late max %llu ns, %u task runs, %llu ms cpu\n",
+		n, duration, fired, early, missed, bad, (unsigned long long)late_max, hr_timer_drv_h->task_ctx.stats.run,
+		(unsigned long long)((host_time() - start) / NSECS_PER_MS));
+
+	if (early || missed || bad)
+		return -1;
+
+	return 0;
+}
+
+/* All timers pending beyond the ratio window, so that a task run doesn't program any of them */
+static uint64_t bench_value(void)
+{
+	return 300 * NSECS_PER_MS + (uint64_t)(rand() % 100000) * 10000;
+}
+
+static int host_benchmark(int n)
+{
+	uint64_t start, run, restart;
+	int i, k;
+
+	if (host_timer_create(n) < 0)
+		return -1;
+
+	sim_now = NSECS_PER_SEC;
+
+	for (i = 0; i < n; i++) {
+		timer_active[i] = 1;
+		hr_timer_start(timer[i], bench_value(), 0, 1, 0);
+	}
+
+	start = host_time();
+
+	for (k = 0; k < HOST_BENCH_LOOPS; k++)
+		hr_timer_task_run(&hr_timer_drv_h->task_ctx);
+
+	run = (host_time() - start) / HOST_BENCH_LOOPS;
+
+	start = host_time();
+
+	for (k = 0; k < HOST_BENCH_LOOPS; k++) {
+		i = rand() % n;
+		hr_timer_stop(timer[i]);
+		hr_timer_start(timer[i], bench_value(), 0, 1, 0);
+	}
+
+	restart = (host_time() - start) / HOST_BENCH_LOOPS;
+
+	printf("%d timers pending: task run %llu ns, stop + start %llu ns\n", n,
+		(unsigned long long)run, (unsigned long long)restart);
+
+	return 0;
+}
+
+static void print_usage(void)
+{
+	printf("\nUsage:\n hr_timer_host [options]\n");
+	printf("\nOptions:\n"
+		"\t-n <timers>           number of timers (default 500, max %u)\n"
+		"\t-d <duration>         simulated duration in seconds (default 20)\n"
+		"\t-s <seed>             random seed (default 1)\n"
+		"\t-b                    benchmark mode\n"
+		"\t-h                    print this help text\n", HOST_TIMERS_MAX);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int duration = 20, seed = 1;
+	int n = 500, bench = 0;
+	int option, rc;
+
+	while ((option = getopt(argc, argv, "n:d:s:bh")) != -1) {
+		switch (option) {
+		case 'n':
+			n = strtoul(optarg, NULL, 0);
+			break;
+
+		case 'd':
+			duration = strtoul(optarg, NULL, 0);
+			break;
+
+		case 's':
+			seed = strtoul(optarg, NULL, 0);
+			break;
+
+		case 'b':
+			bench = 1;
+			break;
+
+		case 'h':
+		default:
+			print_usage();
+			return 0;
+		}
+	}
+
+	if ((n <= 0) || (n > HOST_TIMERS_MAX)) {
+		print_usage();
+		return 1;
+	}
+
+	srand(seed);
+
+	if (hr_timer_init() < 0) {
+		printf("hr_timer_init() failed\n");
+		return 1;
+	}
+
+	if (bench)
+		rc = host_benchmark(n);
+	else
+		rc = host_simulation(n, duration);
+
+	if (rc < 0) {
+		printf("FAILED\n");
+		return 1;
+	}
+
+	return 0;
+}
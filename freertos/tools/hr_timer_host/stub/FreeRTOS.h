@@ -0,0 +1,74 @@
+/*
+* Copyright 2021 NXP
+*
+* NXP Confidential. This software is owned or controlled by NXP and may only
+* be used strictly in accordance with the applicable license terms.  By expressly
+* accepting such terms or by downloading, installing, activating and/or otherwise
+* using the software, you are agreeing that you have read, and that you agree to
+* comply with and are bound by, such license terms.  If you do not agree to be
+* bound by the applicable license terms, then you may not retain, install, activate
+* or otherwise use the software.
+*/
+
+/**
+ @file
+ @brief FreeRTOS kernel stub for the hr_timer host harness
+ @details Only the types and calls used by hr_timer.c, implemented in hr_timer_host.c
+*/
+
+#ifndef _HOST_FREERTOS_H_
+#define _HOST_FREERTOS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef long BaseType_t;
+typedef uint32_t TickType_t;
+typedef uint32_t EventBits_t;
+
+typedef void *QueueHandle_t;
+typedef void *SemaphoreHandle_t;
+typedef void *TimerHandle_t;
+typedef void *TaskHandle_t;
+typedef void *EventGroupHandle_t;
+
+typedef struct { int dummy; } StaticQueue_t;
+typedef struct { int dummy; } StaticSemaphore_t;
+typedef struct { int dummy; } StaticTimer_t;
+typedef struct { int dummy; } StaticEventGroup_t;
+
+#define pdTRUE			1
+#define pdFALSE			0
+#define pdPASS			1
+#define pdFAIL			0
+#define portMAX_DELAY		0xffffffff
+#define configMINIMAL_STACK_SIZE	100
+#define configMAX_PRIORITIES	32
+#define pdMS_TO_TICKS(ms)	((TickType_t)(ms))
+
+void *pvPortMalloc(size_t size);
+void vPortFree(void *p);
+
+QueueHandle_t xQueueCreateStatic(int length, int size, uint8_t *buffer, StaticQueue_t *queue);
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t wait);
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void *item, TickType_t wait);
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t wait);
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *semaphore);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t wait);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
+
+TimerHandle_t xTimerCreateStatic(const char *name, TickType_t period, BaseType_t reload, void *id,
+				 void (*callback)(TimerHandle_t), StaticTimer_t *timer);
+BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t period, TickType_t wait);
+BaseType_t xTimerStart(TimerHandle_t timer, TickType_t wait);
+void *pvTimerGetTimerID(TimerHandle_t timer);
+
+BaseType_t xTaskCreate(void (*task)(void *), const char *name, int depth, void *param, int priority, TaskHandle_t *handle);
+void vTaskDelete(TaskHandle_t handle);
+
+EventGroupHandle_t xEventGroupCreateStatic(StaticEventGroup_t *group);
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear, BaseType_t all, TickType_t wait);
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits);
+
+#endif /* _HOST_FREERTOS_H_ */
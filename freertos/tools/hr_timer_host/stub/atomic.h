@@ -0,0 +1,20 @@
+/*
+* Copyright 2021 NXP
+*
+* NXP Confidential. This software is owned or controlled by NXP and may only
+* be used strictly in accordance with the applicable license terms.  By expressly
+* accepting such terms or by downloading, installing, activating and/or otherwise
+* using the software, you are agreeing that you have read, and that you agree to
+* comply with and are bound by, such license terms.  If you do not agree to be
+* bound by the applicable license terms, then you may not retain, install, activate
+* or otherwise use the software.
+*/
+
+#ifndef _HOST_ATOMIC_H_
+#define _HOST_ATOMIC_H_
+
+/* The harness is single threaded */
+#define atomic_set(p, v)	(*(volatile unsigned int *)(p) = (v))
+#define atomic_read(p)		(*(volatile unsigned int *)(p))
+
+#endif /* _HOST_ATOMIC_H_ */
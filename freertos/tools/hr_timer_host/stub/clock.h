@@ -0,0 +1,28 @@
+/*
+* Copyright 2021 NXP
+*
+* NXP Confidential. This software is owned or controlled by NXP and may only
+* be used strictly in accordance with the applicable license terms.  By expressly
+* accepting such terms or by downloading, installing, activating and/or otherwise
+* using the software, you are agreeing that you have read, and that you agree to
+* comply with and are bound by, such license terms.  If you do not agree to be
+* bound by the applicable license terms, then you may not retain, install, activate
+* or otherwise use the software.
+*/
+
+#ifndef _HOST_CLOCK_H_
+#define _HOST_CLOCK_H_
+
+#include "common/types.h"
+#include "os/clock.h"
+
+typedef int hw_clock_id_t;
+
+#define HW_CLOCK_NONE	-1
+
+/* Simulated clocks, one cycle per ns */
+int clock_time_to_cycles(os_clock_id_t clk_id, uint64_t time, uint64_t *cycles);
+int clock_time_to_cycles_isr(os_clock_id_t clk_id, uint64_t time, uint64_t *cycles);
+hw_clock_id_t clock_to_hw_clock(os_clock_id_t clk_id);
+
+#endif /* _HOST_CLOCK_H_ */
@@ -0,0 +1,36 @@
+/*
+* Copyright 2021 NXP
+*
+* NXP Confidential. This software is owned or controlled by NXP and may only
+* be used strictly in accordance with the applicable license terms.  By expressly
+* accepting such terms or by downloading, installing, activating and/or otherwise
+* using the software, you are agreeing that you have read, and that you agree to
+* comply with and are bound by, such license terms.  If you do not agree to be
+* bound by the applicable license terms, then you may not retain, install, activate
+* or otherwise use the software.
+*/
+
+#ifndef _HOST_HW_TIMER_H_
+#define _HOST_HW_TIMER_H_
+
+#include <stdbool.h>
+
+#include "common/log.h"
+
+/* Simulated hardware timer, expires when the simulated time reaches the programmed event */
+struct hw_timer {
+	uint64_t event;
+	int armed;
+	void (*func)(void *data);
+	void *data;
+};
+
+static inline int hw_timer_pps_enable(struct hw_timer *t) { return -1; }
+static inline void hw_timer_pps_disable(struct hw_timer *t) {}
+
+struct hw_timer *hw_timer_request(hw_clock_id_t id, bool pps, void (*func)(void *data), void *data);
+void hw_timer_free(struct hw_timer *t);
+int hw_timer_set_next_event(struct hw_timer *t, uint64_t cycles);
+void hw_timer_cancel(struct hw_timer *t);
+
+#endif /* _HOST_HW_TIMER_H_ */
@@ -32,6 +32,7 @@
 
 #define CFG_GPTP_DEFAULT_LOG_LEVEL "info"
 #define CFG_GPTP_DEFAULT_LOG_MONOTONIC "disabled"
+#define CFG_GPTP_DEFAULT_LOG_ASYNC "disabled"
 
 
 /*
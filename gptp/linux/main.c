@@ -274,6 +274,8 @@ void *gptp_thread_main(void *arg)
 	};
 	int rc;
 
+	log_thread_register();
+
 	rc = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
 	if (rc) {
 		os_log(LOG_ERR, "pthread_setschedparam(), %s\n", strerror(rc));
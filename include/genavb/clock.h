@@ -60,5 +60,7 @@ typedef enum {
  */
 int genavb_clock_gettime64(genavb_clock_id_t id, uint64_t *ns);
 
+#include "os/clock_shm.h"
+
 #endif /* _GENAVB_PUBLIC_CLOCK_H_ */
 
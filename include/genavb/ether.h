@@ -94,6 +94,7 @@ struct vlan_hdr
 #define ETHERTYPE_AVTP	0x22f0
 #define ETHERTYPE_VLAN	0x8100
 #define ETHERTYPE_IPV6	0x86DD
+#define ETHERTYPE_SVLAN	0x88a8
 #define ETHERTYPE_MVRP	0x88f5
 #define ETHERTYPE_MMRP	0x88f6
 #define ETHERTYPE_PTP	0x88f7
@@ -53,7 +53,7 @@ struct genavb_socket_tx;
  * Socket rx parameters
  */
 struct genavb_socket_rx_params {
-	struct net_address addr; /**< Socket address */
+	struct net_address addr; /**< Socket address: ::PTYPE_L2, or ::PTYPE_AVTP to receive a single AVTP stream (subtype and stream id). For AVTP streams the network interface must accept the stream destination MAC address, it is not joined by the socket. */
 };
 
 /**
@@ -61,7 +61,18 @@ struct genavb_socket_rx_params {
  * Socket rx parameters
  */
 struct genavb_socket_tx_params {
-	struct net_address addr; /**< Socket address */
+	struct net_address addr; /**< Socket address: ::PTYPE_L2, or ::PTYPE_AVTP (raw sockets only) to transmit a single AVTP stream. On the standard Linux network backend, AVTP stream frames are sent with a launch time (SO_TXTIME) derived from the AVTP presentation time. */
+};
+
+/**
+ * \ingroup socket
+ * Network buffer loaned to the application, to receive or transmit a frame in place
+ */
+struct genavb_socket_buf {
+	void *data;		/**< Frame data. Starts with the L2 header for raw sockets, with the L2 payload otherwise (the header is added by the stack) */
+	unsigned int len;	/**< Receive: frame data length. Transmit: maximum frame data length that can be written */
+	uint64_t ts;		/**< Receive: frame receive timestamp */
+	void *priv;		/**< Stack private data, must not be modified */
 };
 
 /** Open rx socket
@@ -94,6 +105,81 @@ int genavb_socket_tx(struct genavb_socket_tx *sock, void *buf, unsigned int len)
  */
 int genavb_socket_rx(struct genavb_socket_rx *sock, void *buf, unsigned int len, uint64_t *ts);
 
+/** Socket receive, without copy
+ * \ingroup socket
+ * \return		::GENAVB_SUCCESS or negative error code (::GENAVB_ERR_SOCKET_AGAIN if no frame is available).
+ * \param sock		Socket handle
+ * \param buf		Updated on success with the frame data, length and timestamp. The buffer is owned by the application
+ *			until it is returned with ::genavb_socket_rx_release.
+ */
+int genavb_socket_rx_borrow(struct genavb_socket_rx *sock, struct genavb_socket_buf *buf);
+
+/** Release a buffer returned by ::genavb_socket_rx_borrow
+ * \ingroup socket
+ * \param sock		Socket handle
+ * \param buf		Buffer to release
+ */
+void genavb_socket_rx_release(struct genavb_socket_rx *sock, struct genavb_socket_buf *buf);
+
+/** Get a transmit buffer, to build a frame in place
+ * \ingroup socket
+ * \return		::GENAVB_SUCCESS or negative error code.
+ * \param sock		Socket handle
+ * \param buf		Updated on success with the location and maximum length of the frame data.
+ *			The buffer must then be passed to ::genavb_socket_tx_commit, which consumes it.
+ * \param len		Requested frame data length (excluding the L2 header, for non raw sockets)
+ */
+int genavb_socket_tx_get_buf(struct genavb_socket_tx *sock, struct genavb_socket_buf *buf, unsigned int len);
+
+/** Transmit a buffer returned by ::genavb_socket_tx_get_buf
+ * \ingroup socket
+ * \return		::GENAVB_SUCCESS or negative error code. The buffer is consumed in all cases.
+ * \param sock		Socket handle
+ * \param buf		Buffer to transmit
+ * \param len		Length of the frame data written by the application, if 0 the buffer is freed without being transmitted
+ */
+int genavb_socket_tx_commit(struct genavb_socket_tx *sock, struct genavb_socket_buf *buf, unsigned int len);
+
+/**
+ * \ingroup socket
+ * ::genavb_socket_rx_multi entry, for one socket
+ */
+struct genavb_socket_rx_entry {
+	struct genavb_socket_rx *sock;	/**< Socket handle */
+	struct genavb_socket_buf *buf;	/**< Array of buffers, updated with the frames received, as ::genavb_socket_rx_borrow does.
+					     Each buffer must then be returned with ::genavb_socket_rx_release. */
+	unsigned int buf_len;		/**< Number of buffers in the array */
+	int rc;				/**< Updated with the number of frames received, or negative error code */
+};
+
+/**
+ * \ingroup socket
+ * ::genavb_socket_tx_multi entry, for one socket
+ */
+struct genavb_socket_tx_entry {
+	struct genavb_socket_tx *sock;	/**< Socket handle */
+	struct genavb_socket_buf *buf;	/**< Array of buffers returned by ::genavb_socket_tx_get_buf, with len updated to the frame data length
+					     actually written. The buffers are consumed in all cases. */
+	unsigned int buf_len;		/**< Number of buffers in the array */
+	int rc;				/**< Updated with the number of frames transmitted, or negative error code */
+};
+
+/** Receive frames from several sockets in a single call, without copy
+ * \ingroup socket
+ * \return		Total number of frames received, or negative error code. Per socket results are returned in each entry rc.
+ * \param entry		Array of entries, one per socket. Only non-blocking sockets are supported.
+ * \param n		Number of entries
+ */
+int genavb_socket_rx_multi(struct genavb_socket_rx_entry *entry, unsigned int n);
+
+/** Transmit frames on several sockets in a single call, without copy
+ * \ingroup socket
+ * \return		Total number of frames transmitted, or negative error code. Per socket results are returned in each entry rc.
+ * \param entry		Array of entries, one per socket.
+ * \param n		Number of entries
+ */
+int genavb_socket_tx_multi(struct genavb_socket_tx_entry *entry, unsigned int n);
+
 /** Close rx socket
  * \ingroup socket
  * \param sock		Socket handle
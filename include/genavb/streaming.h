@@ -60,9 +60,42 @@ typedef enum {
  */
 typedef enum {
 	AVTP_NONBLOCK = (1 << 0), /**< Create stream in non-blocking mode */
-	AVTP_DGRAM = (1 << 1)	/**< Create stream in DATAGRAM mode */
+	AVTP_DGRAM = (1 << 1),	/**< Create stream in DATAGRAM mode */
+	AVTP_MMAP_RING = (1 << 2)	/**< Create stream in mmap ring mode (Linux only), data is exchanged with the genavb_stream_tx_acquire/genavb_stream_rx_acquire family of functions */
 } genavb_stream_create_flags_t;
 
+/**
+ * \ingroup stream
+ * Listener stream wakeup modes
+ */
+typedef enum {
+	GENAVB_STREAM_WAKEUP_BATCH = 0,	/**< Default, wake up when at least batch size bytes are available */
+	GENAVB_STREAM_WAKEUP_PACKETS,	/**< Wake up when at least ::genavb_stream_wakeup.packets packets were received since the stream was last read */
+	GENAVB_STREAM_WAKEUP_TIME,	/**< Wake up when the data available spans at least ::genavb_stream_wakeup.time ns of media time (based on received AVTP timestamps) */
+	GENAVB_STREAM_WAKEUP_GROUP	/**< Wake up all the streams of ::genavb_stream_wakeup.group, when all of them have at least batch size bytes available */
+} genavb_stream_wakeup_mode_t;
+
+#define GENAVB_STREAM_WAKEUP_GROUP_MAX	16
+
+/**
+ * \ingroup stream
+ * Listener stream wakeup policy
+ */
+struct genavb_stream_wakeup {
+	genavb_stream_wakeup_mode_t mode;	/**< Wakeup mode */
+	unsigned int packets;			/**< Number of packets, for ::GENAVB_STREAM_WAKEUP_PACKETS */
+	unsigned int time;			/**< Media time in ns, for ::GENAVB_STREAM_WAKEUP_TIME */
+	unsigned int group;			/**< Group number, in [1, ::GENAVB_STREAM_WAKEUP_GROUP_MAX], for ::GENAVB_STREAM_WAKEUP_GROUP */
+};
+
+/**
+ * \ingroup stream
+ * Stream statistics
+ */
+struct genavb_stream_stats {
+	avb_u64 wakeups;	/**< Number of times the media application was woken up for this stream. Sampling it periodically gives the wakeup rate. */
+};
+
 
 /**
  * \ingroup stream
@@ -114,6 +147,10 @@ struct genavb_stream_params {
  * \param flags		may have the following bits set:
  * * ::AVTP_NONBLOCK to have the send/receive functions return immediately with the currently available data, even if it less than requested. If this flag is not set, the function call will block until all requested data is received or transmitted.
  * 			Blocking mode hasn't been implemented yet, so the send/receive functions will always behave in non-blocking mode.
+ * * ::AVTP_DGRAM to create the stream in datagram mode (TSCF and NTSCF subtypes only).
+ * * ::AVTP_MMAP_RING to fill/read AVTP payloads in a ring of payload slots mapped by the library, without system calls on the data path, instead of using the send/receive functions (Linux only).
+ *			The slots are private to the stream: the stack still copies the payload once between a slot and its network buffer (on transmit and on receive),
+ *			this mode only removes the system calls and the copies from/to the application buffers.
  */
 int genavb_stream_create(struct genavb_handle *genavb, struct genavb_stream_handle **stream, struct genavb_stream_params const *params,
 							unsigned int *batch_size, genavb_stream_create_flags_t flags);
@@ -169,6 +206,23 @@ int genavb_stream_destroy(struct genavb_stream_handle *stream);
  */
 unsigned int genavb_stream_presentation_offset(const struct genavb_stream_handle *handle);
 
+/** Set the wakeup policy of a given listener stream.
+ * \ingroup stream
+ * \return		::GENAVB_SUCCESS or negative error code.
+ * \param stream	stream handle returned by ::genavb_stream_create.
+ * \param wakeup	wakeup policy. The media application is always woken up if the stream queue is full or an End-of-Frame event was received,
+ *			regardless of the policy. Not supported for talker streams and mmap ring streams.
+ */
+int genavb_stream_set_wakeup(struct genavb_stream_handle *stream, struct genavb_stream_wakeup const *wakeup);
+
+/** Retrieve the statistics of a given stream.
+ * \ingroup stream
+ * \return		::GENAVB_SUCCESS or negative error code.
+ * \param stream	stream handle returned by ::genavb_stream_create.
+ * \param stats	pointer to the statistics structure to update.
+ */
+int genavb_stream_get_stats(struct genavb_stream_handle const *stream, struct genavb_stream_stats *stats);
+
 /* OS specific headers */
 #include "os/streaming.h"
 
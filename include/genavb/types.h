@@ -60,7 +60,7 @@ struct genavb_timer;
  */
 typedef enum {
 	GENAVB_SOCKF_NONBLOCK = 0x01, /**< Non-blocking mode (only applies to receive socket) */
-	GENAVB_SOCKF_ZEROCOPY = 0x02, /**< Zero-copy mode (not implemented) */
+	GENAVB_SOCKF_ZEROCOPY = 0x02, /**< Zero-copy mode (not implemented, zero-copy receive/transmit is available on any socket through the buffer loan functions) */
 	GENAVB_SOCKF_RAW = 0x04	      /**< Raw socket (only applies to transmit socket) */
 } genavb_sock_f_t;
 
@@ -0,0 +1,94 @@
+/*
+ * Copyright 2021 NXP
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *    Neither the name of NXP Semiconductors nor the
+ *    names of its contributors may be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ \file clock_shm.h
+ \brief OS specific GenAVB public API
+ \details OS specific shared memory clock API definition for the GenAVB library
+
+ \copyright Copyright 2021 NXP
+*/
+
+#ifndef _OS_GENAVB_PUBLIC_CLOCK_SHM_H_
+#define _OS_GENAVB_PUBLIC_CLOCK_SHM_H_
+
+#define GENAVB_CLOCK_SHM_PATH		"/dev/shm/genavb_clock"
+#define GENAVB_CLOCK_SHM_VERSION	1
+
+#define GENAVB_CLOCK_SHM_F_VALID	(1 << 0)
+
+/** Clock parameters published by the stack (gPTP) for each GenAVB clock.
+ * The clock time is computed from the hardware clock time (read from hw_device,
+ * or hw_clock_id if hw_device is empty) as:
+ * ns = sw_t0 + (((ns_hw - hw_t0) * mul) >> shift), or ns = sw_t0 + (ns_hw - hw_t0) if mul is 0.
+ * The generation counter is odd while the parameters are being updated.
+ */
+struct genavb_clock_shm_entry {
+	uint32_t seq;		/**< generation counter */
+	uint32_t flags;		/**< GENAVB_CLOCK_SHM_F_* */
+	int32_t hw_clock_id;	/**< Linux hardware clock id, if hw_device is empty */
+	char hw_device[32];	/**< hardware clock device (e.g. /dev/ptp0) */
+	uint32_t shift;
+	uint64_t mul;
+	uint64_t sw_t0;
+	uint64_t hw_t0;
+};
+
+/** Shared memory clock page, read-only for applications */
+struct genavb_clock_shm_page {
+	uint32_t version;	/**< GENAVB_CLOCK_SHM_VERSION */
+	uint32_t count;		/**< number of entries */
+	struct genavb_clock_shm_entry entry[GENAVB_CLOCK_MAX];	/**< indexed by ::genavb_clock_id_t */
+};
+
+struct genavb_clock_shm;
+
+/** Map the shared memory clock page.
+ * \ingroup clock
+ * \return	shared memory clock handle, or NULL if the page isn't available (yet).
+ */
+struct genavb_clock_shm *genavb_clock_shm_open(void);
+
+/** Unmap the shared memory clock page.
+ * \ingroup clock
+ * \param shm	shared memory clock handle.
+ */
+void genavb_clock_shm_close(struct genavb_clock_shm *shm);
+
+/** Get time in nanoseconds, from the shared memory clock page.
+ * \ingroup clock
+ * Same result as genavb_clock_gettime64(), but with a single clock_gettime() system call
+ * (or vDSO call), without any IPC or locking.
+ * \return	::GENAVB_SUCCESS or negative error code.
+ * \param shm	shared memory clock handle.
+ * \param id	clock id.
+ * \param ns	pointer to uint64_t variable that will hold the result.
+ */
+int genavb_clock_shm_gettime64(struct genavb_clock_shm *shm, genavb_clock_id_t id, uint64_t *ns);
+
+#endif /* _OS_GENAVB_PUBLIC_CLOCK_SHM_H_ */
@@ -46,7 +46,30 @@ struct genavb_xdp_key {
 	uint16_t protocol;	/**< protocol type */
 	uint16_t vlan_id;	/**< vlan id (network order), one of [VLAN_VID_MIN, VLAN_VID_MAX], VLAN_VID_NONE or VLAND_ID_DEFAULT */
 	uint8_t dst_mac[6];	/**< destination MAC */
+	uint8_t stream_id[8];	/**< AVTP stream ID (network order), all zeros for non stream flows (dst_mac is then all zeros for stream flows) */
 };
 
+/** XDP per flow statistics (one entry per XSK map index, summed over all CPUs) */
+struct genavb_xdp_stats {
+	uint64_t hits;			/**< frames matching the flow */
+	uint64_t redirects;		/**< frames redirected to the flow AF_XDP socket */
+	uint64_t redirect_failures;	/**< frames that could not be redirected (no socket bound) */
+	uint64_t passes;		/**< frames passed to the network stack */
+};
+
+/** Reasons for frames not taking the XDP fast path */
+enum genavb_xdp_pass_reason {
+	GENAVB_XDP_PASS_TRUNCATED = 0,	/**< frame too short to be classified */
+	GENAVB_XDP_PASS_NO_MATCH,	/**< no flow matching the frame */
+	GENAVB_XDP_PASS_REDIRECT_FAILED,	/**< flow matched but redirect failed */
+	GENAVB_XDP_PASS_MAX
+};
+
+#define GENAVB_XDP_MAPS_PATH		"/sys/fs/bpf/xdp/globals"
+#define GENAVB_XDPKEY_NAME		GENAVB_XDP_MAPS_PATH "/genavb_xdpkey"
+#define GENAVB_XSKMAP_NAME		GENAVB_XDP_MAPS_PATH "/genavb_xskmap"
+#define GENAVB_XDP_STATS_NAME		GENAVB_XDP_MAPS_PATH "/genavb_xdpstats"
+#define GENAVB_XDP_PASS_NAME		GENAVB_XDP_MAPS_PATH "/genavb_xdppass"
+
 #endif /* _OS_GENAVB_PUBLIC_NET_TYPES_H_ */
 
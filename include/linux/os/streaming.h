@@ -105,5 +105,117 @@ int genavb_stream_receive_iov(struct genavb_stream_handle const *stream, struct
 int genavb_stream_send_iov(struct genavb_stream_handle const *stream, struct genavb_iovec const *data_iov, unsigned int data_iov_len, struct genavb_event const *event, unsigned int event_len);
 
 
+/** Stream receive request
+ * \ingroup stream
+ */
+struct genavb_stream_receive_entry {
+	struct genavb_stream_handle const *stream;	/**< stream handle returned by ::genavb_stream_create */
+	struct genavb_iovec const *data_iov;		/**< iovec array where stream data is to be copied */
+	unsigned int data_iov_len;			/**< length of the data_iov array */
+	struct genavb_iovec const *event_iov;		/**< iovec array where events are to be copied, see ::genavb_stream_receive_iov */
+	unsigned int event_iov_len;			/**< length of the event_iov array */
+	unsigned int event_len;				/**< On return, number of events copied to the event iovecs */
+	int rc;						/**< On return, amount copied (in bytes) or negative error code, as for ::genavb_stream_receive_iov */
+};
+
+
+/** Stream send request
+ * \ingroup stream
+ */
+struct genavb_stream_send_entry {
+	struct genavb_stream_handle const *stream;	/**< stream handle returned by ::genavb_stream_create */
+	struct genavb_iovec const *data_iov;		/**< iovec array containing the data to send */
+	unsigned int data_iov_len;			/**< length of the data_iov array */
+	struct genavb_event const *event;		/**< event structure array timestamps/flags for the data to be sent (see genavb_event) */
+	unsigned int event_len;				/**< length of the event array (in struct genavb_event units) */
+	int rc;						/**< On return, amount copied (in bytes) or negative error code, as for ::genavb_stream_send_iov */
+};
+
+
+/** Receive media data from several avb streams.
+ *  Equivalent to calling ::genavb_stream_receive_iov for each entry, but with a single system call for all the streams
+ *  (one system call per 128 streams).
+ * \ingroup stream
+ * \return 			::GENAVB_SUCCESS or negative error code. In case of success, the per stream result is returned in each entry.
+ * \param entry		array of stream receive requests.
+ * \param n			length of the entry array.
+ */
+int genavb_stream_receive_multi(struct genavb_stream_receive_entry *entry, unsigned int n);
+
+
+/** Send media data on several AVTP streams.
+ *  Equivalent to calling ::genavb_stream_send_iov for each entry, but with a single system call for all the streams
+ *  (one system call per 128 streams).
+ * \ingroup stream
+ * \return 			::GENAVB_SUCCESS or negative error code. In case of success, the per stream result is returned in each entry.
+ * \param entry		array of stream send requests.
+ * \param n			length of the entry array.
+ */
+int genavb_stream_send_multi(struct genavb_stream_send_entry *entry, unsigned int n);
+
+
+/** Mmap ring stream buffer (payload slot)
+ * \ingroup stream
+ */
+struct genavb_stream_buf {
+	void *data;		/**< Start of the AVTP payload */
+	unsigned int len;	/**< Talker: maximum AVTP payload size, Listener: AVTP payload size (in bytes) */
+	void *priv;		/**< Private, must not be modified */
+};
+
+
+/** Get a free buffer from an mmap ring AVTP talker stream.
+ *  The AVTP payload is written in the buffer slot (copied once by the stack to a network buffer), and the buffer is then passed to the stack with ::genavb_stream_tx_commit.
+ *  Data is not reformatted: for formats with holes in the payload (e.g 61883-4), the caller must write the full AVTP payload.
+ *  A system call is only made when no free buffers are left.
+ * \ingroup stream
+ * \return 			1 if a buffer was acquired (buf->len holds the maximum AVTP payload size), 0 if no buffer is available, or negative error code.
+ * \param stream		stream handle returned by ::genavb_stream_create, with ::AVTP_MMAP_RING flag.
+ * \param buf			buffer descriptor, updated on return.
+ */
+int genavb_stream_tx_acquire(struct genavb_stream_handle *stream, struct genavb_stream_buf *buf);
+
+
+/** Pass a filled buffer to the stack for transmission.
+ *  Buffers must be committed in the same order they were acquired.
+ *  The stack is woken up once every batch of packets, or when an ::AVTP_FLUSH or ::AVTP_FRAME_END event is passed.
+ * \ingroup stream
+ * \return 			::GENAVB_SUCCESS or negative error code.
+ * \param stream		stream handle returned by ::genavb_stream_create, with ::AVTP_MMAP_RING flag.
+ * \param buf			buffer descriptor returned by ::genavb_stream_tx_acquire.
+ * \param len			AVTP payload length in bytes. A zero length discards the buffer.
+ * \param event		event array for the packet (see genavb_event), the event index is the byte offset in the AVTP payload.
+ *				Up to 7 ::AVTP_SYNC events are used, ::AVTP_FRAME_END marks the packet as the end of a frame.
+ * \param event_len		length of the event array (in struct genavb_event units)
+ */
+int genavb_stream_tx_commit(struct genavb_stream_handle *stream, struct genavb_stream_buf const *buf, unsigned int len,
+				struct genavb_event const *event, unsigned int event_len);
+
+
+/** Get the next received buffer from an mmap ring AVTP listener stream.
+ *  The AVTP payload is read in the buffer slot (copied once by the stack from the network buffer), and the buffer is then returned to the stack with ::genavb_stream_rx_release.
+ *  Data is not reformatted: for formats with holes in the payload (e.g 61883-4), the caller gets the full AVTP payload.
+ *  No system call is made.
+ * \ingroup stream
+ * \return 			1 if a buffer was acquired (buf->len holds the AVTP payload size), 0 if no buffer is available, or negative error code.
+ * \param stream		stream handle returned by ::genavb_stream_create, with ::AVTP_MMAP_RING flag.
+ * \param buf			buffer descriptor, updated on return.
+ * \param event		event array where the packet events are copied (see genavb_event), the event index is the byte offset in the AVTP payload.
+ *				Packet level flags are set on the first event.
+ * \param event_len		length of the event array (in struct genavb_event units). On return, contains the number of events copied.
+ */
+int genavb_stream_rx_acquire(struct genavb_stream_handle *stream, struct genavb_stream_buf *buf, struct genavb_event *event, unsigned int *event_len);
+
+
+/** Return a buffer to the stack.
+ *  Buffers must be released in the same order they were acquired.
+ * \ingroup stream
+ * \return 			::GENAVB_SUCCESS or negative error code.
+ * \param stream		stream handle returned by ::genavb_stream_create, with ::AVTP_MMAP_RING flag.
+ * \param buf			buffer descriptor returned by ::genavb_stream_rx_acquire.
+ */
+int genavb_stream_rx_release(struct genavb_stream_handle *stream, struct genavb_stream_buf const *buf);
+
+
 #endif /* _OS_GENAVB_PUBLIC_STREAMING_API_H_ */
 
@@ -43,6 +43,7 @@
 #include "avb.h"
 #include "init.h"
 #include "log.h"
+#include "timer_wheel.h"
 #include "net.h"
 
 #if defined(CONFIG_AVDECC)
@@ -192,6 +193,7 @@ static int process_section_general(struct _SECTIONENTRY *configtree, struct avb_
 	int level;
 	int i, rc = 0;
 	int nb_cmp;
+	unsigned int timer_slack;
 	char log_item[max_COMPONENT_ID][CFG_STRING_LIST_MAX_LEN];
 	char stringvalue[CFG_STRING_MAX_LEN] = "";
 
@@ -226,6 +228,22 @@ static int process_section_general(struct _SECTIONENTRY *configtree, struct avb_
 	if (!strcmp(stringvalue, "enabled"))
 		log_enable_monotonic();
 
+	/* log_async */
+	if (cfg_get_string(configtree, "AVB_GENERAL", "log_async", "disabled", stringvalue)) {
+		rc = -1;
+		goto exit;
+	}
+
+	if (!strcmp(stringvalue, "enabled"))
+		log_enable_async();
+
+	/* timer_slack */
+	if (cfg_get_uint(configtree, "AVB_GENERAL", "timer_slack", CFG_TIMER_SLACK_DEFAULT, CFG_TIMER_SLACK_MIN, CFG_TIMER_SLACK_MAX, &timer_slack)) {
+		rc = -1;
+		goto exit;
+	}
+
+	timer_wheel_slack_set((u64)timer_slack * 1000);
 
 	/* enable sr_class */
 	if ((rc = process_sr_class_config(stringvalue, configtree, avb->sr_class)) < 0)
@@ -0,0 +1,352 @@
+/*
+* Copyright 2021 NXP
+*
+* NXP Confidential. This software is owned or controlled by NXP and may only
+* be used strictly in accordance with the applicable license terms.  By expressly
+* accepting such terms or by downloading, installing, activating and/or otherwise
+* using the software, you are agreeing that you have read, and that you agree to
+* comply with and are bound by, such license terms.  If you do not agree to be
+* bound by the applicable license terms, then you may not retain, install, activate
+* or otherwise use the software.
+*/
+
+/**
+ @file
+ @brief GenAVB standard network backend AVTP stream loopback test
+ @details Opens an AVTP stream transmit socket and two AVTP stream receive sockets (one per stream id) on the
+ standard (AF_PACKET) network backend, the same way the socket API does for ::PTYPE_AVTP addresses.
+ Each iteration transmits stream A frames (vlan tagged and untagged), a stream B frame, and a non AVTP frame
+ carrying stream A bytes, then checks each receive socket only gets its own stream (BPF demux).
+ Stream frames carry a presentation time in the future, so that the launch time (SO_TXTIME) can be checked:
+ with an etf qdisc on the interface, frames are received after the launch time, without it as soon as sent.
+ The gPTP clock is a software clock ("sw_clock") running on top of the system clock, no PTP hardware clock
+ is needed: runs on a plain Linux host, by default on the loopback interface (requires CAP_NET_RAW).
+*/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <poll.h>
+#include <time.h>
+
+#include "common/log.h"
+#include "common/net.h"
+#include "genavb/avtp.h"
+#include "genavb/sr_class.h"
+#include "os/clock.h"
+
+#include "clock.h"
+#include "net.h"
+#include "net_logical_port.h"
+
+#define LOOP_PORT		0
+#define LOOP_VLAN_ID		2
+#define LOOP_PRIORITY		3
+#define LOOP_ETHERTYPE_OTHER	0x88b5	/* local experimental ethertype */
+#define LOOP_PAYLOAD_SIZE	64
+#define LOOP_RX_TIMEOUT		100	/* ms */
+
+static const u8 loop_dst_mac[6] = {0x91, 0xe0, 0xf0, 0x00, 0xfe, 0x00};
+static const u8 loop_stream_a[8] = {0x00, 0x04, 0x9f, 0x00, 0x00, 0x01, 0x00, 0x00};
+static const u8 loop_stream_b[8] = {0x00, 0x04, 0x9f, 0x00, 0x00, 0x01, 0x00, 0x01};
+
+struct loop_rx {
+	struct net_rx rx;
+	const u8 *stream_id;
+
+	unsigned int frames;
+	unsigned int errors;
+
+	u8 seq;		/* sequence number of the current iteration */
+	bool seen;	/* current iteration frame received */
+	u64 seen_time;	/* CLOCK_TAI of the first current iteration frame reception */
+};
+
+static unsigned int loop_count = 1000;
+static unsigned int loop_offset = 3000;	/* us, presentation time offset */
+
+static void print_usage(void)
+{
+	printf("\nUsage:\ngenavb-avtp-loop [options]\n");
+	printf("\nOptions:\n"
+		"\t-i <name>     network interface (default lo)\n"
+		"\t-n <count>    number of iterations (default 1000)\n"
+		"\t-o <us>       presentation time offset (default 3000 us)\n"
+		"\t-m            use PACKET_MMAP rings instead of standard sockets\n"
+		"\t-h            print this help text\n");
+}
+
+static u64 loop_tai(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_TAI, &now);
+
+	return (u64)now.tv_sec * NSECS_PER_SEC + now.tv_nsec;
+}
+
+static void loop_rx_cb(struct net_rx *rx, struct net_rx_desc *desc)
+{
+	struct loop_rx *lrx = container_of(rx, struct loop_rx, rx);
+	struct avtp_data_hdr *avtp = (struct avtp_data_hdr *)((char *)desc + desc->l3_offset);
+
+	if ((desc->ethertype != ETHERTYPE_AVTP) || (desc->len < (desc->l3_offset - desc->l2_offset + sizeof(struct avtp_data_hdr)))
+	|| (avtp->subtype != AVTP_SUBTYPE_61883_IIDC) || memcmp(&avtp->stream_id, lrx->stream_id, 8))
+		goto err;
+
+	lrx->frames++;
+
+	if ((avtp->sequence_num == lrx->seq) && !lrx->seen) {
+		lrx->seen = true;
+		lrx->seen_time = loop_tai();
+	}
+
+	net_rx_free(desc);
+
+	return;
+
+err:
+	lrx->errors++;
+
+	net_rx_free(desc);
+}
+
+static int loop_send(struct net_tx *tx, const u8 *stream_id, bool vlan, u16 ethertype, u8 seq, u32 presentation_time)
+{
+	struct net_tx_desc *desc;
+	struct avtp_data_hdr *avtp;
+	u8 *data;
+
+	desc = net_tx_ctx_alloc(tx, DEFAULT_NET_DATA_SIZE);
+	if (!desc)
+		return -1;
+
+	data = NET_DATA_START(desc);
+
+	if (vlan) {
+		desc->len = net_add_eth_header(data, loop_dst_mac, ETHERTYPE_VLAN);
+		desc->len += net_add_vlan_header(data + desc->len, ethertype, LOOP_VLAN_ID, LOOP_PRIORITY, 0);
+	} else {
+		desc->len = net_add_eth_header(data, loop_dst_mac, ethertype);
+	}
+
+	avtp = (struct avtp_data_hdr *)(data + desc->len);
+	memset(avtp, 0, sizeof(*avtp) + LOOP_PAYLOAD_SIZE);
+
+	avtp->subtype = AVTP_SUBTYPE_61883_IIDC;
+	avtp->sv = 1;
+	avtp->tv = 1;
+	avtp->sequence_num = seq;
+	memcpy(&avtp->stream_id, stream_id, 8);
+	avtp->avtp_timestamp = htonl(presentation_time);
+	avtp->stream_data_length = htons(LOOP_PAYLOAD_SIZE);
+
+	desc->len += sizeof(*avtp) + LOOP_PAYLOAD_SIZE;
+
+	if (net_tx(tx, desc) < 0) {
+		net_tx_free(desc);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Receives until both sockets got the current iteration frame, or the timeout expires.
+ * With a negative timeout, receives until no frame is received for 10 ms.
+ */
+static void loop_receive(struct loop_rx *rx_a, struct loop_rx *rx_b, int timeout)
+{
+	struct pollfd fds[2];
+	int i;
+
+	fds[0].fd = rx_a->rx.fd;
+	fds[1].fd = rx_b->rx.fd;
+	fds[0].events = fds[1].events = POLLIN;
+
+	while (!rx_a->seen || !rx_b->seen || (timeout < 0)) {
+		if (poll(fds, 2, timeout < 0 ? 10 : timeout) <= 0)
+			break;
+
+		for (i = 0; i < 2; i++)
+			if (fds[i].revents & POLLIN)
+				net_rx(i ? &rx_b->rx : &rx_a->rx);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	struct os_logical_port_config port_config;
+	struct os_clock_config clock_config;
+	struct os_net_config net_config = { .net_mode = NET_STD };
+	struct net_address addr;
+	struct net_tx tx;
+	struct loop_rx rx_a, rx_b;
+	const char *ifname = "lo";
+	unsigned int i, sent = 0, late = 0;
+	u64 gptp, start, delay, delay_min = (u64)-1, delay_max = 0, delay_sum = 0;
+	int option, rc = 1;
+
+	while ((option = getopt(argc, argv, "i:n:o:mh")) != -1) {
+		switch (option) {
+		case 'i':
+			ifname = optarg;
+			break;
+
+		case 'n':
+			loop_count = strtoul(optarg, NULL, 0);
+			break;
+
+		case 'o':
+			loop_offset = strtoul(optarg, NULL, 0);
+			break;
+
+		case 'm':
+			net_config.net_mode = NET_STD_MMAP;
+			break;
+
+		case 'h':
+		default:
+			print_usage();
+			return 0;
+		}
+	}
+
+	if (!loop_count || (strlen(ifname) >= sizeof(port_config.endpoint[0])) || (loop_offset * 1000ULL > 0x7fffffff)) {
+		print_usage();
+		return 1;
+	}
+
+	memset(&port_config, 0, sizeof(port_config));
+	strcpy(port_config.endpoint[LOOP_PORT], ifname);
+
+	logical_port_init(&port_config);
+
+	memset(&clock_config, 0, sizeof(clock_config));
+	strcpy(clock_config.endpoint_gptp[0][LOOP_PORT], "sw_clock");
+	strcpy(clock_config.endpoint_local[LOOP_PORT], "sw_clock");
+
+	if (os_clock_init(&clock_config) < 0) {
+		printf("os_clock_init() failed\n");
+		goto err_clock;
+	}
+
+	if (net_init(&net_config, NULL) < 0) {
+		printf("net_init() failed\n");
+		goto err_net;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.ptype = PTYPE_AVTP;
+	addr.port = LOOP_PORT;
+	addr.vlan_id = htons(LOOP_VLAN_ID);
+	addr.priority = LOOP_PRIORITY;
+	addr.u.avtp.subtype = AVTP_SUBTYPE_61883_IIDC;
+	addr.u.avtp.sr_class = SR_CLASS_A;
+	memcpy(addr.u.avtp.stream_id, loop_stream_a, 8);
+
+	if (net_tx_init(&tx, &addr) < 0) {
+		printf("net_tx_init() failed\n");
+		goto err_tx;
+	}
+
+	memset(&rx_a, 0, sizeof(rx_a));
+	rx_a.stream_id = loop_stream_a;
+
+	if (net_rx_init(&rx_a.rx, &addr, loop_rx_cb, (unsigned long)-1) < 0) {
+		printf("net_rx_init() failed\n");
+		goto err_rx_a;
+	}
+
+	memset(&rx_b, 0, sizeof(rx_b));
+	rx_b.stream_id = loop_stream_b;
+	memcpy(addr.u.avtp.stream_id, loop_stream_b, 8);
+
+	if (net_rx_init(&rx_b.rx, &addr, loop_rx_cb, (unsigned long)-1) < 0) {
+		printf("net_rx_init() failed\n");
+		goto err_rx_b;
+	}
+
+	for (i = 0; i < loop_count; i++) {
+		if (os_clock_gettime64(tx.clock_domain, &gptp) < 0) {
+			printf("os_clock_gettime64() failed\n");
+			goto err_send;
+		}
+
+		start = loop_tai();
+
+		gptp += loop_offset * 1000ULL;
+
+		rx_a.seq = rx_b.seq = i;
+		rx_a.seen = rx_b.seen = false;
+
+		if ((loop_send(&tx, loop_stream_a, true, ETHERTYPE_AVTP, i, gptp) < 0)
+		|| (loop_send(&tx, loop_stream_a, false, ETHERTYPE_AVTP, i, gptp) < 0)
+		|| (loop_send(&tx, loop_stream_b, true, ETHERTYPE_AVTP, i, gptp) < 0)
+		|| (loop_send(&tx, loop_stream_a, true, LOOP_ETHERTYPE_OTHER, i, gptp) < 0)) {
+			printf("transmit failed\n");
+			goto err_send;
+		}
+
+		sent++;
+
+		/* A frame may be received more than once (e.g. outgoing and looped back copies on lo), only the first one is timed */
+		loop_receive(&rx_a, &rx_b, LOOP_RX_TIMEOUT + loop_offset / 1000);
+
+		if (!rx_a.seen || !rx_b.seen) {
+			printf("iteration %u: stream %s frame not received\n", i, rx_a.seen ? "B" : "A");
+			break;
+		}
+
+		delay = rx_b.seen_time - start;
+		delay_sum += delay;
+
+		if (delay < delay_min)
+			delay_min = delay;
+
+		if (delay > delay_max)
+			delay_max = delay;
+
+		if (delay < (loop_offset * 1000ULL - sr_class_max_transit_time(SR_CLASS_A)))
+			late++;
+	}
+
+	/* Collect the remaining copies */
+	loop_receive(&rx_a, &rx_b, -1);
+
+	printf("interface %s%s, launch time (SO_TXTIME) %s, %u iterations\n", ifname, (net_config.net_mode == NET_STD_MMAP) ? " (PACKET_MMAP)" : "",
+		tx.txtime ? "enabled" : "disabled", sent);
+	printf("stream A: %u frames, %u errors (expected %u or %u frames)\n", rx_a.frames, rx_a.errors, 2 * sent, 4 * sent);
+	printf("stream B: %u frames, %u errors (expected %u or %u frames)\n", rx_b.frames, rx_b.errors, sent, 2 * sent);
+
+	if (sent)
+		printf("transmit to stream B receive: min %llu ns, avg %llu ns, max %llu ns, %u before launch time\n",
+			(unsigned long long)delay_min, (unsigned long long)(delay_sum / sent), (unsigned long long)delay_max, late);
+
+	if ((sent == loop_count) && !rx_a.errors && !rx_b.errors && rx_b.frames
+	&& (rx_a.frames == 2 * rx_b.frames) && ((rx_b.frames == sent) || (rx_b.frames == 2 * sent)))
+		rc = 0;
+
+	printf("%s\n", rc ? "FAILED" : "OK");
+
+err_send:
+	net_rx_exit(&rx_b.rx);
+
+err_rx_b:
+	net_rx_exit(&rx_a.rx);
+
+err_rx_a:
+	net_tx_exit(&tx);
+
+err_tx:
+	net_exit();
+
+err_net:
+	os_clock_exit();
+
+err_clock:
+	return rc;
+}
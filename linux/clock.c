@@ -27,9 +27,11 @@
 #include <stdlib.h>
 #include <time.h>
 #include <sys/syscall.h>
+#include <sys/mman.h>
 
 #include "common/log.h"
 #include "os/clock.h"
+#include "genavb/clock.h"
 
 #include "clock.h"
 #include "net_logical_port.h"
@@ -66,15 +68,35 @@ static struct os_clock os_clock[OS_CLOCK_MAX] = {
 };
 
 /*
- * Mutex lock to protect concurrent access to entire clock layer
+ * Mutex lock to serialize clock adjustments
  *
  * Offset/frequency computation must be done atomically to avoid bad (old) values
- * when calling into ->gettime_sw(), ->setfreq(), ->setoffset() and so on...
+ * when calling into ->setfreq(), ->setoffset() and so on...
+ * Software clock readers don't take the lock, the software clock parameters are
+ * published through a sequence counter (see sw_clock_read()).
  */
 static pthread_mutex_t os_clock_mutex;
 
 static int clock_gettime64_hw(struct os_clock *c, u64 *ns);
 
+/*
+ * Shared memory clock page, mapped (read/write) by the processes adjusting the clocks,
+ * on their first adjustment. Each process only publishes (and invalidates on exit) the entries
+ * of the clocks it adjusts, as several processes may run at once (e.g fgptp and fgptp-br).
+ * Applications map it read-only, see genavb_clock_shm_gettime64().
+ */
+static const os_clock_id_t clock_shm_to_os_clock[GENAVB_CLOCK_MAX] = {
+	[GENAVB_CLOCK_MONOTONIC] = OS_CLOCK_SYSTEM_MONOTONIC,
+	[GENAVB_CLOCK_GPTP_0_0] = OS_CLOCK_GPTP_EP_0_0,
+	[GENAVB_CLOCK_GPTP_0_1] = OS_CLOCK_GPTP_EP_0_1,
+	[GENAVB_CLOCK_GPTP_1_0] = OS_CLOCK_GPTP_EP_1_0,
+	[GENAVB_CLOCK_GPTP_1_1] = OS_CLOCK_GPTP_EP_1_1,
+};
+
+static struct genavb_clock_shm_page *clock_shm;
+static bool clock_shm_failed = false;
+static unsigned int clock_shm_owned;	/* bitmask of the entries published by this process */
+
 os_clock_id_t logical_port_to_local_clock(unsigned int port_id)
 {
 	if (!logical_port_valid(port_id))
@@ -105,93 +127,317 @@ err:
 
 #define TIME_BASE_UPDATE_TRESHOLD (2000000000ULL)
 
-static inline void clock_time_base_update(struct os_clock *c, uint64_t ns, uint64_t ns_hw)
+/*
+ * Software clock parameters update, with the sequence counter protocol:
+ * the counter is odd while an update is in progress and incremented again once done,
+ * so that readers can detect (and retry) a read racing with an update.
+ * Note:
+ * - os_clock_mutex must be held (only one writer at a time)
+ */
+static inline void sw_clock_write_begin(struct os_sw_clock *sw_clk)
 {
-	uint64_t delta_hw = ns_hw - c->sw_clk.hw.t0;
+	__atomic_store_n(&sw_clk->seq, sw_clk->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
 
-	/*
-	 * The below functions clock_time_from_hw/clock_time_to_hw overflow
-	 * if the delta between current time and t0 is greater than ~4 seconds.
-	 * In general t0 is updated when frequency is adjusted but if not it's
-	 * done here.
-	 */
-	if (delta_hw > TIME_BASE_UPDATE_TRESHOLD) {
-		c->sw_clk.sw.t0 = ns;
-		c->sw_clk.hw.t0 = ns_hw;
-	}
+static inline void sw_clock_write_end(struct os_sw_clock *sw_clk)
+{
+	__atomic_store_n(&sw_clk->seq, sw_clk->seq + 1, __ATOMIC_RELEASE);
 }
 
 /*
  * Note:
  * - os_clock_mutex must be held before entering this function
  */
-static inline uint64_t __clock_time_from_hw(struct os_clock *c, uint64_t ns_hw)
+static void clock_shm_entry_update(struct genavb_clock_shm_entry *e, struct os_clock *c)
 {
-	uint64_t ns = ns_hw;
+	__atomic_store_n(&e->seq, e->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
 
-	if (c->type != CLOCK_TYPE_SW)
-		goto pass_through;
+	if (c->enabled) {
+		e->flags = GENAVB_CLOCK_SHM_F_VALID;
+		e->hw_clock_id = c->id;
 
-	if (c->sw_clk.sw.mul) {
-		if (ns_hw > c->sw_clk.hw.t0)
-			ns = c->sw_clk.sw.t0 + (((ns_hw - c->sw_clk.hw.t0) * c->sw_clk.sw.mul) >> c->sw_clk.sw.shift);
+		if (c->clk_device)
+			snprintf(e->hw_device, sizeof(e->hw_device), "%s", c->clk_device);
 		else
-			ns = c->sw_clk.sw.t0 - (((c->sw_clk.hw.t0 - ns_hw) * c->sw_clk.sw.mul) >> c->sw_clk.sw.shift);
+			e->hw_device[0] = '\0';
 	} else {
-		ns = c->sw_clk.sw.t0 + (ns_hw - c->sw_clk.hw.t0);
+		e->flags = 0;
 	}
 
-pass_through:
-	return ns;
+	if (c->type == CLOCK_TYPE_SW) {
+		e->shift = c->sw_clk.sw.shift;
+		e->mul = c->sw_clk.sw.mul;
+		e->sw_t0 = c->sw_clk.sw.t0;
+		e->hw_t0 = c->sw_clk.hw.t0;
+	} else {
+		e->shift = 0;
+		e->mul = 0;
+		e->sw_t0 = 0;
+		e->hw_t0 = 0;
+	}
+
+	__atomic_store_n(&e->seq, e->seq + 1, __ATOMIC_RELEASE);
 }
 
 /*
  * Note:
  * - os_clock_mutex must be held before entering this function
  */
-static uint64_t __clock_time_to_hw(struct os_clock *c, uint64_t ns)
+static void clock_shm_publish(struct os_clock *c)
 {
-	uint64_t ns_hw = ns;
+	int i;
 
-	if (c->type != CLOCK_TYPE_SW)
-		goto pass_through;
+	if (!clock_shm)
+		return;
+
+	for (i = 0; i < GENAVB_CLOCK_MAX; i++)
+		if ((clock_shm_owned & (1 << i)) && (&os_clock[clock_shm_to_os_clock[i]] == c))
+			clock_shm_entry_update(&clock_shm->entry[i], c);
+}
+
+/*
+ * Maps the shared memory clock page, done once by each process adjusting clocks.
+ * Only the monotonic clock, which is the same for all processes, is published here.
+ * Note:
+ * - os_clock_mutex must be held before entering this function
+ */
+static void clock_shm_map(void)
+{
+	struct genavb_clock_shm_page *page;
+	int fd;
+
+	if (clock_shm || clock_shm_failed)
+		return;
+
+	clock_shm_failed = true;
+
+	fd = open(GENAVB_CLOCK_SHM_PATH, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		os_log(LOG_ERR, "open(%s) failed: %s\n", GENAVB_CLOCK_SHM_PATH, strerror(errno));
+		goto err_open;
+	}
+
+	if (ftruncate(fd, sizeof(struct genavb_clock_shm_page)) < 0) {
+		os_log(LOG_ERR, "ftruncate(%s) failed: %s\n", GENAVB_CLOCK_SHM_PATH, strerror(errno));
+		goto err_truncate;
+	}
+
+	page = mmap(NULL, sizeof(struct genavb_clock_shm_page), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (page == MAP_FAILED) {
+		os_log(LOG_ERR, "mmap(%s) failed: %s\n", GENAVB_CLOCK_SHM_PATH, strerror(errno));
+		goto err_mmap;
+	}
+
+	close(fd);
+
+	clock_shm_entry_update(&page->entry[GENAVB_CLOCK_MONOTONIC], &os_clock[clock_shm_to_os_clock[GENAVB_CLOCK_MONOTONIC]]);
+
+	page->count = GENAVB_CLOCK_MAX;
+	__atomic_store_n(&page->version, GENAVB_CLOCK_SHM_VERSION, __ATOMIC_RELEASE);
+
+	clock_shm = page;
+	clock_shm_failed = false;
+
+	os_log(LOG_INIT, "clock page %s mapped\n", GENAVB_CLOCK_SHM_PATH);
+
+	return;
+
+err_mmap:
+err_truncate:
+	close(fd);
+
+err_open:
+	return;
+}
+
+/*
+ * Maps the shared memory clock page if needed, and publishes the entries of a clock adjusted by this process.
+ * Note:
+ * - os_clock_mutex must be held before entering this function
+ */
+static void clock_shm_claim(struct os_clock *c)
+{
+	int i;
+
+	clock_shm_map();
+
+	if (!clock_shm)
+		return;
+
+	for (i = 0; i < GENAVB_CLOCK_MAX; i++) {
+		if ((i == GENAVB_CLOCK_MONOTONIC) || (clock_shm_owned & (1 << i)))
+			continue;
+
+		if (&os_clock[clock_shm_to_os_clock[i]] == c) {
+			clock_shm_owned |= 1 << i;
+			clock_shm_entry_update(&clock_shm->entry[i], c);
+		}
+	}
+}
+
+/*
+ * Invalidates the entries published by this process and unmaps the shared memory clock page.
+ * Note:
+ * - os_clock_mutex must be held before entering this function
+ */
+static void clock_shm_unmap(void)
+{
+	int i;
+
+	if (!clock_shm)
+		return;
+
+	for (i = 0; i < GENAVB_CLOCK_MAX; i++) {
+		if (!(clock_shm_owned & (1 << i)))
+			continue;
+
+		__atomic_store_n(&clock_shm->entry[i].seq, clock_shm->entry[i].seq + 1, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+		clock_shm->entry[i].flags = 0;
+		__atomic_store_n(&clock_shm->entry[i].seq, clock_shm->entry[i].seq + 1, __ATOMIC_RELEASE);
+	}
+
+	munmap(clock_shm, sizeof(struct genavb_clock_shm_page));
+	clock_shm = NULL;
+	clock_shm_owned = 0;
+}
+
+/*
+ * Lock-free read of a consistent copy of the software clock parameters
+ */
+static inline void sw_clock_read(struct os_sw_clock *sw_clk, struct os_sw_clock *copy)
+{
+	unsigned int seq;
+
+	do {
+		seq = __atomic_load_n(&sw_clk->seq, __ATOMIC_ACQUIRE);
+
+		copy->sw = sw_clk->sw;
+		copy->hw = sw_clk->hw;
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	} while ((seq & 1) || (seq != __atomic_load_n(&sw_clk->seq, __ATOMIC_RELAXED)));
+}
+
+static inline uint64_t sw_clock_from_hw(struct os_sw_clock *sw_clk, uint64_t ns_hw)
+{
+	uint64_t ns;
+
+	if (sw_clk->sw.mul) {
+		if (ns_hw > sw_clk->hw.t0)
+			ns = sw_clk->sw.t0 + (((ns_hw - sw_clk->hw.t0) * sw_clk->sw.mul) >> sw_clk->sw.shift);
+		else
+			ns = sw_clk->sw.t0 - (((sw_clk->hw.t0 - ns_hw) * sw_clk->sw.mul) >> sw_clk->sw.shift);
+	} else {
+		ns = sw_clk->sw.t0 + (ns_hw - sw_clk->hw.t0);
+	}
+
+	return ns;
+}
 
-	if (c->sw_clk.sw.mul) {
-		if (ns > c->sw_clk.sw.t0)
-			ns_hw = c->sw_clk.hw.t0 + (((ns - c->sw_clk.sw.t0) * c->sw_clk.hw.mul) >> c->sw_clk.hw.shift);
+static inline uint64_t sw_clock_to_hw(struct os_sw_clock *sw_clk, uint64_t ns)
+{
+	uint64_t ns_hw;
+
+	if (sw_clk->sw.mul) {
+		if (ns > sw_clk->sw.t0)
+			ns_hw = sw_clk->hw.t0 + (((ns - sw_clk->sw.t0) * sw_clk->hw.mul) >> sw_clk->hw.shift);
 		else
-			ns_hw = c->sw_clk.hw.t0 - (((c->sw_clk.sw.t0 - ns) * c->sw_clk.hw.mul) >> c->sw_clk.hw.shift);
+			ns_hw = sw_clk->hw.t0 - (((sw_clk->sw.t0 - ns) * sw_clk->hw.mul) >> sw_clk->hw.shift);
 	} else {
-		ns_hw = c->sw_clk.hw.t0 + (ns - c->sw_clk.sw.t0);
+		ns_hw = sw_clk->hw.t0 + (ns - sw_clk->sw.t0);
 	}
 
-pass_through:
 	return ns_hw;
 }
 
+/*
+ * Note:
+ * - os_clock_mutex must be held before entering this function
+ */
+static inline uint64_t __clock_time_from_hw(struct os_clock *c, uint64_t ns_hw)
+{
+	if (c->type != CLOCK_TYPE_SW)
+		return ns_hw;
+
+	return sw_clock_from_hw(&c->sw_clk, ns_hw);
+}
+
+/*
+ * Lock-free variants, can be called without os_clock_mutex
+ */
+static inline uint64_t clock_time_from_hw_lockless(struct os_clock *c, uint64_t ns_hw)
+{
+	struct os_sw_clock sw_clk;
+
+	if (c->type != CLOCK_TYPE_SW)
+		return ns_hw;
+
+	sw_clock_read(&c->sw_clk, &sw_clk);
+
+	return sw_clock_from_hw(&sw_clk, ns_hw);
+}
+
+static inline uint64_t clock_time_to_hw_lockless(struct os_clock *c, uint64_t ns)
+{
+	struct os_sw_clock sw_clk;
+
+	if (c->type != CLOCK_TYPE_SW)
+		return ns;
+
+	sw_clock_read(&c->sw_clk, &sw_clk);
+
+	return sw_clock_to_hw(&sw_clk, ns);
+}
+
+/*
+ * The conversion functions overflow if the delta between current time and t0 is
+ * greater than ~4 seconds. In general t0 is updated when frequency is adjusted
+ * but if not it's done here (rarely, so taking the lock is fine).
+ */
+static void clock_time_base_update(struct os_clock *c, uint64_t ns_hw)
+{
+	pthread_mutex_lock(&os_clock_mutex);
+
+	if (c->sw_clk.sw.mul && ((ns_hw - c->sw_clk.hw.t0) > TIME_BASE_UPDATE_TRESHOLD)) {
+		sw_clock_write_begin(&c->sw_clk);
+
+		c->sw_clk.sw.t0 = sw_clock_from_hw(&c->sw_clk, ns_hw);
+		c->sw_clk.hw.t0 = ns_hw;
+
+		sw_clock_write_end(&c->sw_clk);
+
+		clock_shm_publish(c);
+	}
+
+	pthread_mutex_unlock(&os_clock_mutex);
+}
+
 static int clock_gettime64_sw(struct os_clock *c, u64 *ns)
 {
-	int err;
+	struct os_sw_clock sw_clk;
 	struct timespec now;
 	uint64_t ns_hw;
-
-	pthread_mutex_lock(&os_clock_mutex);
+	int err;
 
 	err = clock_gettime(c->id, &now);
 	if (err) {
 		os_log(LOG_ERR, "clock(%p) clock_gettime failed: %s\n", c, strerror(errno));
-		goto unlock;
+		goto exit;
 	}
 
 	ns_hw = (u64)now.tv_sec*NSECS_PER_SEC + now.tv_nsec;
-	*ns = __clock_time_from_hw(c, ns_hw);
 
-	if (c->sw_clk.sw.mul)
-		clock_time_base_update(c, *ns, ns_hw);
+	sw_clock_read(&c->sw_clk, &sw_clk);
 
-unlock:
-	pthread_mutex_unlock(&os_clock_mutex);
+	*ns = sw_clock_from_hw(&sw_clk, ns_hw);
 
+	if (unlikely(sw_clk.sw.mul && ((ns_hw - sw_clk.hw.t0) > TIME_BASE_UPDATE_TRESHOLD)))
+		clock_time_base_update(c, ns_hw);
+
+exit:
 	return err;
 }
 
@@ -211,8 +457,16 @@ int clock_setoffset_sw(struct os_clock *c, s64 offset)
 {
 	pthread_mutex_lock(&os_clock_mutex);
 
+	clock_shm_claim(c);
+
+	sw_clock_write_begin(&c->sw_clk);
+
 	c->sw_clk.sw.t0 += offset;
 
+	sw_clock_write_end(&c->sw_clk);
+
+	clock_shm_publish(c);
+
 	pthread_mutex_unlock(&os_clock_mutex);
 
 	return 0;
@@ -224,6 +478,8 @@ int clock_setoffset_sw(struct os_clock *c, s64 offset)
  */
 static void __clock_setfreq_sw(struct os_clock *c, int32_t ppb, uint64_t t0_hw)
 {
+	sw_clock_write_begin(&c->sw_clk);
+
 	c->sw_clk.sw.t0 = __clock_time_from_hw(c, t0_hw);
 	c->sw_clk.hw.t0 = t0_hw;
 
@@ -238,6 +494,10 @@ static void __clock_setfreq_sw(struct os_clock *c, int32_t ppb, uint64_t t0_hw)
 		c->sw_clk.sw.mul = 0;
 	}
 
+	sw_clock_write_end(&c->sw_clk);
+
+	clock_shm_publish(c);
+
 	c->ppb = ppb;
 }
 
@@ -248,6 +508,8 @@ static int clock_setfreq_sw(struct os_clock *c, int32_t ppb)
 
 	pthread_mutex_lock(&os_clock_mutex);
 
+	clock_shm_claim(c);
+
 	ret = clock_gettime64_hw(c, &t0_hw);
 	if (ret)
 		goto unlock;
@@ -328,6 +590,8 @@ static int clock_setfreq_hw(struct os_clock *c, s32 ppb)
 
 	pthread_mutex_lock(&os_clock_mutex);
 
+	clock_shm_claim(c);
+
 	if (clock_adjust_time(c->id, &t) < 0) {
 		os_log(LOG_ERR, "clock_id(0x%x) failed adjusting frequency\n", c->id);
 		goto unlock;
@@ -380,6 +644,8 @@ static int clock_setoffset_hw(struct os_clock *c, s64 offset)
 
 	pthread_mutex_lock(&os_clock_mutex);
 
+	clock_shm_claim(c);
+
 	if (clock_adjust_time(c->id, &t) < 0) {
 		os_log(LOG_ERR, "clock_id(0x%x) failed adjusting offset\n", c->id);
 		err = -1;
@@ -392,8 +658,14 @@ static int clock_setoffset_hw(struct os_clock *c, s64 offset)
 
 	for_each_sw_clock_with_same_parent(c, _c) {
 
+		sw_clock_write_begin(&_c->sw_clk);
+
 		_c->sw_clk.hw.t0 += offset;
 
+		sw_clock_write_end(&_c->sw_clk);
+
+		clock_shm_publish(_c);
+
 		os_log(LOG_DEBUG, "clock_id(0x%x) adjusted hw.t0 offset by %"PRId64" ns\n",
 				 _c->id, offset);
 	}
@@ -585,6 +857,12 @@ void os_clock_exit(void)
 {
 	int i;
 
+	pthread_mutex_lock(&os_clock_mutex);
+
+	clock_shm_unmap();
+
+	pthread_mutex_unlock(&os_clock_mutex);
+
 	for (i = 0; i < OS_CLOCK_MAX; i++)
 		_os_clock_exit(i);
 
@@ -678,12 +956,8 @@ int os_clock_convert(os_clock_id_t clk_id_src, u64 ns_src, os_clock_id_t clk_id_
 		goto err;
 	}
 
-	pthread_mutex_lock(&os_clock_mutex);
-
-	ns_hw_clk = __clock_time_to_hw(c_src, ns_src);
-	*ns_dst = __clock_time_from_hw(c_dst, ns_hw_clk);
-
-	pthread_mutex_unlock(&os_clock_mutex);
+	ns_hw_clk = clock_time_to_hw_lockless(c_src, ns_src);
+	*ns_dst = clock_time_from_hw_lockless(c_dst, ns_hw_clk);
 
 	return 0;
 
@@ -759,11 +1033,7 @@ int clock_time_from_hw(os_clock_id_t clk_id, uint64_t hw_ns, uint64_t *ns)
 	if (!c || !c->parent_id)
 		goto err;
 
-	pthread_mutex_lock(&os_clock_mutex);
-
-	*ns = __clock_time_from_hw(c, hw_ns);
-
-	pthread_mutex_unlock(&os_clock_mutex);
+	*ns = clock_time_from_hw_lockless(c, hw_ns);
 
 	return 0;
 
@@ -38,6 +38,8 @@ enum clock_type {
 #define OS_CLOCK_FLAGS_IS_LOCAL  (1 << 2)
 
 struct os_sw_clock {
+	/* sequence counter, odd while the parameters below are being updated (see clock.c) */
+	unsigned int seq;
 
 	/* software clock parameters */
 	struct {
@@ -0,0 +1,252 @@
+/*
+* Copyright 2021 NXP
+*
+* NXP Confidential. This software is owned or controlled by NXP and may only
+* be used strictly in accordance with the applicable license terms.  By expressly
+* accepting such terms or by downloading, installing, activating and/or otherwise
+* using the software, you are agreeing that you have read, and that you agree to
+* comply with and are bound by, such license terms.  If you do not agree to be
+* bound by the applicable license terms, then you may not retain, install, activate
+* or otherwise use the software.
+*/
+
+/**
+ @file
+ @brief GenAVB software clock read benchmark
+ @details Several threads read a software gPTP clock with os_clock_gettime64(), while a servo thread
+ adjusts its frequency periodically. The software clock is configured with "sw_clock", so that it runs
+ on top of the system clock and no PTP hardware clock is needed: runs on a plain Linux host.
+ The cost per read is reported for each thread, along with the cost of the underlying system clock read,
+ optionally with all reads serialized by a mutex (as before the lock-free reads) for comparison.
+ Each thread checks its reads never go backwards, which would reveal a torn read of the clock parameters.
+ Must be run while the GenAVB stack is stopped, since the clock adjustments update the shared memory clock page.
+*/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "common/log.h"
+#include "os/clock.h"
+
+#include "clock.h"
+
+#define BENCH_THREADS_MAX	64
+#define BENCH_CLOCK		OS_CLOCK_GPTP_BR_0_0
+#define BENCH_PPB		100
+#define BENCH_BACKWARDS_MAX	1000	/* ns, rounding of frequency changes is far below */
+
+struct bench_thread {
+	pthread_t thread;
+
+	uint64_t reads;
+	uint64_t errors;
+	uint64_t time;
+};
+
+static pthread_barrier_t bench_barrier;
+static pthread_mutex_t bench_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned int bench_locked = 0;
+static unsigned int bench_iterations = 1000000;
+static unsigned int bench_servo_period = 1000;	/* us */
+static volatile int bench_stop = 0;
+
+static void print_usage(void)
+{
+	printf("\nUsage:\n genavb-clock-bench [options]\n");
+	printf("\nOptions:\n"
+		"\t-t <threads>          number of reader threads (default 4, max %u)\n"
+		"\t-n <iterations>       number of reads per thread (default 1000000)\n"
+		"\t-s <period>           frequency adjustment period in us, 0 to disable (default 1000)\n"
+		"\t-l                    serialize all reads with a mutex (reference)\n"
+		"\t-h                    print this help text\n", BENCH_THREADS_MAX);
+}
+
+static uint64_t bench_time(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t)now.tv_sec * NSECS_PER_SEC + now.tv_nsec;
+}
+
+static void *bench_servo_main(void *arg)
+{
+	struct timespec period = { .tv_sec = 0, .tv_nsec = bench_servo_period * 1000 };
+	int ppb = BENCH_PPB;
+
+	while (!bench_stop) {
+		if (bench_locked)
+			pthread_mutex_lock(&bench_lock);
+
+		os_clock_setfreq(BENCH_CLOCK, ppb);
+
+		if (bench_locked)
+			pthread_mutex_unlock(&bench_lock);
+
+		ppb = -ppb;
+
+		nanosleep(&period, NULL);
+	}
+
+	return NULL;
+}
+
+static void *bench_thread_main(void *arg)
+{
+	struct bench_thread *t = arg;
+	uint64_t start, ns, last = 0;
+	unsigned int i;
+
+	pthread_barrier_wait(&bench_barrier);
+
+	start = bench_time();
+
+	for (i = 0; i < bench_iterations; i++) {
+		if (bench_locked)
+			pthread_mutex_lock(&bench_lock);
+
+		os_clock_gettime64(BENCH_CLOCK, &ns);
+
+		if (bench_locked)
+			pthread_mutex_unlock(&bench_lock);
+
+		if ((ns < last) && ((last - ns) > BENCH_BACKWARDS_MAX))
+			t->errors++;
+
+		last = ns;
+	}
+
+	t->time = bench_time() - start;
+
+	return NULL;
+}
+
+/* Reference: cost of the system clock read the software clock is based on */
+static uint64_t bench_system_clock(void)
+{
+	struct timespec now;
+	uint64_t start;
+	unsigned int i;
+
+	start = bench_time();
+
+	for (i = 0; i < bench_iterations; i++)
+		clock_gettime(CLOCK_REALTIME, &now);
+
+	return (bench_time() - start) / bench_iterations;
+}
+
+int main(int argc, char *argv[])
+{
+	struct bench_thread thread[BENCH_THREADS_MAX];
+	struct os_clock_config config;
+	pthread_t servo;
+	unsigned int threads = 4;
+	uint64_t reads = 0, errors = 0, time = 0;
+	unsigned int i;
+	int option, rc = 1;
+
+	while ((option = getopt(argc, argv, "t:n:s:lh")) != -1) {
+		switch (option) {
+		case 't':
+			threads = strtoul(optarg, NULL, 0);
+			break;
+
+		case 'n':
+			bench_iterations = strtoul(optarg, NULL, 0);
+			break;
+
+		case 's':
+			bench_servo_period = strtoul(optarg, NULL, 0);
+			break;
+
+		case 'l':
+			bench_locked = 1;
+			break;
+
+		case 'h':
+		default:
+			print_usage();
+			return 0;
+		}
+	}
+
+	if (!threads || (threads > BENCH_THREADS_MAX) || !bench_iterations || (bench_servo_period >= 1000000)) {
+		print_usage();
+		return 1;
+	}
+
+	memset(&config, 0, sizeof(config));
+	strcpy(config.bridge_local[0], "sw_clock");
+	strcpy(config.bridge_gptp[0][0], "sw_clock");
+
+	if (os_clock_init(&config) < 0) {
+		printf("os_clock_init() failed\n");
+		goto err_clock;
+	}
+
+	if (pthread_barrier_init(&bench_barrier, NULL, threads)) {
+		printf("pthread_barrier_init() failed\n");
+		goto err_barrier;
+	}
+
+	if (bench_servo_period && pthread_create(&servo, NULL, bench_servo_main, NULL)) {
+		printf("pthread_create() failed\n");
+		goto err_servo;
+	}
+
+	for (i = 0; i < threads; i++) {
+		memset(&thread[i], 0, sizeof(thread[i]));
+
+		if (pthread_create(&thread[i].thread, NULL, bench_thread_main, &thread[i])) {
+			printf("pthread_create() failed\n");
+			/* The barrier can't complete, the process exits */
+			exit(1);
+		}
+	}
+
+	for (i = 0; i < threads; i++) {
+		pthread_join(thread[i].thread, NULL);
+
+		printf("thread %2u: %llu reads, %llu ns per read, %llu errors\n", i,
+			(unsigned long long)bench_iterations, (unsigned long long)(thread[i].time / bench_iterations),
+			(unsigned long long)thread[i].errors);
+
+		reads += bench_iterations;
+		errors += thread[i].errors;
+		if (thread[i].time > time)
+			time = thread[i].time;
+	}
+
+	bench_stop = 1;
+
+	if (bench_servo_period)
+		pthread_join(servo, NULL);
+
+	printf("%s reads, %u threads, adjustment period %u us: %llu reads/s, %llu errors (system clock read %llu ns)\n",
+		bench_locked ? "locked" : "lock-free", threads, bench_servo_period,
+		(unsigned long long)(time ? reads * NSECS_PER_SEC / time : 0),
+		(unsigned long long)errors, (unsigned long long)bench_system_clock());
+
+	if (errors)
+		printf("FAILED\n");
+	else
+		rc = 0;
+
+err_servo:
+	pthread_barrier_destroy(&bench_barrier);
+
+err_barrier:
+	os_clock_exit();
+
+err_clock:
+	return rc;
+}
@@ -10,6 +10,7 @@
 #include "genavb/net_types.h"
 #include "ebpf.h"
 #include "genavb/ether.h"
+#include "genavb/avtp.h"
 
 struct bpf_elf_map __section("maps") genavb_xdpkey = {
 	.type		= BPF_MAP_TYPE_HASH,
@@ -27,39 +28,123 @@ struct bpf_elf_map __section("maps") genavb_xskmap = {
 	.max_elem	= MAX_SOCKETS,
 };
 
+struct bpf_elf_map __section("maps") genavb_xdpstats = {
+	.type		= BPF_MAP_TYPE_PERCPU_ARRAY,
+	.size_key	= sizeof(uint32_t),
+	.size_value	= sizeof(struct genavb_xdp_stats),
+	.pinning	= PIN_GLOBAL_NS,
+	.max_elem	= MAX_SOCKETS,
+};
+
+struct bpf_elf_map __section("maps") genavb_xdppass = {
+	.type		= BPF_MAP_TYPE_PERCPU_ARRAY,
+	.size_key	= sizeof(uint32_t),
+	.size_value	= sizeof(uint64_t),
+	.pinning	= PIN_GLOBAL_NS,
+	.max_elem	= GENAVB_XDP_PASS_MAX,
+};
+
+static __inline int genavb_xdp_pass(uint32_t reason)
+{
+	uint64_t *count;
+
+	count = bpf_map_lookup_elem(&genavb_xdppass, &reason);
+	if (count)
+		(*count)++;
+
+	return XDP_PASS;
+}
+
 __section("prog")
 static int genavb_xdp_prog(struct xdp_ctx *ctx)
 {
 	void *data = (void *)(long)ctx->data;
 	void *data_end = (void *)(long)ctx->data_end;
 	struct eth_hdr *eth = (struct eth_hdr *)data;
+	struct vlan_hdr *vlan;
+	struct avtp_hdr *avtp;
 	struct genavb_xdp_key key = {};
-	uint64_t xsk;
-	uintptr_t *pxsk;
+	struct genavb_xdp_stats *stats;
+	uint32_t *pxsk = NULL;
+	uint32_t xsk;
+	void *next;
+	int rc;
 
 	if ((void *)(eth + 1) > data_end)
-		return XDP_PASS;
+		return genavb_xdp_pass(GENAVB_XDP_PASS_TRUNCATED);
 
 	key.protocol = eth->type;
-	__builtin_memcpy(key.dst_mac, eth->dst, 6);
+	key.vlan_id = VLAN_VID_NONE;
+	next = eth + 1;
+
+	/* 802.1ad double tagged frames are classified on the inner (customer) vlan */
+	if (key.protocol == htons(ETHERTYPE_SVLAN)) {
+		vlan = (struct vlan_hdr *)next;
+
+		if ((void *)(vlan + 1) > data_end)
+			return genavb_xdp_pass(GENAVB_XDP_PASS_TRUNCATED);
+
+		key.protocol = vlan->type;
+		key.vlan_id = htons(VLAN_VID(vlan));
+		next = vlan + 1;
+	}
 
 	if (key.protocol == htons(ETHERTYPE_VLAN)) {
-		struct vlan_hdr *vlan = (struct vlan_hdr *)(eth + 1);
+		vlan = (struct vlan_hdr *)next;
 
 		if ((void *)(vlan + 1) > data_end)
-			return XDP_PASS;
+			return genavb_xdp_pass(GENAVB_XDP_PASS_TRUNCATED);
 
 		key.protocol = vlan->type;
 		key.vlan_id = htons(VLAN_VID(vlan));
-	} else {
-		key.vlan_id = VLAN_VID_NONE;
+		next = vlan + 1;
+	}
+
+	/* AVTP stream flows are matched on stream ID (with a null destination MAC) first */
+	if (key.protocol == htons(ETHERTYPE_AVTP)) {
+		avtp = (struct avtp_hdr *)next;
+
+		if ((void *)(avtp + 1) > data_end)
+			return genavb_xdp_pass(GENAVB_XDP_PASS_TRUNCATED);
+
+		if (avtp->sv) {
+			__builtin_memcpy(key.stream_id, &avtp->stream_id, 8);
+
+			pxsk = bpf_map_lookup_elem(&genavb_xdpkey, &key);
+
+			__builtin_memset(key.stream_id, 0, 8);
+		}
+	}
+
+	if (!pxsk) {
+		__builtin_memcpy(key.dst_mac, eth->dst, 6);
+
+		pxsk = bpf_map_lookup_elem(&genavb_xdpkey, &key);
+		if (!pxsk)
+			return genavb_xdp_pass(GENAVB_XDP_PASS_NO_MATCH);
 	}
 
-	pxsk = bpf_map_lookup_elem(&genavb_xdpkey, &key);
-	if (!pxsk)
-		return XDP_PASS;
 	xsk = *pxsk;
-	return bpf_redirect_map(&genavb_xskmap, (void *)xsk, XDP_PASS);
+
+	stats = bpf_map_lookup_elem(&genavb_xdpstats, &xsk);
+	if (stats)
+		stats->hits++;
+
+	/* Returns the flags (XDP_PASS) if no socket is bound at this index */
+	rc = bpf_redirect_map(&genavb_xskmap, (void *)(uintptr_t)xsk, XDP_PASS);
+	if (rc != XDP_REDIRECT) {
+		if (stats) {
+			stats->redirect_failures++;
+			stats->passes++;
+		}
+
+		return genavb_xdp_pass(GENAVB_XDP_PASS_REDIRECT_FAILED);
+	}
+
+	if (stats)
+		stats->redirects++;
+
+	return rc;
 }
 
 char _license[] __section("license") = "Proprietary";
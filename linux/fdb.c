@@ -127,6 +127,7 @@ int fdb_init(struct os_net_config *config)
 		}
 		break;
 	case NET_STD:
+	case NET_STD_MMAP:
 	case NET_XDP:
 		if (fdb_std_init(&fdb_ops) < 0) {
 			os_log(LOG_ERR, "Could not initialize STD FDB service implementation\n");
@@ -174,6 +174,15 @@ static int process_section_general(struct _SECTIONENTRY *configtree, int instanc
 	if (!strcmp(stringvalue, "enabled"))
 		log_enable_monotonic();
 
+	/* log_async */
+	if (cfg_get_string(configtree, "FGPTP_GENERAL", "log_async", CFG_GPTP_DEFAULT_LOG_ASYNC, stringvalue)) {
+		rc = -1;
+		goto exit;
+	}
+
+	if (!strcmp(stringvalue, "enabled"))
+		log_enable_async();
+
 	/* neighbor propagation delay threshold */
 	if (cfg_get_u64(configtree, "FGPTP_GENERAL", "neighborPropDelayThreshold", CFG_GPTP_NEIGH_THRESH_DEFAULT, CFG_GPTP_NEIGH_THRESH_MIN_DEFAULT, CFG_GPTP_NEIGH_THRESH_MAX_DEFAULT, &cfg->neighborPropDelayThreshold)) {
 		rc = -1;
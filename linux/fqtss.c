@@ -50,6 +50,7 @@ int fqtss_init(struct os_net_config *config)
 		}
 		break;
 	case NET_STD:
+	case NET_STD_MMAP:
 	case NET_XDP:
 		if (fqtss_std_init(&fqtss_ops) < 0) {
 			os_log(LOG_ERR, "Could not initialize STD network service implementation\n");
@@ -61,6 +61,12 @@ int os_init(struct os_net_config *net_config)
 	if (os_clock_init(&config.clock_config) < 0)
 		goto err_clock;
 
+	/*
+	* Standard sockets can be replaced by PACKET_MMAP rings from the configuration file.
+	*/
+	if ((net_config->net_mode == NET_STD) && config.net_std_config.packet_mmap)
+		net_config->net_mode = NET_STD_MMAP;
+
 	/*
 	* Network layer global init.
 	*/
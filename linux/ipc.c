@@ -19,6 +19,7 @@
 
 #define _GNU_SOURCE
 
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <fcntl.h>
@@ -38,6 +39,7 @@
 #define static_assert(condition) extern char __CHECK__[1/(condition)];
 
 static_assert(sizeof(struct ipc_desc) < IPC_BUF_SIZE);
+static_assert(offsetof(struct ipc_desc, src) == IPC_MSG_SRC_OFFSET);
 
 /* Each IPC channel has two ends, each end is mapped to a specific device file */
 
@@ -242,6 +244,14 @@ static const char ipc_device[IPC_ID_MAX][2][64] = {
 
 };
 
+/* Frees deferred while ipc_rx() runs the receive callbacks, released with a single ioctl */
+struct ipc_free_batch {
+	int fd;
+	struct ipc_free_multi_data data;
+};
+
+static __thread struct ipc_free_batch *ipc_free_batch;
+
 static void *ipc_shmem_to_virt(void *mmap_baseaddr, unsigned long addr)
 {
 	return (char *)mmap_baseaddr + addr;
@@ -265,17 +275,59 @@ struct ipc_desc *ipc_alloc(struct ipc_tx const *tx, unsigned int size)
 }
 
 
+static void ipc_free_flush(struct ipc_free_batch *batch)
+{
+	if (!batch->data.n)
+		return;
+
+	if (ioctl(batch->fd, IPC_IOC_FREE_MULTI, &batch->data) < 0)
+		os_log(LOG_ERR, "ioctl() %s\n", strerror(errno));
+
+	batch->data.n = 0;
+}
+
 void ipc_free(void const *ipc, struct ipc_desc *desc)
 {
 	unsigned long addr = ipc_virt_to_shmem(((struct ipc_tx const *)ipc)->mmap_baseaddr, desc);
+	struct ipc_free_batch *batch = ipc_free_batch;
+
+	/* Called from an ipc_rx() callback for the same channel */
+	if (batch && (batch->fd == ((struct ipc_tx const *)ipc)->fd)) {
+		batch->data.addr_shmem[batch->data.n++] = addr;
+
+		if (batch->data.n == IPC_RX_BATCH)
+			ipc_free_flush(batch);
+
+		return;
+	}
 
 	if (ioctl(((struct ipc_tx const *)ipc)->fd, IPC_IOC_FREE, &addr) < 0)
 		os_log(LOG_ERR, "ioctl() %s\n", strerror(errno));
 }
 
+void ipc_free_multi(void const *ipc, struct ipc_desc **desc, unsigned int n)
+{
+	struct ipc_free_batch batch;
+	unsigned int i;
+
+	batch.fd = ((struct ipc_tx const *)ipc)->fd;
+	batch.data.n = 0;
+
+	for (i = 0; i < n; i++) {
+		batch.data.addr_shmem[batch.data.n++] = ipc_virt_to_shmem(((struct ipc_tx const *)ipc)->mmap_baseaddr, desc[i]);
+
+		if (batch.data.n == IPC_RX_BATCH)
+			ipc_free_flush(&batch);
+	}
+
+	ipc_free_flush(&batch);
+}
+
 
 int ipc_rx_init_no_notify(struct ipc_rx *rx, ipc_id_t id)
 {
+	unsigned long pool_size, bcast_pool_size;
+
 	os_log(LOG_DEBUG, "ipc_rx(%p)\n", rx);
 
 	rx->fd = open(ipc_device[id][IPC_RX], O_RDWR | O_CLOEXEC);
@@ -284,17 +336,37 @@ int ipc_rx_init_no_notify(struct ipc_rx *rx, ipc_id_t id)
 		goto err_open;
 	}
 
-	if (ioctl(rx->fd, IPC_IOC_POOL_SIZE, &rx->pool_size) < 0) {
+	if (ioctl(rx->fd, IPC_IOC_POOL_SIZE, &pool_size) < 0) {
 		os_log(LOG_ERR, "ioctl() %s\n", strerror(errno));
 		goto err_ioctl;
 	}
 
-	rx->mmap_baseaddr = mmap(NULL, rx->pool_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED, rx->fd, 0);
+	if (ioctl(rx->fd, IPC_IOC_BCAST_POOL_SIZE, &bcast_pool_size) < 0) {
+		os_log(LOG_ERR, "ioctl() %s\n", strerror(errno));
+		goto err_ioctl;
+	}
+
+	rx->pool_size = pool_size + bcast_pool_size;
+
+	/* Reserve space for both pools, the broadcast pool is mapped read only right after the reader pool */
+	rx->mmap_baseaddr = mmap(NULL, rx->pool_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
 	if (rx->mmap_baseaddr == MAP_FAILED) {
 		os_log(LOG_ERR, "mmap() %s\n", strerror(errno));
 		goto err_mmap;
 	}
 
+	if (mmap(rx->mmap_baseaddr, pool_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED | MAP_FIXED, rx->fd, 0) == MAP_FAILED) {
+		os_log(LOG_ERR, "mmap() %s\n", strerror(errno));
+		goto err_mmap_pool;
+	}
+
+	if (bcast_pool_size) {
+		if (mmap((char *)rx->mmap_baseaddr + pool_size, bcast_pool_size, PROT_READ, MAP_SHARED | MAP_LOCKED | MAP_FIXED, rx->fd, pool_size) == MAP_FAILED) {
+			os_log(LOG_ERR, "mmap() %s\n", strerror(errno));
+			goto err_mmap_pool;
+		}
+	}
+
 	if (madvise(rx->mmap_baseaddr, rx->pool_size, MADV_DONTFORK) < 0)
 		os_log(LOG_ERR, "madvise() %s\n", strerror(errno));
 
@@ -302,6 +374,9 @@ int ipc_rx_init_no_notify(struct ipc_rx *rx, ipc_id_t id)
 
 	return 0;
 
+err_mmap_pool:
+	munmap(rx->mmap_baseaddr, rx->pool_size);
+
 err_ioctl:
 err_mmap:
 	close(rx->fd);
@@ -457,8 +532,8 @@ struct ipc_desc * __ipc_rx(struct ipc_rx const *rx)
 	if (ioctl(rx->fd, IPC_IOC_RX, &data) < 0)
 		goto err;
 
+	/* The source address is filled by the driver, broadcast buffers are read only */
 	desc = ipc_shmem_to_virt(rx->mmap_baseaddr, data.addr_shmem);
-	desc->src = data.src;
 
 err:
 	return desc;
@@ -466,14 +541,33 @@ err:
 
 void ipc_rx(struct ipc_rx const *rx)
 {
+	struct ipc_rx_multi_data data;
+	struct ipc_free_batch batch, *batch_prev = ipc_free_batch;
 	struct ipc_desc *desc;
+	unsigned int i;
+
+	batch.fd = rx->fd;
+	batch.data.n = 0;
 
-	while (1) {
-		desc = __ipc_rx(rx);
-		if (!desc)
+	ipc_free_batch = &batch;
+
+	do {
+		data.n = IPC_RX_BATCH;
+
+		if (ioctl(rx->fd, IPC_IOC_RX_MULTI, &data) < 0)
 			break;
 
-		rx->func(rx, desc);
-	}
+		for (i = 0; i < data.n; i++) {
+			desc = ipc_shmem_to_virt(rx->mmap_baseaddr, data.data[i].addr_shmem);
+
+			rx->func(rx, desc);
+		}
+
+		ipc_free_flush(&batch);
+
+	/* A short batch means the queue is empty */
+	} while (data.n == IPC_RX_BATCH);
+
+	ipc_free_batch = batch_prev;
 }
 
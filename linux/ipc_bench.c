@@ -0,0 +1,412 @@
+/*
+* Copyright 2021 NXP
+*
+* NXP Confidential. This software is owned or controlled by NXP and may only
+* be used strictly in accordance with the applicable license terms.  By expressly
+* accepting such terms or by downloading, installing, activating and/or otherwise
+* using the software, you are agreeing that you have read, and that you agree to
+* comply with and are bound by, such license terms.  If you do not agree to be
+* bound by the applicable license terms, then you may not retain, install, activate
+* or otherwise use the software.
+*/
+
+/**
+ @file
+ @brief GenAVB IPC benchmark
+ @details Measures the IPC transport (kernel driver or shared memory, depending on CONFIG_IPC_SHM)
+ with bursts of MSRP commands and responses between an application process and a stack process,
+ over the MSRP command (many writers) and sync response (many readers) IPC channels.
+ With -B, checks instead that broadcast messages on the sync response channel are received intact by two readers.
+ Must be run while the GenAVB stack is stopped, since it uses the stack IPC channels.
+*/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <poll.h>
+#include <signal.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/wait.h>
+
+#include "common/log.h"
+#include "common/ipc.h"
+#include "os/ipc.h"
+
+static void print_usage(void)
+{
+	printf("\nUsage:\n genavb-ipc-bench [options]\n");
+	printf("\nOptions:\n"
+		"\t-b <burst>            number of messages per burst (default 16)\n"
+		"\t-n <count>            number of bursts (default 10000)\n"
+		"\t-B                    broadcast test, one writer and two readers\n"
+		"\t-h                    print this help text\n");
+}
+
+static uint64_t bench_time(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t)now.tv_sec * NSECS_PER_SEC + now.tv_nsec;
+}
+
+static int bench_wait(struct ipc_rx *rx)
+{
+	struct pollfd fds;
+
+	fds.fd = rx->fd;
+	fds.events = POLLIN;
+
+	return poll(&fds, 1, 1000);
+}
+
+static int bench_send(struct ipc_tx *tx, unsigned int type, unsigned int dst)
+{
+	struct ipc_desc *desc;
+	int rc;
+
+	desc = ipc_alloc(tx, sizeof(struct ipc_msrp_listener_register));
+	if (!desc)
+		return -1;
+
+	desc->type = type;
+	desc->len = sizeof(struct ipc_msrp_listener_register);
+	desc->flags = 0;
+	desc->dst = dst;
+	memset(&desc->u, 0, desc->len);
+
+	rc = ipc_tx(tx, desc);
+	if (rc < 0)
+		ipc_free(tx, desc);
+
+	return rc;
+}
+
+/* Stack side: answers each command on the sync response channel */
+static int bench_stack(unsigned int count)
+{
+	struct ipc_rx rx;
+	struct ipc_tx tx;
+	struct ipc_desc *desc;
+	unsigned int done = 0;
+	int rc = 1;
+
+	if (ipc_rx_init_no_notify(&rx, IPC_MEDIA_STACK_MSRP) < 0)
+		goto err_rx;
+
+	if (ipc_tx_init(&tx, IPC_MSRP_MEDIA_STACK_SYNC) < 0)
+		goto err_tx;
+
+	while (done < count) {
+		desc = __ipc_rx(&rx);
+		if (!desc) {
+			bench_wait(&rx);
+			continue;
+		}
+
+		/* Retry until the application processes some responses */
+		while (bench_send(&tx, GENAVB_MSG_LISTENER_RESPONSE, desc->src) < 0)
+			sched_yield();
+
+		ipc_free(&rx, desc);
+		done++;
+	}
+
+	rc = 0;
+
+	ipc_tx_exit(&tx);
+
+err_tx:
+	ipc_rx_exit(&rx);
+
+err_rx:
+	return rc;
+}
+
+/* Application side: sends bursts of commands and waits for all the responses */
+static int bench_app(unsigned int burst, unsigned int count)
+{
+	struct ipc_rx rx;
+	struct ipc_tx tx;
+	struct ipc_desc *desc;
+	uint64_t start, t, min = (uint64_t)-1, max = 0, total = 0;
+	unsigned int i, sent, received;
+	int rc = 1;
+
+	if (ipc_tx_init(&tx, IPC_MEDIA_STACK_MSRP) < 0)
+		goto err_tx;
+
+	if (ipc_rx_init_no_notify(&rx, IPC_MSRP_MEDIA_STACK_SYNC) < 0)
+		goto err_rx;
+
+	if (ipc_tx_connect(&tx, &rx) < 0)
+		goto err_connect;
+
+	for (i = 0; i < count; i++) {
+		start = bench_time();
+
+		for (sent = 0, received = 0; received < burst;) {
+			if (sent < burst) {
+				rc = bench_send(&tx, GENAVB_MSG_LISTENER_REGISTER, 0);
+				if (!rc) {
+					sent++;
+					continue;
+				}
+
+				/* Stack process not started yet */
+				if (rc == -IPC_TX_ERR_NO_READER) {
+					usleep(1000);
+					continue;
+				}
+
+				/* Queue full, process some responses */
+			}
+
+			desc = __ipc_rx(&rx);
+			if (!desc) {
+				bench_wait(&rx);
+				continue;
+			}
+
+			ipc_free(&rx, desc);
+			received++;
+		}
+
+		t = bench_time() - start;
+
+		/* First burst includes the stack process startup */
+		if (!i)
+			continue;
+
+		total += t;
+		if (t < min)
+			min = t;
+		if (t > max)
+			max = t;
+	}
+
+	if (count > 1)
+		printf("%u bursts of %u command/response: burst min %llu ns, avg %llu ns, max %llu ns, per message %llu ns\n",
+			count - 1, burst, (unsigned long long)min, (unsigned long long)(total / (count - 1)),
+			(unsigned long long)max, (unsigned long long)(total / ((count - 1) * burst)));
+
+	rc = 0;
+
+err_connect:
+	ipc_rx_exit(&rx);
+
+err_rx:
+	ipc_tx_exit(&tx);
+
+err_tx:
+	return rc;
+}
+
+#define BCAST_READERS	2
+
+static unsigned int bcast_received, bcast_errors;
+
+static void bench_bcast_rx(struct ipc_rx const *rx, struct ipc_desc *desc)
+{
+	/* Broadcast buffers are read only for the readers, the source is filled by the transport */
+	if ((desc->type != GENAVB_MSG_LISTENER_RESPONSE) || desc->src || (desc->dst != IPC_DST_ALL))
+		bcast_errors++;
+
+	bcast_received++;
+
+	ipc_free(rx, desc);
+}
+
+/* Broadcast reader: receives each burst, alternating between the single and batched receive paths */
+static int bench_bcast_reader(int ack_fd, unsigned int burst, unsigned int count)
+{
+	struct ipc_rx rx;
+	struct ipc_desc *desc;
+	unsigned int i;
+	int rc = 1;
+
+	if (ipc_rx_init(&rx, IPC_MSRP_MEDIA_STACK_SYNC, bench_bcast_rx, (unsigned long)-1) < 0)
+		goto err_rx;
+
+	/* Ready */
+	if (write(ack_fd, "r", 1) != 1)
+		goto err_ack;
+
+	for (i = 0; i < count; i++) {
+		while (bcast_received < (i + 1) * burst) {
+			if (i & 1) {
+				desc = __ipc_rx(&rx);
+				if (desc) {
+					bench_bcast_rx(&rx, desc);
+					continue;
+				}
+			} else {
+				ipc_rx(&rx);
+				if (bcast_received >= (i + 1) * burst)
+					break;
+			}
+
+			if (bench_wait(&rx) <= 0) {
+				printf("reader %d: burst %u timeout, received %u messages\n", getpid(), i, bcast_received);
+				goto err_ack;
+			}
+		}
+
+		if (write(ack_fd, "a", 1) != 1)
+			goto err_ack;
+	}
+
+	if (!bcast_errors)
+		rc = 0;
+	else
+		printf("reader %d: %u invalid messages\n", getpid(), bcast_errors);
+
+err_ack:
+	ipc_rx_exit(&rx);
+
+err_rx:
+	return rc;
+}
+
+/* Broadcast writer: sends a burst each time all the readers processed the previous one */
+static int bench_bcast_writer(int ack_fd, unsigned int burst, unsigned int count)
+{
+	struct ipc_tx tx;
+	unsigned int i, j, acks;
+	char ack[BCAST_READERS];
+	ssize_t len;
+	int rc = 1;
+
+	if (ipc_tx_init(&tx, IPC_MSRP_MEDIA_STACK_SYNC) < 0)
+		goto err_tx;
+
+	/* Last iteration only waits for the readers to process the last burst */
+	for (i = 0; i <= count; i++) {
+		for (acks = 0; acks < BCAST_READERS; acks += len) {
+			len = read(ack_fd, ack, BCAST_READERS - acks);
+			if (len <= 0)
+				goto err_read;
+		}
+
+		if (i == count)
+			break;
+
+		for (j = 0; j < burst; j++)
+			while (bench_send(&tx, GENAVB_MSG_LISTENER_RESPONSE, IPC_DST_ALL) < 0)
+				sched_yield();
+	}
+
+	rc = 0;
+
+err_read:
+	ipc_tx_exit(&tx);
+
+err_tx:
+	return rc;
+}
+
+static int bench_bcast(unsigned int burst, unsigned int count)
+{
+	pid_t pid[BCAST_READERS];
+	int fds[2];
+	int i, status, rc;
+
+	if (pipe(fds) < 0) {
+		printf("pipe() failed\n");
+		return 1;
+	}
+
+	for (i = 0; i < BCAST_READERS; i++) {
+		pid[i] = fork();
+		if (pid[i] < 0) {
+			printf("fork() failed\n");
+			return 1;
+		}
+
+		if (!pid[i]) {
+			close(fds[0]);
+			exit(bench_bcast_reader(fds[1], burst, count));
+		}
+	}
+
+	close(fds[1]);
+
+	rc = bench_bcast_writer(fds[0], burst, count);
+
+	close(fds[0]);
+
+	for (i = 0; i < BCAST_READERS; i++) {
+		waitpid(pid[i], &status, 0);
+
+		if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+			if (WIFSIGNALED(status))
+				printf("reader %d: killed by signal %d\n", pid[i], WTERMSIG(status));
+
+			rc = 1;
+		}
+	}
+
+	printf("%u broadcast messages to %u readers: %s\n", burst * count, BCAST_READERS, rc ? "FAILED" : "OK");
+
+	return rc;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int burst = 16, count = 10000;
+	int option, status, rc;
+	int bcast = 0;
+	pid_t pid;
+
+	while ((option = getopt(argc, argv, "b:n:Bh")) != -1) {
+		switch (option) {
+		case 'b':
+			burst = strtoul(optarg, NULL, 0);
+			break;
+
+		case 'B':
+			bcast = 1;
+			break;
+
+		case 'n':
+			count = strtoul(optarg, NULL, 0);
+			break;
+
+		case 'h':
+		default:
+			print_usage();
+			return 0;
+		}
+	}
+
+	if (!burst || !count) {
+		print_usage();
+		return 1;
+	}
+
+	if (bcast)
+		return bench_bcast(burst, count);
+
+	pid = fork();
+	if (pid < 0) {
+		printf("fork() failed\n");
+		return 1;
+	}
+
+	if (!pid)
+		return bench_stack(burst * count);
+
+	rc = bench_app(burst, count);
+	if (rc)
+		kill(pid, SIGTERM);
+
+	waitpid(pid, &status, 0);
+
+	return rc;
+}
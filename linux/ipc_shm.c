@@ -0,0 +1,1024 @@
+/*
+* Copyright 2021 NXP
+*
+* NXP Confidential. This software is owned or controlled by NXP and may only
+* be used strictly in accordance with the applicable license terms.  By expressly
+* accepting such terms or by downloading, installing, activating and/or otherwise
+* using the software, you are agreeing that you have read, and that you agree to
+* comply with and are bound by, such license terms.  If you do not agree to be
+* bound by the applicable license terms, then you may not retain, install, activate
+* or otherwise use the software.
+*/
+
+/**
+ @file
+ @brief Linux shared memory IPC service implementation
+ @details Alternative to the IPC kernel driver (see linux/ipc.c), selected with CONFIG_IPC_SHM.
+ Messages are exchanged through rings in a shared memory file, one per IPC channel, without
+ any system call in the common case.
+*/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "common/log.h"
+#include "common/ipc.h"
+
+#include "epoll.h"
+#include "pool.h"
+
+#include "modules/ipc.h"
+
+/*
+ * Shared memory layout follows the IPC kernel driver:
+ *
+ * Each IPC channel has IPC_SHM_SLOTS slots, each owned by one reader or writer (process local
+ * handle) and each slot has a single producer/single consumer ring of IPC_BUF_SIZE messages.
+ *
+ * IPC_TYPE_SINGLE_READER_WRITER:
+ *	Reader slot is always 0, writer slot is always 1.
+ *	Messages are queued on the reader slot.
+ *
+ * IPC_TYPE_MANY_READERS
+ *	Reader slot is allocated between 1 and IPC_MAX_READER_WRITERS, writer slot is always 0.
+ *	Messages are queued on the reader slots. The writer sends to all readers (indications)
+ *	or one in particular (responses), using the destination map set by ipc_tx_connect().
+ *
+ * IPC_TYPE_MANY_WRITERS
+ *	Reader slot is always 0, writer slot is allocated between 1 and IPC_MAX_READER_WRITERS.
+ *	Messages are queued on the _writer_ slots, the reader services them in round-robin.
+ *
+ * A reader about to wait sets the notify flag of its slot, the writer that queues the next
+ * message clears it and writes to the reader notification fifo, so that there is at most one
+ * system call per burst of messages on each side.
+ *
+ * Slots are owned by a process (pid), slots of processes that died without releasing them are
+ * reclaimed on the next init.
+ */
+
+#define IPC_SHM_PATH		"/dev/shm/genavb_ipc_%u"
+#define IPC_SHM_NOTIFY_PATH	"/dev/shm/genavb_ipc_%u_%u"
+#define IPC_SHM_VERSION		1
+#define IPC_SHM_MODE		0660	/* channels are shared by the stack processes, same user or group */
+
+#define IPC_MAX_READER_WRITERS	8
+#define IPC_SHM_SLOTS		(IPC_MAX_READER_WRITERS + 1)
+
+#define IPC_SHM_RING_SIZE	32	/* power of 2 */
+#define IPC_SHM_POOL_SIZE	(32 * IPC_BUF_SIZE)
+
+#define IPC_SHM_CACHELINE	64
+
+struct ipc_shm_ring {
+	uint32_t head __attribute__((aligned(IPC_SHM_CACHELINE)));	/* written by the producer only */
+	uint32_t tail __attribute__((aligned(IPC_SHM_CACHELINE)));	/* written by the consumer only */
+	uint8_t buf[IPC_SHM_RING_SIZE][IPC_BUF_SIZE] __attribute__((aligned(IPC_SHM_CACHELINE)));
+};
+
+struct ipc_shm_slot {
+	int32_t pid;		/* owner process, 0 if free */
+	uint32_t notify;	/* set by the reader before waiting, cleared by the writer waking it up */
+	struct ipc_shm_ring ring;
+};
+
+struct ipc_shm_channel {
+	uint32_t version;
+	uint32_t dst_map[IPC_SHM_SLOTS];	/* many readers: writer address (bits 0-15), reader slot (bits 16-23) */
+	struct ipc_shm_slot slot[IPC_SHM_SLOTS];
+};
+
+struct ipc_shm {
+	pthread_mutex_t lock;
+	struct ipc_shm_channel *channel;
+	ipc_id_t id;
+	unsigned int type;
+	unsigned int slot;
+	unsigned int last;
+	struct pool pool;
+	int notify_fd[IPC_SHM_SLOTS];
+	int rx_fd;		/* reader notification fifo, -1 if not a reader */
+	uint32_t rx_starved;	/* set while the reader is out of buffers, cleared by the next buffer free */
+};
+
+#define static_assert(condition) extern char __CHECK__[1/(condition)];
+
+static_assert(sizeof(struct ipc_desc) < IPC_BUF_SIZE);
+
+static const unsigned int ipc_type[IPC_ID_MAX] = {
+	[IPC_MEDIA_STACK_AVDECC] = IPC_MEDIA_STACK_AVDECC_TYPE,
+	[IPC_AVDECC_MEDIA_STACK] = IPC_AVDECC_MEDIA_STACK_TYPE,
+
+	[IPC_CONTROLLER_AVDECC] = IPC_CONTROLLER_AVDECC_TYPE,
+	[IPC_AVDECC_CONTROLLER] = IPC_AVDECC_CONTROLLER_TYPE,
+	[IPC_AVDECC_CONTROLLER_SYNC] = IPC_AVDECC_CONTROLLER_SYNC_TYPE,
+
+	[IPC_CONTROLLED_AVDECC] = IPC_CONTROLLED_AVDECC_TYPE,
+	[IPC_AVDECC_CONTROLLED] = IPC_AVDECC_CONTROLLED_TYPE,
+
+	[IPC_MEDIA_STACK_MSRP] = IPC_MEDIA_STACK_MSRP_TYPE,
+	[IPC_MSRP_MEDIA_STACK] = IPC_MSRP_MEDIA_STACK_TYPE,
+	[IPC_MSRP_MEDIA_STACK_SYNC] = IPC_MSRP_MEDIA_STACK_SYNC_TYPE,
+
+	[IPC_MEDIA_STACK_MSRP_BRIDGE] = IPC_MEDIA_STACK_MSRP_BRIDGE_TYPE,
+	[IPC_MSRP_BRIDGE_MEDIA_STACK] = IPC_MSRP_BRIDGE_MEDIA_STACK_TYPE,
+	[IPC_MSRP_BRIDGE_MEDIA_STACK_SYNC] = IPC_MSRP_BRIDGE_MEDIA_STACK_SYNC_TYPE,
+
+	[IPC_MEDIA_STACK_MVRP] = IPC_MEDIA_STACK_MVRP_TYPE,
+	[IPC_MVRP_MEDIA_STACK] = IPC_MVRP_MEDIA_STACK_TYPE,
+	[IPC_MVRP_MEDIA_STACK_SYNC] = IPC_MVRP_MEDIA_STACK_SYNC_TYPE,
+
+	[IPC_MEDIA_STACK_MVRP_BRIDGE] = IPC_MEDIA_STACK_MVRP_BRIDGE_TYPE,
+	[IPC_MVRP_BRIDGE_MEDIA_STACK] = IPC_MVRP_BRIDGE_MEDIA_STACK_TYPE,
+	[IPC_MVRP_BRIDGE_MEDIA_STACK_SYNC] = IPC_MVRP_BRIDGE_MEDIA_STACK_SYNC_TYPE,
+
+	[IPC_MEDIA_STACK_CLOCK_DOMAIN] = IPC_MEDIA_STACK_CLOCK_DOMAIN_TYPE,
+	[IPC_CLOCK_DOMAIN_MEDIA_STACK] = IPC_CLOCK_DOMAIN_MEDIA_STACK_TYPE,
+	[IPC_CLOCK_DOMAIN_MEDIA_STACK_SYNC] = IPC_CLOCK_DOMAIN_MEDIA_STACK_SYNC_TYPE,
+
+	[IPC_MEDIA_STACK_MAAP] = IPC_MEDIA_STACK_MAAP_TYPE,
+	[IPC_MAAP_MEDIA_STACK] = IPC_MAAP_MEDIA_STACK_TYPE,
+	[IPC_MAAP_MEDIA_STACK_SYNC] = IPC_MAAP_MEDIA_STACK_SYNC_TYPE,
+
+	[IPC_MEDIA_STACK_GPTP] = IPC_MEDIA_STACK_GPTP_TYPE,
+	[IPC_GPTP_MEDIA_STACK] = IPC_GPTP_MEDIA_STACK_TYPE,
+	[IPC_GPTP_MEDIA_STACK_SYNC] = IPC_GPTP_MEDIA_STACK_SYNC_TYPE,
+
+	[IPC_MEDIA_STACK_GPTP_BRIDGE] = IPC_MEDIA_STACK_GPTP_BRIDGE_TYPE,
+	[IPC_GPTP_BRIDGE_MEDIA_STACK] = IPC_GPTP_BRIDGE_MEDIA_STACK_TYPE,
+	[IPC_GPTP_BRIDGE_MEDIA_STACK_SYNC] = IPC_GPTP_BRIDGE_MEDIA_STACK_SYNC_TYPE,
+
+	[IPC_MEDIA_STACK_AVTP] = IPC_MEDIA_STACK_AVTP_TYPE,
+	[IPC_AVTP_MEDIA_STACK] = IPC_AVTP_MEDIA_STACK_TYPE,
+	[IPC_AVTP_MEDIA_STACK_SYNC] = IPC_AVTP_MEDIA_STACK_SYNC_TYPE,
+
+	[IPC_AVDECC_MSRP] = IPC_AVDECC_MSRP_TYPE,
+
+	[IPC_AVTP_STATS] = IPC_AVTP_STATS_TYPE,
+
+	[IPC_MEDIA_STACK_MAC_SERVICE] = IPC_MEDIA_STACK_MAC_SERVICE_TYPE,
+	[IPC_MAC_SERVICE_MEDIA_STACK] = IPC_MAC_SERVICE_MEDIA_STACK_TYPE,
+	[IPC_MAC_SERVICE_MEDIA_STACK_SYNC] = IPC_MAC_SERVICE_MEDIA_STACK_SYNC_TYPE,
+
+	[IPC_MEDIA_STACK_MAC_SERVICE_BRIDGE] = IPC_MEDIA_STACK_MAC_SERVICE_BRIDGE_TYPE,
+	[IPC_MAC_SERVICE_BRIDGE_MEDIA_STACK] = IPC_MAC_SERVICE_BRIDGE_MEDIA_STACK_TYPE,
+	[IPC_MAC_SERVICE_BRIDGE_MEDIA_STACK_SYNC] = IPC_MAC_SERVICE_BRIDGE_MEDIA_STACK_SYNC_TYPE,
+};
+
+static inline unsigned int ipc_header_len(void)
+{
+	struct ipc_desc *tmp = (struct ipc_desc *)0;
+
+	/* Length of all structure members, up to the union */
+	return (unsigned long)&tmp->u;
+}
+
+static unsigned int ipc_slot_address(ipc_id_t id, unsigned int slot)
+{
+	return (slot | (id << 8));
+}
+
+static int ipc_shm_ring_push(struct ipc_shm_ring *ring, struct ipc_desc *desc, unsigned int len)
+{
+	uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+	uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+	if ((head - tail) >= IPC_SHM_RING_SIZE)
+		return -1;
+
+	memcpy(ring->buf[head & (IPC_SHM_RING_SIZE - 1)], desc, len);
+
+	__atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+/* Dequeues one message, copied to desc */
+static int ipc_shm_ring_pop(struct ipc_shm_ring *ring, struct ipc_desc *desc)
+{
+	uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+	uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+	struct ipc_desc *entry;
+	unsigned int len;
+
+	if (head == tail)
+		return -1;
+
+	entry = (struct ipc_desc *)ring->buf[tail & (IPC_SHM_RING_SIZE - 1)];
+
+	len = ipc_header_len() + entry->len;
+	if (len > IPC_BUF_SIZE)
+		len = IPC_BUF_SIZE;
+
+	memcpy(desc, entry, len);
+
+	__atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+static int ipc_shm_ring_empty(struct ipc_shm_ring *ring)
+{
+	return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+}
+
+/* Discards all pending messages, called by the consumer */
+static void ipc_shm_ring_flush(struct ipc_shm_ring *ring)
+{
+	__atomic_store_n(&ring->tail, __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+}
+
+static int ipc_shm_pid_alive(pid_t pid)
+{
+	return !((kill(pid, 0) < 0) && (errno == ESRCH));
+}
+
+static int ipc_shm_slot_claim(struct ipc_shm_channel *channel, unsigned int first, unsigned int last)
+{
+	pid_t pid = getpid();
+	int32_t owner;
+	int i;
+
+	for (i = first; i <= last; i++) {
+		owner = 0;
+		if (__atomic_compare_exchange_n(&channel->slot[i].pid, &owner, pid, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+			return i;
+	}
+
+	/* Reclaim slots of processes that exited without releasing them */
+	for (i = first; i <= last; i++) {
+		owner = __atomic_load_n(&channel->slot[i].pid, __ATOMIC_RELAXED);
+		if (!owner || (owner == pid) || ipc_shm_pid_alive(owner))
+			continue;
+
+		if (__atomic_compare_exchange_n(&channel->slot[i].pid, &owner, pid, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+			os_log(LOG_INFO, "slot %d reclaimed from pid %d\n", i, owner);
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+static void ipc_shm_slot_release(struct ipc_shm_channel *channel, unsigned int slot)
+{
+	__atomic_store_n(&channel->slot[slot].pid, 0, __ATOMIC_RELEASE);
+}
+
+static int ipc_shm_slot_has_reader(struct ipc_shm_channel *channel, unsigned int slot)
+{
+	int32_t owner = __atomic_load_n(&channel->slot[slot].pid, __ATOMIC_ACQUIRE);
+
+	return owner && ipc_shm_pid_alive(owner);
+}
+
+/* Removes the many readers destination map entries pointing to slot */
+static void ipc_shm_dst_map_clear(struct ipc_shm_channel *channel, unsigned int slot)
+{
+	uint32_t map;
+	int i;
+
+	for (i = 0; i < IPC_SHM_SLOTS; i++) {
+		map = __atomic_load_n(&channel->dst_map[i], __ATOMIC_ACQUIRE);
+		if (map && ((map >> 16) == slot))
+			__atomic_compare_exchange_n(&channel->dst_map[i], &map, 0, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+	}
+}
+
+/*
+ * Checks a channel file before use: it must have the expected type and belong to the calling user (or root).
+ * Permissions of files owned by the calling user are reset (the creation mode is subject to the umask, and
+ * files may be left by an older run with a wider mode), files owned by root must not be accessible to other users.
+ */
+static int ipc_shm_file_check(int fd, const char *path, mode_t type)
+{
+	struct stat st;
+
+	if (fstat(fd, &st) < 0) {
+		os_log(LOG_ERR, "fstat(%s) %s\n", path, strerror(errno));
+		goto err;
+	}
+
+	if ((st.st_mode & S_IFMT) != type) {
+		os_log(LOG_ERR, "%s: unexpected file type\n", path);
+		goto err;
+	}
+
+	if ((st.st_uid != geteuid()) && (st.st_uid != 0)) {
+		os_log(LOG_ERR, "%s: owned by uid %u\n", path, st.st_uid);
+		goto err;
+	}
+
+	if (st.st_uid == geteuid()) {
+		if (((st.st_mode & 0777) != IPC_SHM_MODE) && (fchmod(fd, IPC_SHM_MODE) < 0)) {
+			os_log(LOG_ERR, "fchmod(%s) %s\n", path, strerror(errno));
+			goto err;
+		}
+	} else if (st.st_mode & S_IRWXO) {
+		os_log(LOG_ERR, "%s: accessible by other users (mode %o)\n", path, st.st_mode & 0777);
+		goto err;
+	}
+
+	return 0;
+
+err:
+	return -1;
+}
+
+static int ipc_shm_notify_open(ipc_id_t id, unsigned int slot)
+{
+	char path[64];
+	int fd;
+
+	snprintf(path, sizeof(path), IPC_SHM_NOTIFY_PATH, id, slot);
+
+	if ((mkfifo(path, IPC_SHM_MODE) < 0) && (errno != EEXIST)) {
+		os_log(LOG_ERR, "mkfifo(%s) %s\n", path, strerror(errno));
+		goto err;
+	}
+
+	/* Opened read/write so that it never blocks nor fails, with or without peer */
+	fd = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC | O_NOFOLLOW);
+	if (fd < 0) {
+		os_log(LOG_ERR, "open(%s) %s\n", path, strerror(errno));
+		goto err;
+	}
+
+	if (ipc_shm_file_check(fd, path, S_IFIFO) < 0)
+		goto err_check;
+
+	return fd;
+
+err_check:
+	close(fd);
+
+err:
+	return -1;
+}
+
+static void ipc_shm_notify_drain(int fd)
+{
+	uint8_t buf[64];
+
+	while (read(fd, buf, sizeof(buf)) == sizeof(buf))
+		;
+}
+
+/* Wakes up the reader owning slot, if it's waiting */
+static void ipc_shm_notify(struct ipc_shm *shm, unsigned int slot)
+{
+	struct ipc_shm_slot *s = &shm->channel->slot[slot];
+	uint8_t val = 1;
+
+	/* Orders the ring update with the notify flag read, pairs with ipc_shm_rx_arm() */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	if (!__atomic_load_n(&s->notify, __ATOMIC_RELAXED))
+		return;
+
+	if (!__atomic_exchange_n(&s->notify, 0, __ATOMIC_ACQ_REL))
+		return;
+
+	if (shm->notify_fd[slot] < 0) {
+		shm->notify_fd[slot] = ipc_shm_notify_open(shm->id, slot);
+		if (shm->notify_fd[slot] < 0)
+			return;
+	}
+
+	if ((write(shm->notify_fd[slot], &val, sizeof(val)) < 0) && (errno != EAGAIN))
+		os_log(LOG_ERR, "ipc(%d) slot(%u) write() %s\n", shm->id, slot, strerror(errno));
+}
+
+static struct ipc_shm_channel *ipc_shm_channel_map(ipc_id_t id, int *fd_out)
+{
+	struct ipc_shm_channel *channel;
+	char path[64];
+	uint32_t version = 0;
+	int fd;
+
+	snprintf(path, sizeof(path), IPC_SHM_PATH, id);
+
+	fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC | O_NOFOLLOW, IPC_SHM_MODE);
+	if (fd < 0) {
+		os_log(LOG_ERR, "open(%s) %s\n", path, strerror(errno));
+		goto err_open;
+	}
+
+	if (ipc_shm_file_check(fd, path, S_IFREG) < 0)
+		goto err_check;
+
+	/* All zeroes is a valid initial state, so concurrent initialization is harmless */
+	if (ftruncate(fd, sizeof(struct ipc_shm_channel)) < 0) {
+		os_log(LOG_ERR, "ftruncate(%s) %s\n", path, strerror(errno));
+		goto err_truncate;
+	}
+
+	channel = mmap(NULL, sizeof(struct ipc_shm_channel), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (channel == MAP_FAILED) {
+		os_log(LOG_ERR, "mmap(%s) %s\n", path, strerror(errno));
+		goto err_mmap;
+	}
+
+	if (!__atomic_compare_exchange_n(&channel->version, &version, IPC_SHM_VERSION, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+	&& (version != IPC_SHM_VERSION)) {
+		os_log(LOG_ERR, "%s version %u, expected %u\n", path, version, IPC_SHM_VERSION);
+		goto err_version;
+	}
+
+	if (fd_out)
+		*fd_out = fd;
+	else
+		close(fd);
+
+	return channel;
+
+err_version:
+	munmap(channel, sizeof(struct ipc_shm_channel));
+
+err_mmap:
+err_truncate:
+err_check:
+	close(fd);
+
+err_open:
+	return NULL;
+}
+
+static struct ipc_shm *ipc_shm_init(ipc_id_t id, int rx, void **pool_base, unsigned long *pool_size, int *fd)
+{
+	struct ipc_shm *shm;
+	unsigned int first, last;
+	int slot, i;
+
+	if (id >= IPC_ID_MAX)
+		goto err;
+
+	shm = malloc(sizeof(struct ipc_shm));
+	if (!shm)
+		goto err;
+
+	memset(shm, 0, sizeof(*shm));
+
+	shm->id = id;
+	shm->type = ipc_type[id];
+	shm->last = 1;
+
+	for (i = 0; i < IPC_SHM_SLOTS; i++)
+		shm->notify_fd[i] = -1;
+
+	shm->rx_fd = -1;
+
+	pthread_mutex_init(&shm->lock, NULL);
+
+	*pool_size = IPC_SHM_POOL_SIZE;
+	*pool_base = mmap(NULL, *pool_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_LOCKED, -1, 0);
+	if (*pool_base == MAP_FAILED) {
+		os_log(LOG_ERR, "mmap() %s\n", strerror(errno));
+		goto err_pool_mmap;
+	}
+
+	if (pool_init(&shm->pool, *pool_base, *pool_size, IPC_BUF_ORDER) < 0) {
+		os_log(LOG_ERR, "pool_init() failed\n");
+		goto err_pool_init;
+	}
+
+	shm->channel = ipc_shm_channel_map(id, rx ? NULL : fd);
+	if (!shm->channel)
+		goto err_map;
+
+	switch (shm->type) {
+	case IPC_TYPE_MANY_READERS:
+		first = last = 0;
+		if (rx) {
+			first = 1;
+			last = IPC_MAX_READER_WRITERS;
+		}
+		break;
+
+	case IPC_TYPE_MANY_WRITERS:
+		first = last = 0;
+		if (!rx) {
+			first = 1;
+			last = IPC_MAX_READER_WRITERS;
+		}
+		break;
+
+	case IPC_TYPE_SINGLE_READER_WRITER:
+	default:
+		first = last = rx ? 0 : 1;
+		break;
+	}
+
+	slot = ipc_shm_slot_claim(shm->channel, first, last);
+	if (slot < 0) {
+		os_log(LOG_ERR, "ipc(%d) no free slot\n", id);
+		goto err_slot;
+	}
+
+	shm->slot = slot;
+
+	return shm;
+
+err_slot:
+	munmap(shm->channel, sizeof(struct ipc_shm_channel));
+
+	if (!rx)
+		close(*fd);
+
+err_map:
+	pool_exit(&shm->pool);
+
+err_pool_init:
+	munmap(*pool_base, *pool_size);
+
+err_pool_mmap:
+	pthread_mutex_destroy(&shm->lock);
+	free(shm);
+
+err:
+	return NULL;
+}
+
+static void ipc_shm_exit(struct ipc_shm *shm, void *pool_base, unsigned long pool_size)
+{
+	int i;
+
+	ipc_shm_slot_release(shm->channel, shm->slot);
+
+	for (i = 0; i < IPC_SHM_SLOTS; i++)
+		if (shm->notify_fd[i] >= 0)
+			close(shm->notify_fd[i]);
+
+	munmap(shm->channel, sizeof(struct ipc_shm_channel));
+
+	pool_exit(&shm->pool);
+
+	munmap(pool_base, pool_size);
+
+	pthread_mutex_destroy(&shm->lock);
+
+	free(shm);
+}
+
+struct ipc_desc *ipc_alloc(struct ipc_tx const *tx, unsigned int size)
+{
+	struct ipc_desc *desc;
+
+	if (size > IPC_BUF_SIZE)
+		return NULL;
+
+	desc = pool_alloc(&tx->shm->pool);
+	if (!desc)
+		os_log(LOG_ERR, "ipc_tx(%p) no buffer\n", tx);
+
+	return desc;
+}
+
+/* Wakes up a reader that ran out of buffers, after a buffer was freed */
+static void ipc_shm_rx_starved_notify(struct ipc_shm *shm)
+{
+	uint8_t val = 1;
+
+	/* Orders the pool update with the flag read, pairs with __ipc_rx() */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	if (!__atomic_load_n(&shm->rx_starved, __ATOMIC_RELAXED))
+		return;
+
+	if (!__atomic_exchange_n(&shm->rx_starved, 0, __ATOMIC_ACQ_REL))
+		return;
+
+	if ((write(shm->rx_fd, &val, sizeof(val)) < 0) && (errno != EAGAIN))
+		os_log(LOG_ERR, "ipc(%d) write() %s\n", shm->id, strerror(errno));
+}
+
+void ipc_free(void const *ipc, struct ipc_desc *desc)
+{
+	struct ipc_shm *shm = ((struct ipc_tx const *)ipc)->shm;
+
+	pool_free(&shm->pool, desc);
+
+	ipc_shm_rx_starved_notify(shm);
+}
+
+void ipc_free_multi(void const *ipc, struct ipc_desc **desc, unsigned int n)
+{
+	struct ipc_shm *shm = ((struct ipc_tx const *)ipc)->shm;
+
+	__pool_free_array(&shm->pool, (void **)desc, n);
+
+	ipc_shm_rx_starved_notify(shm);
+}
+
+/* Prepares the reader to wait, returns 1 if messages were queued meanwhile */
+static int ipc_shm_rx_arm(struct ipc_rx const *rx)
+{
+	struct ipc_shm *shm = rx->shm;
+	struct ipc_shm_channel *channel = shm->channel;
+	int i;
+
+	/* Any notification sent after this point is for messages not seen yet */
+	ipc_shm_notify_drain(rx->fd);
+
+	__atomic_store_n(&channel->slot[shm->slot].notify, 1, __ATOMIC_SEQ_CST);
+
+	if (shm->type == IPC_TYPE_MANY_WRITERS) {
+		for (i = 1; i <= IPC_MAX_READER_WRITERS; i++)
+			if (!ipc_shm_ring_empty(&channel->slot[i].ring))
+				return 1;
+	} else {
+		if (!ipc_shm_ring_empty(&channel->slot[shm->slot].ring))
+			return 1;
+	}
+
+	return 0;
+}
+
+int ipc_rx_init_no_notify(struct ipc_rx *rx, ipc_id_t id)
+{
+	struct ipc_shm_channel *channel;
+	uint8_t val = 1;
+	int i;
+
+	os_log(LOG_DEBUG, "ipc_rx(%p)\n", rx);
+
+	rx->shm = ipc_shm_init(id, 1, &rx->mmap_baseaddr, &rx->pool_size, NULL);
+	if (!rx->shm)
+		goto err_init;
+
+	channel = rx->shm->channel;
+
+	__atomic_store_n(&channel->slot[rx->shm->slot].notify, 0, __ATOMIC_RELEASE);
+
+	rx->fd = ipc_shm_notify_open(id, rx->shm->slot);
+	if (rx->fd < 0)
+		goto err_notify;
+
+	rx->shm->rx_fd = rx->fd;
+
+	/* Discard messages and mappings left over by a previous reader */
+	if (rx->shm->type == IPC_TYPE_MANY_WRITERS) {
+		for (i = 1; i <= IPC_MAX_READER_WRITERS; i++)
+			ipc_shm_ring_flush(&channel->slot[i].ring);
+	} else {
+		ipc_shm_ring_flush(&channel->slot[rx->shm->slot].ring);
+
+		if (rx->shm->type == IPC_TYPE_MANY_READERS)
+			ipc_shm_dst_map_clear(channel, rx->shm->slot);
+	}
+
+	if (ipc_shm_rx_arm(rx))
+		if (write(rx->fd, &val, sizeof(val)) < 0)
+			os_log(LOG_ERR, "write() %s\n", strerror(errno));
+
+	os_log(LOG_INFO, "ipc_rx(%p) id(%d) slot(%u) fd(%d) baseaddr(%p) size : %lu\n", rx, id, rx->shm->slot, rx->fd, rx->mmap_baseaddr, rx->pool_size);
+
+	return 0;
+
+err_notify:
+	ipc_shm_exit(rx->shm, rx->mmap_baseaddr, rx->pool_size);
+	rx->shm = NULL;
+
+err_init:
+	rx->fd = -1;
+
+	return -1;
+}
+
+int ipc_rx_init(struct ipc_rx *rx, ipc_id_t id, void (*func)(struct ipc_rx const *, struct ipc_desc *), unsigned long priv)
+{
+	int epoll_fd = (int)priv;
+
+	if (ipc_rx_init_no_notify(rx, id) < 0)
+		goto err_init;
+
+	if (epoll_fd >= 0) {
+		if (epoll_ctl_add(epoll_fd, rx->fd, EPOLL_TYPE_IPC, rx, &rx->epoll_data, EPOLLIN) < 0) {
+			os_log(LOG_ERR, "ipc_rx(%p) epoll_ctl_add() failed for ipc id(%d)\n", rx, id);
+			goto err_epoll_ctl;
+		}
+	}
+
+	rx->func = func;
+
+	return 0;
+
+err_epoll_ctl:
+	ipc_rx_exit(rx);
+
+err_init:
+	return -1;
+}
+
+int ipc_tx_init(struct ipc_tx *tx, ipc_id_t id)
+{
+	os_log(LOG_DEBUG, "ipc_tx(%p, %d)\n", tx, id);
+
+	tx->shm = ipc_shm_init(id, 0, &tx->mmap_baseaddr, &tx->pool_size, &tx->fd);
+	if (!tx->shm)
+		goto err_init;
+
+	os_log(LOG_INFO, "ipc_tx(%p) id(%d) slot(%u) fd(%d) baseaddr(%p) size : %lu\n", tx, id, tx->shm->slot, tx->fd, tx->mmap_baseaddr, tx->pool_size);
+
+	return 0;
+
+err_init:
+	tx->fd = -1;
+
+	return -1;
+}
+
+int ipc_tx_connect(struct ipc_tx *tx, struct ipc_rx *rx)
+{
+	struct ipc_shm *tx_shm = tx->shm;
+	struct ipc_shm *rx_shm = rx->shm;
+
+	if ((tx_shm->type != IPC_TYPE_MANY_WRITERS) || (rx_shm->type != IPC_TYPE_MANY_READERS)) {
+		os_log(LOG_ERR, "ipc_tx(%p) ipc_rx(%p) invalid types\n", tx, rx);
+		goto err;
+	}
+
+	__atomic_store_n(&rx_shm->channel->dst_map[tx_shm->slot],
+			ipc_slot_address(tx_shm->id, tx_shm->slot) | (rx_shm->slot << 16), __ATOMIC_RELEASE);
+
+	return 0;
+
+err:
+	return -1;
+}
+
+void ipc_rx_exit(struct ipc_rx *rx)
+{
+	struct ipc_shm *shm = rx->shm;
+	struct ipc_shm_channel *channel;
+
+	os_log(LOG_DEBUG, "ipc_rx(%p)\n", rx);
+
+	if (rx->fd < 0)
+		return;
+
+	channel = shm->channel;
+
+	__atomic_store_n(&channel->slot[shm->slot].notify, 0, __ATOMIC_RELEASE);
+
+	switch (shm->type) {
+	case IPC_TYPE_MANY_READERS:
+		ipc_shm_ring_flush(&channel->slot[shm->slot].ring);
+
+		/* Clear mapping, if any */
+		ipc_shm_dst_map_clear(channel, shm->slot);
+
+		break;
+
+	case IPC_TYPE_SINGLE_READER_WRITER:
+		ipc_shm_ring_flush(&channel->slot[shm->slot].ring);
+		break;
+
+	default:
+		break;
+	}
+
+	shm->rx_fd = -1;
+	close(rx->fd);
+	rx->fd = -1;
+
+	ipc_shm_exit(shm, rx->mmap_baseaddr, rx->pool_size);
+	rx->shm = NULL;
+}
+
+void ipc_tx_exit(struct ipc_tx *tx)
+{
+	os_log(LOG_DEBUG, "ipc_tx(%p)\n", tx);
+
+	if (tx->fd < 0)
+		return;
+
+	close(tx->fd);
+	tx->fd = -1;
+
+	ipc_shm_exit(tx->shm, tx->mmap_baseaddr, tx->pool_size);
+	tx->shm = NULL;
+}
+
+static int __ipc_tx(struct ipc_shm *shm, unsigned int slot, struct ipc_desc *desc, unsigned int len)
+{
+	struct ipc_shm_channel *channel = shm->channel;
+
+	if (ipc_shm_ring_push(&channel->slot[slot].ring, desc, len) < 0) {
+		/* A reader that died doesn't release its slot, detect it here */
+		if (!ipc_shm_slot_has_reader(channel, slot))
+			return -IPC_TX_ERR_NO_READER;
+
+		return -IPC_TX_ERR_QUEUE_FULL;
+	}
+
+	return 0;
+}
+
+int ipc_tx(struct ipc_tx const *tx, struct ipc_desc *desc)
+{
+	struct ipc_shm *shm = tx->shm;
+	struct ipc_shm_channel *channel = shm->channel;
+	unsigned int len = desc->len + ipc_header_len();
+	unsigned int dst_index, map, i;
+	int rc = 0;
+
+	if (len > IPC_BUF_SIZE)
+		return -IPC_TX_ERR_UNKNOWN;
+
+	pthread_mutex_lock(&shm->lock);
+
+	switch (shm->type) {
+	case IPC_TYPE_MANY_READERS:
+		if (desc->dst == IPC_DST_ALL) {
+			for (i = 1; i <= IPC_MAX_READER_WRITERS; i++) {
+				if (!__atomic_load_n(&channel->slot[i].pid, __ATOMIC_ACQUIRE))
+					continue;
+
+				if (__ipc_tx(shm, i, desc, len) < 0)
+					continue;
+
+				ipc_shm_notify(shm, i);
+			}
+		} else {
+			/* send message to specific reader */
+			dst_index = desc->dst & 0xff;
+			if (!dst_index || (dst_index > IPC_MAX_READER_WRITERS)) {
+				rc = -IPC_TX_ERR_UNKNOWN;
+				goto err_unlock;
+			}
+
+			map = __atomic_load_n(&channel->dst_map[dst_index], __ATOMIC_ACQUIRE);
+			if (!map || ((map & 0xffff) != desc->dst)) {
+				rc = -IPC_TX_ERR_NO_READER;
+				goto err_unlock;
+			}
+
+			rc = __ipc_tx(shm, map >> 16, desc, len);
+			if (rc < 0)
+				goto err_unlock;
+
+			ipc_shm_notify(shm, map >> 16);
+		}
+
+		break;
+
+	case IPC_TYPE_SINGLE_READER_WRITER:
+		if (!__atomic_load_n(&channel->slot[0].pid, __ATOMIC_ACQUIRE)) {
+			rc = -IPC_TX_ERR_NO_READER;
+			goto err_unlock;
+		}
+
+		rc = __ipc_tx(shm, 0, desc, len);
+		if (rc < 0)
+			goto err_unlock;
+
+		ipc_shm_notify(shm, 0);
+
+		break;
+
+	case IPC_TYPE_MANY_WRITERS:
+		if (!__atomic_load_n(&channel->slot[0].pid, __ATOMIC_ACQUIRE)) {
+			rc = -IPC_TX_ERR_NO_READER;
+			goto err_unlock;
+		}
+
+		/* Messages are queued on the writer slot */
+		rc = __ipc_tx(shm, shm->slot, desc, len);
+		if (rc < 0) {
+			if (!ipc_shm_slot_has_reader(channel, 0))
+				rc = -IPC_TX_ERR_NO_READER;
+
+			goto err_unlock;
+		}
+
+		ipc_shm_notify(shm, 0);
+
+		break;
+
+	default:
+		rc = -IPC_TX_ERR_UNKNOWN;
+		goto err_unlock;
+	}
+
+	pthread_mutex_unlock(&shm->lock);
+
+	/* Message was copied, the descriptor is released (as with the kernel driver) */
+	ipc_free(tx, desc);
+
+	return 0;
+
+err_unlock:
+	pthread_mutex_unlock(&shm->lock);
+
+	os_log(LOG_DEBUG, "ipc_tx(%p) error %d\n", tx, rc);
+
+	return rc;
+}
+
+static struct ipc_desc *ipc_shm_rx(struct ipc_rx const *rx, struct ipc_desc *desc)
+{
+	struct ipc_shm *shm = rx->shm;
+	struct ipc_shm_channel *channel = shm->channel;
+	int i;
+
+	switch (shm->type) {
+	case IPC_TYPE_MANY_READERS:
+	case IPC_TYPE_SINGLE_READER_WRITER:
+		if (ipc_shm_ring_pop(&channel->slot[shm->slot].ring, desc) < 0)
+			goto err;
+
+		desc->src = 0;
+
+		break;
+
+	case IPC_TYPE_MANY_WRITERS:
+		for (i = 1; i <= IPC_MAX_READER_WRITERS; i++) {
+			shm->last++;
+			if (shm->last > IPC_MAX_READER_WRITERS)
+				shm->last = 1;
+
+			if (ipc_shm_ring_pop(&channel->slot[shm->last].ring, desc) < 0)
+				continue;
+
+			desc->src = ipc_slot_address(shm->id, shm->last);
+
+			goto out;
+		}
+
+		goto err;
+
+	default:
+		goto err;
+	}
+
+out:
+	return desc;
+
+err:
+	return NULL;
+}
+
+struct ipc_desc * __ipc_rx(struct ipc_rx const *rx)
+{
+	struct ipc_shm *shm = rx->shm;
+	struct ipc_desc *desc, *rc;
+
+	/* Messages stay queued until the receiver frees some buffers */
+	desc = pool_alloc(&shm->pool);
+	if (!desc) {
+		/*
+		 * Stop the (level triggered) notification until a buffer is freed: drain the fifo,
+		 * the writers don't notify again as the slot is not armed, and the next ipc_free()
+		 * writes to the fifo. Retry once, in case a buffer was freed before the flag was set.
+		 */
+		ipc_shm_notify_drain(rx->fd);
+
+		__atomic_store_n(&shm->rx_starved, 1, __ATOMIC_SEQ_CST);
+
+		desc = pool_alloc(&shm->pool);
+		if (!desc) {
+			os_log(LOG_ERR, "ipc_rx(%p) no buffer\n", rx);
+			return NULL;
+		}
+
+		__atomic_store_n(&shm->rx_starved, 0, __ATOMIC_RELAXED);
+	}
+
+	pthread_mutex_lock(&shm->lock);
+
+	while (!(rc = ipc_shm_rx(rx, desc))) {
+		/* No more messages, re-enable notifications (and check for a race with a writer) */
+		if (!ipc_shm_rx_arm(rx))
+			break;
+	}
+
+	pthread_mutex_unlock(&shm->lock);
+
+	if (!rc)
+		pool_free(&shm->pool, desc);
+
+	return rc;
+}
+
+void ipc_rx(struct ipc_rx const *rx)
+{
+	struct ipc_desc *desc;
+
+	while (1) {
+		desc = __ipc_rx(rx);
+		if (!desc)
+			break;
+
+		rx->func(rx, desc);
+	}
+}
@@ -0,0 +1,250 @@
+/*
+* Copyright 2021 NXP
+*
+* NXP Confidential. This software is owned or controlled by NXP and may only
+* be used strictly in accordance with the applicable license terms.  By expressly
+* accepting such terms or by downloading, installing, activating and/or otherwise
+* using the software, you are agreeing that you have read, and that you agree to
+* comply with and are bound by, such license terms.  If you do not agree to be
+* bound by the applicable license terms, then you may not retain, install, activate
+* or otherwise use the software.
+*/
+
+/**
+ @file
+ @brief GenAVB transmit and receive latency statistics tool
+ @details Reads the latency trace records exported by the AVB kernel module (built with CONFIG_AVB_LATENCY_TRACE),
+ matches the records of each packet and displays, for each pipeline stage, the histogram of the latency from the previous stage,
+ and the transmit and receive end to end latency histograms.
+*/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+
+#include "modules/latency_trace.h"
+
+#define HIST_BINS	32	/* log2 bins, bin n holds latencies in [2^n, 2^(n+1)[ ns */
+#define PACKET_TABLE_SIZE	4096
+
+struct latency_hist {
+	uint64_t count;
+	uint64_t sum;
+	uint64_t min;
+	uint64_t max;
+	uint64_t bin[HIST_BINS];
+};
+
+/* In flight packet state, indexed by the record key */
+struct packet_entry {
+	uint32_t key;
+	uint8_t stage;
+	uint8_t valid;
+	uint64_t first_ts;
+	uint64_t last_ts;
+};
+
+static struct packet_entry packet_table[PACKET_TABLE_SIZE];
+
+#define HIST_TX_END_TO_END	LATENCY_TRACE_STAGE_MAX
+#define HIST_RX_END_TO_END	(LATENCY_TRACE_STAGE_MAX + 1)
+#define HIST_MAX		(LATENCY_TRACE_STAGE_MAX + 2)
+
+/* Latency from the previous stage, indexed by stage, followed by the end to end latencies */
+static struct latency_hist hist[HIST_MAX];
+
+static const char *stage_str[HIST_MAX] = {
+	[LATENCY_TRACE_MEDIA_ENQUEUE] = "media enqueue",
+	[LATENCY_TRACE_MEDIA_DEQUEUE] = "media dequeue",
+	[LATENCY_TRACE_QOS_ENQUEUE] = "qos enqueue",
+	[LATENCY_TRACE_QOS_DEQUEUE] = "qos dequeue",
+	[LATENCY_TRACE_DRIVER_TX] = "driver tx",
+	[LATENCY_TRACE_HW_TX_TS] = "hw tx timestamp",
+	[LATENCY_TRACE_TX_DONE] = "tx done",
+	[LATENCY_TRACE_HW_RX_TS] = "hw rx timestamp",
+	[LATENCY_TRACE_NET_RX] = "net rx",
+	[LATENCY_TRACE_NET_RX_DEQUEUE] = "net rx dequeue",
+	[LATENCY_TRACE_MEDIA_RX_ENQUEUE] = "media rx enqueue",
+	[LATENCY_TRACE_MEDIA_RX_DEQUEUE] = "media rx dequeue",
+	[HIST_TX_END_TO_END] = "tx end to end",
+	[HIST_RX_END_TO_END] = "rx end to end",
+};
+
+static void print_usage(void)
+{
+	printf("\nUsage:\n genavb-latency-stats [options]\n");
+	printf("\nOptions:\n"
+		"\t-i <interval>         display statistics every <interval> seconds (default 1)\n"
+		"\t-h                    print this help text\n");
+}
+
+static void hist_update(struct latency_hist *h, uint64_t val)
+{
+	unsigned int bin = 0;
+
+	if (val)
+		bin = 63 - __builtin_clzll(val);
+
+	if (bin >= HIST_BINS)
+		bin = HIST_BINS - 1;
+
+	h->bin[bin]++;
+
+	if (!h->count || (val < h->min))
+		h->min = val;
+
+	if (val > h->max)
+		h->max = val;
+
+	h->sum += val;
+	h->count++;
+}
+
+/* Hardware timestamps are converted to monotonic time, with some jitter: may precede the previous stage */
+static uint64_t latency(uint64_t from, uint64_t to)
+{
+	if (to < from)
+		return 0;
+
+	return to - from;
+}
+
+static void record_process(struct latency_trace_record *r)
+{
+	struct packet_entry *e = &packet_table[(r->key * 2654435761u) >> 20];
+
+	if (r->stage >= LATENCY_TRACE_STAGE_MAX)
+		return;
+
+	/* New packet, or buffer reused for a new packet */
+	if (!e->valid || (e->key != r->key) || (r->stage < e->stage)
+	    || (LATENCY_TRACE_STAGE_IS_RX(r->stage) != LATENCY_TRACE_STAGE_IS_RX(e->stage))) {
+		e->key = r->key;
+		e->stage = r->stage;
+		e->first_ts = r->ts;
+		e->last_ts = r->ts;
+		e->valid = 1;
+
+		return;
+	}
+
+	/* Stage repeated (e.g. transmit retried on full ring), keep the first occurrence */
+	if (r->stage == e->stage)
+		return;
+
+	hist_update(&hist[r->stage], latency(e->last_ts, r->ts));
+
+	e->stage = r->stage;
+	e->last_ts = r->ts;
+
+	if (r->flags & LATENCY_TRACE_FLAGS_LAST) {
+		if (LATENCY_TRACE_STAGE_IS_RX(r->stage))
+			hist_update(&hist[HIST_RX_END_TO_END], latency(e->first_ts, r->ts));
+		else
+			hist_update(&hist[HIST_TX_END_TO_END], latency(e->first_ts, r->ts));
+
+		e->valid = 0;
+	}
+}
+
+static void stats_dump(void)
+{
+	struct latency_hist *h;
+	unsigned int stage, bin;
+
+	printf("%-16s %12s %10s %10s %10s\n", "stage (ns)", "count", "min", "avg", "max");
+
+	for (stage = 0; stage < HIST_MAX; stage++) {
+		h = &hist[stage];
+
+		if (!h->count)
+			continue;
+
+		printf("%-16s %12llu %10llu %10llu %10llu\n", stage_str[stage], (unsigned long long)h->count,
+			(unsigned long long)h->min, (unsigned long long)(h->sum / h->count), (unsigned long long)h->max);
+
+		for (bin = 0; bin < HIST_BINS; bin++)
+			if (h->bin[bin])
+				printf("  [%10llu, %10llu[ %12llu\n", 1ULL << bin, 1ULL << (bin + 1), (unsigned long long)h->bin[bin]);
+	}
+
+	printf("\n");
+
+	fflush(stdout);
+}
+
+static uint64_t monotonic_ns(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+int main(int argc, char *argv[])
+{
+	struct latency_trace_record record[256];
+	unsigned int interval = 1;
+	uint64_t next_dump;
+	ssize_t len;
+	int option;
+	int fd, i;
+
+	while ((option = getopt(argc, argv, "i:h")) != -1) {
+		switch (option) {
+		case 'i':
+			interval = strtoul(optarg, NULL, 0);
+			break;
+
+		case 'h':
+		default:
+			print_usage();
+			return 0;
+		}
+	}
+
+	if (!interval)
+		interval = 1;
+
+	fd = open(LATENCY_TRACE_FILE, O_RDONLY);
+	if (fd < 0) {
+		printf("Could not open %s (%s), is the AVB module built with CONFIG_AVB_LATENCY_TRACE?\n", LATENCY_TRACE_FILE, strerror(errno));
+		goto err_open;
+	}
+
+	next_dump = monotonic_ns() + (uint64_t)interval * 1000000000ULL;
+
+	while (1) {
+		len = read(fd, record, sizeof(record));
+		if (len < 0) {
+			printf("read() failed (%s)\n", strerror(errno));
+			goto err_read;
+		}
+
+		for (i = 0; i < len / sizeof(struct latency_trace_record); i++)
+			record_process(&record[i]);
+
+		if (monotonic_ns() >= next_dump) {
+			stats_dump();
+			next_dump += (uint64_t)interval * 1000000000ULL;
+		}
+
+		/* Ring drained, let it fill up again */
+		if (len < sizeof(record))
+			usleep(1000);
+	}
+
+err_read:
+	close(fd);
+
+err_open:
+	return 1;
+}
@@ -20,11 +20,17 @@
 #define _GNU_SOURCE
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdarg.h>
 #include <string.h>
+#include <ctype.h>
 #include <errno.h>
 #include <time.h>
 #include <inttypes.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stddef.h>
+#include <unistd.h>
 
 #include "common/log.h"
 
@@ -32,6 +38,161 @@ static int log_monotonic_enabled = 0;
 static u64 log_monotonic_time_s;
 static u64 log_monotonic_time_ns;
 
+/*
+ * Asynchronous logging
+ *
+ * When enabled, _os_log() doesn't format nor print anything. It stores the log timestamps, the format string
+ * pointer and the arguments in binary form in a per thread single producer/single consumer ring, and a low
+ * priority thread formats and prints the records. String arguments are copied in the record, since they
+ * may not outlive the call. Records with arguments that can't be stored in binary form (too many arguments,
+ * unsupported conversions) are formatted in the record by the caller.
+ * A record whose data (strings or formatted text) doesn't fit in its data area is chained: it extends over
+ * the following ring slots, so that the data stays contiguous. A record never wraps around the end of the
+ * ring, the slots left at the end are skipped with a padding record.
+ * If a ring is full the record is dropped and accounted, the caller never blocks.
+ * Records are printed in order for a given thread, but not across threads.
+ * Threads should register with log_thread_register() before logging from a time critical context, so that
+ * their ring isn't allocated on first use.
+ */
+
+#define LOG_ASYNC_RING_SIZE	256	/* records, must be a power of 2 */
+#define LOG_ASYNC_ARGS_MAX	8
+#define LOG_ASYNC_DATA_SIZE	128	/* data area of a single slot record */
+#define LOG_ASYNC_PERIOD_NS	10000000
+
+#define LOG_ASYNC_FLAGS_RAW	(1 << 0)
+#define LOG_ASYNC_FLAGS_TEXT	(1 << 1)
+#define LOG_ASYNC_FLAGS_PAD	(1 << 2)
+
+#define LOG_OUT_BUF_SIZE	512
+
+#define LOG_SPEC_MAX		32
+
+enum log_arg_type {
+	LOG_ARG_NONE,	/* %% */
+	LOG_ARG_INT,
+	LOG_ARG_LONG,
+	LOG_ARG_LLONG,
+	LOG_ARG_DOUBLE,
+	LOG_ARG_PTR,
+	LOG_ARG_STR,
+	LOG_ARG_INVALID
+};
+
+struct log_spec {
+	enum log_arg_type type;
+	unsigned int stars;	/* number of '*' width/precision arguments */
+	unsigned int precision_star;
+	int precision;		/* -1 if none or from an argument */
+	unsigned int len;
+};
+
+union log_arg {
+	long long ll;
+	double d;
+	void *p;
+	unsigned int str;	/* offset in record data */
+};
+
+struct log_record {
+	u64 time_s;
+	u64 time_ns;
+	u64 monotonic_s;
+	u64 monotonic_ns;
+	const char *level;
+	const char *func;
+	const char *component;
+	const char *format;
+	unsigned int flags;
+	unsigned int slots;	/* number of ring slots used by the record */
+	unsigned int nargs;
+	union log_arg arg[LOG_ASYNC_ARGS_MAX];
+	char data[LOG_ASYNC_DATA_SIZE];	/* must be last, extended by the following slots */
+};
+
+struct log_ring {
+	unsigned int head __attribute__((aligned(64)));	/* written by the owner thread */
+	unsigned int dropped;
+
+	unsigned int tail __attribute__((aligned(64)));	/* written by the drain thread */
+	unsigned int dropped_reported;
+
+	int in_use;
+	struct log_ring *next;
+
+	struct log_record record[LOG_ASYNC_RING_SIZE];
+};
+
+static int log_async_enabled = 0;
+static int log_async_stop = 0;
+static pthread_t log_async_thread;
+static pthread_key_t log_ring_key;
+static pthread_mutex_t log_drain_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct log_ring *log_ring_list;
+static __thread struct log_ring *log_ring_local;
+
+/*
+ * Log output: stdio, or raw write() calls from the crash handler since the crashed thread
+ * may hold the stdio locks.
+ */
+struct log_out {
+	int fd;		/* -1 for stdio */
+};
+
+static struct log_out log_out_stdio = { .fd = -1 };
+
+static void log_out_write(struct log_out *out, const char *data, size_t len)
+{
+	ssize_t rc;
+
+	if (out->fd < 0) {
+		fwrite(data, 1, len, stdout);
+		return;
+	}
+
+	while (len) {
+		rc = write(out->fd, data, len);
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+
+			break;
+		}
+
+		data += rc;
+		len -= rc;
+	}
+}
+
+static void log_out_printf(struct log_out *out, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+static void log_out_printf(struct log_out *out, const char *format, ...)
+{
+	char buf[LOG_OUT_BUF_SIZE];
+	va_list ap;
+	int len;
+
+	va_start(ap, format);
+
+	if (out->fd < 0) {
+		vprintf(format, ap);
+		va_end(ap);
+		return;
+	}
+
+	len = vsnprintf(buf, sizeof(buf), format, ap);
+
+	va_end(ap);
+
+	if (len < 0)
+		return;
+
+	if (len >= sizeof(buf))
+		len = sizeof(buf) - 1;
+
+	log_out_write(out, buf, len);
+}
+
 void log_enable_monotonic(void)
 {
 	log_monotonic_enabled = 1;
@@ -56,12 +217,634 @@ int log_update_monotonic(void)
 	return 0;
 }
 
+static void log_header_print(struct log_out *out, const char *level, const char *func, const char *component, u64 time_s, u64 time_ns, u64 monotonic_s, u64 monotonic_ns)
+{
+	/* customizing log output depending on user's configuration to have either ptp only or monotonic and ptp time reference */
+	if (log_monotonic_enabled)
+		log_out_printf(out, "%-4s %4" PRIu64 ".%09" PRIu64 " %11" PRIu64 ".%09" PRIu64 " %-6s %-32.32s : ", level, monotonic_s, monotonic_ns, time_s, time_ns, component, func);
+	else
+		log_out_printf(out, "%-4s %11" PRIu64 ".%09" PRIu64 " %-6s %-32.32s : ", level, time_s, time_ns, component, func);
+}
+
+/* Parses one printf conversion specification, starting at the '%' character */
+static void log_spec_parse(const char *p, struct log_spec *spec)
+{
+	const char *s = p + 1;
+	unsigned int length = 0;
+
+	spec->stars = 0;
+	spec->precision_star = 0;
+	spec->precision = -1;
+
+	if (*s == '%') {
+		spec->type = LOG_ARG_NONE;
+		spec->len = 2;
+		return;
+	}
+
+	while (*s && strchr("-+ #0'", *s))
+		s++;
+
+	if (*s == '*') {
+		spec->stars++;
+		s++;
+	} else {
+		while (isdigit(*s))
+			s++;
+	}
+
+	if (*s == '.') {
+		s++;
+
+		if (*s == '*') {
+			spec->stars++;
+			spec->precision_star = 1;
+			s++;
+		} else {
+			spec->precision = 0;
+			while (isdigit(*s))
+				spec->precision = spec->precision * 10 + (*s++ - '0');
+		}
+	}
+
+	switch (*s) {
+	case 'h':
+		s++;
+		if (*s == 'h')
+			s++;
+		break;
+
+	case 'l':
+		s++;
+		length = 1;
+		if (*s == 'l') {
+			s++;
+			length = 2;
+		}
+		break;
+
+	case 'z':
+	case 't':
+		s++;
+		length = 1;
+		break;
+
+	case 'q':
+	case 'j':
+		s++;
+		length = 2;
+		break;
+
+	case 'L':
+		s++;
+		length = 3;
+		break;
+
+	default:
+		break;
+	}
+
+	switch (*s) {
+	case 'd':
+	case 'i':
+	case 'u':
+	case 'o':
+	case 'x':
+	case 'X':
+	case 'c':
+		if (length == 0)
+			spec->type = LOG_ARG_INT;
+		else if (length == 1)
+			spec->type = LOG_ARG_LONG;
+		else if (length == 2)
+			spec->type = LOG_ARG_LLONG;
+		else
+			spec->type = LOG_ARG_INVALID;
+		break;
+
+	case 'e':
+	case 'E':
+	case 'f':
+	case 'F':
+	case 'g':
+	case 'G':
+	case 'a':
+	case 'A':
+		spec->type = (length == 3) ? LOG_ARG_INVALID : LOG_ARG_DOUBLE;
+		break;
+
+	case 's':
+		spec->type = length ? LOG_ARG_INVALID : LOG_ARG_STR;
+		break;
+
+	case 'p':
+		spec->type = LOG_ARG_PTR;
+		break;
+
+	default:
+		/* %n, %m, wide characters, ... */
+		spec->type = LOG_ARG_INVALID;
+		break;
+	}
+
+	if (*s)
+		s++;
+
+	spec->len = s - p;
+}
+
+/*
+ * Stores the arguments of a log message in binary form, strings are only copied if they fit in data_max bytes.
+ * Returns the data length required by the record, or -1 if the arguments can't be stored in binary form.
+ */
+static int log_async_capture(struct log_record *r, unsigned int data_max, const char *format, va_list ap)
+{
+	const char *p = format;
+	struct log_spec spec;
+	unsigned int data_len = 0;
+	unsigned int i, len;
+	int precision;
+	const char *s;
+
+	r->nargs = 0;
+
+	while ((p = strchr(p, '%'))) {
+		log_spec_parse(p, &spec);
+		p += spec.len;
+
+		if (spec.type == LOG_ARG_NONE)
+			continue;
+
+		if ((spec.type == LOG_ARG_INVALID) || (spec.len >= LOG_SPEC_MAX) || ((r->nargs + spec.stars) >= LOG_ASYNC_ARGS_MAX))
+			return -1;
+
+		precision = spec.precision;
+
+		for (i = 0; i < spec.stars; i++)
+			r->arg[r->nargs++].ll = va_arg(ap, int);
+
+		if (spec.precision_star)
+			precision = r->arg[r->nargs - 1].ll;
+
+		switch (spec.type) {
+		case LOG_ARG_INT:
+			r->arg[r->nargs].ll = va_arg(ap, int);
+			break;
+
+		case LOG_ARG_LONG:
+			r->arg[r->nargs].ll = va_arg(ap, long);
+			break;
+
+		case LOG_ARG_LLONG:
+			r->arg[r->nargs].ll = va_arg(ap, long long);
+			break;
+
+		case LOG_ARG_DOUBLE:
+			r->arg[r->nargs].d = va_arg(ap, double);
+			break;
+
+		case LOG_ARG_PTR:
+			r->arg[r->nargs].p = va_arg(ap, void *);
+			break;
+
+		case LOG_ARG_STR:
+			s = va_arg(ap, const char *);
+			if (!s)
+				s = "(null)";
+
+			/* The string may not be null terminated if a precision is used */
+			if (precision >= 0)
+				len = strnlen(s, precision);
+			else
+				len = strlen(s);
+
+			if ((data_len + len) < data_max) {
+				memcpy(r->data + data_len, s, len);
+				r->data[data_len + len] = '\0';
+			}
+
+			r->arg[r->nargs].str = data_len;
+			data_len += len + 1;
+			break;
+
+		default:
+			return -1;
+		}
+
+		r->nargs++;
+	}
+
+	return data_len;
+}
+
+/* Data area of a record extended over a number of ring slots */
+static unsigned int log_record_data_max(unsigned int slots)
+{
+	return slots * sizeof(struct log_record) - offsetof(struct log_record, data);
+}
+
+static unsigned int log_record_slots(unsigned int data_len)
+{
+	unsigned int slots = 1;
+
+	while (log_record_data_max(slots) < data_len)
+		slots++;
+
+	return slots;
+}
+
+/*
+ * Reserves contiguous slots for a record at the head of the ring, skipping the slots left at the end of the ring
+ * if needed. The head is only updated locally, returns NULL if the ring doesn't have enough free slots.
+ */
+static struct log_record *log_ring_reserve(struct log_ring *ring, unsigned int *head, unsigned int slots)
+{
+	unsigned int free = LOG_ASYNC_RING_SIZE - (*head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE));
+	unsigned int index = *head & (LOG_ASYNC_RING_SIZE - 1);
+	unsigned int contig = LOG_ASYNC_RING_SIZE - index;
+
+	if (slots > contig) {
+		if ((contig + slots) > free)
+			return NULL;
+
+		ring->record[index].flags = LOG_ASYNC_FLAGS_PAD;
+		ring->record[index].slots = contig;
+
+		*head += contig;
+		index = 0;
+	} else if (slots > free) {
+		return NULL;
+	}
+
+	return &ring->record[index];
+}
+
+static void log_ring_release(void *data)
+{
+	struct log_ring *ring = data;
+
+	/* Pending records are still printed, the ring is reused by the next new thread */
+	__atomic_store_n(&ring->in_use, 0, __ATOMIC_RELEASE);
+}
+
+static struct log_ring *log_ring_get(void)
+{
+	struct log_ring *ring;
+	int free;
+
+	for (ring = __atomic_load_n(&log_ring_list, __ATOMIC_ACQUIRE); ring; ring = ring->next) {
+		free = 0;
+		if (__atomic_compare_exchange_n(&ring->in_use, &free, 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+			goto out;
+	}
+
+	if (posix_memalign((void **)&ring, 64, sizeof(struct log_ring)))
+		return NULL;
+
+	memset(ring, 0, sizeof(struct log_ring));
+	ring->in_use = 1;
+
+	ring->next = __atomic_load_n(&log_ring_list, __ATOMIC_RELAXED);
+	while (!__atomic_compare_exchange_n(&log_ring_list, &ring->next, ring, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+out:
+	pthread_setspecific(log_ring_key, ring);
+	log_ring_local = ring;
+
+	return ring;
+}
+
+void log_thread_register(void)
+{
+	if (!__atomic_load_n(&log_async_enabled, __ATOMIC_ACQUIRE) || log_ring_local)
+		return;
+
+	if (!log_ring_get())
+		os_log(LOG_ERR, "log ring allocation failed\n");
+}
+
+static void log_async_write(unsigned int flags, const char *level, const char *func, const char *component, const char *format, va_list ap)
+{
+	struct log_ring *ring = log_ring_local;
+	struct log_record *r;
+	unsigned int head, slots, avail;
+	int len;
+	va_list aq;
+
+	/* Threads that didn't register get their ring on first use */
+	if (!ring) {
+		ring = log_ring_get();
+		if (!ring)
+			return;
+	}
+
+	head = ring->head;
+
+	/* Try first in the contiguous free slots, without moving the head */
+	avail = LOG_ASYNC_RING_SIZE - (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE));
+	if (!avail)
+		goto drop;
+
+	if (avail > (LOG_ASYNC_RING_SIZE - (head & (LOG_ASYNC_RING_SIZE - 1))))
+		avail = LOG_ASYNC_RING_SIZE - (head & (LOG_ASYNC_RING_SIZE - 1));
+
+	r = &ring->record[head & (LOG_ASYNC_RING_SIZE - 1)];
+
+	va_copy(aq, ap);
+	len = log_async_capture(r, log_record_data_max(avail), format, aq);
+	va_end(aq);
+
+	if (len < 0) {
+		va_copy(aq, ap);
+		len = vsnprintf(NULL, 0, format, aq) + 1;
+		va_end(aq);
+
+		flags |= LOG_ASYNC_FLAGS_TEXT;
+	}
+
+	slots = log_record_slots(len);
+
+	if (slots > avail) {
+		r = log_ring_reserve(ring, &head, slots);
+		if (!r)
+			goto drop;
+
+		if (!(flags & LOG_ASYNC_FLAGS_TEXT)) {
+			va_copy(aq, ap);
+			log_async_capture(r, log_record_data_max(slots), format, aq);
+			va_end(aq);
+		}
+	}
+
+	if (flags & LOG_ASYNC_FLAGS_TEXT)
+		vsnprintf(r->data, log_record_data_max(slots), format, ap);
+
+	r->slots = slots;
+	r->time_s = log_time_s;
+	r->time_ns = log_time_ns;
+	r->monotonic_s = log_monotonic_time_s;
+	r->monotonic_ns = log_monotonic_time_ns;
+	r->level = level;
+	r->func = func;
+	r->component = component;
+	r->format = format;
+	r->flags = flags;
+
+	__atomic_store_n(&ring->head, head + slots, __ATOMIC_RELEASE);
+
+	return;
+
+drop:
+	__atomic_store_n(&ring->dropped, ring->dropped + 1, __ATOMIC_RELAXED);
+}
+
+#define log_arg_print(out, spec, stars, star, arg)						\
+	((stars) == 2 ? log_out_printf(out, spec, (star)[0], (star)[1], arg) :		\
+	 (stars) == 1 ? log_out_printf(out, spec, (star)[0], arg) : log_out_printf(out, spec, arg))
+
+static void log_record_print(struct log_out *out, struct log_record *r)
+{
+	const char *p, *q;
+	char spec_str[LOG_SPEC_MAX];
+	struct log_spec spec;
+	union log_arg *arg = r->arg;
+	int star[2];
+	unsigned int i;
+
+	if (!(r->flags & LOG_ASYNC_FLAGS_RAW))
+		log_header_print(out, r->level, r->func, r->component, r->time_s, r->time_ns, r->monotonic_s, r->monotonic_ns);
+
+	if (r->flags & LOG_ASYNC_FLAGS_TEXT) {
+		log_out_write(out, r->data, strlen(r->data));
+		return;
+	}
+
+	p = r->format;
+
+	while ((q = strchr(p, '%'))) {
+		log_out_write(out, p, q - p);
+
+		log_spec_parse(q, &spec);
+		p = q + spec.len;
+
+		if (spec.type == LOG_ARG_NONE) {
+			log_out_write(out, "%", 1);
+			continue;
+		}
+
+		memcpy(spec_str, q, spec.len);
+		spec_str[spec.len] = '\0';
+
+		for (i = 0; i < spec.stars; i++)
+			star[i] = (arg++)->ll;
+
+		switch (spec.type) {
+		case LOG_ARG_INT:
+			log_arg_print(out, spec_str, spec.stars, star, (int)arg->ll);
+			break;
+
+		case LOG_ARG_LONG:
+			log_arg_print(out, spec_str, spec.stars, star, (long)arg->ll);
+			break;
+
+		case LOG_ARG_LLONG:
+			log_arg_print(out, spec_str, spec.stars, star, arg->ll);
+			break;
+
+		case LOG_ARG_DOUBLE:
+			log_arg_print(out, spec_str, spec.stars, star, arg->d);
+			break;
+
+		case LOG_ARG_PTR:
+			log_arg_print(out, spec_str, spec.stars, star, arg->p);
+			break;
+
+		case LOG_ARG_STR:
+			log_arg_print(out, spec_str, spec.stars, star, r->data + arg->str);
+			break;
+
+		default:
+			break;
+		}
+
+		arg++;
+	}
+
+	log_out_write(out, p, strlen(p));
+}
+
+/* Prints all the pending records, returns the number of records printed */
+static unsigned int log_async_drain(struct log_out *out)
+{
+	struct log_record *r;
+	struct log_ring *ring;
+	unsigned int head, tail, dropped;
+	unsigned int count = 0;
+
+	for (ring = __atomic_load_n(&log_ring_list, __ATOMIC_ACQUIRE); ring; ring = ring->next) {
+		tail = ring->tail;
+		head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+		while (tail != head) {
+			r = &ring->record[tail & (LOG_ASYNC_RING_SIZE - 1)];
+
+			if (!(r->flags & LOG_ASYNC_FLAGS_PAD)) {
+				log_record_print(out, r);
+				count++;
+			}
+
+			tail += r->slots;
+
+			__atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+		}
+
+		dropped = __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+		if (dropped != ring->dropped_reported) {
+			log_header_print(out, log_lvl_string[LOG_ERR], __func__, "os", log_time_s, log_time_ns, log_monotonic_time_s, log_monotonic_time_ns);
+			log_out_printf(out, "%u log messages dropped\n", dropped - ring->dropped_reported);
+			ring->dropped_reported = dropped;
+		}
+	}
+
+	if (count && (out->fd < 0))
+		fflush(stdout);
+
+	return count;
+}
+
+static void *log_async_thread_main(void *arg)
+{
+	struct timespec period = { .tv_sec = 0, .tv_nsec = LOG_ASYNC_PERIOD_NS };
+	sigset_t set;
+	unsigned int count;
+
+	/* Signals are handled by the application threads */
+	sigfillset(&set);
+	pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+	while (!__atomic_load_n(&log_async_stop, __ATOMIC_RELAXED)) {
+		pthread_mutex_lock(&log_drain_lock);
+		count = log_async_drain(&log_out_stdio);
+		pthread_mutex_unlock(&log_drain_lock);
+
+		if (!count)
+			nanosleep(&period, NULL);
+	}
+
+	return NULL;
+}
+
+static void log_async_crash_handler(int sig)
+{
+	struct log_out out = { .fd = STDOUT_FILENO };
+
+	/*
+	 * Best effort, stdio isn't used since the crashed thread may hold its locks. If the drain lock is taken,
+	 * the drain thread is printing (or is the one crashing) and the rings can't be walked safely.
+	 */
+	if (!pthread_mutex_trylock(&log_drain_lock)) {
+		log_out_printf(&out, "\n*** signal %d, post-mortem log dump ***\n", sig);
+		log_async_drain(&out);
+		pthread_mutex_unlock(&log_drain_lock);
+	}
+
+	/* Handler was reset, the default action now applies */
+	raise(sig);
+}
+
+static void log_async_crash_handler_init(void)
+{
+	const int signals[] = { SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT };
+	struct sigaction action, old;
+	int i;
+
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = log_async_crash_handler;
+	action.sa_flags = SA_RESETHAND | SA_NODEFER;
+	sigemptyset(&action.sa_mask);
+
+	for (i = 0; i < sizeof(signals) / sizeof(signals[0]); i++) {
+		/* Don't override the application handlers */
+		if (sigaction(signals[i], NULL, &old) < 0 || (old.sa_handler != SIG_DFL))
+			continue;
+
+		sigaction(signals[i], &action, NULL);
+	}
+}
+
+static void log_async_exit(void)
+{
+	__atomic_store_n(&log_async_stop, 1, __ATOMIC_RELAXED);
+	pthread_join(log_async_thread, NULL);
+
+	__atomic_store_n(&log_async_enabled, 0, __ATOMIC_RELAXED);
+
+	pthread_mutex_lock(&log_drain_lock);
+	log_async_drain(&log_out_stdio);
+	pthread_mutex_unlock(&log_drain_lock);
+}
+
+void log_enable_async(void)
+{
+	pthread_attr_t attr;
+	struct sched_param param = { .sched_priority = 0 };
+	int rc;
+
+	if (log_async_enabled)
+		return;
+
+	rc = pthread_key_create(&log_ring_key, log_ring_release);
+	if (rc) {
+		os_log(LOG_ERR, "pthread_key_create(): %s\n", strerror(rc));
+		goto err_key;
+	}
+
+	/* The drain thread must never compete with the real-time threads */
+	pthread_attr_init(&attr);
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, SCHED_OTHER);
+	pthread_attr_setschedparam(&attr, &param);
+
+	rc = pthread_create(&log_async_thread, &attr, log_async_thread_main, NULL);
+
+	pthread_attr_destroy(&attr);
+
+	if (rc) {
+		os_log(LOG_ERR, "pthread_create(): %s\n", strerror(rc));
+		goto err_thread;
+	}
+
+	pthread_setname_np(log_async_thread, "genavb-log");
+
+	log_async_crash_handler_init();
+
+	atexit(log_async_exit);
+
+	__atomic_store_n(&log_async_enabled, 1, __ATOMIC_RELEASE);
+
+	log_thread_register();
+
+	return;
+
+err_thread:
+	pthread_key_delete(log_ring_key);
+
+err_key:
+	return;
+}
+
 void _os_log_raw(const char *format, ...)
 {
 	va_list ap;
 
 	va_start(ap, format);
 
+	if (__atomic_load_n(&log_async_enabled, __ATOMIC_RELAXED)) {
+		log_async_write(LOG_ASYNC_FLAGS_RAW, NULL, NULL, NULL, format, ap);
+		va_end(ap);
+		return;
+	}
+
 	vprintf(format, ap);
 
 	va_end(ap);
@@ -73,14 +856,16 @@ void _os_log(const char *level, const char *func, const char *component, const c
 {
 	va_list ap;
 
-	/* customizing log output depending on user's configuration to have either ptp only or monotonic and ptp time reference */
-	if (log_monotonic_enabled)
-		printf("%-4s %4" PRIu64 ".%09" PRIu64 " %11" PRIu64 ".%09" PRIu64 " %-6s %-32.32s : ", level, log_monotonic_time_s, log_monotonic_time_ns, log_time_s, log_time_ns, component, func);
-	else
-		printf("%-4s %11" PRIu64 ".%09" PRIu64 " %-6s %-32.32s : ", level, log_time_s, log_time_ns, component, func);
-
 	va_start(ap, format);
 
+	if (__atomic_load_n(&log_async_enabled, __ATOMIC_RELAXED)) {
+		log_async_write(0, level, func, component, format, ap);
+		va_end(ap);
+		return;
+	}
+
+	log_header_print(&log_out_stdio, level, func, component, log_time_s, log_time_ns, log_monotonic_time_s, log_monotonic_time_ns);
+
 	vprintf(format, ap);
 
 	va_end(ap);
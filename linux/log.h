@@ -33,4 +33,18 @@ void log_enable_monotonic(void);
  */
 int log_update_monotonic(void);
 
+/** Enable asynchronous logging.
+ * Log messages are stored in binary form in per thread rings and printed by a low priority thread,
+ * so that logging never blocks the caller. Messages are dropped (and accounted) if a ring is full.
+ * \return none
+ */
+void log_enable_async(void);
+
+/** Register the calling thread for asynchronous logging.
+ * Allocates the thread log ring upfront, so that the first log message from a time critical context
+ * doesn't allocate memory. Does nothing if asynchronous logging isn't enabled.
+ * \return none
+ */
+void log_thread_register(void);
+
 #endif /* _LINUX_LOG_H_ */
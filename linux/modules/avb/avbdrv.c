@@ -39,6 +39,7 @@
 #include "dmadrv.h"
 #include "mle145170.h"
 #include "gpt.h"
+#include "latency_trace.h"
 
 #define AVB_READ_MAX_BUFFERS	32
 #define AVB_WRITE_BATCH		16
@@ -395,6 +396,12 @@ static int avbdrv_init(void)
 		goto err_buf_pool;
 	}
 
+	rc = latency_trace_init(avb->debugfs, &avb->buf_pool);
+	if (rc < 0) {
+		pr_err("%s: latency_trace_init() failed\n", __func__);
+		goto err_latency_trace;
+	}
+
 	rc = alloc_chrdev_region(&avb->devno, AVBDRV_MINOR, AVBDRV_MINOR_COUNT, AVBDRV_NAME);
 	if (rc < 0) {
 		pr_err("%s: alloc_chrdev_region() failed\n", __func__);
@@ -562,6 +569,9 @@ err_cdev_add:
 	unregister_chrdev_region(avb->devno, AVBDRV_MINOR_COUNT);
 
 err_alloc_chrdev:
+	latency_trace_exit();
+
+err_latency_trace:
 	pool_dma_exit(&avb->buf_pool);
 
 err_buf_pool:
@@ -614,6 +624,8 @@ static void avbdrv_exit(void)
 	cdev_del(&avb->cdev);
 	unregister_chrdev_region(avb->devno, AVBDRV_MINOR_COUNT);
 
+	latency_trace_exit();
+
 	pool_dma_exit(&avb->buf_pool);
 
 	avb_free_range(avb->buf_baseaddr, BUF_POOL_SIZE);
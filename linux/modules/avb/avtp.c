@@ -26,6 +26,7 @@
 
 #include "avtp.h"
 #include "net_socket.h"
+#include "latency_trace.h"
 
 struct avtp_rx_hdlr avtp_rx_hdlr;
 struct avtp_tx_hdlr avtp_tx_hdlr;
@@ -274,6 +275,8 @@ static int avtp_tx(struct net_socket *sock, struct logical_port *port, unsigned
 			desc->common.flags |= AVB_TX_FLAG_TS;
 
 		queue_enqueue_next(&sock->queue, &write, (unsigned long)desc);
+
+		latency_trace(LATENCY_TRACE_QOS_ENQUEUE, desc, desc->common.len);
 	}
 
 	queue_enqueue_done(&sock->queue, write);
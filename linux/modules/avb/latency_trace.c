@@ -0,0 +1,148 @@
+/*
+ * AVB transmit and receive latency tracing
+ * Copyright 2021 NXP
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/*
+ * Each transmit and receive pipeline stage appends a timestamped record, identified by the packet buffer offset
+ * in the network buffer pool, to a single overwriting ring. Readers of the debugfs file get the records written since they opened it,
+ * records overwritten before being read are skipped.
+ */
+
+#include <linux/debugfs.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/uaccess.h>
+
+#include "latency_trace.h"
+
+struct latency_trace_ring latency_ring;
+
+struct latency_trace_reader {
+	u32 r;
+	struct latency_trace_record buf[64];
+};
+
+static int latency_trace_open(struct inode *inode, struct file *file)
+{
+	struct latency_trace_reader *reader;
+
+	reader = kmalloc(sizeof(*reader), GFP_KERNEL);
+	if (!reader)
+		return -ENOMEM;
+
+	reader->r = atomic_read(&latency_ring.w);
+
+	file->private_data = reader;
+
+	return nonseekable_open(inode, file);
+}
+
+static int latency_trace_release(struct inode *inode, struct file *file)
+{
+	kfree(file->private_data);
+
+	return 0;
+}
+
+static ssize_t latency_trace_read(struct file *file, char __user *buf, size_t len, loff_t *off)
+{
+	struct latency_trace_reader *reader = file->private_data;
+	struct latency_trace_record *r;
+	unsigned int n;
+	size_t total = 0;
+	u32 w;
+
+	len /= sizeof(struct latency_trace_record);
+
+	while (len) {
+		w = atomic_read(&latency_ring.w);
+
+		/* Writers went around the ring, skip the overwritten records */
+		if ((w - reader->r) > LATENCY_TRACE_SIZE)
+			reader->r = w - LATENCY_TRACE_SIZE;
+
+		if (reader->r == w)
+			break;
+
+		n = 0;
+		while ((reader->r != w) && (n < ARRAY_SIZE(reader->buf)) && (n < len)) {
+			r = &latency_ring.record[reader->r & (LATENCY_TRACE_SIZE - 1)];
+
+			if (READ_ONCE(r->seq) != (reader->r + 1))
+				goto next;
+
+			smp_rmb();
+			reader->buf[n] = *r;
+			smp_rmb();
+
+			/* Record overwritten while copying */
+			if (READ_ONCE(r->seq) != (reader->r + 1))
+				goto next;
+
+			n++;
+		next:
+			reader->r++;
+		}
+
+		if (copy_to_user(buf + total, reader->buf, n * sizeof(struct latency_trace_record)))
+			return -EFAULT;
+
+		total += n * sizeof(struct latency_trace_record);
+		len -= n;
+	}
+
+	return total;
+}
+
+static const struct file_operations latency_trace_fops = {
+	.open		= latency_trace_open,
+	.release	= latency_trace_release,
+	.read		= latency_trace_read,
+	.llseek		= no_llseek,
+};
+
+int latency_trace_init(struct dentry *avb_dentry, struct pool_dma *pool)
+{
+	struct latency_trace_record *record;
+
+	record = vzalloc(LATENCY_TRACE_SIZE * sizeof(struct latency_trace_record));
+	if (!record)
+		return -ENOMEM;
+
+	atomic_set(&latency_ring.w, 0);
+	latency_ring.pool = pool;
+
+	smp_wmb();
+	latency_ring.record = record;
+
+	debugfs_create_file("latency_trace", S_IRUSR, avb_dentry, NULL, &latency_trace_fops);
+
+	pr_info("%s: %u records\n", __func__, LATENCY_TRACE_SIZE);
+
+	return 0;
+}
+
+void latency_trace_exit(void)
+{
+	struct latency_trace_record *record = latency_ring.record;
+
+	/* Called once all the traced paths are stopped */
+	latency_ring.record = NULL;
+
+	vfree(record);
+}
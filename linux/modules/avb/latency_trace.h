@@ -0,0 +1,134 @@
+/*
+ * AVB transmit and receive latency tracing
+ * Copyright 2021 NXP
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef _LATENCY_TRACE_H_
+#define _LATENCY_TRACE_H_
+
+#include "genavb/types.h"
+
+/* Pipeline stages, transmit then receive, each in packet order */
+enum latency_trace_stage {
+	LATENCY_TRACE_MEDIA_ENQUEUE = 0,	/* media packet written by the application (genavb_stream_send()) */
+	LATENCY_TRACE_MEDIA_DEQUEUE,		/* media packet read by the AVTP stack */
+	LATENCY_TRACE_QOS_ENQUEUE,		/* packet queued for transmission */
+	LATENCY_TRACE_QOS_DEQUEUE,		/* packet selected by the port scheduler */
+	LATENCY_TRACE_DRIVER_TX,		/* packet added to the network driver transmit ring */
+	LATENCY_TRACE_HW_TX_TS,			/* packet transmitted, hardware timestamp */
+	LATENCY_TRACE_TX_DONE,			/* transmit completion reported by the network driver */
+	LATENCY_TRACE_HW_RX_TS,			/* packet received, hardware timestamp */
+	LATENCY_TRACE_NET_RX,			/* packet received by the network driver */
+	LATENCY_TRACE_NET_RX_DEQUEUE,		/* packet read by the stack */
+	LATENCY_TRACE_MEDIA_RX_ENQUEUE,		/* media packet written by the AVTP stack (or copied to the mmap ring) */
+	LATENCY_TRACE_MEDIA_RX_DEQUEUE,		/* media packet read by the application (genavb_stream_receive()) */
+	LATENCY_TRACE_STAGE_MAX
+};
+
+#define LATENCY_TRACE_STAGE_IS_RX(stage)	((stage) >= LATENCY_TRACE_HW_RX_TS)
+
+#define LATENCY_TRACE_FLAGS_LAST	(1 << 0)	/* last stage traced for this packet, the buffer is released */
+
+struct latency_trace_record {
+	avb_u32 seq;		/* record index + 1, 0 while the record is being written */
+	avb_u8 stage;
+	avb_u8 flags;
+	avb_u16 len;
+	avb_u32 key;		/* packet buffer offset in the network buffer pool, identical for all the stages of a given packet */
+	avb_u32 hw_ts;		/* raw hardware timestamp (PTP hardware clock, ns), only for the hardware timestamp stages */
+	avb_u64 ts;		/* monotonic time, ns. For the hardware timestamp stages, hw_ts converted to monotonic time */
+};
+
+#define LATENCY_TRACE_SIZE	16384	/* records, must be a power of 2 */
+#define LATENCY_TRACE_FILE	"/sys/kernel/debug/avb/latency_trace"
+
+#ifdef __KERNEL__
+
+#include <linux/atomic.h>
+#include <linux/timekeeping.h>
+
+#include "pool_dma.h"
+
+struct dentry;
+
+#if defined(CONFIG_AVB_LATENCY_TRACE)
+struct latency_trace_ring {
+	atomic_t w;
+	struct latency_trace_record *record;
+	struct pool_dma *pool;
+};
+
+extern struct latency_trace_ring latency_ring;
+
+/* Lockless, may be called from any context concurrently */
+static inline void __latency_trace(unsigned int stage, unsigned int flags, void *desc, unsigned int len, u32 hw_ts, u64 ts)
+{
+	struct latency_trace_record *r;
+	u32 seq;
+
+	if (unlikely(!latency_ring.record))
+		return;
+
+	seq = atomic_inc_return_relaxed(&latency_ring.w) - 1;
+	r = &latency_ring.record[seq & (LATENCY_TRACE_SIZE - 1)];
+
+	r->seq = 0;
+	smp_wmb();
+
+	r->ts = ts;
+	r->stage = stage;
+	r->flags = flags;
+	r->len = len;
+	r->key = pool_dma_virt_to_shmem(latency_ring.pool, desc);
+	r->hw_ts = hw_ts;
+
+	smp_wmb();
+	r->seq = seq + 1;
+}
+
+static inline void latency_trace(unsigned int stage, void *desc, unsigned int len)
+{
+	__latency_trace(stage, 0, desc, len, 0, ktime_get_mono_fast_ns());
+}
+
+static inline void latency_trace_last(unsigned int stage, void *desc, unsigned int len)
+{
+	__latency_trace(stage, LATENCY_TRACE_FLAGS_LAST, desc, len, 0, ktime_get_mono_fast_ns());
+}
+
+/*
+ * Hardware timestamp stage. The hardware timestamp is converted to monotonic time using the hardware clock (hw_now)
+ * and the monotonic clock (now) read back to back by the caller. Only valid for timestamps less than 2^32 ns old.
+ */
+static inline void latency_trace_hw_ts(unsigned int stage, void *desc, unsigned int len, u32 hw_ts, u32 hw_now, u64 now)
+{
+	__latency_trace(stage, 0, desc, len, hw_ts, now - (u32)(hw_now - hw_ts));
+}
+
+int latency_trace_init(struct dentry *avb_dentry, struct pool_dma *pool);
+void latency_trace_exit(void);
+#else
+static inline void latency_trace(unsigned int stage, void *desc, unsigned int len) {}
+static inline void latency_trace_last(unsigned int stage, void *desc, unsigned int len) {}
+static inline void latency_trace_hw_ts(unsigned int stage, void *desc, unsigned int len, u32 hw_ts, u32 hw_now, u64 now) {}
+static inline int latency_trace_init(struct dentry *avb_dentry, struct pool_dma *pool) { return 0; }
+static inline void latency_trace_exit(void) {}
+#endif
+
+#endif /* __KERNEL__ */
+
+#endif /* _LATENCY_TRACE_H_ */
@@ -21,6 +21,10 @@
 #include <linux/slab.h>
 #include <linux/poll.h>
 #include <linux/sched.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/file.h>
+#include <linux/version.h>
 
 #include "genavb/media.h"
 #include "genavb/types.h"
@@ -31,6 +35,7 @@
 #include "pool.h"
 #include "avbdrv.h"
 #include "media.h"
+#include "latency_trace.h"
 
 
 /**
@@ -42,9 +47,15 @@
  * the other to the media stack.
  * Both the AVB network stack (avtp thread) and media stack open a media queue and then try to bind
  * to opposite ends, to exchange data and control information.
- * A data copy is always done in the driver, which allows data to be moved between media stack buffers
+ * By default a data copy is done in the driver, which allows data to be moved between media stack buffers
  * and AVB network stack buffers. This means AVB network buffers are never shared with media application/stack.
  *
+ * In mmap ring mode (AVTP_MMAP_RING) the media application maps a per queue ring, followed by one payload slot
+ * per ring entry, and fills/reads AVTP payloads and metadata in the slots, without system calls on the data path.
+ * The mapping is private to the media queue: the driver copies payload and metadata between the slots and
+ * the AVB network buffers, validating everything written by the application, so AVB network buffers are
+ * still never shared with the media application.
+ *
  */
 
 #define FRAME_STRIDE_MAX	1024
@@ -55,9 +66,115 @@
 #error "Invalid NET_PAYLOAD_SIZE_MAX"
 #endif
 
+#if (MEDIA_RING_SIZE & (MEDIA_RING_SIZE - 1))
+#error "MEDIA_RING_SIZE must be a power of 2"
+#endif
+
+#if (NET_PAYLOAD_SIZE_MAX > MEDIA_RING_SLOT_SIZE)
+#error "Invalid MEDIA_RING_SLOT_SIZE"
+#endif
+
+#define DESC_MAX	32
+#define EVENT_MAX	32
+
+static inline int media_queue_wakeup_ready(struct media_queue *mqueue)
+{
+	return media_wakeup_ready(&mqueue->wakeup, media_queue_avail(mqueue), mqueue->batch_size);
+}
+
+/* Called with drv->wakeup_lock held */
+static int media_queue_wakeup_group_ready(struct media_drv *drv, unsigned int group)
+{
+	struct media_queue *member;
+
+	list_for_each_entry(member, &drv->wakeup_group[group - 1], group_list)
+		if (!media_queue_wakeup_ready(member))
+			return 0;
+
+	return 1;
+}
+
+/* Called with drv->wakeup_lock held */
 static inline int need_to_wake_up_listener_queue(struct media_queue * mqueue)
 {
-	return (media_queue_avail(mqueue) >= mqueue->batch_size) || queue_full(&mqueue->queue) || media_queue_eofs(mqueue);
+	if (queue_full(&mqueue->queue) || media_queue_eofs(mqueue))
+		return 1;
+
+	if (mqueue->wakeup.policy.mode == GENAVB_STREAM_WAKEUP_GROUP)
+		return media_queue_wakeup_group_ready(mqueue->drv, mqueue->wakeup.policy.group);
+
+	return media_queue_wakeup_ready(mqueue);
+}
+
+/* Called with drv->wakeup_lock held */
+static void media_queue_api_wake_up(struct media_queue *mqueue)
+{
+	if (waitqueue_active(&mqueue->api_wait)) {
+		mqueue->wakeup.wakeups++;
+		wake_up(&mqueue->api_wait);
+	}
+}
+
+/**
+ * media_queue_listener_wake_up() - wakes up the media application, based on the listener wakeup policy
+ * @mqueue - media queue pointer
+ *
+ * In group mode, the last stream to become ready wakes up all the streams of the group.
+ * Called with drv->wakeup_lock held.
+ */
+static void media_queue_listener_wake_up(struct media_queue *mqueue)
+{
+	struct media_drv *drv = mqueue->drv;
+	struct media_queue *member;
+
+	if (queue_full(&mqueue->queue) || media_queue_eofs(mqueue)) {
+		media_queue_api_wake_up(mqueue);
+	} else if (mqueue->wakeup.policy.mode == GENAVB_STREAM_WAKEUP_GROUP) {
+		if (media_queue_wakeup_group_ready(drv, mqueue->wakeup.policy.group))
+			list_for_each_entry(member, &drv->wakeup_group[mqueue->wakeup.policy.group - 1], group_list)
+				media_queue_api_wake_up(member);
+	} else if (media_queue_wakeup_ready(mqueue)) {
+		media_queue_api_wake_up(mqueue);
+	}
+}
+
+/**
+ * media_queue_set_wakeup() - updates the listener wakeup policy
+ * @mqueue - media queue pointer
+ * @wakeup - wakeup policy, already validated
+ *
+ */
+static void media_queue_set_wakeup(struct media_queue *mqueue, struct genavb_stream_wakeup *wakeup)
+{
+	struct media_drv *drv = mqueue->drv;
+
+	spin_lock(&drv->wakeup_lock);
+
+	list_del_init(&mqueue->group_list);
+
+	mqueue->wakeup.policy = *wakeup;
+
+	if (wakeup->mode == GENAVB_STREAM_WAKEUP_GROUP)
+		list_add_tail(&mqueue->group_list, &drv->wakeup_group[wakeup->group - 1]);
+
+	spin_unlock(&drv->wakeup_lock);
+}
+
+static inline int need_to_wake_up_listener_ring(struct media_ring_ctx *mring)
+{
+	unsigned int read = READ_ONCE(mring->ring->read);
+
+	return ((mring->write - read) >= mring->batch) || ((int)(mring->eof - read) > 0);
+}
+
+static void media_drv_desc_free(struct avb_drv *avb, void *desc_array[], unsigned int *count, void *desc)
+{
+	desc_array[*count] = desc;
+	(*count)++;
+	if (unlikely(*(count) >= DESC_MAX)) {
+		pool_dma_free_array(&avb->buf_pool, desc_array, DESC_MAX);
+		*count = 0;
+	}
 }
 
 /**
@@ -84,9 +201,12 @@ static struct media_queue *media_queue_alloc(struct media_drv *drv, unsigned int
 		/* TODO add queue size param coming from api */
 		mqueue->queue.size += CFG_MEDIA_QUEUE_EXTRA_ENTRIES;
 
-		spin_lock_init(&mqueue->lock); // FIXME do we need it?
+		spin_lock_init(&mqueue->lock);
 		atomic_set(&mqueue->available, 0);
 		atomic_set(&mqueue->eofs, 0);
+
+		media_wakeup_init(&mqueue->wakeup);
+		INIT_LIST_HEAD(&mqueue->group_list);
 	}
 
 	return mqueue;
@@ -186,6 +306,187 @@ static void media_queue_bind_finish(struct media_drv *drv, void **private_data,
 }
 
 
+/**
+ * media_drv_net_desc_check() - validates a media descriptor written by the AVB stack
+ * @avb - avb driver pointer
+ * @addr_shmem - descriptor shared memory address
+ * @desc - descriptor kernel virtual address, updated on return
+ *
+ */
+static int media_drv_net_desc_check(struct avb_drv *avb, unsigned long addr_shmem, struct media_desc **desc)
+{
+	if (addr_shmem >= BUF_POOL_SIZE) {
+		pr_err("%s: desc(%lx) outside of pool range\n", __func__, addr_shmem);
+		return -EFAULT;
+	}
+
+	*desc = pool_dma_shmem_to_virt(&avb->buf_pool, addr_shmem);
+
+	if ((*desc)->len > NET_PAYLOAD_SIZE_MAX) {
+		pr_err("%s: desc(%lx), len(%u) too big\n", __func__, addr_shmem, (*desc)->len);
+		return -EINVAL;
+	}
+
+	if (((*desc)->l2_offset + (*desc)->len) > BUF_SIZE) {
+		pr_err("%s: desc(%lx), offset(%u) too big\n", __func__, addr_shmem, (*desc)->l2_offset);
+		return -EINVAL;
+	}
+
+	if ((*desc)->n_ts > MEDIA_TS_PER_PACKET) {
+		pr_err("%s: desc(%lx), n_ts(%u) is not valid\n", __func__, addr_shmem, (*desc)->n_ts);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static inline void *media_ring_slot(struct media_ring_ctx *mring, unsigned int index)
+{
+	return mring->slot + (index & (MEDIA_RING_SIZE - 1)) * MEDIA_RING_SLOT_SIZE;
+}
+
+/**
+ * media_ring_rx_reclaim() - reclaims the listener ring entries released by the media application
+ * @mring - mmap ring pointer
+ *
+ * Must be called with mqueue->lock held.
+ *
+ */
+static void media_ring_rx_reclaim(struct media_ring_ctx *mring)
+{
+	unsigned int n;
+
+	n = READ_ONCE(mring->ring->done) - mring->done;
+
+	/* The media application can only release entries it was given */
+	if (n > (mring->write - mring->done))
+		n = mring->write - mring->done;
+
+	mring->done += n;
+}
+
+/**
+ * media_ring_rx_fill() - copies a received packet to the next listener ring entry
+ * @mring - mmap ring pointer
+ * @desc - media descriptor, already validated
+ *
+ */
+static void media_ring_rx_fill(struct media_ring_ctx *mring, struct media_desc *desc)
+{
+	struct media_ring_entry *entry = &mring->ring->entry[mring->write & (MEDIA_RING_SIZE - 1)];
+	int i;
+
+	entry->len = desc->len;
+	entry->flags = desc->flags;
+	entry->bytes_lost = desc->bytes_lost;
+	entry->ts_n = desc->n_ts;
+
+	for (i = 0; i < desc->n_ts; i++) {
+		entry->ts[i].val = desc->avtp_ts[i].val;
+		entry->ts[i].flags = desc->avtp_ts[i].flags;
+		entry->ts[i].offset = desc->avtp_ts[i].offset;
+	}
+
+	memcpy(media_ring_slot(mring, mring->write), (char *)desc + desc->l2_offset, desc->len);
+
+	/* The application reads the ring directly, the last stage visible from the kernel */
+	latency_trace_last(LATENCY_TRACE_MEDIA_RX_ENQUEUE, desc, desc->len);
+}
+
+/**
+ * media_ring_net_write() - AVB stack listener stream write, mmap ring mode
+ * @mqueue - media queue pointer
+ * @buf - array of avb media descriptors pointers
+ * @len - length of array (in number of entries)
+ *
+ * Received packets are copied to the mmap ring and the descriptors are freed right away.
+ *
+ */
+static ssize_t media_ring_net_write(struct media_queue *mqueue, const char __user *buf, size_t len)
+{
+	struct avb_drv *avb = container_of(mqueue->drv, struct avb_drv, media_drv);
+	unsigned long addr_shmem[DESC_MAX];
+	void *desc_array[DESC_MAX];
+	struct media_ring_ctx *mring;
+	struct media_desc *desc;
+	unsigned int n_now, free, count, written = 0;
+	int i, rc = 0, wake_up_api = 0;
+
+	while (written < len) {
+		n_now = len - written;
+		if (n_now > DESC_MAX)
+			n_now = DESC_MAX;
+
+		/* Copy outside of the lock, may fault */
+		if (copy_from_user(addr_shmem, &((unsigned long *)buf)[written], n_now * sizeof(unsigned long))) {
+			rc = -EFAULT;
+			break;
+		}
+
+		count = 0;
+
+		spin_lock(&mqueue->lock);
+
+		mring = mqueue->mring;
+		if (!mring) {
+			spin_unlock(&mqueue->lock);
+			rc = -EPIPE;
+			break;
+		}
+
+		media_ring_rx_reclaim(mring);
+
+		free = MEDIA_RING_SIZE - (mring->write - mring->done);
+		if (n_now > free)
+			n_now = free;
+
+		for (i = 0; i < n_now; i++) {
+			rc = media_drv_net_desc_check(avb, addr_shmem[i], &desc);
+			if (rc < 0)
+				break;
+
+			media_ring_rx_fill(mring, desc);
+
+			mring->write++;
+
+			/* The End-of-Frame marker is assumed always to be at the end of a packet, or at least always to be the last event in a packet. */
+			if (desc->n_ts && (desc->avtp_ts[desc->n_ts - 1].flags & AVTP_FLAGS_TO_MEDIA_DESC(AVTP_END_OF_FRAME)))
+				mring->eof = mring->write;
+
+			media_drv_desc_free(avb, desc_array, &count, desc);
+		}
+
+		if (i) {
+			smp_wmb();
+			WRITE_ONCE(mring->ring->write, mring->write);
+
+			wake_up_api |= need_to_wake_up_listener_ring(mring);
+		}
+
+		spin_unlock(&mqueue->lock);
+
+		if (count)
+			pool_dma_free_array(&avb->buf_pool, desc_array, count);
+
+		written += i;
+
+		/* Ring full or invalid descriptor */
+		if (i < n_now || !free)
+			break;
+	}
+
+	if (wake_up_api) {
+		spin_lock(&mqueue->drv->wakeup_lock);
+		media_queue_api_wake_up(mqueue);
+		spin_unlock(&mqueue->drv->wakeup_lock);
+	}
+
+	if (written)
+		return written * sizeof(unsigned long);
+	else
+		return rc;
+}
+
 /**
  * media_drv_net_write() - AVB stack listener stream write
  * @buf - array of avb media descriptors pointers
@@ -200,6 +501,7 @@ static ssize_t media_drv_net_write(struct file *file, const char __user *buf, si
 	struct media_queue *mqueue = file->private_data;
 	struct avb_drv *avb = container_of(mqueue->drv, struct avb_drv, media_drv);
 	struct media_desc *desc;
+	struct media_wakeup_rx wakeup_rx;
 	unsigned long addr_shmem;
 	int i, rc = 0;
 	unsigned int desc_len, written = 0;
@@ -217,43 +519,26 @@ static ssize_t media_drv_net_write(struct file *file, const char __user *buf, si
 
 	len /= sizeof(unsigned long);
 
+	if (mqueue->flags & MEDIA_QUEUE_FLAGS_MMAP_RING)
+		return media_ring_net_write(mqueue, buf, len);
+
 	qa = queue_available(&mqueue->queue);
 	if (len > qa)
 		len = qa;
 
 	queue_enqueue_init(&mqueue->queue, &write);
 
+	media_wakeup_rx_init(&wakeup_rx);
+
 	for (i = 0; i < len; i++) {
 		if (get_user(addr_shmem, &((unsigned long *)buf)[i]) < 0) {
 			rc = -EFAULT;
 			break;
 		}
 
-		if (addr_shmem >= BUF_POOL_SIZE) {
-			pr_err("%s: desc(%lx) outside of pool range\n", __func__, addr_shmem);
-			rc = -EFAULT;
-			break;
-		}
-
-		desc = pool_dma_shmem_to_virt(&avb->buf_pool, addr_shmem);
-
-		if (desc->len > NET_PAYLOAD_SIZE_MAX) {
-			pr_err("%s: desc(%lx), len(%u) too big\n", __func__, addr_shmem, desc->len);
-			rc = -EINVAL;
-			break;
-		}
-
-		if ((desc->l2_offset + desc->len) > BUF_SIZE) {
-			pr_err("%s: desc(%lx), offset(%u) too big\n", __func__, addr_shmem, desc->l2_offset);
-			rc = -EINVAL;
-			break;
-		}
-
-		if (desc->n_ts > MEDIA_TS_PER_PACKET) {
-			pr_err("%s: desc(%lx), n_ts(%u) is not valid\n", __func__, addr_shmem, desc->n_ts);
-			rc = -EINVAL;
+		rc = media_drv_net_desc_check(avb, addr_shmem, &desc);
+		if (rc < 0)
 			break;
-		}
 
 		if (mqueue->frame_stride != mqueue->frame_size)
 			desc_len = (desc->len * mqueue->frame_size) / mqueue->frame_stride;
@@ -262,22 +547,29 @@ static ssize_t media_drv_net_write(struct file *file, const char __user *buf, si
 
 		queue_enqueue_next(&mqueue->queue, &write, (unsigned long) desc);
 
+		latency_trace(LATENCY_TRACE_MEDIA_RX_ENQUEUE, desc, desc->len);
+
 		/* The End-of-Frame marker is assumed always to be at the end of a packet, or at least always to be the last event in a packet. */
 		if (desc->n_ts && (desc->avtp_ts[desc->n_ts - 1].flags & AVTP_FLAGS_TO_MEDIA_DESC(AVTP_END_OF_FRAME)))
 			atomic_inc(&mqueue->eofs);
 
+		media_wakeup_rx(&wakeup_rx, desc);
+
 		written += desc_len;
 	}
 
 	queue_enqueue_done(&mqueue->queue, write);
 
 	if (written) {
+		spin_lock(&mqueue->drv->wakeup_lock);
+
 		atomic_add(written, &mqueue->available);
 
-		if (need_to_wake_up_listener_queue(mqueue)) {
-			if (waitqueue_active(&mqueue->api_wait))
-				wake_up(&mqueue->api_wait);
-		}
+		media_wakeup_rx_merge(&mqueue->wakeup, &wakeup_rx);
+
+		media_queue_listener_wake_up(mqueue);
+
+		spin_unlock(&mqueue->drv->wakeup_lock);
 	}
 
 	if (i > 0)
@@ -343,6 +635,8 @@ static ssize_t media_drv_net_read(struct file *file, char __user *buf, size_t le
 			break;
 		}
 
+		latency_trace(LATENCY_TRACE_MEDIA_DEQUEUE, addr, desc->net.len);
+
 		read = _read;
 		len--;
 		n++;
@@ -351,8 +645,9 @@ static ssize_t media_drv_net_read(struct file *file, char __user *buf, size_t le
 	queue_dequeue_done(&mqueue->queue, read);
 
 	if ((media_queue_remaining(mqueue) >= mqueue->batch_size) || queue_empty(&mqueue->queue)) {
-		if (waitqueue_active(&mqueue->api_wait))
-			wake_up(&mqueue->api_wait);
+		spin_lock(&mqueue->drv->wakeup_lock);
+		media_queue_api_wake_up(mqueue);
+		spin_unlock(&mqueue->drv->wakeup_lock);
 	}
 
 	if (n)
@@ -713,9 +1008,6 @@ static void tx_read_event(struct media_rx_desc *desc, struct genavb_event *event
 	event_info->src_offset += src_len;
 }
 
-#define DESC_MAX	32
-#define EVENT_MAX	32
-
 /**
  * media_drv_api_tx() - media talker stream write
  * @mqueue - media queue pointer
@@ -917,6 +1209,8 @@ static int media_drv_api_tx(struct media_queue *mqueue, struct media_queue_tx *t
 
 					queue_enqueue_next(&mqueue->queue, &write, (unsigned long)desc[i]);
 
+					latency_trace(LATENCY_TRACE_MEDIA_ENQUEUE, desc[i], desc[i]->net.len);
+
 					i++;
 
 					if (i < n_now) {
@@ -977,6 +1271,8 @@ static int media_drv_api_tx(struct media_queue *mqueue, struct media_queue_tx *t
 				desc[i]->net.flags |= NET_TX_FLAGS_END_FRAME;
 
 			queue_enqueue_next(&mqueue->queue, &write, (unsigned long)desc[i]);
+
+			latency_trace(LATENCY_TRACE_MEDIA_ENQUEUE, desc[i], desc[i]->net.len);
 		} else {
 			mqueue->partial_desc = desc[i];
 			mqueue->dst_len = dst_len;
@@ -1065,16 +1361,6 @@ static void rx_write_event(struct genavb_event *avb_event, struct media_desc *de
 	event_info->total_read += len_now;
 }
 
-static void media_drv_desc_free(struct avb_drv *avb, void *desc_array[], unsigned int *count, void *desc)
-{
-	desc_array[*count] = desc;
-	(*count)++;
-	if (unlikely(*(count) >= DESC_MAX)) {
-		pool_dma_free_array(&avb->buf_pool, desc_array, DESC_MAX);
-		*count = 0;
-	}
-}
-
 /**
  * media_drv_api_rx() - media listener stream read
  * @mqueue - media queue pointer
@@ -1099,6 +1385,8 @@ static int media_drv_api_rx(struct media_queue *mqueue, struct media_queue_rx *r
 	struct media_desc *desc;
 	int i, skip_event = 0;
 	int finished, rc = 0;
+	int ts_valid;
+	u32 first_ts = 0;
 	const int stride_overhead = mqueue->frame_stride - mqueue->frame_size;
 
 	total_read = 0;
@@ -1357,6 +1645,8 @@ static int media_drv_api_rx(struct media_queue *mqueue, struct media_queue_rx *r
 			if (desc->n_ts && (desc->avtp_ts[desc->n_ts - 1].flags & AVTP_FLAGS_TO_MEDIA_DESC(AVTP_END_OF_FRAME)))
 				atomic_dec(&mqueue->eofs);
 
+			latency_trace_last(LATENCY_TRACE_MEDIA_RX_DEQUEUE, desc, desc->len);
+
 			media_drv_desc_free(avb, desc_array, &desc_count, desc);
 
 			if (mqueue->flags & MEDIA_QUEUE_FLAGS_DGRAM) {
@@ -1401,6 +1691,8 @@ exit:
 		/* For datagram we always stop rx process at packets boundaries, i.e.
 		not partial descriptor are maintained */
 		if (mqueue->flags & MEDIA_QUEUE_FLAGS_DGRAM) {
+			latency_trace_last(LATENCY_TRACE_MEDIA_RX_DEQUEUE, desc, desc->len);
+
 			media_drv_desc_free(avb, desc_array, &desc_count, desc);
 
 			mqueue->partial_desc = NULL;
@@ -1424,6 +1716,8 @@ exit:
 			if (desc->n_ts && (desc->avtp_ts[desc->n_ts - 1].flags & AVTP_FLAGS_TO_MEDIA_DESC(AVTP_END_OF_FRAME)))
 				atomic_dec(&mqueue->eofs);
 
+			latency_trace_last(LATENCY_TRACE_MEDIA_RX_DEQUEUE, desc, desc->len);
+
 			media_drv_desc_free(avb, desc_array, &desc_count, desc);
 		}
 
@@ -1437,13 +1731,369 @@ early_exit:
 		pool_dma_free_array(&avb->buf_pool, desc_array, desc_count);
 
 	rx->data_read = total_read;
-	atomic_sub(total_read, &mqueue->available);
+
+	if (total_read) {
+		atomic_sub(total_read, &mqueue->available);
+
+		/* Under the lock, so that data enqueued but not yet accounted is included */
+		spin_lock(&mqueue->drv->wakeup_lock);
+		ts_valid = media_wakeup_pending_ts(&mqueue->queue, mqueue->partial_desc, mqueue->event_src_idx, &first_ts);
+		media_wakeup_read(&mqueue->wakeup, ts_valid, first_ts);
+		spin_unlock(&mqueue->drv->wakeup_lock);
+	}
 
 	rx->event_read = event_info.total_read;
 
 	return rc;
 }
 
+/**
+ * media_ring_tx_fill() - copies a committed talker ring entry to a media descriptor
+ * @mqueue - media queue pointer
+ * @mring - mmap ring pointer
+ * @desc - media descriptor
+ *
+ * The ring entry is read once, and validated, as the media application may still modify it.
+ * Returns 0 if the descriptor should be passed to the avb stack, -1 if the entry is discarded.
+ *
+ */
+static int media_ring_tx_fill(struct media_queue *mqueue, struct media_ring_ctx *mring, struct media_rx_desc *desc)
+{
+	struct media_ring_entry entry;
+	int i;
+
+	memcpy(&entry, &mring->ring->entry[mring->done & (MEDIA_RING_SIZE - 1)], sizeof(entry));
+
+	if (!entry.len || (entry.len > mqueue->max_payload_size))
+		return -1;
+
+	desc->net.l2_offset = mqueue->payload_offset;
+	desc->net.len = entry.len;
+	desc->net.flags = entry.flags & NET_TX_FLAGS_END_FRAME;
+	if (entry.len != mqueue->max_payload_size)
+		desc->net.flags |= NET_TX_FLAGS_PARTIAL;
+
+	if (entry.ts_n > MEDIA_TS_PER_PACKET)
+		entry.ts_n = MEDIA_TS_PER_PACKET;
+
+	desc->ts_n = entry.ts_n;
+
+	for (i = 0; i < entry.ts_n; i++) {
+		desc->avtp_ts[i].val = entry.ts[i].val;
+		desc->avtp_ts[i].offset = entry.ts[i].offset;
+	}
+
+	memcpy((char *)desc + desc->net.l2_offset, media_ring_slot(mring, mring->done), entry.len);
+
+	return 0;
+}
+
+/**
+ * media_ring_tx_sync() - media talker stream write, mmap ring mode
+ * @mqueue - media queue pointer
+ *
+ * Media application calls this function to pass the entries it committed to the mmap ring
+ * to the avb stack, and to get the ring slots back.
+ * Committed entries with a zero length are discarded.
+ *
+ */
+static int media_ring_tx_sync(struct media_queue *mqueue)
+{
+	struct avb_drv *avb = container_of(mqueue->drv, struct avb_drv, media_drv);
+	struct media_ring_ctx *mring = mqueue->mring;
+	struct media_rx_desc *desc[DESC_MAX];
+	void *desc_array[DESC_MAX];
+	unsigned int n, n_now, qa, write, count = 0, enqueued = 0;
+	int i, rc;
+
+	n = READ_ONCE(mring->ring->done) - mring->done;
+
+	/* The media application can only commit entries it was given */
+	if (n > (mring->write - mring->done))
+		n = mring->write - mring->done;
+
+	qa = queue_available(&mqueue->queue);
+	if (n > qa)
+		n = qa;
+
+	/* Read entries content after the ring index */
+	smp_rmb();
+
+	queue_enqueue_init(&mqueue->queue, &write);
+
+	while (n) {
+		n_now = n;
+		if (n_now > DESC_MAX)
+			n_now = DESC_MAX;
+
+		rc = pool_dma_alloc_array(&avb->buf_pool, (void **)desc, n_now);
+		if (rc <= 0)
+			break;
+
+		for (i = 0; i < rc; i++) {
+			if (media_ring_tx_fill(mqueue, mring, desc[i]) < 0) {
+				media_drv_desc_free(avb, desc_array, &count, desc[i]);
+			} else {
+				queue_enqueue_next(&mqueue->queue, &write, (unsigned long)desc[i]);
+
+				latency_trace(LATENCY_TRACE_MEDIA_ENQUEUE, desc[i], desc[i]->net.len);
+
+				enqueued++;
+			}
+
+			mring->done++;
+		}
+
+		n -= rc;
+	}
+
+	queue_enqueue_done(&mqueue->queue, write);
+
+	if (count)
+		pool_dma_free_array(&avb->buf_pool, desc_array, count);
+
+	if (enqueued) {
+		if (waitqueue_active(&mqueue->net_wait))
+			wake_up(&mqueue->net_wait);
+	}
+
+	/* Processed slots can be acquired again */
+	mring->write = mring->done + MEDIA_RING_SIZE;
+
+	smp_wmb();
+	WRITE_ONCE(mring->ring->write, mring->write);
+
+	return 0;
+}
+
+static int media_ring_alloc(struct media_queue *mqueue)
+{
+	struct media_ring_ctx *mring;
+	unsigned int batch;
+	int rc;
+
+	mring = kzalloc(sizeof(*mring), GFP_KERNEL);
+	if (!mring) {
+		rc = -ENOMEM;
+		goto err_kzalloc;
+	}
+
+	/* Ring and payload slots, zeroed so that no kernel data ever reaches the media application */
+	mring->size = PAGE_ALIGN(sizeof(struct media_ring)) + MEDIA_RING_SIZE * MEDIA_RING_SLOT_SIZE;
+
+	mring->ring = vmalloc_user(mring->size);
+	if (!mring->ring) {
+		rc = -ENOMEM;
+		goto err_vmalloc;
+	}
+
+	mring->slot = (char *)mring->ring + PAGE_ALIGN(sizeof(struct media_ring));
+
+	/* Batch size in number of packets */
+	if (mqueue->flags & MEDIA_QUEUE_FLAGS_DGRAM)
+		batch = mqueue->batch_size;
+	else
+		batch = mqueue->batch_size / mqueue->max_frame_payload_size;
+
+	if (batch > MEDIA_RING_SIZE / 4)
+		batch = MEDIA_RING_SIZE / 4;
+
+	if (!batch)
+		batch = 1;
+
+	mring->batch = batch;
+
+	mring->ring->size = MEDIA_RING_SIZE;
+	mring->ring->batch = batch;
+	mring->ring->max_payload_size = mqueue->max_payload_size;
+	mring->ring->slot_offset = PAGE_ALIGN(sizeof(struct media_ring));
+	mring->ring->slot_size = MEDIA_RING_SLOT_SIZE;
+
+	/* All talker slots are free to start with */
+	if (mqueue->flags & MEDIA_QUEUE_FLAGS_TALKER) {
+		mring->write = MEDIA_RING_SIZE;
+		mring->ring->write = mring->write;
+	}
+
+	spin_lock(&mqueue->lock);
+	mqueue->mring = mring;
+	spin_unlock(&mqueue->lock);
+
+	mqueue->flags |= MEDIA_QUEUE_FLAGS_MMAP_RING;
+
+	return 0;
+
+err_vmalloc:
+	kfree(mring);
+
+err_kzalloc:
+	return rc;
+}
+
+static void media_ring_free(struct media_queue *mqueue)
+{
+	struct media_ring_ctx *mring;
+
+	spin_lock(&mqueue->lock);
+	mring = mqueue->mring;
+	mqueue->mring = NULL;
+	spin_unlock(&mqueue->lock);
+
+	mqueue->flags &= ~MEDIA_QUEUE_FLAGS_MMAP_RING;
+
+	if (!mring)
+		return;
+
+	/* The file is only released once all the mappings are gone */
+	vfree(mring->ring);
+	kfree(mring);
+}
+
+static int media_queue_rx_check(struct media_queue *mqueue)
+{
+	if (mqueue->flags & MEDIA_QUEUE_FLAGS_TALKER)
+		return -EPERM;
+
+	if ((mqueue->flags & MEDIA_QUEUE_FLAGS_BOUND_MASK) != MEDIA_QUEUE_FLAGS_BOUND_MASK)
+		return -EPIPE;
+
+	if (mqueue->flags & MEDIA_QUEUE_FLAGS_MMAP_RING)
+		return -EINVAL;
+
+	return 0;
+}
+
+static int media_queue_tx_check(struct media_queue *mqueue)
+{
+	if (!(mqueue->flags & MEDIA_QUEUE_FLAGS_TALKER))
+		return -EPERM;
+
+	if ((mqueue->flags & MEDIA_QUEUE_FLAGS_BOUND_MASK) != MEDIA_QUEUE_FLAGS_BOUND_MASK)
+		return -EPIPE;
+
+	if (mqueue->flags & MEDIA_QUEUE_FLAGS_MMAP_RING)
+		return -EINVAL;
+
+	return 0;
+}
+
+static const struct file_operations media_drv_api_fops;
+
+/**
+ * media_queue_fget() - gets the media queue of a media queue api file descriptor
+ * @fd - file descriptor
+ * @file - file pointer, updated on return. Must be released with fput().
+ *
+ */
+static struct media_queue *media_queue_fget(int fd, struct file **file)
+{
+	*file = fget(fd);
+	if (!*file)
+		return NULL;
+
+	if ((*file)->f_op != &media_drv_api_fops) {
+		fput(*file);
+		return NULL;
+	}
+
+	return (*file)->private_data;
+}
+
+/**
+ * media_drv_api_rx_multi() - media listener streams read
+ * @arg - user space struct media_queue_multi pointer
+ *
+ * Services several listener streams in a single call, the return value of each stream is returned in its entry.
+ *
+ */
+static int media_drv_api_rx_multi(void __user *arg)
+{
+	struct media_queue_multi multi;
+	struct media_queue_rx_multi_entry __user *entry;
+	struct media_queue_rx_multi_entry e;
+	struct media_queue *mqueue;
+	struct file *file;
+	int i;
+
+	if (copy_from_user(&multi, arg, sizeof(struct media_queue_multi)))
+		return -EFAULT;
+
+	if (multi.n > MEDIA_MULTI_MAX)
+		return -EINVAL;
+
+	entry = multi.entry;
+
+	for (i = 0; i < multi.n; i++) {
+		if (copy_from_user(&e, &entry[i], sizeof(e)))
+			return -EFAULT;
+
+		mqueue = media_queue_fget(e.fd, &file);
+		if (!mqueue) {
+			e.rc = -EBADF;
+			goto next;
+		}
+
+		e.rc = media_queue_rx_check(mqueue);
+		if (!e.rc)
+			e.rc = media_drv_api_rx(mqueue, &e.rx);
+
+		fput(file);
+
+	next:
+		if (copy_to_user(&entry[i], &e, sizeof(e)))
+			return -EFAULT;
+	}
+
+	return 0;
+}
+
+/**
+ * media_drv_api_tx_multi() - media talker streams write
+ * @arg - user space struct media_queue_multi pointer
+ *
+ * Services several talker streams in a single call, the return value of each stream is returned in its entry.
+ *
+ */
+static int media_drv_api_tx_multi(void __user *arg)
+{
+	struct media_queue_multi multi;
+	struct media_queue_tx_multi_entry __user *entry;
+	struct media_queue_tx_multi_entry e;
+	struct media_queue *mqueue;
+	struct file *file;
+	int i, rc;
+
+	if (copy_from_user(&multi, arg, sizeof(struct media_queue_multi)))
+		return -EFAULT;
+
+	if (multi.n > MEDIA_MULTI_MAX)
+		return -EINVAL;
+
+	entry = multi.entry;
+
+	for (i = 0; i < multi.n; i++) {
+		if (copy_from_user(&e, &entry[i], sizeof(e)))
+			return -EFAULT;
+
+		mqueue = media_queue_fget(e.fd, &file);
+		if (!mqueue) {
+			rc = -EBADF;
+			goto next;
+		}
+
+		rc = media_queue_tx_check(mqueue);
+		if (!rc)
+			rc = media_drv_api_tx(mqueue, &e.tx);
+
+		fput(file);
+
+	next:
+		if (put_user(rc, &entry[i].rc))
+			return -EFAULT;
+	}
+
+	return 0;
+}
 
 static long media_drv_api_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 {
@@ -1453,6 +2103,8 @@ static long media_drv_api_ioctl(struct file *file, unsigned int cmd, unsigned lo
 	struct media_queue_api_params params;
 	struct media_queue_rx rx;
 	struct media_queue_tx tx;
+	struct genavb_stream_wakeup wakeup;
+	struct genavb_stream_stats stats;
 	struct logical_port *port;
 	int rc = 0;
 
@@ -1471,6 +2123,19 @@ static long media_drv_api_ioctl(struct file *file, unsigned int cmd, unsigned lo
 			break;
 		}
 
+		/* The mmap ring requires a read/write mapping of the ring, so the stream direction can't be derived from the open mode */
+		if (params.flags & AVTP_MMAP_RING) {
+			if ((file->f_mode & (FMODE_READ | FMODE_WRITE)) != (FMODE_READ | FMODE_WRITE)) {
+				rc = -EINVAL;
+				break;
+			}
+
+			if (params.direction == AVTP_DIRECTION_LISTENER)
+				mqueue->flags &= ~MEDIA_QUEUE_FLAGS_TALKER;
+			else
+				mqueue->flags |= MEDIA_QUEUE_FLAGS_TALKER;
+		}
+
 		mutex_lock(&drv->list_lock);
 
 		mqueue_orig = mqueue;
@@ -1503,6 +2168,12 @@ static long media_drv_api_ioctl(struct file *file, unsigned int cmd, unsigned lo
 		if (rc)
 			goto unlock;
 
+		if (params.flags & AVTP_MMAP_RING) {
+			rc = media_ring_alloc(mqueue);
+			if (rc < 0)
+				goto unlock;
+		}
+
 		media_queue_bind_finish(drv, &file->private_data, mqueue, MEDIA_QUEUE_FLAGS_API_BOUND);
 
 		if (mqueue_orig != mqueue)
@@ -1517,15 +2188,9 @@ static long media_drv_api_ioctl(struct file *file, unsigned int cmd, unsigned lo
 		break;
 
 	case MEDIA_IOC_RX:
-		if (mqueue->flags & MEDIA_QUEUE_FLAGS_TALKER) {
-			rc = -EPERM;
-			break;
-		}
-
-		if ((mqueue->flags & MEDIA_QUEUE_FLAGS_BOUND_MASK) != MEDIA_QUEUE_FLAGS_BOUND_MASK) {
-			rc = -EPIPE;
+		rc = media_queue_rx_check(mqueue);
+		if (rc < 0)
 			break;
-		}
 
 		if (copy_from_user(&rx, (void *)arg, sizeof(struct media_queue_rx))) {
 			rc = -EFAULT;
@@ -1543,22 +2208,75 @@ static long media_drv_api_ioctl(struct file *file, unsigned int cmd, unsigned lo
 		break;
 
 	case MEDIA_IOC_TX:
-		if (!(mqueue->flags & MEDIA_QUEUE_FLAGS_TALKER)) {
-			rc = -EPERM;
+		rc = media_queue_tx_check(mqueue);
+		if (rc < 0)
+			break;
+
+		if (copy_from_user(&tx, (void *)arg, sizeof(struct media_queue_tx))) {
+			rc = -EFAULT;
 			break;
 		}
 
-		if ((mqueue->flags & MEDIA_QUEUE_FLAGS_BOUND_MASK) != MEDIA_QUEUE_FLAGS_BOUND_MASK) {
-			rc = -EPIPE;
+		rc = media_drv_api_tx(mqueue, &tx);
+
+		break;
+
+	case MEDIA_IOC_RX_MULTI:
+		rc = media_drv_api_rx_multi((void *)arg);
+		break;
+
+	case MEDIA_IOC_TX_MULTI:
+		rc = media_drv_api_tx_multi((void *)arg);
+		break;
+
+	case MEDIA_IOC_SET_WAKEUP:
+		/* Wakeup policies only apply to listener streams using the receive functions */
+		rc = media_queue_rx_check(mqueue);
+		if (rc < 0)
+			break;
+
+		if (copy_from_user(&wakeup, (void *)arg, sizeof(struct genavb_stream_wakeup))) {
+			rc = -EFAULT;
 			break;
 		}
 
-		if (copy_from_user(&tx, (void *)arg, sizeof(struct media_queue_tx))) {
+		if (media_wakeup_check(&wakeup) < 0) {
+			rc = -EINVAL;
+			break;
+		}
+
+		media_queue_set_wakeup(mqueue, &wakeup);
+
+		break;
+
+	case MEDIA_IOC_GET_STATS:
+		spin_lock(&drv->wakeup_lock);
+		stats.wakeups = mqueue->wakeup.wakeups;
+		spin_unlock(&drv->wakeup_lock);
+
+		if (copy_to_user((void *)arg, &stats, sizeof(struct genavb_stream_stats)))
 			rc = -EFAULT;
+
+		break;
+
+	case MEDIA_IOC_RING_SYNC:
+		if (!(mqueue->flags & MEDIA_QUEUE_FLAGS_MMAP_RING)) {
+			rc = -EINVAL;
 			break;
 		}
 
-		rc = media_drv_api_tx(mqueue, &tx);
+		if ((mqueue->flags & MEDIA_QUEUE_FLAGS_BOUND_MASK) != MEDIA_QUEUE_FLAGS_BOUND_MASK) {
+			rc = -EPIPE;
+			break;
+		}
+
+		if (mqueue->flags & MEDIA_QUEUE_FLAGS_TALKER) {
+			rc = media_ring_tx_sync(mqueue);
+		} else {
+			spin_lock(&mqueue->lock);
+			media_ring_rx_reclaim(mqueue->mring);
+			spin_unlock(&mqueue->lock);
+		}
 
 		break;
 
@@ -1586,9 +2304,16 @@ static unsigned int media_drv_api_poll(struct file *file, poll_table *poll)
 	if (mqueue->flags & MEDIA_QUEUE_FLAGS_TALKER) {
 		if ((media_queue_remaining(mqueue) >= mqueue->batch_size) || queue_empty(&mqueue->queue))
 			mask |= POLLOUT | POLLWRNORM;
+	} else if (mqueue->flags & MEDIA_QUEUE_FLAGS_MMAP_RING) {
+		if (need_to_wake_up_listener_ring(mqueue->mring))
+			mask |= POLLIN | POLLRDNORM;
 	} else {
+		spin_lock(&mqueue->drv->wakeup_lock);
+
 		if (need_to_wake_up_listener_queue(mqueue))
 			mask |= POLLIN | POLLRDNORM;
+
+		spin_unlock(&mqueue->drv->wakeup_lock);
 	}
 
 exit:
@@ -1597,6 +2322,28 @@ exit:
 	return mask;
 }
 
+/**
+ * media_drv_api_mmap() - maps the mmap ring and payload slots of a media queue
+ *
+ * Only available for media queues bound in mmap ring mode.
+ *
+ */
+static int media_drv_api_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct media_queue *mqueue = file->private_data;
+
+	if (!(mqueue->flags & MEDIA_QUEUE_FLAGS_MMAP_RING))
+		return -EINVAL;
+
+	if (vma->vm_end < vma->vm_start)
+		return -EINVAL;
+
+	if (vma->vm_pgoff || ((vma->vm_end - vma->vm_start) != mqueue->mring->size))
+		return -EINVAL;
+
+	return remap_vmalloc_range(vma, mqueue->mring->ring, 0);
+}
+
 static int media_drv_api_open(struct inode *in, struct file *file)
 {
 	struct media_drv *drv = container_of(in->i_cdev, struct media_drv, cdev_api);
@@ -1636,6 +2383,13 @@ static int media_drv_api_release(struct inode *in, struct file *file)
 
 	mutex_lock(&drv->list_lock);
 
+	media_ring_free(mqueue);
+
+	spin_lock(&drv->wakeup_lock);
+	list_del_init(&mqueue->group_list);
+	media_wakeup_init(&mqueue->wakeup);
+	spin_unlock(&drv->wakeup_lock);
+
 	if ((mqueue->flags & ~MEDIA_QUEUE_FLAGS_API_BOUND & MEDIA_QUEUE_FLAGS_BOUND_MASK) == 0) {
 		media_queue_flush(mqueue);
 		media_queue_free(mqueue);
@@ -1669,12 +2423,13 @@ static const struct file_operations media_drv_api_fops = {
 	.release = media_drv_api_release,
 	.unlocked_ioctl = media_drv_api_ioctl,
 	.poll = media_drv_api_poll,
+	.mmap = media_drv_api_mmap,
 };
 
 
 int media_drv_init(struct media_drv *drv)
 {
-	int rc;
+	int i, rc;
 
 	pr_info("%s: %p\n", __func__, drv);
 
@@ -1682,6 +2437,11 @@ int media_drv_init(struct media_drv *drv)
 
 	mutex_init(&drv->list_lock);
 
+	for (i = 0; i < GENAVB_STREAM_WAKEUP_GROUP_MAX; i++)
+		INIT_LIST_HEAD(&drv->wakeup_group[i]);
+
+	spin_lock_init(&drv->wakeup_lock);
+
 	rc = alloc_chrdev_region(&drv->devno, MEDIA_DRV_MINOR, MEDIA_DRV_MINOR_COUNT, MEDIA_DRV_NAME);
 	if (rc < 0) {
 		pr_err("%s: alloc_chrdev_region() failed\n", __func__);
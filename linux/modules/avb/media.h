@@ -21,6 +21,7 @@
 #define _MEDIA_DRV_H_
 
 #include "genavb/types.h"
+#include "genavb/media.h"
 
 struct media_queue_api_params {
 	unsigned int port;
@@ -31,7 +32,8 @@ struct media_queue_api_params {
 	unsigned int queue_size;			/** Size of the queue in ??? */
 	unsigned int batch_size;			/** Size of a batch in ??? */  // TODO determine size based on what? stream bandwidth and max pkt size?
 	unsigned int max_payload_size;			/**< Maximum size of the AVTP payload in bytes. Used in talker mode to split incoming stream of data into properly sized chunks. */
-	unsigned int flags;				/**< Possible flags: AVTP_DGRAM when in datagram mode. */
+	unsigned int flags;				/**< Possible flags: AVTP_DGRAM when in datagram mode, AVTP_MMAP_RING when in mmap ring mode. */
+	unsigned int direction;				/**< AVTP_DIRECTION_TALKER or AVTP_DIRECTION_LISTENER. Only used in mmap ring mode, where the device is opened in read/write mode. */
 };
 
 struct media_queue_net_params {
@@ -60,14 +62,78 @@ struct media_queue_tx {
 	unsigned int event_len;
 };
 
+struct media_queue_rx_multi_entry {
+	int fd;					/**< media queue api file descriptor */
+	struct media_queue_rx rx;
+	int rc;					/**< return value */
+};
+
+struct media_queue_tx_multi_entry {
+	int fd;					/**< media queue api file descriptor */
+	struct media_queue_tx tx;
+	int rc;					/**< return value */
+};
+
+/* Several media queues serviced in one call, the entry array type depends on the ioctl */
+struct media_queue_multi {
+	void *entry;
+	unsigned int n;
+};
+
 #define IOV_MAX		32
 
+#define MEDIA_MULTI_MAX	128
+
+#define MEDIA_RING_SIZE	64	/* Must be a power of 2 */
+#define MEDIA_RING_SLOT_SIZE	2048	/* Must be larger than the maximum AVTP payload size */
+
+/* Mmap media ring entry, describes the AVTP payload held in the matching ring slot */
+struct media_ring_entry {
+	avb_u32 len;				/**< AVTP payload size in bytes */
+	avb_u32 flags;				/**< Talker: NET_TX_FLAGS_*, Listener: packet level AVTP flags */
+	avb_u32 bytes_lost;			/**< Listener: number of bytes lost between previous packet and current */
+	avb_u32 ts_n;				/**< Number of valid timestamps in the array below */
+	struct {
+		avb_u32 val;
+		avb_u16 flags;
+		avb_u16 offset;
+	} ts[MEDIA_TS_PER_PACKET];
+};
+
+/* Mmap media ring, shared with the media application (mmap() of the media queue api device).
+ * The mapping is private to the media queue and holds the ring, followed by one payload slot per ring entry
+ * (at slot_offset, slot_size bytes each). AVB network buffers are never mapped in the media application,
+ * the driver copies payload and metadata between the slots and the network buffers.
+ * The kernel produces entries (write), the media application acquires them (read) and then commits
+ * them (talker) or releases them (listener), strictly in order (done).
+ */
+struct media_ring {
+	avb_u32 write;				/**< Written by the kernel */
+	avb_u32 pad0[15];
+
+	avb_u32 read;				/**< Written by the media application */
+	avb_u32 done;				/**< Written by the media application */
+	avb_u32 pad1[14];
+
+	avb_u32 size;				/**< Number of ring entries */
+	avb_u32 batch;				/**< Number of packets between two wakeups */
+	avb_u32 max_payload_size;		/**< Maximum size of the AVTP payload in bytes */
+	avb_u32 slot_offset;			/**< Offset of the first payload slot from the start of the mapping */
+	avb_u32 slot_size;			/**< Size of a payload slot in bytes */
+	avb_u32 pad2[11];
+
+	struct media_ring_entry entry[MEDIA_RING_SIZE];
+};
+
 #ifdef __KERNEL__
 
 #include <linux/cdev.h>
 #include <linux/string.h>
 #include <linux/atomic.h>
 
+#include "genavb/avtp.h"
+#include "genavb/streaming.h"
+#include "media_wakeup_common.h"
 
 #define MEDIA_DRV_NAME		"media_drv"
 #define MEDIA_DRV_MINOR		0
@@ -76,6 +142,18 @@ struct media_queue_tx {
 #define MEDIA_DRV_MINOR_COUNT	2
 
 
+/* Mmap media ring kernel context */
+struct media_ring_ctx {
+	struct media_ring *ring;		/* Start of the vmalloc'ed area mapped by the media application */
+	void *slot;				/* First payload slot */
+	unsigned long size;			/* Size of the mapped area */
+
+	unsigned int write;			/* Kernel copy of ring->write */
+	unsigned int done;			/* Ring entries returned by the media application and already processed */
+	unsigned int eof;			/* Ring index following the last End-of-Frame packet (listener) */
+	unsigned int batch;
+};
+
 /* Media queue character device instance */
 struct media_queue {
 	void *partial_desc;
@@ -114,6 +192,11 @@ struct media_queue {
 	unsigned int ts_dst_offset;
 	unsigned int ts_dst_len;
 
+	struct media_ring_ctx *mring;		/* Mmap ring, protected by lock */
+
+	struct media_wakeup wakeup;		/* Wakeup policy and statistics, protected by drv->wakeup_lock */
+	struct list_head group_list;		/* Wakeup group membership, protected by drv->wakeup_lock */
+
 	struct queue queue;			/* Contains pointers to media_descs */
 						/* Placed last so that we can allocate a dynamic queue size */
 };
@@ -124,6 +207,7 @@ struct media_queue {
 #define MEDIA_QUEUE_FLAGS_BOUND_MASK		(MEDIA_QUEUE_FLAGS_NET_BOUND | MEDIA_QUEUE_FLAGS_API_BOUND)
 
 #define MEDIA_QUEUE_FLAGS_DGRAM			(1 << 3)
+#define MEDIA_QUEUE_FLAGS_MMAP_RING		(1 << 4)
 
 static inline unsigned int media_queue_avail(struct media_queue *mqueue)
 {
@@ -156,6 +240,9 @@ struct media_drv {
 	struct cdev cdev_api;
 	struct mutex list_lock;
 	dev_t devno;
+
+	struct list_head wakeup_group[GENAVB_STREAM_WAKEUP_GROUP_MAX];
+	spinlock_t wakeup_lock;
 };
 
 int media_drv_init(struct media_drv *drv);
@@ -169,5 +256,10 @@ void media_drv_exit(struct media_drv *drv);
 #define MEDIA_IOC_API_BIND		_IOWR(MEDIA_IOC_MAGIC, 1, struct media_queue_api_params)
 #define MEDIA_IOC_RX		_IOR(MEDIA_IOC_MAGIC, 2, struct media_queue_rx)
 #define MEDIA_IOC_TX		_IOW(MEDIA_IOC_MAGIC, 3, struct media_queue_tx)
+#define MEDIA_IOC_RING_SYNC	_IO(MEDIA_IOC_MAGIC, 4)
+#define MEDIA_IOC_RX_MULTI	_IOW(MEDIA_IOC_MAGIC, 5, struct media_queue_multi)
+#define MEDIA_IOC_TX_MULTI	_IOW(MEDIA_IOC_MAGIC, 6, struct media_queue_multi)
+#define MEDIA_IOC_SET_WAKEUP	_IOW(MEDIA_IOC_MAGIC, 7, struct genavb_stream_wakeup)
+#define MEDIA_IOC_GET_STATS	_IOR(MEDIA_IOC_MAGIC, 8, struct genavb_stream_stats)
 
 #endif /* _MEDIA_DRV_H_ */
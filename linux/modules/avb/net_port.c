@@ -27,6 +27,7 @@
 #include "debugfs.h"
 
 #include "ptp.h"
+#include "latency_trace.h"
 
 #if defined(CONFIG_HYBRID) || defined(CONFIG_BRIDGE)
 static int switch_open(struct eth_avb *eth, void *arg)
@@ -215,6 +216,22 @@ static int eth_avb_tx_full(void *data)
 	return (queue_full(queue) || (queue_available(&eth->tx_cleanup_queue) <= TX_CLEANUP_QUEUE_MIN_AVAIL));
 }
 
+#if defined(CONFIG_AVB_LATENCY_TRACE)
+/* Traces a hardware timestamp stage, converted from the PTP hardware clock to monotonic time */
+static void eth_avb_latency_trace_hw_ts(struct eth_avb *eth, unsigned int stage, void *desc, unsigned int len, u32 hw_ts)
+{
+	u64 now = ktime_get_mono_fast_ns();
+	u32 hw_now;
+
+	if (fec_ptp_read_cnt(eth->fec_data, &hw_now) < 0)
+		return;
+
+	latency_trace_hw_ts(stage, desc, len, hw_ts, hw_now, now);
+}
+#else
+static inline void eth_avb_latency_trace_hw_ts(struct eth_avb *eth, unsigned int stage, void *desc, unsigned int len, u32 hw_ts) {}
+#endif
+
 static int eth_avb_rx_irq(void *data, struct avb_rx_desc *arg)
 {
 	struct eth_avb *eth = data;
@@ -223,6 +240,9 @@ static int eth_avb_rx_irq(void *data, struct avb_rx_desc *arg)
 
 //	pr_info("%s\n", __func__);
 
+	eth_avb_latency_trace_hw_ts(eth, LATENCY_TRACE_HW_RX_TS, desc, desc->len, desc->ts);
+	latency_trace(LATENCY_TRACE_NET_RX, desc, desc->len);
+
 	rc = eth_rx(eth, desc);
 	if (likely(rc == AVB_NET_RX_OK))
 		return 0;
@@ -265,6 +285,8 @@ static int eth_avb_tx_cleanup(void *data, struct avb_tx_desc *desc)
 
 //	pr_info("%s: %p %p\n", __func__, data, desc);
 
+	latency_trace_last(LATENCY_TRACE_TX_DONE, desc, desc->common.len);
+
 	/* We need to stop transmit before this queue is full */
 	rc = queue_enqueue(&eth->tx_cleanup_queue, (unsigned long)desc);
 	if (rc < 0)
@@ -316,6 +338,9 @@ static int eth_avb_enqueue_tx_ts(void *data, struct avb_desc *desc)
 	struct eth_avb *eth = data;
 	struct net_tx_desc *tx_desc = (struct net_tx_desc *)desc;
 
+	eth_avb_latency_trace_hw_ts(eth, LATENCY_TRACE_HW_TX_TS, desc, tx_desc->len, tx_desc->ts);
+	latency_trace_last(LATENCY_TRACE_TX_DONE, desc, tx_desc->len);
+
 	if (((struct avb_tx_desc *)desc)->common.flags & AVB_TX_FLAG_AED_B)
 		return switch_egress_ts_done(eth, tx_desc);
 	else {
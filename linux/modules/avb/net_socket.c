@@ -194,6 +194,8 @@ int socket_read(struct net_socket *sock, unsigned long *buf, unsigned int n)
 
 	while (n && ((addr = queue_dequeue(&sock->queue)) != (unsigned long)-1)) {
 
+		latency_trace(LATENCY_TRACE_NET_RX_DEQUEUE, (void *)addr, ((struct net_rx_desc *)addr)->len);
+
 		buf[read] = pool_dma_virt_to_shmem(&avb->buf_pool, (void *)addr);
 
 		n--;
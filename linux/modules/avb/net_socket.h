@@ -29,6 +29,7 @@
 
 #include "net_logical_port.h"
 #include "queue.h"
+#include "latency_trace.h"
 
 /* number of slots for the rx histogram */
 #define NET_STATS_BIN_MAX		64
@@ -156,6 +157,8 @@ static inline int socket_qos_enqueue(struct net_socket *sock, struct qos_queue *
 		return -EIO;
 	}
 
+	latency_trace(LATENCY_TRACE_QOS_ENQUEUE, desc, desc->common.len);
+
 	set_bit(qos_q->index, &qos_q->tc->shared_pending_mask);
 
 	return 0;
@@ -49,22 +49,12 @@ struct net_sr_config {
 #include "genavb/sr_class.h"
 #include "genavb/config.h"
 
-
 //#define PORT_TRACE	1
 #define PORT_TRACE_SIZE	128
 
-#define PORT_RATE_bps		100000000 /* 100 Mbps */
-
-#define FCS_LEN		4
-#define IFG_LEN		12
-#define PREAMBLE_LEN	8
-#define PORT_OVERHEAD	(IFG_LEN + PREAMBLE_LEN + FCS_LEN)
+#include "net_tx_common.h"
 
-#if 1
-#define print_debug(...)	;
-#else
-#define print_debug(...)	pr_info(__VA_ARGS__)
-#endif
+#define PORT_RATE_bps		100000000 /* 100 Mbps */
 
 struct jitter_stats {
 	unsigned int ptp_last;
@@ -112,102 +102,8 @@ struct ptp_grid {
 };
 
 
-struct shaper {
-	int credit;		/* bits x scale */
-	int credit_min;		/* bits x scale */
-	unsigned int tlast;	/* in interval units */
-	unsigned int rate;	/* bits/interval */
-};
-
-
-#define QOS_QUEUE_FLAG_CONNECTED	(1 << 0)
-#define QOS_QUEUE_FLAG_ENABLED		(1 << 1)
-
-struct qos_queue {
-	struct traffic_class *tc;
-
-	struct stream_queue *stream;
-
-	unsigned int index;
-
-	struct queue *queue;
-
-	unsigned int flags;
-	unsigned long atomic_flags;
-
-	unsigned int tx;
-	unsigned int dropped;
-	unsigned int full;
-	unsigned int disabled;
-};
-
-#define STREAM_FLAGS_CONNECTED	(1 << 0)
-#define STREAM_FLAGS_CONFIGURED	(1 << 1)
-#define STREAM_FLAGS_USED	(STREAM_FLAGS_CONNECTED | STREAM_FLAGS_CONFIGURED)
-
-struct stream_queue {
-	struct shaper shaper;
-	unsigned int idle_slope;		/* bits/s */
-	struct sr_class *sr_class;
-	struct qos_queue *qos_queue;
-
-	u16 vlan_label;		/* In Big Endian */
-	u8 id[8];
-	unsigned int flags;
-
-#ifdef PORT_TRACE
-	unsigned int burst;
-	unsigned int burst_max;
-#endif
-};
-
 #define SR_FLAGS_HW_CBS	(1 << 0)
 
-struct sr_class {
-	/* Private to tx context */
-	struct shaper shaper;
-
-	unsigned int flags;
-
-	sr_class_t class;
-	struct traffic_class *tc;
-	unsigned int stream_max;
-	unsigned int streams;
-
-	unsigned int idle_slope;		/* bits/s */
-
-	struct rational interval;		/* class scheduling interval (in nanoseconds) */
-	struct rational interval_ratio;		/* class to port scheduling interval ratio */
-	struct rational tnext;			/* class next scheduling interval (in nanoseconds) */
-	unsigned int tnext_gptp;
-	unsigned int sched_offset;
-	unsigned int interval_n;		/* class interval count */
-	unsigned int scale;			/* class subintervals, for software scheduling */
-
-	unsigned long int pending_mask;
-
-	struct stream_queue stream[CFG_SR_CLASS_STREAM_MAX];
-};
-
-
-struct traffic_class {
-	struct sr_class *sr_class;		/* Set only if the traffic class is an SR class */
-
-	unsigned int index;
-	unsigned int hw_queue_id;
-	unsigned int flags;
-
-	struct qos_queue qos_queue[CFG_TRAFFIC_CLASS_QUEUE_MAX];	/* array of queues assigned to this traffic class */
-
-	unsigned long scheduled_mask;		/* bit mask of queues that can transmit packets */
-	unsigned long slast;
-
-	unsigned int tx;
-
-	/* Shared with enqueue code */
-	unsigned long shared_pending_mask;	/* bit mask of queues with pending packets */
-};
-
 #ifdef PORT_TRACE
 
 struct port_trace {
@@ -53,19 +53,116 @@ static void *ipc_shmem_to_virt(struct ipc_slot *slot, unsigned long addr_shmem)
 	return pool_user_shmem_to_virt(&slot->buf_pool, addr_shmem);
 }
 
+static int ipc_bcast_init(struct ipc_bcast *bcast)
+{
+	bcast->mmap_size = IPC_BUF_POOL_SIZE;
+	bcast->mmap_base = vmalloc(IPC_BUF_POOL_SIZE);
+	if (!bcast->mmap_base)
+		goto err_vmalloc;
+
+	if (pool_init(&bcast->buf_pool, bcast->mmap_base, IPC_BUF_COUNT << IPC_BUF_ORDER, IPC_BUF_ORDER) < 0) {
+		pr_err("%s: pool_init() failed\n", __func__);
+		goto err_pool_init;
+	}
+
+	spin_lock_init(&bcast->lock);
+	memset(bcast->holders, 0, sizeof(bcast->holders));
+
+	return 0;
+
+err_pool_init:
+	vfree(bcast->mmap_base);
+
+err_vmalloc:
+	return -ENOMEM;
+}
+
+static void ipc_bcast_exit(struct ipc_bcast *bcast)
+{
+	pool_exit(&bcast->buf_pool);
+
+	vfree(bcast->mmap_base);
+}
+
+static int ipc_bcast_owns(struct ipc_bcast *bcast, void *addr)
+{
+	return (addr >= bcast->buf_pool.baseaddr) && (addr < bcast->buf_pool.end);
+}
+
+/**
+ * ipc_bcast_put() - Drops the reference of a reader slot to a broadcast buffer
+ * @bcast: pointer to the broadcast pool
+ * @addr: kernel virtual buffer address
+ * @index: reader slot index
+ *
+ * The buffer is returned to the pool when the last reader drops its reference.
+ *
+ * Return: 0 on success, -EFAULT if the reader didn't hold the buffer.
+ */
+static int ipc_bcast_put(struct ipc_bcast *bcast, void *addr, unsigned int index)
+{
+	unsigned int i = addr_to_index(&bcast->buf_pool, addr);
+	u16 holders;
+
+	spin_lock(&bcast->lock);
+
+	holders = bcast->holders[i];
+	bcast->holders[i] &= ~(1 << index);
+
+	spin_unlock(&bcast->lock);
+
+	if (!(holders & (1 << index)))
+		return -EFAULT;
+
+	if (holders == (1 << index))
+		pool_free(&bcast->buf_pool, addr);
+
+	return 0;
+}
+
+/* Drops all the broadcast buffer references of an exiting reader slot */
+static void ipc_bcast_release(struct ipc_bcast *bcast, unsigned int index)
+{
+	int i;
+
+	for (i = 0; i < IPC_BUF_COUNT; i++)
+		if (bcast->holders[i] & (1 << index))
+			ipc_bcast_put(bcast, index_to_addr(&bcast->buf_pool, i), index);
+}
+
 static unsigned long ipc_virt_to_shmem(struct ipc_slot *slot, void *addr)
 {
+	/* Broadcast buffers are mapped right after the slot buffers */
+	if (slot->bcast && ipc_bcast_owns(slot->bcast, addr))
+		return slot->mmap_size + pool_virt_to_shmem(&slot->bcast->buf_pool, addr);
+
 	return pool_virt_to_shmem(&slot->buf_pool, addr);
 }
 
-static void ipc_flush_queue(struct ipc_slot *slot)
+static unsigned long ipc_bcast_mmap_size(struct ipc_slot *slot)
 {
-	queue_flush(&slot->queue, &slot->buf_pool);
+	if (slot->bcast)
+		return slot->bcast->mmap_size;
+
+	return 0;
 }
 
 static void ipc_free(struct ipc_slot *slot, void *addr)
 {
-	pool_free(&slot->buf_pool, addr);
+	if (slot->bcast && ipc_bcast_owns(slot->bcast, addr))
+		ipc_bcast_put(slot->bcast, addr, slot->index);
+	else
+		pool_free(&slot->buf_pool, addr);
+}
+
+static void ipc_free_entry(void *data, unsigned long entry)
+{
+	ipc_free((struct ipc_slot *)data, (void *)entry);
+}
+
+static void ipc_flush_queue(struct ipc_slot *slot)
+{
+	queue_flush(&slot->queue, slot);
 }
 
 
@@ -84,6 +181,22 @@ err:
 	return rc;
 }
 
+static int ipc_free_shmem(struct ipc_slot *slot, unsigned long addr_shmem)
+{
+	if (slot->bcast && (addr_shmem >= slot->mmap_size)) {
+		void *addr = pool_user_shmem_to_virt(&slot->bcast->buf_pool, addr_shmem - slot->mmap_size);
+
+		if (!addr)
+			return -EFAULT;
+
+		return ipc_bcast_put(slot->bcast, addr, slot->index);
+	}
+
+	pool_free_shmem(&slot->buf_pool, addr_shmem);
+
+	return 0;
+}
+
 static int ipc_free_user(struct ipc_slot *slot, unsigned long arg)
 {
 	unsigned long addr_shmem;
@@ -93,9 +206,36 @@ static int ipc_free_user(struct ipc_slot *slot, unsigned long arg)
 	if (rc < 0)
 		goto err;
 
-	pool_free_shmem(&slot->buf_pool, addr_shmem);
+	return ipc_free_shmem(slot, addr_shmem);
 
-	return 0;
+err:
+	return rc;
+}
+
+static int ipc_free_multi_user(struct ipc_slot *slot, unsigned long arg)
+{
+	struct ipc_free_multi_data *data = (struct ipc_free_multi_data *)arg;
+	unsigned long addr_shmem[IPC_RX_BATCH];
+	unsigned int n, i;
+	int rc;
+
+	rc = get_user(n, &data->n);
+	if (rc < 0)
+		goto err;
+
+	if (n > IPC_RX_BATCH) {
+		rc = -EINVAL;
+		goto err;
+	}
+
+	if (copy_from_user(addr_shmem, data->addr_shmem, n * sizeof(unsigned long))) {
+		rc = -EFAULT;
+		goto err;
+	}
+
+	for (i = 0; i < n; i++)
+		if (ipc_free_shmem(slot, addr_shmem[i]) < 0)
+			rc = -EFAULT;
 
 err:
 	return rc;
@@ -139,6 +279,11 @@ static void ipc_free_slot(struct ipc_slot *slot)
 	slot->ipc->slot[slot->index] = NULL;
 }
 
+static void ipc_set_src(void *addr, unsigned int src)
+{
+	*(u16 *)((u8 *)addr + IPC_MSG_SRC_OFFSET) = src;
+}
+
 static void *ipc_copy(struct ipc_slot *slot_dst, struct ipc_slot *slot_src, void *addr_src, unsigned int len)
 {
 	void *addr_dst;
@@ -152,6 +297,8 @@ static void *ipc_copy(struct ipc_slot *slot_dst, struct ipc_slot *slot_src, void
 
 	memcpy(addr_dst, addr_src, len);
 
+	ipc_set_src(addr_dst, 0);
+
 	return addr_dst;
 
 err:
@@ -171,6 +318,56 @@ err:
 	return -1;
 }
 
+/**
+ * ipc_tx_bcast() - Sends a message to all the readers of an IPC_TYPE_MANY_READERS channel
+ * @ipc: pointer to the IPC channel
+ * @addr: kernel virtual address of the message
+ * @len: message length
+ *
+ * The message is copied once to the broadcast pool and the same buffer is queued to all the readers,
+ * independently of their number. Broadcast buffers are read only for the readers.
+ * The caller needs to hold the channel lock.
+ *
+ * Return: 0 on success, -1 if the broadcast pool is empty.
+ */
+static int ipc_tx_bcast(struct ipc_channel *ipc, void *addr, unsigned int len)
+{
+	struct ipc_bcast *bcast = &ipc->bcast;
+	void *addr_rx;
+	u16 holders = 0;
+	int i;
+
+	if (!bcast->readers)
+		return 0;
+
+	addr_rx = pool_alloc(&bcast->buf_pool);
+	if (!addr_rx)
+		return -1;
+
+	memcpy(addr_rx, addr, len);
+
+	ipc_set_src(addr_rx, 0);
+
+	for (i = 1; i <= IPC_MAX_READER_WRITERS; i++)
+		if (!ipc_is_disabled_slot(ipc->slot[i]))
+			holders |= 1 << i;
+
+	/* Take all the references before queuing, readers may free the buffer right away */
+	spin_lock(&bcast->lock);
+	bcast->holders[addr_to_index(&bcast->buf_pool, addr_rx)] = holders;
+	spin_unlock(&bcast->lock);
+
+	for (i = 1; i <= IPC_MAX_READER_WRITERS; i++) {
+		if (!(holders & (1 << i)))
+			continue;
+
+		if (ipc_tx_slot(ipc->slot[i], ipc->slot[i], addr_rx) < 0)
+			ipc_bcast_put(bcast, addr_rx, i);
+	}
+
+	return 0;
+}
+
 static int ipc_tx(struct ipc_slot *slot, void *addr, unsigned int len, unsigned int dst)
 {
 	struct ipc_channel *ipc = slot->ipc;
@@ -184,17 +381,19 @@ static int ipc_tx(struct ipc_slot *slot, void *addr, unsigned int len, unsigned
 	switch (ipc->type) {
 	case IPC_TYPE_MANY_READERS:
 		if (dst == IPC_DST_ALL) {
-			for (i = 1; i <= IPC_MAX_READER_WRITERS; i++) {
-				rx_slot = ipc->slot[i];
-
-				addr_rx = ipc_copy(rx_slot, slot, addr, len);
-				if (!addr_rx)
-					continue;
-
-				rc = ipc_tx_slot(rx_slot, rx_slot, addr_rx);
-				if (rc < 0)
-					ipc_free(rx_slot, addr_rx);
-
+			if (ipc_tx_bcast(ipc, addr, len) < 0) {
+				/* Broadcast pool exhausted, fallback to one copy per reader */
+				for (i = 1; i <= IPC_MAX_READER_WRITERS; i++) {
+					rx_slot = ipc->slot[i];
+
+					addr_rx = ipc_copy(rx_slot, slot, addr, len);
+					if (!addr_rx)
+						continue;
+
+					rc = ipc_tx_slot(rx_slot, rx_slot, addr_rx);
+					if (rc < 0)
+						ipc_free(rx_slot, addr_rx);
+				}
 			}
 
 			ipc_free(slot, addr);
@@ -328,6 +527,7 @@ static void *ipc_rx(struct ipc_slot *slot, unsigned int *src)
 			}
 
 			*src = ipc_slot_address(tx_slot);
+			ipc_set_src(addr, *src);
 
 			ipc_free(tx_slot, addr_tx);
 
@@ -353,6 +553,46 @@ err_unlock:
 	return NULL;
 }
 
+static int ipc_rx_multi_user(struct ipc_slot *slot, unsigned long arg)
+{
+	struct ipc_rx_multi_data *data = (struct ipc_rx_multi_data *)arg;
+	struct ipc_rx_data rx_data[IPC_RX_BATCH];
+	void *addr[IPC_RX_BATCH];
+	unsigned int n, i, j;
+	int rc;
+
+	rc = get_user(n, &data->n);
+	if (rc < 0)
+		goto err;
+
+	if (n > IPC_RX_BATCH)
+		n = IPC_RX_BATCH;
+
+	for (i = 0; i < n; i++) {
+		addr[i] = ipc_rx(slot, &rx_data[i].src);
+		if (!addr[i])
+			break;
+
+		rx_data[i].addr_shmem = ipc_virt_to_shmem(slot, addr[i]);
+	}
+
+	if (!i) {
+		rc = -EAGAIN;
+		goto err;
+	}
+
+	if (copy_to_user(data->data, rx_data, i * sizeof(struct ipc_rx_data)) || put_user(i, &data->n)) {
+		/* The messages can not be handed to userspace, return them to the pool instead of leaking them */
+		for (j = 0; j < i; j++)
+			ipc_free(slot, addr[j]);
+
+		rc = -EFAULT;
+	}
+
+err:
+	return rc;
+}
+
 static int ipc_rx_init(struct ipc_channel *ipc, struct ipc_slot *slot)
 {
 	int slot_i;
@@ -400,10 +640,22 @@ static int ipc_rx_init(struct ipc_channel *ipc, struct ipc_slot *slot)
 		goto err_pool_init;
 	}
 
+	if (ipc->type == IPC_TYPE_MANY_READERS) {
+		/* Broadcast pool lives as long as the channel has readers */
+		if (!ipc->bcast.readers) {
+			rc = ipc_bcast_init(&ipc->bcast);
+			if (rc < 0)
+				goto err_bcast_init;
+		}
+
+		ipc->bcast.readers++;
+		slot->bcast = &ipc->bcast;
+	}
+
 	ipc_alloc_slot(ipc, slot_i, slot);
 
 	if (ipc->type != IPC_TYPE_MANY_WRITERS)
-		queue_init(&slot->queue, pool_free_virt);
+		queue_init(&slot->queue, ipc_free_entry);
 
 	init_waitqueue_head(&slot->wait);
 
@@ -411,6 +663,9 @@ static int ipc_rx_init(struct ipc_channel *ipc, struct ipc_slot *slot)
 
 	return 0;
 
+err_bcast_init:
+	pool_exit(&slot->buf_pool);
+
 err_pool_init:
 	vfree(slot->mmap_base);
 
@@ -440,6 +695,11 @@ static void ipc_rx_exit(struct ipc_slot *slot)
 				break;
 			}
 
+		ipc_bcast_release(slot->bcast, slot->index);
+
+		if (!--ipc->bcast.readers)
+			ipc_bcast_exit(&ipc->bcast);
+
 		break;
 	case IPC_TYPE_SINGLE_READER_WRITER:
 		ipc_flush_queue(slot);
@@ -521,7 +781,7 @@ static int ipc_tx_init(struct ipc_channel *ipc, struct ipc_slot *slot)
 	}
 
 	if (ipc->type == IPC_TYPE_MANY_WRITERS)
-		queue_init(&slot->queue, pool_free_virt);
+		queue_init(&slot->queue, ipc_free_entry);
 
 	ipc_alloc_slot(ipc, slot_i, slot);
 
@@ -580,11 +840,10 @@ static int ipcdrv_vma_fault(struct vm_fault *vmf)
 static vm_fault_t ipcdrv_vma_fault(struct vm_fault *vmf)
 #endif
 {
-#if LINUX_VERSION_CODE < KERNEL_VERSION(4,11,0)
-	struct ipc_dev *dev = vma->vm_private_data;
-#else
-	struct ipc_dev *dev = vmf->vma->vm_private_data;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,11,0)
+	struct vm_area_struct *vma = vmf->vma;
 #endif
+	struct ipc_dev *dev = vma->vm_private_data;
 	struct ipc_slot *slot = &dev->slot;
 	struct page *page;
 	unsigned long offset;
@@ -594,11 +853,13 @@ static vm_fault_t ipcdrv_vma_fault(struct vm_fault *vmf)
 
 	offset = vmf->pgoff << PAGE_SHIFT;
 
-	if (offset >= slot->mmap_size)
+	if (offset < slot->mmap_size)
+		addr = slot->mmap_base + offset;
+	else if (slot->bcast && ((offset - slot->mmap_size) < slot->bcast->mmap_size) && !(vma->vm_flags & VM_WRITE))
+		addr = slot->bcast->mmap_base + (offset - slot->mmap_size);
+	else
 		return VM_FAULT_SIGBUS;
 
-	addr = slot->mmap_base + offset;
-
 	page = vmalloc_to_page(addr);
 	get_page(page);
 
@@ -623,13 +884,38 @@ static const struct vm_operations_struct ipcdrv_mem_ops = {
 	.fault = ipcdrv_vma_fault,
 };
 
+/**
+ * ipcdrv_mmap() - Maps the IPC buffer pools
+ *
+ * The slot pool starts at file offset 0. For readers of IPC_TYPE_MANY_READERS channels, the broadcast pool
+ * is shared by all the readers, it starts at file offset slot->mmap_size and can only be mapped read only.
+ */
 static int ipcdrv_mmap(struct file *file, struct vm_area_struct *vma)
 {
+	struct ipc_dev *dev = file->private_data;
+	struct ipc_slot *slot = &dev->slot;
+	unsigned long offset, size;
+
 	//pr_info("%s: start: %lx, end: %lx, offset: %lx, flags: %lx\n", __func__, vma->vm_start, vma->vm_end, vma->vm_pgoff, vma->vm_flags);
 
 	if (vma->vm_end < vma->vm_start)
 		return -EINVAL;
 
+	offset = vma->vm_pgoff << PAGE_SHIFT;
+	size = vma->vm_end - vma->vm_start;
+
+	if ((offset + size) > slot->mmap_size) {
+		/* Broadcast pool mappings can't overlap the slot pool, and can't be made writable */
+		if ((offset < slot->mmap_size) || (vma->vm_flags & VM_WRITE))
+			return -EPERM;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,3,0)
+		vm_flags_clear(vma, VM_MAYWRITE);
+#else
+		vma->vm_flags &= ~VM_MAYWRITE;
+#endif
+	}
+
 	vma->vm_ops = &ipcdrv_mem_ops;
 #if LINUX_VERSION_CODE < KERNEL_VERSION(3,10,0)
 	vma->vm_flags |= VM_RESERVED;
@@ -665,6 +951,16 @@ static long ipcdrv_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 
 			break;
 
+		case IPC_IOC_FREE_MULTI:
+			rc = ipc_free_multi_user(slot, arg);
+
+			break;
+
+		case IPC_IOC_RX_MULTI:
+			rc = ipc_rx_multi_user(slot, arg);
+
+			break;
+
 		case IPC_IOC_RX:
 
 			addr = ipc_rx(slot, &src);
@@ -676,8 +972,10 @@ static long ipcdrv_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 			rx_data.addr_shmem = ipc_virt_to_shmem(slot, addr);
 			rx_data.src = src;
 
-			if (copy_to_user((void *)arg, &rx_data, sizeof(struct ipc_rx_data)))
+			if (copy_to_user((void *)arg, &rx_data, sizeof(struct ipc_rx_data))) {
+				ipc_free(slot, addr);
 				rc = -EFAULT;
+			}
 
 			break;
 
@@ -686,6 +984,11 @@ static long ipcdrv_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 
 			break;
 
+		case IPC_IOC_BCAST_POOL_SIZE:
+			rc = put_user(ipc_bcast_mmap_size(slot), (unsigned long *)arg);
+
+			break;
+
 		default:
 			rc = -EINVAL;
 			break;
@@ -701,6 +1004,10 @@ static long ipcdrv_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 			rc = ipc_free_user(slot, arg);
 			break;
 
+		case IPC_IOC_FREE_MULTI:
+			rc = ipc_free_multi_user(slot, arg);
+			break;
+
 		case IPC_IOC_TX:
 			if (copy_from_user(&tx_data, (void *)arg, sizeof(struct ipc_tx_data))) {
 				rc = -EFAULT;
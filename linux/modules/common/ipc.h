@@ -46,6 +46,28 @@
 #define IPC_SINGLE_READER_WRITER_INDEX_BASE	180	/* 180 - 211 */
 #define IPC_SINGLE_READER_WRITER_MAX		32
 
+#define IPC_BUF_COUNT		QUEUE_ENTRIES_MAX
+#define IPC_BUF_POOL_PAGES	((IPC_BUF_COUNT * IPC_BUF_SIZE + PAGE_SIZE - 1) / PAGE_SIZE)
+#define IPC_BUF_POOL_SIZE	(IPC_BUF_POOL_PAGES * PAGE_SIZE)
+
+/*
+ * Broadcast buffer pool, shared by all the readers of an IPC_TYPE_MANY_READERS channel.
+ * Mapped by each reader right after its own buffer pool. A buffer is returned to the pool
+ * once all the readers it was queued to have freed it.
+ */
+struct ipc_bcast {
+	spinlock_t lock;
+
+	struct pool buf_pool;
+
+	void *mmap_base;
+	unsigned long mmap_size;
+
+	u16 holders[IPC_BUF_COUNT];	/* bitmask of reader slots holding each buffer */
+
+	unsigned int readers;
+};
+
 struct ipc_slot {
 	struct queue queue;
 
@@ -56,6 +78,8 @@ struct ipc_slot {
 	void *mmap_base;
 	unsigned long mmap_size;
 
+	struct ipc_bcast *bcast;	/* reader slots of IPC_TYPE_MANY_READERS channels only */
+
 	struct ipc_channel *ipc;
 
 	unsigned int index;
@@ -88,6 +112,8 @@ struct ipc_channel {
 	struct ipc_dst_map dst_map[IPC_MAX_READER_WRITERS + 1];
 
 	unsigned int last;
+
+	struct ipc_bcast bcast;
 };
 
 
@@ -101,10 +127,6 @@ struct ipc_drv {
 int ipcdrv_init(struct ipc_drv *drv);
 void ipcdrv_exit(struct ipc_drv *drv);
 
-#define IPC_BUF_COUNT		QUEUE_ENTRIES_MAX
-#define IPC_BUF_POOL_PAGES	((IPC_BUF_COUNT * IPC_BUF_SIZE + PAGE_SIZE - 1) / PAGE_SIZE)
-#define IPC_BUF_POOL_SIZE	(IPC_BUF_POOL_PAGES * PAGE_SIZE)
-
 #endif /* !__KERNEL__ */
 
 #define IPC_BUF_ORDER		10
@@ -121,6 +143,22 @@ struct ipc_rx_data {
 	unsigned int src;
 };
 
+/* Offset of the 16 bit source address in the message header (struct ipc_desc), filled by the driver
+ * before a message is queued to a reader. Broadcast buffers are read only for the readers. */
+#define IPC_MSG_SRC_OFFSET	12
+
+#define IPC_RX_BATCH		16
+
+struct ipc_rx_multi_data {
+	unsigned int n;		/* in: maximum number of messages, out: number of messages received */
+	struct ipc_rx_data data[IPC_RX_BATCH];
+};
+
+struct ipc_free_multi_data {
+	unsigned int n;
+	unsigned long addr_shmem[IPC_RX_BATCH];
+};
+
 #define IPC_IOC_MAGIC		'i'
 
 #define IPC_IOC_ALLOC		_IOR(IPC_IOC_MAGIC, 0, unsigned long)
@@ -129,5 +167,8 @@ struct ipc_rx_data {
 #define IPC_IOC_TX		_IOW(IPC_IOC_MAGIC, 3, struct ipc_tx_data)
 #define IPC_IOC_POOL_SIZE	_IOR(IPC_IOC_MAGIC, 4, unsigned long)
 #define IPC_IOC_CONNECT_TX	_IOW(IPC_IOC_MAGIC, 5, unsigned long)
+#define IPC_IOC_RX_MULTI	_IOWR(IPC_IOC_MAGIC, 6, struct ipc_rx_multi_data)
+#define IPC_IOC_FREE_MULTI	_IOW(IPC_IOC_MAGIC, 7, struct ipc_free_multi_data)
+#define IPC_IOC_BCAST_POOL_SIZE	_IOR(IPC_IOC_MAGIC, 8, unsigned long)	/* Broadcast pool, mapped read only at file offset IPC_IOC_POOL_SIZE */
 
 #endif /* _IPCDRV_H_ */
@@ -44,6 +44,7 @@
 
 __attribute__((weak)) int net_avb_init(struct net_ops_cb *net_ops) { return -1; };
 __attribute__((weak)) int net_std_init(struct net_ops_cb *net_ops) { return -1; };
+__attribute__((weak)) int net_std_mmap_init(struct net_ops_cb *net_ops) { return -1; };
 __attribute__((weak)) int net_xdp_init(struct net_ops_cb *net_ops, struct os_xdp_config *xdp_config) { return -1; };
 static struct net_ops_cb net_ops;
 
@@ -114,6 +115,14 @@ struct net_tx_desc *net_tx_alloc(unsigned int size)
 	return net_ops.net_tx_alloc(size);
 }
 
+struct net_tx_desc *net_tx_ctx_alloc(struct net_tx *tx, unsigned int size)
+{
+	if (net_ops.net_tx_ctx_alloc)
+		return net_ops.net_tx_ctx_alloc(tx, size);
+
+	return net_ops.net_tx_alloc(size);
+}
+
 int net_tx_alloc_multi(struct net_tx_desc **desc, unsigned int n, unsigned int size)
 {
 	return net_ops.net_tx_alloc_multi(desc, n, size);
@@ -425,6 +434,12 @@ int net_init(struct os_net_config *config, struct os_xdp_config *xdp_config)
 			goto err;
 		}
 		break;
+	case NET_STD_MMAP:
+		if (net_std_mmap_init(&net_ops) < 0) {
+			os_log(LOG_ERR, "Could not initialize STD MMAP network service implementation\n");
+			goto err;
+		}
+		break;
 	case NET_XDP:
 		if (net_xdp_init(&net_ops, xdp_config) < 0) {
 			os_log(LOG_ERR, "Could not initialize XDP network service implementation\n");
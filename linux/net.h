@@ -45,6 +45,7 @@ struct net_ops_cb {
 	int (*net_del_multi)(struct net_rx *, unsigned int, const unsigned char *);
 
 	struct net_tx_desc * (*net_tx_alloc)(unsigned int);
+	struct net_tx_desc * (*net_tx_ctx_alloc)(struct net_tx *, unsigned int);	/* optional, defaults to net_tx_alloc */
 	int (*net_tx_alloc_multi)(struct net_tx_desc **, unsigned int, unsigned int);
 	struct net_tx_desc * (*net_tx_clone)(struct net_tx_desc *);
 	void (*net_tx_free)(struct net_tx_desc *);
@@ -66,4 +67,29 @@ int net_std_del_multi(struct net_rx *rx, unsigned int port_id, const unsigned ch
 int net_port_sr_config(unsigned int port_id, uint8_t *sr_class);
 void net_std_rx_parser(struct net_rx *rx, struct net_rx_desc *desc);
 
+/* net_std helpers shared with the other standard socket based backends */
+bool net_std_address_is_supported(struct net_address *addr);
+int net_std_set_socket_ts(unsigned int port_id, int fd, int tx, bool enable);
+int net_std_rx_bind(struct net_rx *rx, struct net_address *addr);
+
+struct net_rx_desc *net_std_rx_alloc(unsigned int size);
+struct net_tx_desc *net_std_tx_alloc(unsigned int size);
+int net_std_tx_alloc_multi(struct net_tx_desc **desc, unsigned int n, unsigned int size);
+struct net_tx_desc *net_std_tx_clone(struct net_tx_desc *src);
+void net_std_tx_free(struct net_tx_desc *buf);
+void net_std_rx_free(struct net_rx_desc *buf);
+void net_std_free_multi(void **buf, unsigned int n);
+bool net_std_buf_from_pool(void *buf);
+
+int net_std_tx_init(struct net_tx *tx, struct net_address *addr);
+void net_std_tx_exit(struct net_tx *tx);
+int net_std_tx(struct net_tx *tx, struct net_tx_desc *desc);
+int net_std_tx_multi(struct net_tx *tx, struct net_tx_desc **desc, unsigned int n);
+int net_std_tx_ts_get(struct net_tx *tx, uint64_t *ts, unsigned int *private);
+int net_std_tx_ts_init(struct net_tx *tx, struct net_address *addr, void (*func)(struct net_tx *, uint64_t, unsigned int), unsigned long priv);
+int net_std_tx_ts_exit(struct net_tx *tx);
+int net_std_port_sr_config(unsigned int port_id, uint8_t *sr_class);
+int net_std_init(struct net_ops_cb *net_ops);
+void net_std_exit(void);
+
 #endif /* _LINUX_NET_H_ */
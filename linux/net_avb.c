@@ -174,11 +174,14 @@ static int __net_avb_rx_init(struct net_rx *rx, struct net_address *addr, void (
 		rx->batch = NET_RX_BATCH;
 	}
 
+	rx->multi_ts = false;
+
 	if (addr) {
 		if (net_avb_rx_bind(rx, addr) < 0)
 			goto err_bind;
 
 		rx->is_ptp = (addr->ptype == PTYPE_PTP);
+		rx->multi_ts = (addr->ptype != PTYPE_AVTP);
 	}
 
 	if (epoll_fd >= 0) {
@@ -223,6 +226,21 @@ void net_avb_rx_exit(struct net_rx *rx)
 	os_log(LOG_INFO, "done\n");
 }
 
+static void net_avb_rx_ts(struct net_rx *rx, struct net_rx_desc *desc)
+{
+	os_clock_id_t clock_domain;
+
+	if (rx->is_ptp)
+		clock_domain = logical_port_to_local_clock(desc->port);
+	else
+		clock_domain = logical_port_to_gptp_clock(desc->port, PTP_DOMAIN_0);
+
+	if (logical_port_is_endpoint(desc->port))
+		desc->ts64 = hwts_to_u64(clock_domain, desc->ts);
+
+	clock_time_from_hw(clock_domain, desc->ts64, &desc->ts64);
+}
+
 void net_avb_rx_multi(struct net_rx *rx)
 {
 	unsigned long addr[NET_RX_BATCH];
@@ -235,14 +253,16 @@ void net_avb_rx_multi(struct net_rx *rx)
 
 	len /= sizeof(unsigned long);
 
-	for (i = 0; i < len; i++)
+	for (i = 0; i < len; i++) {
 		desc[i] = shmem_to_virt(addr[i]);
 
-	/* 64bit timestamps not required in this path, only used by avtp */
-	/*
-	 * clock domain conversion is not required in this path either
-	 * (assuming gptp and hardware clock domain are the same)
-	 */
+		/*
+		 * 64bit timestamps and clock domain conversion are not required by avtp
+		 * (assuming gptp and hardware clock domain are the same), only by the other users (e.g. sockets)
+		 */
+		if (rx->multi_ts)
+			net_avb_rx_ts(rx, desc[i]);
+	}
 
 	rx->func_multi(rx, desc, len);
 }
@@ -251,7 +271,6 @@ struct net_rx_desc *__net_avb_rx(struct net_rx *rx)
 {
 	unsigned long addr;
 	struct net_rx_desc *desc;
-	os_clock_id_t clock_domain;
 	int len;
 
 	len = read(rx->fd, &addr, sizeof(unsigned long));
@@ -260,15 +279,7 @@ struct net_rx_desc *__net_avb_rx(struct net_rx *rx)
 
 	desc = shmem_to_virt(addr);
 
-	if (rx->is_ptp)
-		clock_domain = logical_port_to_local_clock(desc->port);
-	else
-		clock_domain = logical_port_to_gptp_clock(desc->port, PTP_DOMAIN_0);
-
-	if (logical_port_is_endpoint(desc->port))
-		desc->ts64 = hwts_to_u64(clock_domain, desc->ts);
-
-	clock_time_from_hw(clock_domain, desc->ts64, &desc->ts64);
+	net_avb_rx_ts(rx, desc);
 
 	return desc;
 }
@@ -277,7 +288,6 @@ void net_avb_rx(struct net_rx *rx)
 {
 	unsigned long addr[NET_RX_BATCH];
 	struct net_rx_desc *desc;
-	os_clock_id_t clock_domain;
 	int len, i;
 
 	len = read(rx->fd, addr, rx->batch * sizeof(unsigned long));
@@ -289,15 +299,7 @@ void net_avb_rx(struct net_rx *rx)
 	for (i = 0; i < len; i++) {
 		desc = shmem_to_virt(addr[i]);
 
-		if (rx->is_ptp)
-			clock_domain = logical_port_to_local_clock(desc->port);
-		else
-			clock_domain = logical_port_to_gptp_clock(desc->port, PTP_DOMAIN_0);
-
-		if (logical_port_is_endpoint(desc->port))
-			desc->ts64 = hwts_to_u64(clock_domain, desc->ts);
-
-		clock_time_from_hw(clock_domain, desc->ts64, &desc->ts64);
+		net_avb_rx_ts(rx, desc);
 
 		rx->func(rx, desc);
 	}
@@ -26,6 +26,7 @@
 #include <unistd.h>
 #include <errno.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
 #include <net/if.h>
 #include <linux/net_tstamp.h>
@@ -37,18 +38,86 @@
 #include <sys/poll.h>
 #include <sys/types.h>
 #include <time.h>
+#include <inttypes.h>
 
 #include "common/log.h"
 #include "common/net.h"
 #include "common/ptp.h"
+#include "genavb/avtp.h"
+#include "genavb/sr_class.h"
 #include "clock.h"
 #include "epoll.h"
 #include "net.h"
 #include "net_logical_port.h"
 #include "net_std_socket_filters.h"
+#include "pool.h"
 
 extern int net_set_hw_ts(unsigned int port_id, bool enable);
 
+#define NET_STD_BUF_ORDER		11
+#define NET_STD_BUF_SIZE		(1 << NET_STD_BUF_ORDER)	/* must hold NET_DATA_OFFSET + DEFAULT_NET_DATA_SIZE */
+#define NET_STD_BUFFERS_MAX		(MAX_SOCKETS * (NET_RX_BATCH + NET_TX_BATCH))	/* a full receive and transmit batch per socket */
+#define NET_STD_BUF_POOL_SIZE		(NET_STD_BUFFERS_MAX * NET_STD_BUF_SIZE)
+
+#define NET_STD_TX_CONTROL_SIZE		(CMSG_SPACE(sizeof(__u32)) + CMSG_SPACE(sizeof(__u64)))
+
+#define NET_STD_RX_CONTROL_SIZE		128
+#define NET_STD_RX_STATS_PERIOD		(1 << 14)	/* batched receive calls between statistics logs */
+
+/* Receive context for sockets opened with net_std_rx_init_multi().
+ * All the frames of a batch are received with a single recvmmsg() call, each
+ * message getting its own pre-allocated descriptor and control buffer (for the
+ * SO_TIMESTAMPING cmsg).
+ */
+struct net_std_rx_batch {
+	struct mmsghdr msg[NET_RX_BATCH];
+	struct iovec iov[NET_RX_BATCH];
+	char control[NET_RX_BATCH][NET_STD_RX_CONTROL_SIZE];
+	struct net_rx_desc *desc[NET_RX_BATCH];
+
+	uint64_t calls;		/* recvmmsg() calls returning at least one frame */
+	uint64_t frames;	/* frames received through those calls */
+};
+
+static void *net_std_buf_pool_area = MAP_FAILED;
+static struct pool net_std_buf_pool;
+static unsigned int net_std_buf_alloc_errors;
+
+/*
+ * Descriptors are allocated from a pre-allocated buffer pool, so that the
+ * transmit and receive paths don't go through the libc heap. The pool area is
+ * only backed by memory once used, so it's sized for the worst case. If it's
+ * still exhausted, the allocation fails (and is accounted).
+ */
+static void net_std_buf_alloc_error(unsigned int n)
+{
+	unsigned int errors = __atomic_add_fetch(&net_std_buf_alloc_errors, n, __ATOMIC_RELAXED);
+
+	/* Log the first error, then once every NET_STD_RX_STATS_PERIOD errors */
+	if (!(errors - n) || ((errors - n) / NET_STD_RX_STATS_PERIOD != errors / NET_STD_RX_STATS_PERIOD))
+		os_log(LOG_ERR, "buffer pool exhausted, %u allocation errors\n", errors);
+}
+
+static void *net_std_buf_alloc(void)
+{
+	void *buf;
+
+	buf = __pool_alloc(&net_std_buf_pool);
+	if (!buf)
+		net_std_buf_alloc_error(1);
+
+	return buf;
+}
+
+bool net_std_buf_from_pool(void *buf)
+{
+	return ((buf >= net_std_buf_pool.baseaddr) && (buf < net_std_buf_pool.end));
+}
+
+static void net_std_buf_free(void *buf)
+{
+	__pool_free(&net_std_buf_pool, buf);
+}
 
 struct net_rx_desc *net_std_rx_alloc(unsigned int size)
 {
@@ -57,7 +126,7 @@ struct net_rx_desc *net_std_rx_alloc(unsigned int size)
 	if (size > DEFAULT_NET_DATA_SIZE)
 		return NULL;
 
-	desc = malloc(NET_DATA_OFFSET + size);
+	desc = net_std_buf_alloc();
 	if (!desc)
 		goto exit;
 
@@ -75,7 +144,7 @@ struct net_tx_desc *net_std_tx_alloc(unsigned int size)
 	if (size > DEFAULT_NET_DATA_SIZE)
 		return NULL;
 
-	desc = malloc(NET_DATA_OFFSET + size);
+	desc = net_std_buf_alloc();
 	if (!desc)
 		goto exit;
 
@@ -88,21 +157,30 @@ exit:
 
 int net_std_tx_alloc_multi(struct net_tx_desc **desc, unsigned int n, unsigned int size)
 {
-	int i;
+	int i, rc;
 
-	for (i = 0; i < n; i++) {
-		desc[i] = net_std_tx_alloc(size);
-		if (!desc[i])
-			goto err_malloc;
+	if (size > DEFAULT_NET_DATA_SIZE)
+		return 0;
+
+	rc = __pool_alloc_array(&net_std_buf_pool, (void **)desc, n);
+	if (rc < 0)
+		rc = 0;
+
+	if (rc < n)
+		net_std_buf_alloc_error(n - rc);
+
+	for (i = 0; i < rc; i++) {
+		desc[i]->flags = 0;
+		desc[i]->len = 0;
+		desc[i]->l2_offset = NET_DATA_OFFSET;
 	}
 
-err_malloc:
 	return i;
 }
 
 struct net_tx_desc *net_std_tx_clone(struct net_tx_desc *src)
 {
-	struct net_tx_desc *desc = malloc(DEFAULT_NET_DATA_SIZE);
+	struct net_tx_desc *desc = net_std_buf_alloc();
 	if (!desc)
 		goto exit;
 
@@ -114,12 +192,12 @@ exit:
 
 void net_std_tx_free(struct net_tx_desc *buf)
 {
-	free((void *)buf);
+	net_std_buf_free((void *)buf);
 }
 
 void net_std_rx_free(struct net_rx_desc *buf)
 {
-	free((void *)buf);
+	net_std_buf_free((void *)buf);
 }
 
 void net_std_free_multi(void **buf, unsigned int n)
@@ -127,13 +205,13 @@ void net_std_free_multi(void **buf, unsigned int n)
 	int i;
 
 	for (i = 0; i < n; i++)
-		free(buf[i]);
+		net_std_buf_free(buf[i]);
 }
 
 /*
  * returns 1 if the ptype in the network address is supported, 0 otherwise.
  */
-static bool net_address_is_supported(struct net_address *addr)
+bool net_std_address_is_supported(struct net_address *addr)
 {
 	bool rc;
 
@@ -143,6 +221,14 @@ static bool net_address_is_supported(struct net_address *addr)
 	case PTYPE_L2:
 		rc = true;
 		break;
+	case PTYPE_AVTP:
+		/*
+		 * Only stream formats, the receive filter demuxes on stream id. Used by
+		 * socket API stream sockets, the AVTP stack (CONFIG_AVTP) doesn't run on
+		 * this backend: it still requires the avb module media driver.
+		 */
+		rc = is_avtp_stream(addr->u.avtp.subtype) || is_avtp_alternative(addr->u.avtp.subtype);
+		break;
 	default:
 		rc = false;
 		break;
@@ -151,7 +237,7 @@ static bool net_address_is_supported(struct net_address *addr)
 	return rc;
 }
 
-static int net_std_set_socket_ts(unsigned int port_id, int fd, int tx, bool enable)
+int net_std_set_socket_ts(unsigned int port_id, int fd, int tx, bool enable)
 {
 	int flags = 0;
 
@@ -252,7 +338,7 @@ static int net_std_get_cmsg_timestamp(struct msghdr *msg, uint64_t *ts)
 	}
 }
 
-static int net_std_rx_bind(struct net_rx *rx, struct net_address *addr)
+int net_std_rx_bind(struct net_rx *rx, struct net_address *addr)
 {
 	unsigned int index;
 	struct sockaddr_ll sock_addr;
@@ -303,14 +389,90 @@ err_itf:
 	return -1;
 }
 
+static void net_std_rx_batch_free(struct net_std_rx_batch *batch)
+{
+	int i;
+
+	for (i = 0; i < NET_RX_BATCH; i++)
+		if (batch->desc[i])
+			net_std_rx_free(batch->desc[i]);
+
+	free(batch);
+}
+
+static void net_std_rx_batch_stats_print(struct net_rx *rx, struct net_std_rx_batch *batch, int level)
+{
+	unsigned int avg_x100;
+
+	if (!batch->calls)
+		return;
+
+	avg_x100 = (batch->frames * 100) / batch->calls;
+
+	os_log(level, "rx(%p) fd(%d) recvmmsg calls %"PRIu64" frames %"PRIu64" average batch %u.%02u/%u\n",
+		rx, rx->fd, batch->calls, batch->frames, avg_x100 / 100, avg_x100 % 100, rx->batch);
+}
+
+/*
+ * Makes sure the first n slots of the batch have a receive descriptor, and
+ * (re)initializes the message headers, since recvmmsg() updates them.
+ * Returns the number of slots ready for reception.
+ */
+static unsigned int net_std_rx_batch_prepare(struct net_std_rx_batch *batch, unsigned int n)
+{
+	struct msghdr *msg;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		if (!batch->desc[i]) {
+			batch->desc[i] = net_std_rx_alloc(DEFAULT_NET_DATA_SIZE);
+			if (!batch->desc[i])
+				break;
+		}
+
+		batch->iov[i].iov_base = NET_DATA_START(batch->desc[i]);
+		batch->iov[i].iov_len = DEFAULT_NET_DATA_SIZE;
+
+		msg = &batch->msg[i].msg_hdr;
+		msg->msg_name = NULL;
+		msg->msg_namelen = 0;
+		msg->msg_iov = &batch->iov[i];
+		msg->msg_iovlen = 1;
+		msg->msg_control = batch->control[i];
+		msg->msg_controllen = NET_STD_RX_CONTROL_SIZE;
+		msg->msg_flags = 0;
+	}
+
+	return i;
+}
+
 static int __net_std_rx_init(struct net_rx *rx, struct net_address *addr, void (*func)(struct net_rx *, struct net_rx_desc *),
 		void (*func_multi)(struct net_rx *, struct net_rx_desc **, unsigned int), unsigned int packets, unsigned int latency, int epoll_fd)
 {
+	struct net_std_rx_batch *batch = NULL;
+
 	os_log(LOG_INFO, "enter\n");
 
-	if (!addr || !net_address_is_supported(addr))
+	if (!addr || !net_std_address_is_supported(addr))
 		goto err_addr;
 
+	if (func_multi) {
+		/* There is no kernel side buffering for standard sockets, latency is ignored.
+		 * The batch size only limits the number of frames received per call. */
+		if (packets > NET_RX_BATCH)
+			goto err_batch;
+
+		batch = calloc(1, sizeof(struct net_std_rx_batch));
+		if (!batch) {
+			os_log(LOG_ERR, "calloc() failed: %s\n", strerror(errno));
+			goto err_batch;
+		}
+
+		rx->batch = packets ? packets : NET_RX_BATCH;
+	} else {
+		rx->batch = 1;
+	}
+
 	rx->fd = socket(PF_PACKET, SOCK_RAW | SOCK_NONBLOCK, htons(ETH_P_ALL));
 	if (rx->fd < 0) {
 		os_log(LOG_ERR, "socket failed: %s\n", strerror(errno));
@@ -334,8 +496,9 @@ static int __net_std_rx_init(struct net_rx *rx, struct net_address *addr, void (
 
 	rx->func = func;
 	rx->func_multi = func_multi;
+	rx->priv = batch;
 
-	os_log(LOG_INIT, "fd(%d)\n", rx->fd);
+	os_log(LOG_INIT, "fd(%d) batch(%u)\n", rx->fd, rx->batch);
 
 	return 0;
 
@@ -346,6 +509,10 @@ err_set_ts_enable:
 	rx->fd = -1;
 
 err_open_fd:
+	if (batch)
+		free(batch);
+
+err_batch:
 err_addr:
 	return -1;
 }
@@ -362,6 +529,14 @@ int net_std_rx_init_multi(struct net_rx *rx, struct net_address *addr, void (*fu
 
 void net_std_rx_exit(struct net_rx *rx)
 {
+	struct net_std_rx_batch *batch = rx->priv;
+
+	if (batch) {
+		net_std_rx_batch_stats_print(rx, batch, LOG_INFO);
+		net_std_rx_batch_free(batch);
+		rx->priv = NULL;
+	}
+
 	close(rx->fd);
 	rx->fd = -1;
 
@@ -420,17 +595,51 @@ struct net_rx_desc *__net_std_rx(struct net_rx *rx)
 
 void net_std_rx_multi(struct net_rx *rx)
 {
+	struct net_std_rx_batch *batch = rx->priv;
 	struct net_rx_desc *desc[NET_RX_BATCH];
-	int i = 0;
+	unsigned int n;
+	uint64_t ts;
+	int cnt = 0;
+	int i;
+
+	n = net_std_rx_batch_prepare(batch, rx->batch);
+	if (!n)
+		goto out;
+
+	cnt = recvmmsg(rx->fd, batch->msg, n, MSG_DONTWAIT, NULL);
+	if (cnt <= 0) {
+		if ((cnt < 0) && (errno != EAGAIN))
+			os_log(LOG_ERR, "recvmmsg failed: %s\n", strerror(errno));
+
+		cnt = 0;
+		goto out;
+	}
+
+	for (i = 0; i < cnt; i++) {
+		/* Hand over the descriptor, the slot is refilled on the next call */
+		desc[i] = batch->desc[i];
+		batch->desc[i] = NULL;
 
-	do {
-		desc[i] = __net_std_rx(rx);
-		if (!desc[i])
-			break;
-		i++;
-	} while ( i < NET_RX_BATCH);
+		desc[i]->len = batch->msg[i].msg_len;
+		desc[i]->port = rx->port_id;
 
-	rx->func_multi(rx, desc, i);
+		net_std_get_cmsg_timestamp(&batch->msg[i].msg_hdr, &ts);
+
+		clock_time_from_hw(rx->clock_domain, ts, &ts);
+		desc[i]->ts = (uint32_t)ts;
+		desc[i]->ts64 = ts;
+
+		net_std_rx_parser(rx, desc[i]);
+	}
+
+	batch->calls++;
+	batch->frames += cnt;
+
+	if (!(batch->calls % NET_STD_RX_STATS_PERIOD))
+		net_std_rx_batch_stats_print(rx, batch, LOG_DEBUG);
+
+out:
+	rx->func_multi(rx, desc, cnt);
 }
 
 void net_std_rx(struct net_rx *rx)
@@ -485,11 +694,40 @@ static int net_std_tx_connect(struct net_tx *tx, struct net_address *addr)
 	return 0;
 }
 
+/*
+ * Enables per frame launch time for AVTP stream sockets. Frames are then paced
+ * by the etf (or taprio txtime-assist) qdisc configured on the interface, which
+ * uses CLOCK_TAI as reference. If the kernel doesn't support SO_TXTIME the
+ * socket is still usable, frames are just sent as soon as possible.
+ */
+static void net_std_tx_txtime_enable(struct net_tx *tx, struct net_address *addr)
+{
+	struct sock_txtime txtime_cfg;
+
+	tx->txtime = false;
+
+	if (addr->ptype != PTYPE_AVTP)
+		return;
+
+	txtime_cfg.clockid = CLOCK_TAI;
+	txtime_cfg.flags = 0;
+
+	if (setsockopt(tx->fd, SOL_SOCKET, SO_TXTIME, &txtime_cfg, sizeof(txtime_cfg)) < 0) {
+		os_log(LOG_INFO, "setsockopt(SO_TXTIME) failed: %s, launch time disabled\n", strerror(errno));
+		return;
+	}
+
+	tx->txtime = true;
+	tx->launch_offset = sr_class_max_transit_time(addr->u.avtp.sr_class);
+}
+
 int net_std_tx_init(struct net_tx *tx, struct net_address *addr)
 {
-	if (addr && !net_address_is_supported(addr))
+	if (addr && !net_std_address_is_supported(addr))
 		goto err_addr;
 
+	tx->txtime = false;
+
 	/* protocol 0 for AF_PACKET means socket for transmission only (the sll_protocol
 	 * should also be 0 in bind) */
 	tx->fd = socket(AF_PACKET, SOCK_RAW | SOCK_NONBLOCK, 0);
@@ -515,7 +753,9 @@ int net_std_tx_init(struct net_tx *tx, struct net_address *addr)
 		if (net_get_local_addr(tx->port_id, tx->eth_src) < 0)
 			goto err_get_local;
 
-		os_log(LOG_INIT, "fd(%d) logical_port(%u)\n", tx->fd, tx->port_id);
+		net_std_tx_txtime_enable(tx, addr);
+
+		os_log(LOG_INIT, "fd(%d) logical_port(%u) txtime(%d)\n", tx->fd, tx->port_id, tx->txtime);
 	} else {
 		os_log(LOG_INIT, "fd(%d)\n", tx->fd);
 	}
@@ -540,42 +780,154 @@ void net_std_tx_exit(struct net_tx *tx)
 	os_log(LOG_INFO, "done\n");
 }
 
-int net_std_tx(struct net_tx *tx, struct net_tx_desc *desc)
+/*
+ * Reference used to convert gPTP launch times to CLOCK_TAI, sampled once per
+ * transmit call. Only the (short) difference between the launch time and the
+ * current gPTP time is converted, so CLOCK_TAI doesn't need to be phase locked
+ * to gPTP unless the etf qdisc runs in offload mode (in which case the system
+ * clock must be synchronized to the PHC, e.g. by phc2sys).
+ */
+struct net_std_txtime_ref {
+	u32 gptp;
+	u64 tai;
+};
+
+static int net_std_txtime_ref_get(struct net_tx *tx, struct net_std_txtime_ref *ref)
+{
+	struct timespec now;
+	u64 gptp;
+
+	if (os_clock_gettime64(tx->clock_domain, &gptp) < 0)
+		goto err;
+
+	if (clock_gettime(CLOCK_TAI, &now) < 0)
+		goto err;
+
+	ref->gptp = (u32)gptp;
+	ref->tai = (u64)now.tv_sec * NSECS_PER_SEC + now.tv_nsec;
+
+	return 0;
+
+err:
+	return -1;
+}
+
+/*
+ * Returns the launch time (gPTP time) of an AVTP frame: either the one provided
+ * by the caller (NET_TX_FLAGS_TS), or the AVTP presentation time minus the stream
+ * class transit budget.
+ */
+static bool net_std_tx_launch_time(struct net_tx *tx, struct net_tx_desc *desc, u32 *launch)
+{
+	struct eth_hdr *ethhdr = (struct eth_hdr *)NET_DATA_START(desc);
+	struct vlan_hdr *vlan;
+	struct avtp_data_hdr *avtp;
+	unsigned int hdr_len = sizeof(struct eth_hdr) + sizeof(struct avtp_data_hdr);
+
+	if (desc->flags & NET_TX_FLAGS_TS) {
+		*launch = desc->ts;
+		return true;
+	}
+
+	if (ethhdr->type == htons(ETHERTYPE_VLAN)) {
+		vlan = (struct vlan_hdr *)(ethhdr + 1);
+		if (vlan->type != htons(ETHERTYPE_AVTP))
+			return false;
+
+		avtp = (struct avtp_data_hdr *)(vlan + 1);
+		hdr_len += sizeof(struct vlan_hdr);
+	} else if (ethhdr->type == htons(ETHERTYPE_AVTP)) {
+		avtp = (struct avtp_data_hdr *)(ethhdr + 1);
+	} else {
+		return false;
+	}
+
+	if ((desc->len < hdr_len) || !is_avtp_stream(avtp->subtype) || !avtp->tv)
+		return false;
+
+	*launch = ntohl(avtp->avtp_timestamp) - tx->launch_offset;
+
+	return true;
+}
+
+/*
+ * Prepares the message header for transmission of a single descriptor, including
+ * the per-frame hardware timestamping request and launch time (if txtime_ref is not NULL).
+ */
+static void net_std_tx_msg_init(struct net_tx *tx, struct net_tx_desc *desc, struct msghdr *msg, struct iovec *iov, char *control,
+				struct net_std_txtime_ref *txtime_ref)
 {
 	struct eth_hdr *ethhdr = (struct eth_hdr *)NET_DATA_START(desc);
-	struct msghdr msg;
 	struct cmsghdr *cmsg;
-	u32 *cmsg_data;
-	struct iovec iov[1];
-	char control[CMSG_SPACE(sizeof(__u32))];
-	int rc = -1;
+	unsigned int controllen = 0;
+	u32 launch;
 
 	memcpy(ethhdr->src, tx->eth_src, ETH_ALEN);
 
-	iov[0].iov_base = NET_DATA_START(desc);
-	iov[0].iov_len = desc->len;
+	iov->iov_base = NET_DATA_START(desc);
+	iov->iov_len = desc->len;
 
-	memset(&msg, 0, sizeof(struct msghdr));
-	msg.msg_iov = iov;
-	msg.msg_iovlen = 1;
-	msg.msg_name = NULL;
-	msg.msg_namelen = 0;
+	memset(msg, 0, sizeof(struct msghdr));
+	msg->msg_iov = iov;
+	msg->msg_iovlen = 1;
+	msg->msg_name = NULL;
+	msg->msg_namelen = 0;
+	msg->msg_control = control;
+	msg->msg_controllen = NET_STD_TX_CONTROL_SIZE;
+
+	cmsg = CMSG_FIRSTHDR(msg);
 
 	if (desc->flags & NET_TX_FLAGS_HW_TS) {
-		msg.msg_control = control;
-		msg.msg_controllen = sizeof(control);
-		cmsg = CMSG_FIRSTHDR(&msg);
 		cmsg->cmsg_level  = SOL_SOCKET;
 		cmsg->cmsg_type = SO_TIMESTAMPING;
 		cmsg->cmsg_len = CMSG_LEN(sizeof(__u32));
-		cmsg_data = (u32 *)CMSG_DATA(cmsg);
-		*cmsg_data = SOF_TIMESTAMPING_TX_HARDWARE;
-		msg.msg_controllen = cmsg->cmsg_len;
+		*(u32 *)CMSG_DATA(cmsg) = SOF_TIMESTAMPING_TX_HARDWARE;
+
+		controllen += CMSG_SPACE(sizeof(__u32));
+		cmsg = (struct cmsghdr *)(control + controllen);
+	}
+
+	if (txtime_ref && net_std_tx_launch_time(tx, desc, &launch)) {
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_TXTIME;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(__u64));
+		*(u64 *)CMSG_DATA(cmsg) = txtime_ref->tai + (s32)(launch - txtime_ref->gptp);
+
+		controllen += CMSG_SPACE(sizeof(__u64));
+	}
+
+	if (controllen) {
+		msg->msg_controllen = controllen;
 	} else {
-		msg.msg_control = NULL;
-		msg.msg_controllen = 0;
+		msg->msg_control = NULL;
+		msg->msg_controllen = 0;
+	}
+}
+
+/* Returns the launch time reference to use for this transmit call, NULL if launch time is disabled */
+static struct net_std_txtime_ref *net_std_tx_txtime_ref(struct net_tx *tx, struct net_std_txtime_ref *ref)
+{
+	if (!tx->txtime)
+		return NULL;
+
+	if (net_std_txtime_ref_get(tx, ref) < 0) {
+		os_log(LOG_ERR, "net_tx(%p) could not read launch time reference\n", tx);
+		return NULL;
 	}
 
+	return ref;
+}
+
+int net_std_tx(struct net_tx *tx, struct net_tx_desc *desc)
+{
+	struct msghdr msg;
+	struct iovec iov[1];
+	char control[NET_STD_TX_CONTROL_SIZE] __attribute__ ((aligned (sizeof(size_t))));
+	struct net_std_txtime_ref ref;
+	int rc = -1;
+
+	net_std_tx_msg_init(tx, desc, &msg, &iov[0], control, net_std_tx_txtime_ref(tx, &ref));
+
 	if (sendmsg(tx->fd, &msg, 0) < 0) {
 		os_log(LOG_ERR, "sendmsg() failed: %s (%d)\n", strerror(errno), tx->fd);
 		goto err_send;
@@ -591,17 +943,42 @@ err_send:
 
 int net_std_tx_multi(struct net_tx *tx, struct net_tx_desc **desc, unsigned int n)
 {
+	struct mmsghdr msg[NET_TX_BATCH];
+	struct iovec iov[NET_TX_BATCH];
+	char control[NET_TX_BATCH][NET_STD_TX_CONTROL_SIZE] __attribute__ ((aligned (sizeof(size_t))));
+	struct net_std_txtime_ref ref, *txtime_ref;
 	unsigned int written = 0;
-	int i, rc;
+	unsigned int n_now, i;
+	int rc;
+
+	txtime_ref = net_std_tx_txtime_ref(tx, &ref);
 
 	while (written < n) {
-		rc = net_std_tx(tx, desc[written]);
-		if (rc < 0)
+		n_now = n - written;
+		if (n_now > NET_TX_BATCH)
+			n_now = NET_TX_BATCH;
+
+		for (i = 0; i < n_now; i++) {
+			net_std_tx_msg_init(tx, desc[written + i], &msg[i].msg_hdr, &iov[i], control[i], txtime_ref);
+			msg[i].msg_len = 0;
+		}
+
+		rc = sendmmsg(tx->fd, msg, n_now, 0);
+		if (rc < 0) {
+			os_log(LOG_ERR, "sendmmsg() failed: %s (%d)\n", strerror(errno), tx->fd);
 			goto err;
+		}
 
-		written++;
+		/* Only the first rc messages were sent */
+		net_std_free_multi((void **)&desc[written], rc);
+		written += rc;
+
+		if (rc < n_now)
+			goto err;
 	}
 
+	return written;
+
 err:
 	for (i = written; i < n; i++)
 		net_std_tx_free(desc[i]);
@@ -720,7 +1097,12 @@ int net_std_port_sr_config(unsigned int port_id, uint8_t *sr_class) {
 
 void net_std_exit(void)
 {
-	return;
+	if (net_std_buf_alloc_errors)
+		os_log(LOG_INFO, "buffer pool %u allocation errors\n", net_std_buf_alloc_errors);
+
+	pool_exit(&net_std_buf_pool);
+	munmap(net_std_buf_pool_area, NET_STD_BUF_POOL_SIZE);
+	net_std_buf_pool_area = MAP_FAILED;
 }
 
 const static struct net_ops_cb net_std_ops = {
@@ -758,10 +1140,27 @@ const static struct net_ops_cb net_std_ops = {
 
 int net_std_init(struct net_ops_cb *net_ops)
 {
+	net_std_buf_pool_area = mmap(NULL, NET_STD_BUF_POOL_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (net_std_buf_pool_area == MAP_FAILED) {
+		os_log(LOG_ERR, "mmap() failed: %s\n", strerror(errno));
+		goto err;
+	}
+
+	if (pool_init(&net_std_buf_pool, net_std_buf_pool_area, NET_STD_BUF_POOL_SIZE, NET_STD_BUF_ORDER) < 0) {
+		os_log(LOG_ERR, "pool_init() failed\n");
+		goto err_pool;
+	}
+
 	/* We copy the entire struct rather than just point to it, to reduce the number of
 	 * indirections in performance-sensitive code.
 	 */
 	memcpy(net_ops, &net_std_ops, sizeof(struct net_ops_cb));
 
 	return 0;
+
+err_pool:
+	munmap(net_std_buf_pool_area, NET_STD_BUF_POOL_SIZE);
+	net_std_buf_pool_area = MAP_FAILED;
+err:
+	return -1;
 }
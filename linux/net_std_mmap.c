@@ -0,0 +1,669 @@
+/*
+* Copyright 2021 NXP
+*
+* NXP Confidential. This software is owned or controlled by NXP and may only
+* be used strictly in accordance with the applicable license terms.  By expressly
+* accepting such terms or by downloading, installing, activating and/or otherwise
+* using the software, you are agreeing that you have read, and that you agree to
+* comply with and are bound by, such license terms.  If you do not agree to be
+* bound by the applicable license terms, then you may not retain, install, activate
+* or otherwise use the software.
+*/
+
+/**
+ @file
+ @brief Linux PACKET_MMAP Network service implementation
+ @details Standard packet sockets, with TPACKET_V3 receive rings and TPACKET_V2
+ transmit rings shared with the kernel. Received frames are handed over in place
+ (the receive descriptor is written in the ring headroom, in front of the frame),
+ a ring block is given back to the kernel once all its frames have been freed.
+ The kernel fills the blocks in order and stops at the first block still in use, so
+ only a few blocks may hold frames at a given time: beyond that, frames are copied to
+ standard descriptors and their block goes back to the kernel right away.
+ The socket is readable as long as the last block filled by the kernel is not given
+ back, so the frames of that block are always copied: otherwise, a frame held by the
+ application would make a level-triggered poll spin.
+ Transmitted frames are copied to the ring and a single send() kicks the whole batch.
+ Sockets requesting per-frame transmit timestamps (gPTP) use the plain net_std path.
+*/
+
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <linux/net_tstamp.h>
+
+#include "common/log.h"
+#include "common/net.h"
+#include "common/ptp.h"
+#include "clock.h"
+#include "epoll.h"
+#include "net.h"
+#include "net_logical_port.h"
+
+/* Receive ring: NET_STD_MMAP_RX_BLOCK_NR blocks, each holding several frames.
+ * A block is only handed to user space when it is full or when the retire timeout
+ * expires, so the timeout bounds the added receive latency.
+ */
+#define NET_STD_MMAP_RX_BLOCK_ORDER	15
+#define NET_STD_MMAP_RX_BLOCK_SIZE	(1 << NET_STD_MMAP_RX_BLOCK_ORDER)
+#define NET_STD_MMAP_RX_BLOCK_NR	16
+#define NET_STD_MMAP_RX_FRAME_SIZE	2048
+#define NET_STD_MMAP_RX_BLOCK_TIMEOUT	1	/* ms */
+#define NET_STD_MMAP_RX_RESERVE		NET_DATA_OFFSET	/* headroom in front of each frame, holds the net_rx_desc and the ring pointer */
+#define NET_STD_MMAP_RX_HELD_MAX	(NET_STD_MMAP_RX_BLOCK_NR / 2)	/* blocks holding frames, before frames are copied */
+
+/* Transmit ring: fixed size frames */
+#define NET_STD_MMAP_TX_BLOCK_SIZE	(1 << 15)
+#define NET_STD_MMAP_TX_BLOCK_NR	4
+#define NET_STD_MMAP_TX_FRAME_SIZE	2048
+#define NET_STD_MMAP_TX_FRAME_NR	((NET_STD_MMAP_TX_BLOCK_SIZE / NET_STD_MMAP_TX_FRAME_SIZE) * NET_STD_MMAP_TX_BLOCK_NR)
+#define NET_STD_MMAP_TX_DATA_OFFSET	(TPACKET2_HDRLEN - sizeof(struct sockaddr_ll))
+
+/* A transmit frame can be reused once the kernel is done with it (sent or rejected) */
+#define NET_STD_MMAP_TX_FRAME_FREE(status)	(!((status) & (TP_STATUS_SEND_REQUEST | TP_STATUS_SENDING)))
+
+struct net_std_mmap_rx_ring {
+	void *map;
+	size_t map_size;
+
+	unsigned int block_cur;		/* block currently walked */
+	struct tpacket3_hdr *pkt_cur;	/* next frame to process in the current block */
+	unsigned int pkt_left;		/* frames left to process in the current block */
+
+	bool copy;			/* frames of the current block are copied out of the ring */
+
+	/* Number of references to each block: one per frame not yet freed, plus one while the block is walked */
+	unsigned int block_refcnt[NET_STD_MMAP_RX_BLOCK_NR];
+
+	/* Number of references to the ring: one for the socket, plus one per frame not yet freed */
+	unsigned int refcnt;
+};
+
+struct net_std_mmap_tx_ring {
+	void *map;
+	size_t map_size;
+
+	unsigned int frame_cur;		/* next frame to fill */
+};
+
+/* Ring frame descriptors have the ring pointer stored right in front of them, in the frame headroom */
+static inline struct net_std_mmap_rx_ring **net_std_mmap_rx_desc_ring(void *desc)
+{
+	return (struct net_std_mmap_rx_ring **)desc - 1;
+}
+
+/* Frees the ring once the socket is closed and all the frames are freed */
+static void net_std_mmap_rx_ring_put(struct net_std_mmap_rx_ring *ring)
+{
+	if (__atomic_sub_fetch(&ring->refcnt, 1, __ATOMIC_ACQ_REL))
+		return;
+
+	munmap(ring->map, ring->map_size);
+
+	free(ring);
+}
+
+static inline struct tpacket_block_desc *net_std_mmap_rx_block(struct net_std_mmap_rx_ring *ring, unsigned int block)
+{
+	return (struct tpacket_block_desc *)((char *)ring->map + block * NET_STD_MMAP_RX_BLOCK_SIZE);
+}
+
+static void net_std_mmap_rx_block_put(struct net_std_mmap_rx_ring *ring, unsigned int block)
+{
+	struct tpacket_block_desc *block_desc;
+
+	if (__atomic_sub_fetch(&ring->block_refcnt[block], 1, __ATOMIC_ACQ_REL))
+		return;
+
+	/* Last reference gone, give the block back to the kernel */
+	block_desc = net_std_mmap_rx_block(ring, block);
+	__atomic_store_n(&block_desc->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+}
+
+/* Block filled by the kernel and not walked yet */
+static bool net_std_mmap_rx_block_ready(struct net_std_mmap_rx_ring *ring, unsigned int block)
+{
+	/* Frames from the previous pass are still in use, the block was not given back to the kernel yet */
+	if (__atomic_load_n(&ring->block_refcnt[block], __ATOMIC_ACQUIRE))
+		return false;
+
+	return __atomic_load_n(&net_std_mmap_rx_block(ring, block)->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER;
+}
+
+static unsigned int net_std_mmap_rx_blocks_held(struct net_std_mmap_rx_ring *ring)
+{
+	unsigned int held = 0;
+	int i;
+
+	for (i = 0; i < NET_STD_MMAP_RX_BLOCK_NR; i++)
+		if (__atomic_load_n(&ring->block_refcnt[i], __ATOMIC_RELAXED))
+			held++;
+
+	return held;
+}
+
+static void net_std_mmap_free(void *buf)
+{
+	struct net_std_mmap_rx_ring *ring;
+
+	if (net_std_buf_from_pool(buf)) {
+		net_std_free_multi(&buf, 1);
+		return;
+	}
+
+	ring = *net_std_mmap_rx_desc_ring(buf);
+
+	net_std_mmap_rx_block_put(ring, ((char *)buf - (char *)ring->map) >> NET_STD_MMAP_RX_BLOCK_ORDER);
+	net_std_mmap_rx_ring_put(ring);
+}
+
+void net_std_mmap_rx_free(struct net_rx_desc *buf)
+{
+	net_std_mmap_free((void *)buf);
+}
+
+void net_std_mmap_tx_free(struct net_tx_desc *buf)
+{
+	net_std_mmap_free((void *)buf);
+}
+
+void net_std_mmap_free_multi(void **buf, unsigned int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+		net_std_mmap_free(buf[i]);
+}
+
+static struct net_std_mmap_rx_ring *net_std_mmap_rx_ring_init(int fd)
+{
+	struct net_std_mmap_rx_ring *ring;
+	struct tpacket_req3 req;
+	int val;
+
+	ring = calloc(1, sizeof(struct net_std_mmap_rx_ring));
+	if (!ring) {
+		os_log(LOG_ERR, "calloc() failed: %s\n", strerror(errno));
+		goto err_alloc;
+	}
+
+	val = TPACKET_V3;
+	if (setsockopt(fd, SOL_PACKET, PACKET_VERSION, &val, sizeof(val)) < 0) {
+		os_log(LOG_ERR, "setsockopt(PACKET_VERSION) failed: %s\n", strerror(errno));
+		goto err_sockopt;
+	}
+
+	val = NET_STD_MMAP_RX_RESERVE;
+	if (setsockopt(fd, SOL_PACKET, PACKET_RESERVE, &val, sizeof(val)) < 0) {
+		os_log(LOG_ERR, "setsockopt(PACKET_RESERVE) failed: %s\n", strerror(errno));
+		goto err_sockopt;
+	}
+
+	/* Report hardware timestamps in the ring frame headers */
+	val = SOF_TIMESTAMPING_RAW_HARDWARE;
+	if (setsockopt(fd, SOL_PACKET, PACKET_TIMESTAMP, &val, sizeof(val)) < 0) {
+		os_log(LOG_ERR, "setsockopt(PACKET_TIMESTAMP) failed: %s\n", strerror(errno));
+		goto err_sockopt;
+	}
+
+	memset(&req, 0, sizeof(req));
+	req.tp_block_size = NET_STD_MMAP_RX_BLOCK_SIZE;
+	req.tp_block_nr = NET_STD_MMAP_RX_BLOCK_NR;
+	req.tp_frame_size = NET_STD_MMAP_RX_FRAME_SIZE;
+	req.tp_frame_nr = (NET_STD_MMAP_RX_BLOCK_SIZE / NET_STD_MMAP_RX_FRAME_SIZE) * NET_STD_MMAP_RX_BLOCK_NR;
+	req.tp_retire_blk_tov = NET_STD_MMAP_RX_BLOCK_TIMEOUT;
+
+	if (setsockopt(fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0) {
+		os_log(LOG_ERR, "setsockopt(PACKET_RX_RING) failed: %s\n", strerror(errno));
+		goto err_sockopt;
+	}
+
+	ring->map_size = req.tp_block_size * req.tp_block_nr;
+	ring->map = mmap(NULL, ring->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (ring->map == MAP_FAILED) {
+		os_log(LOG_ERR, "mmap() failed: %s\n", strerror(errno));
+		goto err_sockopt;
+	}
+
+	ring->refcnt = 1;
+
+	return ring;
+
+err_sockopt:
+	free(ring);
+
+err_alloc:
+	return NULL;
+}
+
+/* The ring stays mapped until all the frames still in use are freed */
+static void net_std_mmap_rx_ring_exit(struct net_std_mmap_rx_ring *ring)
+{
+	net_std_mmap_rx_ring_put(ring);
+}
+
+static int __net_std_mmap_rx_init(struct net_rx *rx, struct net_address *addr, void (*func)(struct net_rx *, struct net_rx_desc *),
+		void (*func_multi)(struct net_rx *, struct net_rx_desc **, unsigned int), unsigned int packets, unsigned int latency, int epoll_fd)
+{
+	struct net_std_mmap_rx_ring *ring;
+
+	os_log(LOG_INFO, "enter\n");
+
+	if (!addr || !net_std_address_is_supported(addr))
+		goto err_addr;
+
+	if (packets > NET_RX_BATCH)
+		goto err_addr;
+
+	rx->fd = socket(PF_PACKET, SOCK_RAW | SOCK_NONBLOCK, htons(ETH_P_ALL));
+	if (rx->fd < 0) {
+		os_log(LOG_ERR, "socket failed: %s\n", strerror(errno));
+		goto err_open_fd;
+	}
+
+	if (net_std_set_socket_ts(addr->port, rx->fd, 0, 1) < 0) {
+		os_log(LOG_ERR, "net_set_socket_ts error\n");
+		goto err_set_ts_enable;
+	}
+
+	ring = net_std_mmap_rx_ring_init(rx->fd);
+	if (!ring)
+		goto err_ring;
+
+	if (net_std_rx_bind(rx, addr) < 0)
+		goto err_bind;
+
+	if (epoll_fd >= 0) {
+		if (epoll_ctl_add(epoll_fd, rx->fd, EPOLL_TYPE_NET_RX, rx, &rx->epoll_data, EPOLLIN) < 0) {
+			os_log(LOG_ERR, "net_rx(%p) epoll_ctl_add() failed\n", rx);
+			goto err_epoll_ctl;
+		}
+	}
+
+	rx->func = func;
+	rx->func_multi = func_multi;
+	rx->batch = packets ? packets : NET_RX_BATCH;
+	rx->priv = ring;
+
+	os_log(LOG_INIT, "fd(%d) ring(%p) %u blocks of %u bytes\n", rx->fd, ring->map, NET_STD_MMAP_RX_BLOCK_NR, NET_STD_MMAP_RX_BLOCK_SIZE);
+
+	return 0;
+
+err_epoll_ctl:
+err_bind:
+	net_std_mmap_rx_ring_exit(ring);
+
+err_ring:
+err_set_ts_enable:
+	close(rx->fd);
+	rx->fd = -1;
+
+err_open_fd:
+err_addr:
+	return -1;
+}
+
+int net_std_mmap_rx_init(struct net_rx *rx, struct net_address *addr, void (*func)(struct net_rx *, struct net_rx_desc *), unsigned long epoll_fd)
+{
+	return __net_std_mmap_rx_init(rx, addr, func, NULL, 0, 0, epoll_fd);
+}
+
+int net_std_mmap_rx_init_multi(struct net_rx *rx, struct net_address *addr, void (*func)(struct net_rx *, struct net_rx_desc **, unsigned int), unsigned int packets, unsigned int time, unsigned long epoll_fd)
+{
+	return __net_std_mmap_rx_init(rx, addr, NULL, func, packets, time, epoll_fd);
+}
+
+void net_std_mmap_rx_exit(struct net_rx *rx)
+{
+	struct net_std_mmap_rx_ring *ring = rx->priv;
+
+	close(rx->fd);
+	rx->fd = -1;
+
+	net_std_mmap_rx_ring_exit(ring);
+	rx->priv = NULL;
+
+	os_log(LOG_INFO, "done\n");
+}
+
+/*
+ * Returns the next received frame from the ring, or NULL if there is none.
+ * The descriptor is written in the ring itself, in the headroom reserved in front
+ * of the frame, and holds a reference on the ring block until it's freed.
+ * If too many blocks are already held, or the block is the last one filled by the kernel,
+ * the frame is copied to a standard descriptor instead.
+ */
+struct net_rx_desc *__net_std_mmap_rx(struct net_rx *rx)
+{
+	struct net_std_mmap_rx_ring *ring = rx->priv;
+	struct tpacket_block_desc *block;
+	struct tpacket3_hdr *hdr;
+	struct net_rx_desc *desc = NULL;
+	unsigned long data;
+	uint64_t ts;
+
+	while (!ring->pkt_left) {
+		if (!net_std_mmap_rx_block_ready(ring, ring->block_cur))
+			return NULL;
+
+		block = net_std_mmap_rx_block(ring, ring->block_cur);
+
+		/*
+		 * Frames are only held in place if the kernel already filled the next block, so that
+		 * this block is not the last one filled (which keeps the socket readable until freed).
+		 */
+		ring->copy = !net_std_mmap_rx_block_ready(ring, (ring->block_cur + 1) % NET_STD_MMAP_RX_BLOCK_NR)
+			|| (net_std_mmap_rx_blocks_held(ring) >= NET_STD_MMAP_RX_HELD_MAX);
+
+		ring->block_refcnt[ring->block_cur] = 1;
+		ring->pkt_left = block->hdr.bh1.num_pkts;
+		ring->pkt_cur = (struct tpacket3_hdr *)((char *)block + block->hdr.bh1.offset_to_first_pkt);
+
+		if (!ring->pkt_left) {
+			net_std_mmap_rx_block_put(ring, ring->block_cur);
+			ring->block_cur = (ring->block_cur + 1) % NET_STD_MMAP_RX_BLOCK_NR;
+		}
+	}
+
+	hdr = ring->pkt_cur;
+
+	data = (unsigned long)hdr + hdr->tp_mac;
+
+	if (ring->copy) {
+		desc = net_std_rx_alloc(hdr->tp_snaplen);
+		if (desc)
+			memcpy(NET_DATA_START(desc), (void *)data, hdr->tp_snaplen);
+	}
+
+	if (!desc) {
+		/* Descriptor placed right in front of the frame, 64bit aligned */
+		desc = (struct net_rx_desc *)((data - sizeof(struct net_rx_desc)) & ~7UL);
+		desc->l2_offset = data - (unsigned long)desc;
+		*net_std_mmap_rx_desc_ring(desc) = ring;
+
+		__atomic_add_fetch(&ring->block_refcnt[ring->block_cur], 1, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&ring->refcnt, 1, __ATOMIC_RELAXED);
+	}
+
+	desc->len = hdr->tp_snaplen;
+	desc->port = rx->port_id;
+
+	if (hdr->tp_status & TP_STATUS_TS_RAW_HARDWARE)
+		ts = (uint64_t)hdr->tp_sec * NSECS_PER_SEC + hdr->tp_nsec;
+	else
+		ts = 0;
+
+	clock_time_from_hw(rx->clock_domain, ts, &ts);
+	desc->ts = (uint32_t)ts;
+	desc->ts64 = ts;
+
+	net_std_rx_parser(rx, desc);
+
+	ring->pkt_left--;
+	if (ring->pkt_left) {
+		ring->pkt_cur = (struct tpacket3_hdr *)((char *)hdr + hdr->tp_next_offset);
+	} else {
+		/* Done walking this block, drop the walk reference */
+		net_std_mmap_rx_block_put(ring, ring->block_cur);
+		ring->block_cur = (ring->block_cur + 1) % NET_STD_MMAP_RX_BLOCK_NR;
+	}
+
+	return desc;
+}
+
+void net_std_mmap_rx_multi(struct net_rx *rx)
+{
+	struct net_rx_desc *desc[NET_RX_BATCH];
+	int i = 0;
+
+	while (i < rx->batch) {
+		desc[i] = __net_std_mmap_rx(rx);
+		if (!desc[i])
+			break;
+		i++;
+	}
+
+	rx->func_multi(rx, desc, i);
+}
+
+void net_std_mmap_rx(struct net_rx *rx)
+{
+	struct net_rx_desc *desc;
+	int i;
+
+	for (i = 0; i < rx->batch; i++) {
+		desc = __net_std_mmap_rx(rx);
+		if (!desc)
+			break;
+
+		rx->func(rx, desc);
+	}
+}
+
+static struct net_std_mmap_tx_ring *net_std_mmap_tx_ring_init(int fd)
+{
+	struct net_std_mmap_tx_ring *ring;
+	struct tpacket_req req;
+	int val;
+
+	ring = calloc(1, sizeof(struct net_std_mmap_tx_ring));
+	if (!ring) {
+		os_log(LOG_ERR, "calloc() failed: %s\n", strerror(errno));
+		goto err_alloc;
+	}
+
+	val = TPACKET_V2;
+	if (setsockopt(fd, SOL_PACKET, PACKET_VERSION, &val, sizeof(val)) < 0) {
+		os_log(LOG_ERR, "setsockopt(PACKET_VERSION) failed: %s\n", strerror(errno));
+		goto err_sockopt;
+	}
+
+	memset(&req, 0, sizeof(req));
+	req.tp_block_size = NET_STD_MMAP_TX_BLOCK_SIZE;
+	req.tp_block_nr = NET_STD_MMAP_TX_BLOCK_NR;
+	req.tp_frame_size = NET_STD_MMAP_TX_FRAME_SIZE;
+	req.tp_frame_nr = NET_STD_MMAP_TX_FRAME_NR;
+
+	if (setsockopt(fd, SOL_PACKET, PACKET_TX_RING, &req, sizeof(req)) < 0) {
+		os_log(LOG_ERR, "setsockopt(PACKET_TX_RING) failed: %s\n", strerror(errno));
+		goto err_sockopt;
+	}
+
+	ring->map_size = req.tp_block_size * req.tp_block_nr;
+	ring->map = mmap(NULL, ring->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (ring->map == MAP_FAILED) {
+		os_log(LOG_ERR, "mmap() failed: %s\n", strerror(errno));
+		goto err_sockopt;
+	}
+
+	return ring;
+
+err_sockopt:
+	free(ring);
+
+err_alloc:
+	return NULL;
+}
+
+static inline struct tpacket2_hdr *net_std_mmap_tx_frame(struct net_std_mmap_tx_ring *ring, unsigned int frame)
+{
+	return (struct tpacket2_hdr *)((char *)ring->map + frame * NET_STD_MMAP_TX_FRAME_SIZE);
+}
+
+int net_std_mmap_tx_init(struct net_tx *tx, struct net_address *addr)
+{
+	struct net_std_mmap_tx_ring *ring;
+
+	if (net_std_tx_init(tx, addr) < 0)
+		goto err_tx_init;
+
+	/* Launch time is passed per frame (SCM_TXTIME), these sockets don't use a ring */
+	if (tx->txtime) {
+		tx->priv = NULL;
+		return 0;
+	}
+
+	ring = net_std_mmap_tx_ring_init(tx->fd);
+	if (!ring)
+		goto err_ring;
+
+	tx->priv = ring;
+
+	os_log(LOG_INIT, "fd(%d) ring(%p) %u frames\n", tx->fd, ring->map, NET_STD_MMAP_TX_FRAME_NR);
+
+	return 0;
+
+err_ring:
+	net_std_tx_exit(tx);
+
+err_tx_init:
+	return -1;
+}
+
+void net_std_mmap_tx_exit(struct net_tx *tx)
+{
+	struct net_std_mmap_tx_ring *ring = tx->priv;
+
+	net_std_tx_exit(tx);
+
+	if (ring) {
+		munmap(ring->map, ring->map_size);
+		free(ring);
+		tx->priv = NULL;
+	}
+}
+
+int net_std_mmap_tx_ts_init(struct net_tx *tx, struct net_address *addr, void (*func)(struct net_tx *, uint64_t, unsigned int), unsigned long priv)
+{
+	/* Transmit timestamps are requested per frame, so these sockets don't use a ring */
+	tx->priv = NULL;
+
+	return net_std_tx_ts_init(tx, addr, func, priv);
+}
+
+int net_std_mmap_tx_multi(struct net_tx *tx, struct net_tx_desc **desc, unsigned int n)
+{
+	struct net_std_mmap_tx_ring *ring = tx->priv;
+	struct tpacket2_hdr *hdr;
+	struct eth_hdr *ethhdr;
+	unsigned int written = 0;
+	int i;
+
+	/* Sockets without ring (transmit timestamping) */
+	if (!ring)
+		return net_std_tx_multi(tx, desc, n);
+
+	while (written < n) {
+		hdr = net_std_mmap_tx_frame(ring, ring->frame_cur);
+
+		if (!NET_STD_MMAP_TX_FRAME_FREE(__atomic_load_n(&hdr->tp_status, __ATOMIC_ACQUIRE)))
+			break;
+
+		if (desc[written]->len > (NET_STD_MMAP_TX_FRAME_SIZE - NET_STD_MMAP_TX_DATA_OFFSET))
+			break;
+
+		ethhdr = (struct eth_hdr *)((char *)hdr + NET_STD_MMAP_TX_DATA_OFFSET);
+
+		memcpy(ethhdr, NET_DATA_START(desc[written]), desc[written]->len);
+		memcpy(ethhdr->src, tx->eth_src, ETH_ALEN);
+
+		/* NET_TX_FLAGS_HW_TS is not supported here, see net_std_mmap_tx_ts_init() */
+		hdr->tp_len = desc[written]->len;
+		__atomic_store_n(&hdr->tp_status, TP_STATUS_SEND_REQUEST, __ATOMIC_RELEASE);
+
+		ring->frame_cur = (ring->frame_cur + 1) % NET_STD_MMAP_TX_FRAME_NR;
+
+		net_std_mmap_tx_free(desc[written]);
+		written++;
+	}
+
+	/* Single kick for all the frames queued */
+	if (written && (send(tx->fd, NULL, 0, MSG_DONTWAIT) < 0) && (errno != EAGAIN))
+		os_log(LOG_ERR, "send() failed: %s (%d)\n", strerror(errno), tx->fd);
+
+	for (i = written; i < n; i++)
+		net_std_mmap_tx_free(desc[i]);
+
+	if (written)
+		return written;
+	else
+		return -1;
+}
+
+int net_std_mmap_tx(struct net_tx *tx, struct net_tx_desc *desc)
+{
+	int rc;
+
+	if (!tx->priv)
+		return net_std_tx(tx, desc);
+
+	rc = net_std_mmap_tx_multi(tx, &desc, 1);
+	if (rc < 0)
+		return rc;
+
+	return 0;
+}
+
+unsigned int net_std_mmap_tx_available(struct net_tx *tx)
+{
+	struct net_std_mmap_tx_ring *ring = tx->priv;
+	unsigned int available = 0;
+	unsigned int frame;
+
+	if (!ring)
+		return 0;
+
+	frame = ring->frame_cur;
+
+	while (available < NET_STD_MMAP_TX_FRAME_NR) {
+		if (!NET_STD_MMAP_TX_FRAME_FREE(__atomic_load_n(&net_std_mmap_tx_frame(ring, frame)->tp_status, __ATOMIC_ACQUIRE)))
+			break;
+
+		available++;
+		frame = (frame + 1) % NET_STD_MMAP_TX_FRAME_NR;
+	}
+
+	return available;
+}
+
+int net_std_mmap_init(struct net_ops_cb *net_ops)
+{
+	/* Start from the standard socket implementation (descriptors pool, timestamping,
+	 * multicast, port status) and override the data path.
+	 */
+	if (net_std_init(net_ops) < 0)
+		return -1;
+
+	net_ops->net_rx_init = net_std_mmap_rx_init;
+	net_ops->net_rx_init_multi = net_std_mmap_rx_init_multi;
+	net_ops->net_rx_exit = net_std_mmap_rx_exit;
+	net_ops->__net_rx = __net_std_mmap_rx;
+	net_ops->net_rx = net_std_mmap_rx;
+	net_ops->net_rx_multi = net_std_mmap_rx_multi;
+
+	net_ops->net_tx_init = net_std_mmap_tx_init;
+	net_ops->net_tx_exit = net_std_mmap_tx_exit;
+	net_ops->net_tx = net_std_mmap_tx;
+	net_ops->net_tx_multi = net_std_mmap_tx_multi;
+
+	net_ops->net_tx_ts_init = net_std_mmap_tx_ts_init;
+
+	net_ops->net_tx_free = net_std_mmap_tx_free;
+	net_ops->net_rx_free = net_std_mmap_rx_free;
+	net_ops->net_free_multi = net_std_mmap_free_multi;
+
+	net_ops->net_tx_available = net_std_mmap_tx_available;
+
+	os_log(LOG_INIT, "done\n");
+
+	return 0;
+}
@@ -18,6 +18,7 @@
 #include "common/log.h"
 #include "common/ptp.h"
 
+#include "genavb/avtp.h"
 #include "genavb/ether.h"
 
 #include "net_std_socket_filters.h"
@@ -72,6 +73,29 @@ static const struct sock_filter bpf_l2_filter[] = {
 	[14] = { BPF_RET | BPF_K, 0, 0, 0x00000000 }, // reject
 };
 
+/* AVTP stream filter: the X register holds the vlan header size, so that the AVTP header
+ * fields can be read with indirect loads for both tagged and untagged frames. */
+static const struct sock_filter bpf_avtp_filter[] = {
+	BPF_FILTER_OUT_PACKET_OUTGOING_INSTR(13), // filter out PACKET_OUTGOING
+	[2] = { BPF_LDX | BPF_W | BPF_IMM, 0, 0, 0 }, // no vlan header
+	[3] = { BPF_LD | BPF_H | BPF_ABS, 0, 0, ETHER_ETYPE_OFFSET }, // load etype value
+	[4] = { BPF_JMP | BPF_JEQ | BPF_K, 0, 2, ETHERTYPE_VLAN }, // AVTP streams are usually vlan tagged: jump to non-vlan block if not
+	[5] = { BPF_LDX | BPF_W | BPF_IMM, 0, 0, 4 }, // vlan header size
+	[6] = { BPF_LD | BPF_H | BPF_ABS, 0, 0, ETHER_ETYPE_OFFSET + 4 },
+	[7] = { BPF_JMP | BPF_JEQ | BPF_K, 0, 7, ETHERTYPE_AVTP },
+	[8] = { BPF_LD | BPF_B | BPF_IND, 0, 0, ETH_HLEN }, // load AVTP subtype
+#define BPF_FILTER_AVTP_SUBTYPE_CHECK_INSTR_NUM		9
+	[9] = { BPF_JMP | BPF_JEQ | BPF_K, 0, 5, 0 }, // Updated on runtime with the right subtype, BPF_FILTER_AVTP_SUBTYPE_CHECK_INSTR_NUM should match the array index here
+	[10] = { BPF_LD | BPF_W | BPF_IND, 0, 0, ETH_HLEN + 4 }, // Read the 4 Most Significant Bytes of the stream id
+#define BPF_FILTER_AVTP_STREAM_ID_MSB_CHECK_INSTR_NUM	11
+	[11] = { BPF_JMP | BPF_JEQ | BPF_K, 0, 3, 0 }, // Updated on runtime with the right stream id (4 MSB), BPF_FILTER_AVTP_STREAM_ID_MSB_CHECK_INSTR_NUM should match the array index here
+	[12] = { BPF_LD | BPF_W | BPF_IND, 0, 0, ETH_HLEN + 8 }, // Read the 4 Least Significant Bytes of the stream id
+#define BPF_FILTER_AVTP_STREAM_ID_LSB_CHECK_INSTR_NUM	13
+	[13] = { BPF_JMP | BPF_JEQ | BPF_K, 0, 1, 0 }, // Updated on runtime with the right stream id (4 LSB), BPF_FILTER_AVTP_STREAM_ID_LSB_CHECK_INSTR_NUM should match the array index here
+	[14] = { BPF_RET | BPF_K, 0, 0, 0x00040000 }, // accept
+	[15] = { BPF_RET | BPF_K, 0, 0, 0x00000000 }, // reject
+};
+
 /* Copy the right BPF filter code depending on the ethernet type:
  * inst_count is a pointer to the BPF filter array size in number of filter blocks: instructions count */
 int sock_filter_get_bpf_code(struct net_address *addr, void *buf, unsigned int *inst_count)
@@ -81,6 +105,7 @@ int sock_filter_get_bpf_code(struct net_address *addr, void *buf, unsigned int *
 	unsigned int bpf_filter_inst_count;
 	struct sock_filter *filter = (struct sock_filter *) buf;
 	u32 dst_mac_msb, dst_mac_lsb;
+	u32 stream_id_msb, stream_id_lsb;
 
 	switch (addr->ptype) {
 	case PTYPE_PTP:
@@ -98,6 +123,11 @@ int sock_filter_get_bpf_code(struct net_address *addr, void *buf, unsigned int *
 		bpf_filter_inst_count = BPF_FILTER_ARRAY_SIZE(bpf_l2_filter);
 		break;
 
+	case PTYPE_AVTP:
+		src_bpf = bpf_avtp_filter;
+		bpf_filter_inst_count = BPF_FILTER_ARRAY_SIZE(bpf_avtp_filter);
+		break;
+
 	default:
 		rc = -1;
 		goto exit;
@@ -126,6 +156,16 @@ int sock_filter_get_bpf_code(struct net_address *addr, void *buf, unsigned int *
 
 		filter[BPF_FILTER_L2_DST_MAC_MSB_CHECK_INSTR_NUM].k = dst_mac_msb;
 		filter[BPF_FILTER_L2_DST_MAC_LSB_CHECK_INSTR_NUM].k = dst_mac_lsb;
+	} else if (addr->ptype == PTYPE_AVTP) {
+		/* Update the subtype check instruction value */
+		filter[BPF_FILTER_AVTP_SUBTYPE_CHECK_INSTR_NUM].k = addr->u.avtp.subtype;
+
+		/* Update the stream id check instructions values */
+		stream_id_msb = (addr->u.avtp.stream_id[0] << 24) | (addr->u.avtp.stream_id[1] << 16) | (addr->u.avtp.stream_id[2] << 8) | addr->u.avtp.stream_id[3];
+		stream_id_lsb = (addr->u.avtp.stream_id[4] << 24) | (addr->u.avtp.stream_id[5] << 16) | (addr->u.avtp.stream_id[6] << 8) | addr->u.avtp.stream_id[7];
+
+		filter[BPF_FILTER_AVTP_STREAM_ID_MSB_CHECK_INSTR_NUM].k = stream_id_msb;
+		filter[BPF_FILTER_AVTP_STREAM_ID_LSB_CHECK_INSTR_NUM].k = stream_id_lsb;
 	}
 exit:
 	return rc;
@@ -0,0 +1,559 @@
+/*
+* Copyright 2021 NXP
+*
+* NXP Confidential. This software is owned or controlled by NXP and may only
+* be used strictly in accordance with the applicable license terms.  By expressly
+* accepting such terms or by downloading, installing, activating and/or otherwise
+* using the software, you are agreeing that you have read, and that you agree to
+* comply with and are bound by, such license terms.  If you do not agree to be
+* bound by the applicable license terms, then you may not retain, install, activate
+* or otherwise use the software.
+*/
+
+/**
+ @file
+ @brief GenAVB transmit scheduler simulation
+ @details Runs the credit-based shaper scheduler core (common/os/net_tx_common.c), shared with the AVB kernel module
+ and FreeRTOS, against simulated SR class A/B streams and best effort traffic on a link of configurable rate.
+ Reports, for each stream, the departure jitter and latency, the stream and class credit bounds, and the scheduler
+ CPU cost per transmitted frame.
+*/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+
+#include "genavb/config.h"
+#include "genavb/sr_class.h"
+#include "genavb/qos.h"
+#include "genavb/ether.h"
+
+#include "common/types.h"
+
+#define NSEC_PER_SEC		1000000000ULL
+#define SIM_PORT_INTERVAL	125000		/* ns, same as the AVB module hardware timer period */
+#define SIM_BE_FRAME_SIZE	1500		/* bytes, best effort frame size (without FCS) */
+#define SIM_FRAME_SIZE_MAX	1518		/* bytes, VLAN tagged frame (without FCS) */
+
+#ifndef BITS_PER_BYTE
+#define BITS_PER_BYTE		8
+#endif
+#ifndef BITS_PER_LONG
+#define BITS_PER_LONG		(sizeof(long) * BITS_PER_BYTE)
+#endif
+
+/* Single threaded simulation, no atomicity or barriers required */
+typedef struct {
+	u32 counter;
+} atomic_t;
+
+#define atomic_read(v)		((v)->counter)
+#define atomic_set(v, i)	((v)->counter = (i))
+#define smp_wmb()		do {} while (0)
+
+static inline void set_bit(unsigned int nr, unsigned long *addr)
+{
+	*addr |= 1UL << nr;
+}
+
+static inline void clear_bit(unsigned int nr, unsigned long *addr)
+{
+	*addr &= ~(1UL << nr);
+}
+
+#define QUEUE_ENTRIES_MAX	64
+
+#include "common/os/queue_common.h"
+#include "common/os/queue_common.c"
+
+#define rational_err(fmt, ...)	printf("%s: " fmt, __func__, ##__VA_ARGS__)
+#define rational_do_div(n, base)	__rational_do_div(&(n), base)
+
+static inline unsigned int __rational_do_div(unsigned long long *n, unsigned int base)
+{
+	unsigned int rem = *n % base;
+
+	*n /= base;
+
+	return rem;
+}
+
+#include "common/os/rational_common.h"
+#include "common/os/rational_common.c"
+
+#include "common/os/net_tx_common.h"
+
+struct ptp_grid {
+	unsigned int now;
+	unsigned int period;
+};
+
+struct port_qos {
+	unsigned int tnow;		/* ns */
+	unsigned int interval;		/* ns */
+	unsigned int interval_n;
+	unsigned int transmit_event;
+
+	struct shaper shaper;
+	unsigned int tx;
+
+	struct ptp_grid ptp_grid;
+
+	struct traffic_class traffic_class[CFG_TRAFFIC_CLASS_MAX];
+	struct sr_class sr_class[CFG_SR_CLASS_MAX];
+
+	/* Simulated link */
+	unsigned long long time;	/* ns, start of the current interval (port->tnow wraps around) */
+	unsigned int rate_mbps;
+	unsigned long long wire_free;	/* ns, time the link becomes idle */
+};
+
+struct sim_stats {
+	unsigned long long count;
+	long long min;
+	long long max;
+	long long sum;
+};
+
+struct sim_stream {
+	struct stream_queue *stream;
+	struct queue queue;
+
+	unsigned int frame_size;		/* bytes, without FCS */
+	unsigned int period;			/* ns, frame generation period */
+	unsigned long long tnext;		/* ns, next frame generation time */
+	unsigned long long last_departure;	/* ns, last frame transmission end */
+
+	struct sim_stats jitter;		/* ns, departure interval minus generation period */
+	struct sim_stats latency;		/* ns, generation to transmission end */
+	struct sim_stats credit;		/* bits, stream shaper credit */
+	unsigned long long dropped;
+};
+
+struct sim_be {
+	struct queue queue;
+	unsigned int load;			/* percent of link rate */
+	unsigned long long bits;		/* bits generated but not yet queued */
+	unsigned long long tx;
+	unsigned long long dropped;
+};
+
+static struct port_qos sim_port;
+static struct sim_stream sim_stream[CFG_SR_CLASS_MAX][CFG_SR_CLASS_STREAM_MAX];
+static unsigned int sim_streams[CFG_SR_CLASS_MAX];
+static struct sim_be sim_be;
+static struct sim_stats class_credit[CFG_SR_CLASS_MAX];
+
+static const unsigned int sr_class_interval_scale[SR_CLASS_MAX] = {
+	[SR_CLASS_A] = 1,
+	[SR_CLASS_B] = 2,
+	[SR_CLASS_C] = 8,
+	[SR_CLASS_D] = 8,
+	[SR_CLASS_E] = 8
+};
+
+static void print_usage(void)
+{
+	printf("\nUsage:\n genavb-net-tx-sim [options]\n");
+	printf("\nOptions:\n"
+		"\t-r <rate>             link rate, in Mbps (default 100)\n"
+		"\t-a <streams>          number of SR class A streams (default 1)\n"
+		"\t-b <streams>          number of SR class B streams (default 1)\n"
+		"\t-s <size>             SR streams frame size, in bytes (default 238)\n"
+		"\t-e <load>             best effort load, in percent of the link rate (default 50)\n"
+		"\t-d <duration>         simulated duration, in seconds (default 10)\n"
+		"\t-h                    print this help text\n");
+}
+
+static void stats_update(struct sim_stats *s, long long val)
+{
+	if (!s->count || (val < s->min))
+		s->min = val;
+
+	if (!s->count || (val > s->max))
+		s->max = val;
+
+	s->sum += val;
+	s->count++;
+}
+
+static unsigned long long sim_time(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (unsigned long long)now.tv_sec * NSEC_PER_SEC + now.tv_nsec;
+}
+
+/* Returns the time the frame is fully on the wire */
+static unsigned long long sim_wire_tx(struct port_qos *port, unsigned int len)
+{
+	unsigned long long start = port->wire_free;
+
+	if (start < port->time)
+		start = port->time;
+
+	if (len < (ETHER_MIN_FRAME_SIZE - FCS_LEN))
+		len = ETHER_MIN_FRAME_SIZE - FCS_LEN;
+
+	port->wire_free = start + ((len + PORT_OVERHEAD) * BITS_PER_BYTE * 1000ULL) / port->rate_mbps;
+
+	return port->wire_free;
+}
+
+static inline unsigned int queue_tx_ready(struct sr_class *class, struct stream_queue *stream)
+{
+	/* Simulated frames carry no presentation time, they are ready as soon as queued */
+	return queue_pending(stream->qos_queue->queue);
+}
+
+#include "common/os/net_tx_common.c"
+
+/* Simulated streams are never disabled */
+static void sr_class_interval_start(struct traffic_class *tc)
+{
+}
+
+static int sr_class_tx(struct port_qos *port, struct traffic_class *tc, struct qos_queue *qos_q)
+{
+	struct sim_stream *s = container_of(qos_q->queue, struct sim_stream, queue);
+	unsigned long long tgen, departure;
+	unsigned int scale = tc->sr_class->scale;
+
+	tgen = queue_dequeue(qos_q->queue);
+
+	departure = sim_wire_tx(port, s->frame_size);
+
+	if (s->last_departure)
+		stats_update(&s->jitter, (long long)(departure - s->last_departure) - s->period);
+
+	stats_update(&s->latency, departure - tgen);
+	s->last_departure = departure;
+
+	port_dec_credit(port, s->frame_size);
+	sr_class_dec_credit(tc, qos_q, s->frame_size);
+
+	stats_update(&s->credit, qos_q->stream->shaper.credit / (int)scale);
+	stats_update(&class_credit[tc->sr_class - port->sr_class], tc->sr_class->shaper.credit / (int)scale);
+
+	return 0;
+}
+
+static int traffic_class_tx(struct port_qos *port, struct traffic_class *tc, struct qos_queue *qos_q)
+{
+	struct queue *queue = qos_q->queue;
+
+	queue_dequeue(queue);
+
+	sim_wire_tx(port, SIM_BE_FRAME_SIZE);
+
+	port_dec_credit(port, SIM_BE_FRAME_SIZE);
+
+	qos_q->tx++;
+	tc->tx++;
+	sim_be.tx++;
+
+	clear_bit(qos_q->index, &tc->shared_pending_mask);
+	if (queue_pending(queue))
+		set_bit(qos_q->index, &tc->shared_pending_mask);
+	else
+		tc->scheduled_mask &= ~(1UL << qos_q->index);
+
+	return 0;
+}
+
+/* Samples the shaper credits at the end of each scheduling interval, on top of the samples taken after each transmission */
+static void sim_credit_sample(struct port_qos *port)
+{
+	struct sr_class *class;
+	int i, j;
+
+	for (i = 0; i < CFG_SR_CLASS_MAX; i++) {
+		class = &port->sr_class[i];
+
+		if (!class->streams)
+			continue;
+
+		stats_update(&class_credit[i], class->shaper.credit / (int)class->scale);
+
+		for (j = 0; j < sim_streams[i]; j++)
+			stats_update(&sim_stream[i][j].credit, class->stream[j].shaper.credit / (int)class->scale);
+	}
+}
+
+static void sim_queue_free(void *data, unsigned long entry)
+{
+}
+
+static void sim_enqueue(struct queue *queue, struct qos_queue *qos_q, unsigned long entry, unsigned long long *dropped)
+{
+	if (queue_enqueue(queue, entry) < 0) {
+		(*dropped)++;
+		return;
+	}
+
+	set_bit(qos_q->index, &qos_q->tc->shared_pending_mask);
+}
+
+static void sim_generate(struct port_qos *port)
+{
+	struct traffic_class *tc;
+	struct sim_stream *s;
+	int i, j;
+
+	for (i = 0; i < CFG_SR_CLASS_MAX; i++) {
+		for (j = 0; j < sim_streams[i]; j++) {
+			s = &sim_stream[i][j];
+
+			while (s->tnext <= port->time) {
+				sim_enqueue(&s->queue, s->stream->qos_queue, s->tnext, &s->dropped);
+				s->tnext += s->period;
+			}
+		}
+	}
+
+	if (!sim_be.load)
+		return;
+
+	tc = &port->traffic_class[0];
+
+	sim_be.bits += ((unsigned long long)port->rate_mbps * port->interval * sim_be.load) / (1000 * 100);
+
+	while (sim_be.bits >= (SIM_BE_FRAME_SIZE + PORT_OVERHEAD) * BITS_PER_BYTE) {
+		sim_enqueue(&sim_be.queue, &tc->qos_queue[0], 0, &sim_be.dropped);
+		sim_be.bits -= (SIM_BE_FRAME_SIZE + PORT_OVERHEAD) * BITS_PER_BYTE;
+	}
+}
+
+static int sim_stream_init(struct port_qos *port, struct sr_class *class, unsigned int index, unsigned int frame_size)
+{
+	struct sim_stream *s = &sim_stream[class - port->sr_class][index];
+	struct stream_queue *stream = &class->stream[index];
+	struct qos_queue *qos_q = &class->tc->qos_queue[index];
+	unsigned int idle_slope, rate;
+
+	s->stream = stream;
+	s->frame_size = frame_size;
+	s->period = sr_class_interval_p(class->class) / sr_class_interval_q(class->class);
+
+	/* Spread the streams start time over the class interval */
+	s->tnext = (unsigned long long)s->period * index / class->stream_max;
+
+	queue_init(&s->queue, sim_queue_free);
+
+	qos_q->queue = &s->queue;
+	qos_q->stream = stream;
+	qos_q->flags = QOS_QUEUE_FLAG_CONNECTED | QOS_QUEUE_FLAG_ENABLED;
+
+	stream->qos_queue = qos_q;
+	stream->flags = STREAM_FLAGS_USED;
+
+	/* Same computation as the SRP bandwidth reservation, one frame per class interval */
+	idle_slope = (frame_size + PORT_OVERHEAD) * BITS_PER_BYTE * (NSEC_PER_SEC / s->period);
+	rate = ((unsigned long long)idle_slope * sr_class_interval_p(class->class)) / (NSEC_PER_SEC * sr_class_interval_q(class->class));
+
+	shaper_set(&stream->shaper, rate);
+	shaper_add(&class->shaper, stream->shaper.rate);
+
+	stream->idle_slope = idle_slope;
+	class->idle_slope += idle_slope;
+	class->streams++;
+
+	return 0;
+}
+
+static int sim_port_init(struct port_qos *port, unsigned int rate_mbps, unsigned int frame_size)
+{
+	uint8_t *map = priority_to_traffic_class_map(CFG_TRAFFIC_CLASS_MAX, CFG_SR_CLASS_MAX);
+	unsigned int rate, used_rate = 0;
+	struct traffic_class *tc;
+	struct sr_class *class;
+	int i, j;
+
+	if (!map) {
+		printf("Invalid traffic class configuration\n");
+		return -1;
+	}
+
+	port->interval = SIM_PORT_INTERVAL;
+	port->ptp_grid.period = SIM_PORT_INTERVAL;
+	port->rate_mbps = rate_mbps;
+
+	rate = (rate_mbps * port->interval) / 1000; /* bits/interval */
+
+	/* Allow for a 200ppm drift between the hardware timer and ethernet transmit clocks */
+	shaper_init(&port->shaper, rate - (rate + 4999) / 5000);
+
+	for (i = 0; i < CFG_TRAFFIC_CLASS_MAX; i++) {
+		tc = &port->traffic_class[i];
+
+		tc->index = i;
+
+		for (j = 0; j < CFG_TRAFFIC_CLASS_QUEUE_MAX; j++) {
+			tc->qos_queue[j].tc = tc;
+			tc->qos_queue[j].index = j;
+		}
+	}
+
+	for (i = 0; i < CFG_SR_CLASS_MAX; i++) {
+		class = &port->sr_class[i];
+
+		class->class = sr_prio_class(i);
+		class->scale = sr_class_interval_scale[class->class];
+		rational_init(&class->interval, sr_class_interval_p(class->class), sr_class_interval_q(class->class) * class->scale);
+		rational_init(&class->tnext, 0, class->interval.q);
+		rational_int_div(&class->interval_ratio, &class->interval, port->interval);
+
+		class->stream_max = CFG_SR_CLASS_STREAM_MAX;
+
+		shaper_init(&class->shaper, 0);
+
+		tc = &port->traffic_class[map[sr_prio_pcp(i)]];
+		tc->sr_class = class;
+		class->tc = tc;
+
+		for (j = 0; j < class->stream_max; j++)
+			class->stream[j].sr_class = class;
+
+		for (j = 0; j < sim_streams[i]; j++)
+			sim_stream_init(port, class, j, frame_size);
+
+		used_rate += class->idle_slope;
+	}
+
+	if (port->traffic_class[0].sr_class) {
+		printf("Traffic class 0 is an SR class, no best effort traffic class available\n");
+		return -1;
+	}
+
+	queue_init(&sim_be.queue, sim_queue_free);
+	port->traffic_class[0].qos_queue[0].queue = &sim_be.queue;
+	port->traffic_class[0].qos_queue[0].flags = QOS_QUEUE_FLAG_CONNECTED | QOS_QUEUE_FLAG_ENABLED;
+
+	if (used_rate > ((unsigned long long)rate_mbps * 1000000 / 100) * 75) {
+		printf("SR streams bandwidth (%u bps) above 75%% of the link rate\n", used_rate);
+		return -1;
+	}
+
+	return 0;
+}
+
+static void stats_print(const char *name, struct sim_stats *s)
+{
+	if (!s->count) {
+		printf("  %-12s %10s\n", name, "-");
+		return;
+	}
+
+	printf("  %-12s %10lld %10lld %10lld\n", name, s->min, s->sum / (long long)s->count, s->max);
+}
+
+static void sim_report(struct port_qos *port, unsigned long long sched_ns, unsigned long long intervals)
+{
+	struct sim_stream *s;
+	int i, j;
+
+	for (i = 0; i < CFG_SR_CLASS_MAX; i++) {
+		printf("SR class %c, credit bounds (bits): min %lld max %lld\n", 'A' + port->sr_class[i].class,
+			class_credit[i].min, class_credit[i].max);
+
+		for (j = 0; j < sim_streams[i]; j++) {
+			s = &sim_stream[i][j];
+
+			printf(" stream %d: tx %llu dropped %llu\n", j, (unsigned long long)s->latency.count, s->dropped);
+			printf("  %-12s %10s %10s %10s\n", "", "min", "avg", "max");
+			stats_print("jitter (ns)", &s->jitter);
+			stats_print("latency (ns)", &s->latency);
+			stats_print("credit (bits)", &s->credit);
+		}
+	}
+
+	printf("best effort: tx %llu dropped %llu\n", sim_be.tx, sim_be.dropped);
+
+	printf("scheduler: %llu intervals, %u frames, %llu ns/interval", intervals, port->tx, sched_ns / intervals);
+	if (port->tx)
+		printf(", %llu ns/frame", sched_ns / port->tx);
+
+	printf("\n");
+}
+
+int main(int argc, char *argv[])
+{
+	struct port_qos *port = &sim_port;
+	unsigned int rate_mbps = 100, frame_size = 238, duration = 10;
+	unsigned long long intervals, i, start, sched_ns = 0;
+	int option;
+
+	sim_streams[SR_PRIO_HIGH] = 1;
+	sim_streams[SR_PRIO_LOW] = 1;
+	sim_be.load = 50;
+
+	while ((option = getopt(argc, argv, "r:a:b:s:e:d:h")) != -1) {
+		switch (option) {
+		case 'r':
+			rate_mbps = strtoul(optarg, NULL, 0);
+			break;
+
+		case 'a':
+			sim_streams[SR_PRIO_HIGH] = strtoul(optarg, NULL, 0);
+			break;
+
+		case 'b':
+			sim_streams[SR_PRIO_LOW] = strtoul(optarg, NULL, 0);
+			break;
+
+		case 's':
+			frame_size = strtoul(optarg, NULL, 0);
+			break;
+
+		case 'e':
+			sim_be.load = strtoul(optarg, NULL, 0);
+			break;
+
+		case 'd':
+			duration = strtoul(optarg, NULL, 0);
+			break;
+
+		case 'h':
+		default:
+			print_usage();
+			return 0;
+		}
+	}
+
+	if (!rate_mbps || !duration || (frame_size > SIM_FRAME_SIZE_MAX) || (sim_be.load > 100)
+	|| (sim_streams[SR_PRIO_HIGH] > CFG_SR_CLASS_STREAM_MAX) || (sim_streams[SR_PRIO_LOW] > CFG_SR_CLASS_STREAM_MAX)) {
+		print_usage();
+		return 1;
+	}
+
+	if (sim_port_init(port, rate_mbps, frame_size) < 0)
+		return 1;
+
+	intervals = ((unsigned long long)duration * NSEC_PER_SEC) / port->interval;
+
+	for (i = 0; i < intervals; i++) {
+		port->ptp_grid.now = port->tnow;
+
+		sim_generate(port);
+
+		start = sim_time();
+
+		port_qos_schedule(port);
+
+		sched_ns += sim_time() - start;
+
+		sim_credit_sample(port);
+
+		port->time += port->interval;
+	}
+
+	sim_report(port, sched_ns, intervals);
+
+	return 0;
+}
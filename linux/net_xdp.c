@@ -23,25 +23,45 @@
 #include <errno.h>
 #include <sys/mman.h>
 #include <pthread.h>
+#include <sched.h>
 #include <poll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
 #include <string.h>
+#include <unistd.h>
 
 #define asm __asm__
 #include <bpf/libbpf.h>
 #include <bpf/xsk.h>
 #include <bpf/bpf.h>
 #include <linux/if_link.h>
+#include <linux/if_xdp.h>
 
 #include "common/log.h"
 #include "common/net.h"
-#include "common/list.h"
+#include "common/ptp.h"
+#include "genavb/avtp.h"
+#include "clock.h"
 #include "epoll.h"
 #include "net_logical_port.h"
 #include "net.h"
 #include "pool.h"
 
+extern int net_set_hw_ts(unsigned int port_id, bool enable);
+
 #define NET_XDP_ZEROCOPY 1
 
+/*
+ * AF_XDP TX metadata (Linux 6.8+): hardware transmit timestamps and, if supported, launch time.
+ * Also needs the xsk.h umem configuration tx_metadata_len (libxdp 1.4.2+), see linux/Makefile.
+ */
+#if defined(XDP_TX_METADATA) && defined(XDP_TXMD_FLAGS_TIMESTAMP) && defined(HAVE_XSK_TX_METADATA_LEN)
+#define NET_XDP_TX_METADATA 1
+#endif
+
+#define TX_TS_POLL_PERIOD	50000	/* ns, completion ring polling period while transmit timestamps are pending */
+#define TX_TS_TIMEOUT		10000000	/* ns, pending transmit timestamps are dropped if none is received for this long */
+
 #define DEFAULT_XDP_QUEUE 0
 
 // Derived from avbdrv.h
@@ -58,7 +78,8 @@
 #else
 #define HW_RX_QUEUE_SIZE	0
 #endif
-#define N_QUEUES		1
+#define XDP_QUEUES_MAX		8	/* hardware queues usable per port */
+#define UMEM_MAX		(CFG_MAX_ENDPOINTS * XDP_QUEUES_MAX)
 /* The FILL queue must be deep enough to accommodate:
  * . the buffers that will be placed in the HW queue when the UMEM is created (HW_RX_QUEUE_SIZE)
  * . the buffers that will land in the RX queue as the HW starts receiving packets (RX_QUEUE_SIZE)
@@ -67,7 +88,7 @@
  *   => so the FILL queue must contain at least HW_RX_QUEUE_SIZE + 2*RX_QUEUE_SIZE buffers, and be
  *   a power of 2 (design constraint).
  *
- *   For a given queue, the buffer pool must hold:
+ *   Each queue has its own buffer pool, which must hold:
  *   . the packets that go into the FILL queue when the umem is created (FILL_SIZE)
  *   . some packets to be used by the refill code to keep the FILL queue from emptying itself (RX_QUEUE_SIZE)
  *   . the packets that may go into the TX queue (TX_QUEUE_SIZE)
@@ -77,19 +98,34 @@
 #define FILL_LEVEL_INITIAL	(HW_RX_QUEUE_SIZE + 2*RX_QUEUE_SIZE)
 #define FILL_LEVEL		(RX_QUEUE_SIZE)
 #define COMPLETION_QUEUE_SIZE	(TX_QUEUE_SIZE)
-#define BUFFERS_MAX		(N_QUEUES*(FILL_LEVEL_INITIAL + RX_QUEUE_SIZE + COMPLETION_QUEUE_SIZE + TX_QUEUE_SIZE))
+#define BUFFERS_MAX		(FILL_LEVEL_INITIAL + RX_QUEUE_SIZE + COMPLETION_QUEUE_SIZE + TX_QUEUE_SIZE)
 #define BUF_POOL_SIZE		(BUFFERS_MAX * BUF_SIZE)
 
-#define GENAVB_XDPKEY_NAME "/sys/fs/bpf/xdp/globals/genavb_xdpkey"
-#define GENAVB_XSKMAP_NAME "/sys/fs/bpf/xdp/globals/genavb_xskmap"
+/* One UMEM per (port, hardware queue): sockets bound to different queues don't share any
+ * buffer pool, ring or lock, so that independent tasks scale across cores.
+ * The buffer area and pool live until net_xdp_exit() (descriptors may still be in use
+ * by the application after the last socket is closed), the xsk umem and its FILL/COMPLETION
+ * rings only exist while at least one socket is bound to the queue.
+ */
+/* Transmit timestamp, retrieved from the COMPLETION ring and waiting for its socket to read it */
+struct net_xdp_tx_ts {
+	struct net_tx *tx;
+	uint64_t ts;
+	unsigned int private;
+};
 
 struct net_xdp_umem {
 	struct xsk_umem *umem;
+	bool tx_metadata;	/* umem registered with TX metadata */
+	struct net_xdp_tx_ts tx_ts[COMPLETION_QUEUE_SIZE];	/* owned with the COMPLETION ring */
+	unsigned int tx_ts_count;
 	struct xsk_ring_prod fill_ring;
 	struct xsk_ring_cons completion_ring;
-	pthread_mutex_t fill_lock;
-	pthread_mutex_t completion_lock;
-	struct list_head list;
+	int fill_owner;		/* set while a thread produces to the FILL ring */
+	int completion_owner;	/* set while a thread consumes the COMPLETION ring */
+	void *area;
+	struct pool pool;
+	unsigned int port_id;
 	unsigned int queue_index;
 	unsigned int refcnt;
 };
@@ -100,13 +136,36 @@ struct net_xdp_ctx {
 	struct xsk_ring_cons rx_queue;
 	struct xsk_ring_prod tx_queue;
 	struct net_address addr;
+	int ts_fd;			/* timer polling for transmit timestamps, -1 if disabled */
+	unsigned int ts_pending;	/* transmit timestamps requested and not read yet */
+	uint64_t ts_deadline;		/* monotonic time after which the pending transmit timestamps are dropped */
+};
+
+#if defined(NET_XDP_TX_METADATA)
+/* Placed in the buffer headroom, right before the frame data (the TX metadata must immediately
+ * precede the data). The socket is saved for frames requesting a transmit timestamp, so that the
+ * timestamp can be matched when the buffer shows up in the (per umem) COMPLETION ring.
+ */
+struct net_xdp_tx_md {
+	struct net_tx *tx;
+	struct xsk_tx_metadata meta;
 };
 
-static struct list_head umem_list;
+static inline struct net_xdp_tx_md *net_xdp_tx_md(void *data)
+{
+	return (struct net_xdp_tx_md *)((char *)data - sizeof(struct net_xdp_tx_md));
+}
+#endif
+
+/* Entries are only added (under umem_lock) and removed in net_xdp_exit(), so the
+ * array can be scanned without lock on the data path. */
+static struct net_xdp_umem *umem_array[UMEM_MAX];
+static unsigned int umem_count;
 pthread_mutex_t umem_lock;
 
-static void *umem_buffer_pool_area;
-static struct pool umem_buffer_pool;
+/* UMEM of the last socket used for transmit by the current thread, descriptors
+ * are allocated from it so that they can be sent without copy. */
+static __thread struct net_xdp_umem *umem_local;
 
 #define BMAP_LOGSIZE	6
 #define BMAP_SIZE	(1 << BMAP_LOGSIZE)
@@ -115,6 +174,7 @@ static uint64_t free_index_bmap[BMAP_ARRAY_LEN];
 
 static int xskmap_fd = -1;
 static int xdpkey_fd = -1;
+static int xdpstats_fd = -1;
 
 static struct os_xdp_config xdp_config;
 
@@ -122,23 +182,27 @@ static struct os_xdp_config xdp_config;
 static inline int get_unique_index(uint32_t *idx)
 {
 	unsigned int i = 0;
+	int bit;
 
 	pthread_mutex_lock(&umem_lock);
 
 	do {
-		*idx = ffsl(free_index_bmap[i]);
+		bit = ffsll(free_index_bmap[i]);
 		i++;
-	} while ((*idx == 0) && (i < BMAP_ARRAY_LEN));
+	} while ((bit == 0) && (i < BMAP_ARRAY_LEN));
 
-	if (*idx == 0)
+	if (bit == 0) {
+		pthread_mutex_unlock(&umem_lock);
 		return -1;
+	}
 
 	i--;
-	free_index_bmap[i] &= ~(1 << (*idx - 1));
+	free_index_bmap[i] &= ~(1ULL << (bit - 1));
 
 	pthread_mutex_unlock(&umem_lock);
 
-	*idx += i << BMAP_LOGSIZE;
+	/* Index in [0, MAX_SOCKETS - 1], as used by the XSK and statistics maps */
+	*idx = (bit - 1) + (i << BMAP_LOGSIZE);
 	return 0;
 }
 
@@ -148,16 +212,58 @@ static inline void release_unique_index(uint32_t index)
 
 	pthread_mutex_lock(&umem_lock);
 
-	if (index > MAX_SOCKETS)
+	if (index >= MAX_SOCKETS)
 		goto err;
 
 	i = (index & ~(BMAP_SIZE - 1)) >> BMAP_LOGSIZE;
-	free_index_bmap[i] |= (1 << (index & (BMAP_SIZE - 1)));
+	free_index_bmap[i] |= (1ULL << (index & (BMAP_SIZE - 1)));
 
 err:
 	pthread_mutex_unlock(&umem_lock);
 }
 
+static void net_xdp_key_init(struct genavb_xdp_key *key, struct net_address *addr)
+{
+	memset(key, 0, sizeof(*key));
+
+	key->vlan_id = addr->vlan_id;
+
+	if (addr->ptype == PTYPE_AVTP) {
+		/* Stream flows are matched on stream ID only, see genavb_xdp_prog() */
+		key->protocol = htons(ETHERTYPE_AVTP);
+		memcpy(key->stream_id, addr->u.avtp.stream_id, 8);
+	} else {
+		key->protocol = addr->u.l2.protocol;
+		memcpy(key->dst_mac, addr->u.l2.dst_mac, 6);
+	}
+}
+
+/*
+ * Clears the per-CPU statistics of a flow, so that a new socket reusing an XSK map index
+ * starts from zero.
+ */
+static void net_xdp_stats_reset(uint32_t xsk)
+{
+	struct genavb_xdp_stats *stats;
+	int ncpus;
+
+	if (xdpstats_fd == -1)
+		return;
+
+	ncpus = libbpf_num_possible_cpus();
+	if (ncpus <= 0)
+		return;
+
+	stats = calloc(ncpus, sizeof(struct genavb_xdp_stats));
+	if (!stats)
+		return;
+
+	if (bpf_map_update_elem(xdpstats_fd, &xsk, stats, 0))
+		os_log(LOG_ERR, "Could not reset XDP statistics for index(%u)\n", xsk);
+
+	free(stats);
+}
+
 static int net_xdp_xskmap_add_addr(struct net_address *addr, int xsk_fd)
 {
 	int rc;
@@ -167,14 +273,14 @@ static int net_xdp_xskmap_add_addr(struct net_address *addr, int xsk_fd)
 	if ((xdpkey_fd == -1) || (xskmap_fd == -1))
 		goto err_idx;
 
-	key.protocol = addr->u.l2.protocol;
-	key.vlan_id = addr->vlan_id;
-	memcpy(key.dst_mac, addr->u.l2.dst_mac, 6);
+	net_xdp_key_init(&key, addr);
 
 	rc = get_unique_index(&xsk);
 	if (rc < 0)
 		goto err_idx;
 
+	net_xdp_stats_reset(xsk);
+
 	rc = bpf_map_update_elem(xdpkey_fd, &key, &xsk, 0);
 	if (rc)
 		goto err_xdp;
@@ -204,13 +310,11 @@ static int net_xdp_xskmap_del_addr(struct net_address *addr)
 		return -1;
 	}
 
-	key.protocol = addr->ptype;
-	key.vlan_id = addr->vlan_id;
-	memcpy(key.dst_mac, addr->u.l2.dst_mac, 6);
+	net_xdp_key_init(&key, addr);
 
-	rc = bpf_map_lookup_elem(xdpkey_fd, &key, & xsk);
-	if (!rc) {
-		os_log(LOG_ERR, "Could not find XDP entry for key protocol(%d)\n", key.protocol);
+	rc = bpf_map_lookup_elem(xdpkey_fd, &key, &xsk);
+	if (rc) {
+		os_log(LOG_ERR, "Could not find XDP entry for key protocol(%d)\n", ntohs(key.protocol));
 		return -1;
 	}
 
@@ -234,13 +338,44 @@ static void net_xdp_wakeup(int fd, const struct xsk_ring_prod *ring)
 	}
 }
 
+/* Kicks the kernel to process the TX ring, only if the driver requested it */
+static void net_xdp_tx_wakeup(int fd, const struct xsk_ring_prod *ring)
+{
+	if (xsk_ring_prod__needs_wakeup(ring))
+		if ((sendto(fd, NULL, 0, MSG_DONTWAIT, NULL, 0) < 0) && (errno != EAGAIN) && (errno != EBUSY) && (errno != ENOBUFS))
+			os_log(LOG_ERR, "sendto() failed: %s (%d)\n", strerror(errno), fd);
+}
+
+/*
+ * The FILL and COMPLETION rings are single producer/single consumer, but shared by all the sockets
+ * bound to the queue. Instead of a lock, a thread takes ownership of the ring for the duration of an update.
+ * On the data path a thread finding the ring already owned doesn't wait: the owner is refilling, or
+ * recovering transmitted buffers, on behalf of all the sockets.
+ */
+static inline bool net_xdp_umem_own(int *owner)
+{
+	return !__atomic_exchange_n(owner, 1, __ATOMIC_ACQUIRE);
+}
+
+static inline void net_xdp_umem_release(int *owner)
+{
+	__atomic_store_n(owner, 0, __ATOMIC_RELEASE);
+}
+
+/* Control path only, waits for the current owner to release the ring */
+static void net_xdp_umem_own_wait(int *owner)
+{
+	while (!net_xdp_umem_own(owner))
+		sched_yield();
+}
+
 static void net_xdp_umem_fill_cleanup(struct net_xdp_umem *umem)
 {
 	unsigned int count;
 	uint32_t idx = 0;
 	const __u64 *addr, *start;
 
-	pthread_mutex_lock(&umem->fill_lock);
+	net_xdp_umem_own_wait(&umem->fill_owner);
 	count = xsk_prod_nb_free(&umem->fill_ring, FILL_QUEUE_SIZE);
 	count = xsk_ring_prod__reserve(&umem->fill_ring, 0, &idx);
 
@@ -248,33 +383,132 @@ static void net_xdp_umem_fill_cleanup(struct net_xdp_umem *umem)
 	idx += count;
 	do {
 		addr = xsk_ring_prod__fill_addr(&umem->fill_ring, idx);
-		pool_free_shmem(&umem_buffer_pool, *addr);
+		pool_free_shmem(&umem->pool, *addr);
 		idx++;
 	} while (addr != start);
 
-	pthread_mutex_unlock(&umem->fill_lock);
+	net_xdp_umem_release(&umem->fill_owner);
 }
 
-static void net_xdp_umem_completion_cleanup(struct net_xdp_umem *umem)
+#if defined(NET_XDP_TX_METADATA)
+/* Called with the COMPLETION ring owned */
+static void net_xdp_tx_ts_complete(struct net_xdp_umem *umem, void *data)
+{
+	struct net_xdp_tx_md *md = net_xdp_tx_md(data);
+	struct eth_hdr *ethhdr = (struct eth_hdr *)data;
+	struct ptp_hdr *ptp = (struct ptp_hdr *)(ethhdr + 1);
+	struct net_xdp_tx_ts *tx_ts;
+
+	if (!(md->meta.flags & XDP_TXMD_FLAGS_TIMESTAMP))
+		return;
+
+	md->meta.flags = 0;
+
+	if (umem->tx_ts_count >= COMPLETION_QUEUE_SIZE) {
+		os_log(LOG_ERR, "umem(%p) too many pending transmit timestamps\n", umem);
+		return;
+	}
+
+	/* Zeroed on submit, still zero if the driver did not provide a timestamp */
+	if (!md->meta.completion.tx_timestamp) {
+		os_log(LOG_DEBUG, "umem(%p) no transmit timestamp\n", umem);
+		return;
+	}
+
+	tx_ts = &umem->tx_ts[umem->tx_ts_count++];
+	tx_ts->tx = md->tx;
+	tx_ts->ts = md->meta.completion.tx_timestamp;
+
+	/* Same private value as the standard socket backend, for PTP frames */
+	if (ethhdr->type == htons(ETHERTYPE_PTP))
+		tx_ts->private = (ptp->transport_specific << 24) | (ptp->domain_number << 16) | ptp->msg_type;
+	else
+		tx_ts->private = 0;
+}
+#endif
+
+/* Called with the COMPLETION ring owned */
+static void __net_xdp_umem_completion_cleanup(struct net_xdp_umem *umem)
 {
+	void *buf[COMPLETION_QUEUE_SIZE];
 	unsigned int count, i;
 	const __u64 *addr;
 	uint32_t idx = 0;
 
-	pthread_mutex_lock(&umem->completion_lock);
-
 	count = xsk_ring_cons__peek(&umem->completion_ring, COMPLETION_QUEUE_SIZE, &idx);
 
 	for (i = 0; i < count; i++) {
 		addr = xsk_ring_cons__comp_addr(&umem->completion_ring, idx + i);
-		pool_free_shmem(&umem_buffer_pool, pool_align(&umem_buffer_pool, *addr));
+#if defined(NET_XDP_TX_METADATA)
+		if (umem->tx_metadata)
+			net_xdp_tx_ts_complete(umem, xsk_umem__get_data(umem->area, *addr));
+#endif
+		buf[i] = pool_shmem_to_virt(&umem->pool, pool_align(&umem->pool, *addr));
 	}
 	xsk_ring_cons__release(&umem->completion_ring, count);
 
-	pthread_mutex_unlock(&umem->completion_lock);
+	pool_free_multi(&umem->pool, buf, count);
 }
 
-static struct net_xdp_umem *net_xdp_umem_create(unsigned int queue_index)
+static void net_xdp_umem_completion_cleanup(struct net_xdp_umem *umem)
+{
+	if (!net_xdp_umem_own(&umem->completion_owner))
+		return;
+
+	__net_xdp_umem_completion_cleanup(umem);
+
+	net_xdp_umem_release(&umem->completion_owner);
+}
+
+static struct net_xdp_umem *net_xdp_umem_alloc(unsigned int port_id, unsigned int queue_index)
+{
+	struct net_xdp_umem *umem;
+	int rc;
+
+	umem = calloc(1, sizeof(struct net_xdp_umem));
+	if (!umem) {
+		os_log(LOG_ERR, "calloc() failed with error %s\n", strerror(errno));
+		goto err_alloc;
+	}
+
+	umem->area = mmap(NULL, BUF_POOL_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (umem->area == MAP_FAILED) {
+		os_log(LOG_ERR, "mmap() failed: %s\n", strerror(errno));
+		goto err_mmap;
+	}
+
+	rc = pool_init(&umem->pool, umem->area, BUF_POOL_SIZE, BUF_ORDER);
+	if (rc) {
+		os_log(LOG_ERR, "pool_init() failed with error %d\n", rc);
+		goto err_pool;
+	}
+
+	umem->fill_owner = 0;
+	umem->completion_owner = 0;
+	umem->port_id = port_id;
+	umem->queue_index = queue_index;
+	umem->refcnt = 0;
+
+	os_log(LOG_INIT, "umem(%p) logical_port(%u) queue(%u) %u buffers\n", umem, port_id, queue_index, BUFFERS_MAX);
+
+	return umem;
+
+err_pool:
+	munmap(umem->area, BUF_POOL_SIZE);
+err_mmap:
+	free(umem);
+err_alloc:
+	return NULL;
+}
+
+static void net_xdp_umem_free(struct net_xdp_umem *umem)
+{
+	pool_exit(&umem->pool);
+	munmap(umem->area, BUF_POOL_SIZE);
+	free(umem);
+}
+
+static int net_xdp_umem_create(struct net_xdp_umem *umem)
 {
 	struct xsk_umem_config cfg = {
 		.fill_size = FILL_QUEUE_SIZE,
@@ -283,18 +517,33 @@ static struct net_xdp_umem *net_xdp_umem_create(unsigned int queue_index)
 		.frame_headroom = NET_DATA_OFFSET,
 		.flags = XSK_UMEM__DEFAULT_FLAGS
 	};
-	struct net_xdp_umem *umem;
 	int rc, i;
 	uint32_t idx;
 
+	umem->tx_metadata = false;
+	umem->tx_ts_count = 0;
 
-	umem = malloc(sizeof(struct net_xdp_umem));
-	if (!umem) {
-		os_log(LOG_ERR, "malloc() failed with error %s\n", strerror(errno));
-		goto err_alloc;
-	}
+#if defined(NET_XDP_TX_METADATA)
+	cfg.tx_metadata_len = sizeof(struct xsk_tx_metadata);
+#if defined(XDP_UMEM_TX_METADATA_LEN)
+	cfg.flags |= XDP_UMEM_TX_METADATA_LEN;
+#endif
+
+	rc = xsk_umem__create(&umem->umem, umem->area, BUF_POOL_SIZE, &umem->fill_ring, &umem->completion_ring, &cfg);
+	if (!rc) {
+		umem->tx_metadata = true;
+	} else {
+		/* Older kernel, fall back to a umem without TX metadata */
+		os_log(LOG_INFO, "TX metadata not supported (%d), transmit timestamps and launch time disabled\n", rc);
+
+		cfg.tx_metadata_len = 0;
+		cfg.flags = XSK_UMEM__DEFAULT_FLAGS;
 
-	rc = xsk_umem__create(&umem->umem, umem_buffer_pool_area, BUF_POOL_SIZE, &umem->fill_ring, &umem->completion_ring, &cfg);
+		rc = xsk_umem__create(&umem->umem, umem->area, BUF_POOL_SIZE, &umem->fill_ring, &umem->completion_ring, &cfg);
+	}
+#else
+	rc = xsk_umem__create(&umem->umem, umem->area, BUF_POOL_SIZE, &umem->fill_ring, &umem->completion_ring, &cfg);
+#endif
 	if (rc) {
 		os_log(LOG_ERR, "xsk_umem__create() failed with error %d\n", rc);
 		goto err_umem_create;
@@ -310,7 +559,7 @@ static struct net_xdp_umem *net_xdp_umem_create(unsigned int queue_index)
 	}
 
 	for (i = 0; i < FILL_LEVEL_INITIAL; i++) {
-		rc = pool_alloc_shmem(&umem_buffer_pool, (unsigned long *)xsk_ring_prod__fill_addr(&umem->fill_ring, idx + i));
+		rc = pool_alloc_shmem(&umem->pool, (unsigned long *)xsk_ring_prod__fill_addr(&umem->fill_ring, idx + i));
 		if (rc) {
 			os_log(LOG_ERR, "pool_alloc_shmem() failed with error %d\n", rc);
 			goto err_pool_alloc;
@@ -318,62 +567,87 @@ static struct net_xdp_umem *net_xdp_umem_create(unsigned int queue_index)
 	}
 	xsk_ring_prod__submit(&umem->fill_ring, FILL_LEVEL_INITIAL);
 
-	pthread_mutex_init(&umem->fill_lock, NULL);
-	pthread_mutex_init(&umem->completion_lock, NULL);
-	umem->queue_index = queue_index;
-	umem->refcnt = 0;
-
-	return umem;
+	return 0;
 
 
 err_pool_alloc:
 	while (i > 0) {
 		i--;
-		pool_free_shmem(&umem_buffer_pool, *xsk_ring_prod__fill_addr(&umem->fill_ring, idx + i));
+		pool_free_shmem(&umem->pool, *xsk_ring_prod__fill_addr(&umem->fill_ring, idx + i));
 	}
 err_fill_reserve:
 	xsk_umem__delete(umem->umem);
+	umem->umem = NULL;
 err_umem_create:
-	free(umem);
-err_alloc:
-	return NULL;
+	return -1;
 }
 
 static void net_xdp_umem_delete(struct net_xdp_umem *umem)
 {
-	net_xdp_umem_completion_cleanup(umem);
+	net_xdp_umem_own_wait(&umem->completion_owner);
+	__net_xdp_umem_completion_cleanup(umem);
+	net_xdp_umem_release(&umem->completion_owner);
 	//FIXME Can there be packets in-flight in the driver?
 
 	net_xdp_umem_fill_cleanup(umem);
 
 	xsk_umem__delete(umem->umem);
-
-	free(umem);
+	umem->umem = NULL;
 }
 
+static struct net_xdp_umem *net_xdp_umem_find_locked(unsigned int port_id, unsigned int queue_index)
+{
+	int i;
+
+	for (i = 0; i < umem_count; i++)
+		if ((umem_array[i]->port_id == port_id) && (umem_array[i]->queue_index == queue_index))
+			return umem_array[i];
+
+	return NULL;
+}
 
-static struct net_xdp_umem *net_xdp_umem_get(unsigned int queue_index)
+/* Returns the UMEM for a given port and queue, allocating it if needed. */
+static struct net_xdp_umem *net_xdp_umem_lookup_locked(unsigned int port_id, unsigned int queue_index)
 {
-	struct list_head *entry;
-	struct net_xdp_umem *umem = NULL;
+	struct net_xdp_umem *umem;
 
-	pthread_mutex_lock(&umem_lock);
-	for (entry = list_first(&umem_list); entry != &umem_list; entry = list_next(entry)) {
-		umem = container_of(entry, struct net_xdp_umem, list);
-		if (umem->queue_index == queue_index)
-			break;
+	umem = net_xdp_umem_find_locked(port_id, queue_index);
+	if (umem)
+		goto out;
+
+	if (umem_count >= UMEM_MAX) {
+		os_log(LOG_ERR, "too many umem (%u)\n", umem_count);
+		goto out;
 	}
 
-	if (umem && (umem->queue_index != queue_index))
-		umem = NULL;
+	umem = net_xdp_umem_alloc(port_id, queue_index);
+	if (!umem)
+		goto out;
+
+	umem_array[umem_count] = umem;
+	__atomic_store_n(&umem_count, umem_count + 1, __ATOMIC_RELEASE);
+
+out:
+	return umem;
+}
+
+static struct net_xdp_umem *net_xdp_umem_get(unsigned int port_id, unsigned int queue_index)
+{
+	struct net_xdp_umem *umem;
+
+	pthread_mutex_lock(&umem_lock);
 
+	umem = net_xdp_umem_lookup_locked(port_id, queue_index);
 	if (!umem) {
-		umem = net_xdp_umem_create(queue_index);
-		if (!umem) {
-			os_log(LOG_ERR, "Could not allocate new umem\n");
+		os_log(LOG_ERR, "Could not allocate new umem\n");
+		goto err;
+	}
+
+	if (!umem->refcnt) {
+		if (net_xdp_umem_create(umem) < 0) {
+			umem = NULL;
 			goto err;
 		}
-		list_add(&umem_list, &umem->list);
 	}
 
 	umem->refcnt++;
@@ -384,14 +658,11 @@ err:
 	return umem;
 }
 
-
 static void net_xdp_umem_put_locked(struct net_xdp_umem *umem)
 {
 	umem->refcnt--;
-	if (umem->refcnt == 0) {
-		list_del(&umem->list);
+	if (umem->refcnt == 0)
 		net_xdp_umem_delete(umem);
-	}
 }
 
 static void net_xdp_umem_put(struct net_xdp_umem *umem)
@@ -401,13 +672,32 @@ static void net_xdp_umem_put(struct net_xdp_umem *umem)
 	pthread_mutex_unlock(&umem_lock);
 }
 
+/* Returns the UMEM owning a buffer, NULL if none. */
+static inline struct net_xdp_umem *net_xdp_buf_to_umem(void *buf)
+{
+	unsigned int count = __atomic_load_n(&umem_count, __ATOMIC_ACQUIRE);
+	struct net_xdp_umem *umem;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		umem = umem_array[i];
+		if ((buf >= umem->pool.baseaddr) && (buf < umem->pool.end))
+			return umem;
+	}
+
+	return NULL;
+}
+
 static int net_xdp_umem_refill(struct net_xdp_umem *umem)
 {
+	void *buf[FILL_LEVEL];
 	unsigned int count, i, level;
 	uint32_t idx;
 	int rc;
 
-	pthread_mutex_lock(&umem->fill_lock);
+	/* Another thread is already refilling */
+	if (!net_xdp_umem_own(&umem->fill_owner))
+		return 0;
 
 	/* Try to maintain the FILL queue at a certain level:
 	 * if there are already enough buffers, don't add new ones to avoid emptying the pool
@@ -424,18 +714,19 @@ static int net_xdp_umem_refill(struct net_xdp_umem *umem)
 	 */
 	xsk_ring_prod__reserve(&umem->fill_ring, 0, &idx);
 
-	for (i = 0; i < count; i++) {
-		rc = pool_alloc_shmem(&umem_buffer_pool, (unsigned long *)xsk_ring_prod__fill_addr(&umem->fill_ring, idx + i));
-		if (rc) {
-			os_log(LOG_ERR, "pool_alloc_shmem() failed with error %d\n", rc);
-			break;
-		}
+	rc = count ? pool_alloc_multi(&umem->pool, buf, count) : 0;
+	if (rc < 0) {
+		os_log(LOG_ERR, "pool_alloc_multi() failed with error %d\n", rc);
+		rc = 0;
 	}
 
+	for (i = 0; i < rc; i++)
+		*xsk_ring_prod__fill_addr(&umem->fill_ring, idx + i) = pool_virt_to_shmem(&umem->pool, buf[i]);
+
 	xsk_ring_prod__reserve(&umem->fill_ring, i, &idx);
 	xsk_ring_prod__submit(&umem->fill_ring, i);
 
-	pthread_mutex_unlock(&umem->fill_lock);
+	net_xdp_umem_release(&umem->fill_owner);
 
 	net_xdp_wakeup(xsk_umem__fd(umem->umem), &umem->fill_ring);
 
@@ -445,7 +736,7 @@ static int net_xdp_umem_refill(struct net_xdp_umem *umem)
 /*
  * returns 1 if the ptype in the network address is supported, 0 otherwise.
  */
-static bool net_address_is_supported(struct net_address *addr)
+static bool net_address_is_supported(struct net_address *addr, bool rx)
 {
 	bool rc;
 
@@ -453,6 +744,10 @@ static bool net_address_is_supported(struct net_address *addr)
 	case PTYPE_L2:
 		rc = true;
 		break;
+	case PTYPE_AVTP:
+		/* Stream receive only, classified on stream ID by the XDP program */
+		rc = rx && is_avtp_stream(addr->u.avtp.subtype);
+		break;
 	default:
 		rc = false;
 		break;
@@ -461,6 +756,20 @@ static bool net_address_is_supported(struct net_address *addr)
 	return rc;
 }
 
+/*
+ * Pins a socket to one of the hardware queues configured for its port: the traffic
+ * priority selects the queue, starting from endpoint_queue_rx/tx, among the
+ * endpoint_queues_rx/tx configured. Receive flows must be steered to the same queue
+ * by the network interface (RSS, ntuple or priority to queue mapping).
+ */
+static unsigned int net_xdp_queue_index(struct net_address *addr, bool rx)
+{
+	if (rx)
+		return xdp_config.endpoint_queue_rx[addr->port] + (addr->priority % xdp_config.endpoint_queues_rx[addr->port]);
+	else
+		return xdp_config.endpoint_queue_tx[addr->port] + (addr->priority % xdp_config.endpoint_queues_tx[addr->port]);
+}
+
 static struct net_xdp_ctx *net_xdp_ctx_init(struct net_address *addr, unsigned int rx_queue_size, unsigned int tx_queue_size)
 {
 	struct xsk_socket_config cfg = {
@@ -480,11 +789,10 @@ static struct net_xdp_ctx *net_xdp_ctx_init(struct net_address *addr, unsigned i
 	unsigned int queue_index;
 	int rc;
 
-	if (!addr || !net_address_is_supported(addr))
+	if (!addr || !net_address_is_supported(addr, rx_queue_size != 0))
 		goto err_addr;
 
-
-	queue_index = rx_queue_size? xdp_config.endpoint_queue_rx[addr->port]:xdp_config.endpoint_queue_tx[addr->port];
+	queue_index = net_xdp_queue_index(addr, rx_queue_size != 0);
 
 	ctx = malloc(sizeof(struct net_xdp_ctx));
 	if (!ctx) {
@@ -492,7 +800,7 @@ static struct net_xdp_ctx *net_xdp_ctx_init(struct net_address *addr, unsigned i
 		goto err_priv;
 	}
 
-	ctx->umem = net_xdp_umem_get(queue_index);
+	ctx->umem = net_xdp_umem_get(addr->port, queue_index);
 	if (!ctx->umem) {
 		os_log(LOG_ERR, "Could not get umem for socket addr %p\n", addr);
 		goto err_umem;
@@ -508,6 +816,9 @@ static struct net_xdp_ctx *net_xdp_ctx_init(struct net_address *addr, unsigned i
 	}
 
 	memcpy(&ctx->addr, addr, sizeof(struct net_address));
+	ctx->ts_fd = -1;
+	ctx->ts_pending = 0;
+	ctx->ts_deadline = 0;
 
 	return ctx;
 
@@ -529,17 +840,23 @@ static void net_xdp_ctx_exit(struct net_xdp_ctx *ctx)
 	free(ctx);
 }
 
-struct net_tx_desc *net_xdp_tx_alloc(unsigned int size)
+static inline struct net_xdp_umem *net_xdp_umem_local(void)
+{
+	if (umem_local)
+		return umem_local;
+
+	/* Thread not transmitting yet, use the default umem */
+	return umem_array[0];
+}
+
+static struct net_tx_desc *__net_xdp_tx_alloc(struct net_xdp_umem *umem, unsigned int size)
 {
 	struct net_tx_desc *desc = NULL;
 
 	if (size > DEFAULT_NET_DATA_SIZE)
 		return NULL;
 
-	/* First try to recycle a completed buffer */
-
-	/* Then just alloc from the pool */
-	desc = pool_alloc(&umem_buffer_pool);
+	desc = pool_alloc(&umem->pool);
 	if (!desc)
 		goto exit;
 
@@ -551,6 +868,19 @@ exit:
 	return desc;
 }
 
+struct net_tx_desc *net_xdp_tx_alloc(unsigned int size)
+{
+	return __net_xdp_tx_alloc(net_xdp_umem_local(), size);
+}
+
+/* Allocates from the socket UMEM, the descriptor can always be sent on that socket without copy */
+struct net_tx_desc *net_xdp_tx_ctx_alloc(struct net_tx *tx, unsigned int size)
+{
+	struct net_xdp_ctx *ctx = (struct net_xdp_ctx *)tx->priv;
+
+	return __net_xdp_tx_alloc(ctx->umem, size);
+}
+
 int net_xdp_tx_alloc_multi(struct net_tx_desc **desc, unsigned int n, unsigned int size)
 {
 	int i;
@@ -569,7 +899,7 @@ struct net_tx_desc *net_xdp_tx_clone(struct net_tx_desc *src)
 {
 	struct net_tx_desc *desc = NULL;
 
-	desc = pool_alloc(&umem_buffer_pool);
+	desc = pool_alloc(&net_xdp_umem_local()->pool);
 	if (!desc)
 		goto exit;
 
@@ -579,14 +909,26 @@ exit:
 	return desc;
 }
 
+static inline void net_xdp_buf_free(void *buf)
+{
+	struct net_xdp_umem *umem = net_xdp_buf_to_umem(buf);
+
+	if (!umem) {
+		os_log(LOG_ERR, "buffer(%p) not part of any umem\n", buf);
+		return;
+	}
+
+	pool_free(&umem->pool, (void *)pool_align(&umem->pool, (unsigned long)buf));
+}
+
 void net_xdp_tx_free(struct net_tx_desc *buf)
 {
-	pool_free(&umem_buffer_pool, (void *)pool_align(&umem_buffer_pool, (unsigned long)buf));
+	net_xdp_buf_free(buf);
 }
 
 void net_xdp_rx_free(struct net_rx_desc *buf)
 {
-	pool_free(&umem_buffer_pool, (void *)pool_align(&umem_buffer_pool, (unsigned long)buf));
+	net_xdp_buf_free(buf);
 }
 
 void net_xdp_free_multi(void **buf, unsigned int n)
@@ -594,7 +936,7 @@ void net_xdp_free_multi(void **buf, unsigned int n)
 	int i;
 
 	for (i = 0; i < n; i++)
-		pool_free(&umem_buffer_pool, (void *)pool_align(&umem_buffer_pool, (unsigned long)buf[i]));
+		net_xdp_buf_free(buf[i]);
 }
 
 static int __net_xdp_rx_init(struct net_rx *rx, struct net_address *addr, void (*func)(struct net_rx *, struct net_rx_desc *),
@@ -602,6 +944,9 @@ static int __net_xdp_rx_init(struct net_rx *rx, struct net_address *addr, void (
 {
 	struct net_xdp_ctx *ctx;
 
+	if (func_multi && (packets > NET_RX_BATCH))
+		goto err_batch;
+
 	ctx = net_xdp_ctx_init(addr, RX_QUEUE_SIZE, 0);
 	if (!ctx) {
 		os_log(LOG_ERR, "could not create XDP context\n");
@@ -609,6 +954,7 @@ static int __net_xdp_rx_init(struct net_rx *rx, struct net_address *addr, void (
 	}
 
 	rx->fd = xsk_socket__fd(ctx->xdpsock);
+	rx->batch = func_multi ? (packets ? packets : NET_RX_BATCH) : 1;
 
 	if (net_xdp_xskmap_add_addr(addr, rx->fd) < 0) {
 		os_log(LOG_ERR, "Could not add addr ptype(%d) for socket(%d) to XSK map\n", addr->ptype, xskmap_fd);
@@ -628,7 +974,7 @@ static int __net_xdp_rx_init(struct net_rx *rx, struct net_address *addr, void (
 	rx->func = func;
 	rx->func_multi = func_multi;
 
-	os_log(LOG_INIT, "fd(%d)\n", rx->fd);
+	os_log(LOG_INIT, "fd(%d) queue(%u)\n", rx->fd, ctx->umem->queue_index);
 
 	return 0;
 
@@ -638,6 +984,7 @@ err_xskmap:
 	net_xdp_ctx_exit(ctx);
 	rx->fd = -1;
 err_ctx:
+err_batch:
 	return -1;
 }
 
@@ -673,13 +1020,30 @@ static inline struct net_rx_desc *data_start_to_rx_desc(uint64_t start)
 	return desc;
 }
 
+static inline struct net_rx_desc *net_xdp_rx_desc(struct net_rx *rx, struct net_xdp_ctx *ctx, uint32_t idx)
+{
+	const struct xdp_desc *rx_desc = xsk_ring_cons__rx_desc(&ctx->rx_queue, idx);
+	struct net_rx_desc *desc;
+	uint64_t addr;
+
+	addr = xsk_umem__add_offset_to_addr(rx_desc->addr);
+	addr = (uint64_t) xsk_umem__get_data(ctx->umem->area, addr);
+	desc = data_start_to_rx_desc(addr);
+
+	desc->len = rx_desc->len;
+	desc->port = rx->port_id;
+
+	net_std_rx_parser(rx, desc);
+
+	return desc;
+}
+
 struct net_rx_desc *__net_xdp_rx(struct net_rx *rx)
 {
 	struct net_xdp_ctx *ctx = (struct net_xdp_ctx *)rx->priv;
 	struct net_rx_desc *desc = NULL;
 	unsigned int count;
-	uint32_t idx, len;
-	uint64_t addr;
+	uint32_t idx;
 
 	count = xsk_ring_cons__peek(&ctx->rx_queue, 1, &idx);
 	if (count == 0) {
@@ -687,17 +1051,7 @@ struct net_rx_desc *__net_xdp_rx(struct net_rx *rx)
 		goto err;
 	}
 
-	addr = xsk_ring_cons__rx_desc(&ctx->rx_queue, idx)->addr;
-	len = xsk_ring_cons__rx_desc(&ctx->rx_queue, idx)->len;
-
-	addr = xsk_umem__add_offset_to_addr(addr);
-	addr = (uint64_t) xsk_umem__get_data(umem_buffer_pool_area, addr);
-	desc = data_start_to_rx_desc(addr);
-
-	desc->len = len;
-	desc->port = rx->port_id;
-
-	net_std_rx_parser(rx, desc);
+	desc = net_xdp_rx_desc(rx, ctx, idx);
 
 	xsk_ring_cons__release(&ctx->rx_queue, 1);
 
@@ -709,19 +1063,29 @@ err:
 	return NULL;
 }
 
+/*
+ * Dequeues up to rx->batch frames with a single peek/release of the RX ring,
+ * and refills the FILL ring once for the whole batch.
+ */
 void net_xdp_rx_multi(struct net_rx *rx)
 {
+	struct net_xdp_ctx *ctx = (struct net_xdp_ctx *)rx->priv;
 	struct net_rx_desc *desc[NET_RX_BATCH];
-	int i = 0;
+	unsigned int count, i;
+	uint32_t idx;
 
-	do {
-		desc[i] = __net_xdp_rx(rx);
-		if (!desc[i])
-			break;
-		i++;
-	} while ( i < NET_RX_BATCH);
+	count = xsk_ring_cons__peek(&ctx->rx_queue, rx->batch, &idx);
+
+	for (i = 0; i < count; i++)
+		desc[i] = net_xdp_rx_desc(rx, ctx, idx + i);
+
+	if (count) {
+		xsk_ring_cons__release(&ctx->rx_queue, count);
+
+		net_xdp_umem_refill(ctx->umem);
+	}
 
-	rx->func_multi(rx, desc, i);
+	rx->func_multi(rx, desc, count);
 }
 
 void net_xdp_rx(struct net_rx *rx)
@@ -746,8 +1110,11 @@ int net_xdp_tx_init(struct net_tx *tx, struct net_address *addr)
 	tx->priv = ctx;
 	tx->port_id = addr->port;
 	tx->fd = xsk_socket__fd(ctx->xdpsock);
+	tx->clock_domain = logical_port_to_gptp_clock(tx->port_id, PTP_DOMAIN_0);
 
-	os_log(LOG_INIT, "fd(%d)\n", tx->fd);
+	umem_local = ctx->umem;
+
+	os_log(LOG_INIT, "fd(%d) queue(%u)\n", tx->fd, ctx->umem->queue_index);
 
 	return 0;
 
@@ -767,47 +1134,205 @@ void net_xdp_tx_exit(struct net_tx *tx)
 	os_log(LOG_INFO, "done\n");
 }
 
-int net_xdp_tx(struct net_tx *tx, struct net_tx_desc *desc)
+/*
+ * Descriptors allocated from another queue UMEM are copied to a buffer of the socket UMEM,
+ * the original is freed. This only happens for descriptors allocated without a socket
+ * (net_tx_alloc()/net_tx_clone()) by a thread transmitting on several queues, callers
+ * knowing the socket use net_tx_ctx_alloc() and are never copied.
+ */
+static struct net_tx_desc *net_xdp_tx_desc_to_umem(struct net_xdp_umem *umem, struct net_tx_desc *desc)
+{
+	struct net_tx_desc *copy;
+
+	if (((void *)desc >= umem->pool.baseaddr) && ((void *)desc < umem->pool.end))
+		return desc;
+
+	copy = pool_alloc(&umem->pool);
+	if (!copy)
+		return NULL;
+
+	memcpy(copy, desc, desc->l2_offset + desc->len);
+
+	net_xdp_buf_free(desc);
+
+	return copy;
+}
+
+#if defined(NET_XDP_TX_METADATA)
+/*
+ * Reference used to convert gPTP launch times to the network interface hardware clock,
+ * sampled once per transmit call.
+ */
+struct net_xdp_txtime_ref {
+	uint32_t gptp;
+	uint64_t hw;
+};
+
+static struct net_xdp_txtime_ref *net_xdp_txtime_ref_get(struct net_tx *tx, struct net_xdp_txtime_ref *ref)
+{
+#if defined(XDP_TXMD_FLAGS_LAUNCH_TIME)
+	uint64_t gptp;
+
+	if (os_clock_gettime64(tx->clock_domain, &gptp) < 0)
+		goto err;
+
+	if (os_clock_gettime64_of_parent(tx->clock_domain, &ref->hw) < 0)
+		goto err;
+
+	ref->gptp = (uint32_t)gptp;
+
+	return ref;
+
+err:
+#endif
+	return NULL;
+}
+
+/*
+ * Fills the TX metadata for a frame: transmit timestamp request (NET_TX_FLAGS_HW_TS, only for
+ * sockets opened with net_xdp_tx_ts_init()) and launch time (NET_TX_FLAGS_TS, if supported by the kernel).
+ * Returns the xdp descriptor options.
+ */
+static uint32_t net_xdp_tx_md_set(struct net_tx *tx, struct net_xdp_ctx *ctx, struct net_tx_desc *desc, struct net_xdp_txtime_ref *txtime_ref)
+{
+	struct net_xdp_tx_md *md = net_xdp_tx_md(NET_DATA_START(desc));
+
+	md->meta.flags = 0;
+
+	if ((desc->flags & NET_TX_FLAGS_HW_TS) && (ctx->ts_fd >= 0)) {
+		md->meta.flags |= XDP_TXMD_FLAGS_TIMESTAMP;
+		md->tx = tx;
+		ctx->ts_pending++;
+	}
+
+	/*
+	 * The completion timestamp shares a union with the request checksum fields, which are not used.
+	 * Clear it so that a frame completed without timestamp is not reported with stale buffer data.
+	 */
+	md->meta.completion.tx_timestamp = 0;
+
+#if defined(XDP_TXMD_FLAGS_LAUNCH_TIME)
+	if ((desc->flags & NET_TX_FLAGS_TS) && txtime_ref) {
+		md->meta.flags |= XDP_TXMD_FLAGS_LAUNCH_TIME;
+		md->meta.request.launch_time = txtime_ref->hw + (int32_t)(desc->ts - txtime_ref->gptp);
+	}
+#endif
+
+	return md->meta.flags ? XDP_TX_METADATA : 0;
+}
+
+static void net_xdp_tx_ts_deadline_set(struct net_xdp_ctx *ctx)
+{
+	uint64_t now;
+
+	if (os_clock_gettime64(OS_CLOCK_SYSTEM_MONOTONIC, &now) < 0)
+		now = 0;
+
+	ctx->ts_deadline = now + TX_TS_TIMEOUT;
+}
+
+static void net_xdp_tx_ts_timer_arm(struct net_xdp_ctx *ctx)
+{
+	struct itimerspec t = {
+		.it_interval = { 0, 0 },
+		.it_value = { 0, TX_TS_POLL_PERIOD },
+	};
+
+	if (timerfd_settime(ctx->ts_fd, 0, &t, NULL) < 0)
+		os_log(LOG_ERR, "timerfd_settime() failed: %s\n", strerror(errno));
+}
+#endif
+
+/*
+ * Queues up to n descriptors in the TX ring, with a single reserve/submit, at most one
+ * kernel wakeup and one completion ring cleanup. Descriptors that could not be queued
+ * are left to the caller.
+ */
+static unsigned int __net_xdp_tx_multi(struct net_tx *tx, struct net_tx_desc **desc, unsigned int n)
 {
 	struct net_xdp_ctx *ctx = (struct net_xdp_ctx *)tx->priv;
+	struct net_tx_desc *copy;
 	struct xdp_desc *tx_desc;
+	unsigned int count, i;
 	uint32_t idx;
-	unsigned int count;
+#if defined(NET_XDP_TX_METADATA)
+	struct net_xdp_txtime_ref ref, *txtime_ref = NULL;
+	unsigned int ts_pending = ctx->ts_pending;
 
-	count = xsk_ring_prod__reserve(&ctx->tx_queue, 1, &idx);
-	if (count == 0) {
+	if (ctx->umem->tx_metadata)
+		txtime_ref = net_xdp_txtime_ref_get(tx, &ref);
+#endif
+
+	umem_local = ctx->umem;
+
+	count = xsk_prod_nb_free(&ctx->tx_queue, n);
+	if (count > n)
+		count = n;
+
+	if (!count) {
 		os_log(LOG_ERR, "Tx ring full for tx(%p) queue(%d)\n", tx, ctx->umem->queue_index);
-		goto err;
+		goto out;
+	}
+
+	for (i = 0; i < count; i++) {
+		copy = net_xdp_tx_desc_to_umem(ctx->umem, desc[i]);
+		if (!copy) {
+			os_log(LOG_ERR, "Could not copy descriptor to umem for tx(%p) queue(%d)\n", tx, ctx->umem->queue_index);
+			break;
+		}
+
+		desc[i] = copy;
+	}
+
+	count = i;
+	if (!count)
+		goto out;
+
+	xsk_ring_prod__reserve(&ctx->tx_queue, count, &idx);
+
+	for (i = 0; i < count; i++) {
+		tx_desc = xsk_ring_prod__tx_desc(&ctx->tx_queue, idx + i);
+		tx_desc->addr = pool_virt_to_shmem(&ctx->umem->pool, NET_DATA_START(desc[i]));
+		tx_desc->len = desc[i]->len;
+		tx_desc->options = 0;
+#if defined(NET_XDP_TX_METADATA)
+		if (ctx->umem->tx_metadata)
+			tx_desc->options = net_xdp_tx_md_set(tx, ctx, desc[i], txtime_ref);
+#endif
 	}
 
-	tx_desc = xsk_ring_prod__tx_desc(&ctx->tx_queue, idx);
-	tx_desc->addr = pool_virt_to_shmem(&umem_buffer_pool, NET_DATA_START(desc));
-	tx_desc->len = desc->len;
-	xsk_ring_prod__submit(&ctx->tx_queue, 1);
+	xsk_ring_prod__submit(&ctx->tx_queue, count);
 
-	net_xdp_wakeup(tx->fd, &ctx->tx_queue);
+#if defined(NET_XDP_TX_METADATA)
+	if (!ts_pending && ctx->ts_pending) {
+		net_xdp_tx_ts_deadline_set(ctx);
+		net_xdp_tx_ts_timer_arm(ctx);
+	}
+#endif
 
+	net_xdp_tx_wakeup(tx->fd, &ctx->tx_queue);
+
+out:
 	net_xdp_umem_completion_cleanup(ctx->umem);
 
+	return count;
+}
+
+int net_xdp_tx(struct net_tx *tx, struct net_tx_desc *desc)
+{
+	if (__net_xdp_tx_multi(tx, &desc, 1) != 1)
+		return -1;
+
 	return 1;
-err:
-	return -1;
 }
 
 int net_xdp_tx_multi(struct net_tx *tx, struct net_tx_desc **desc, unsigned int n)
 {
-	unsigned int written = 0;
-	int i, rc;
-
-	while (written < n) {
-		rc = net_xdp_tx(tx, desc[written]);
-		if (rc < 0)
-			goto err;
+	unsigned int written;
+	int i;
 
-		written++;
-	}
+	written = __net_xdp_tx_multi(tx, desc, n);
 
-err:
 	for (i = written; i < n; i++)
 		net_xdp_tx_free(desc[i]);
 
@@ -817,6 +1342,155 @@ err:
 		return -1;
 }
 
+#if defined(NET_XDP_TX_METADATA)
+/*
+ * Transmit timestamps are returned by the kernel in the TX metadata of completed buffers.
+ * There is no file descriptor event for completions, so a timer (registered in the caller
+ * epoll) polls the COMPLETION ring while timestamps are pending.
+ */
+int net_xdp_tx_ts_get(struct net_tx *tx, uint64_t *ts, unsigned int *private)
+{
+	struct net_xdp_ctx *ctx = (struct net_xdp_ctx *)tx->priv;
+	struct net_xdp_umem *umem = ctx->umem;
+	uint64_t expirations, now;
+	int i, rc = -1;
+
+	if (read(ctx->ts_fd, &expirations, sizeof(expirations)) < 0 && (errno != EAGAIN))
+		os_log(LOG_ERR, "read() failed: %s\n", strerror(errno));
+
+	/* Another thread is recovering the transmitted buffers, retry on the next timer expiration */
+	if (!net_xdp_umem_own(&umem->completion_owner))
+		goto out;
+
+	__net_xdp_umem_completion_cleanup(umem);
+
+	for (i = 0; i < umem->tx_ts_count; i++) {
+		if (umem->tx_ts[i].tx != tx)
+			continue;
+
+		*ts = umem->tx_ts[i].ts;
+		*private = umem->tx_ts[i].private;
+
+		umem->tx_ts_count--;
+		memmove(&umem->tx_ts[i], &umem->tx_ts[i + 1], (umem->tx_ts_count - i) * sizeof(struct net_xdp_tx_ts));
+
+		rc = 1;
+		break;
+	}
+
+	net_xdp_umem_release(&umem->completion_owner);
+
+out:
+	if (rc > 0) {
+		/* May be a late timestamp, already dropped */
+		if (ctx->ts_pending) {
+			ctx->ts_pending--;
+			net_xdp_tx_ts_deadline_set(ctx);
+		}
+
+		clock_time_from_hw(tx->clock_domain, *ts, ts);
+	} else if (ctx->ts_pending) {
+		if (os_clock_gettime64(OS_CLOCK_SYSTEM_MONOTONIC, &now) < 0)
+			now = 0;
+
+		/* Frame dropped, or timestamp not reported by the driver: stop polling */
+		if (now >= ctx->ts_deadline) {
+			os_log(LOG_ERR, "net_tx(%p) %u transmit timestamp(s) not received after %u ms, dropped\n",
+				tx, ctx->ts_pending, TX_TS_TIMEOUT / 1000000);
+			ctx->ts_pending = 0;
+		} else {
+			net_xdp_tx_ts_timer_arm(ctx);
+		}
+	}
+
+	return rc;
+}
+
+int net_xdp_tx_ts_init(struct net_tx *tx, struct net_address *addr, void (*func)(struct net_tx *, uint64_t, unsigned int), unsigned long priv)
+{
+	struct net_xdp_ctx *ctx;
+	int epoll_fd = priv;
+
+	if (net_xdp_tx_init(tx, addr) < 0)
+		goto err_tx_init;
+
+	ctx = (struct net_xdp_ctx *)tx->priv;
+
+	if (!ctx->umem->tx_metadata) {
+		os_log(LOG_ERR, "net_tx(%p) transmit timestamps not supported (no TX metadata)\n", tx);
+		goto err_md;
+	}
+
+	if (net_set_hw_ts(addr->port, true) < 0) {
+		os_log(LOG_ERR, "net_set_hw_ts error\n");
+		goto err_set_ts;
+	}
+
+	ctx->ts_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+	if (ctx->ts_fd < 0) {
+		os_log(LOG_ERR, "timerfd_create() failed: %s\n", strerror(errno));
+		goto err_timer;
+	}
+
+	if (epoll_ctl_add(epoll_fd, ctx->ts_fd, EPOLL_TYPE_NET_TX_TS, tx, &tx->epoll_data, EPOLLIN) < 0) {
+		os_log(LOG_ERR, "net_tx(%p) epoll_ctl_add() failed\n", tx);
+		goto err_epoll_ctl;
+	}
+
+	tx->func_tx_ts = func;
+	tx->epoll_fd = epoll_fd;
+
+	return 0;
+
+err_epoll_ctl:
+	close(ctx->ts_fd);
+	ctx->ts_fd = -1;
+
+err_timer:
+	net_set_hw_ts(addr->port, false);
+
+err_set_ts:
+err_md:
+	net_xdp_tx_exit(tx);
+
+err_tx_init:
+	return -1;
+}
+
+int net_xdp_tx_ts_exit(struct net_tx *tx)
+{
+	struct net_xdp_ctx *ctx = (struct net_xdp_ctx *)tx->priv;
+	struct net_xdp_umem *umem = ctx->umem;
+	int i = 0;
+
+	if (epoll_ctl_del(tx->epoll_fd, ctx->ts_fd) < 0)
+		os_log(LOG_ERR, "net_tx(%p) epoll_ctl_del() failed\n", tx);
+
+	close(ctx->ts_fd);
+	ctx->ts_fd = -1;
+
+	if (net_set_hw_ts(tx->port_id, false) < 0)
+		os_log(LOG_ERR, "net_tx(%p) net_set_hw_ts() failed\n", tx);
+
+	/* Drop the timestamps not read yet */
+	net_xdp_umem_own_wait(&umem->completion_owner);
+
+	while (i < umem->tx_ts_count) {
+		if (umem->tx_ts[i].tx == tx) {
+			umem->tx_ts_count--;
+			memmove(&umem->tx_ts[i], &umem->tx_ts[i + 1], (umem->tx_ts_count - i) * sizeof(struct net_xdp_tx_ts));
+		} else {
+			i++;
+		}
+	}
+
+	net_xdp_umem_release(&umem->completion_owner);
+
+	net_xdp_tx_exit(tx);
+
+	return 0;
+}
+#else
 int net_xdp_tx_ts_get(struct net_tx *tx, uint64_t *ts, unsigned int *private)
 {
 	return -1;
@@ -824,6 +1498,8 @@ int net_xdp_tx_ts_get(struct net_tx *tx, uint64_t *ts, unsigned int *private)
 
 int net_xdp_tx_ts_init(struct net_tx *tx, struct net_address *addr, void (*func)(struct net_tx *, uint64_t, unsigned int), unsigned long priv)
 {
+	os_log(LOG_ERR, "net_tx(%p) transmit timestamps not supported (no TX metadata)\n", tx);
+
 	return -1;
 }
 
@@ -831,6 +1507,7 @@ int net_xdp_tx_ts_exit(struct net_tx *tx)
 {
 	return 0;
 }
+#endif
 
 unsigned int net_xdp_tx_available(struct net_tx *tx)
 {
@@ -845,20 +1522,21 @@ int net_xdp_port_sr_config(unsigned int port_id, uint8_t *sr_class) {
 
 void net_xdp_exit(void)
 {
-	struct list_head *entry;
-	struct net_xdp_umem *umem;
+	int i;
 
 	pthread_mutex_lock(&umem_lock);
-	entry = list_first(&umem_list);
-	while (entry != &umem_list) {
-		umem = container_of(entry, struct net_xdp_umem, list);
-		entry = list_next(entry);
-		net_xdp_umem_put(umem);
+
+	for (i = 0; i < umem_count; i++) {
+		if (umem_array[i]->refcnt)
+			net_xdp_umem_delete(umem_array[i]);
+
+		net_xdp_umem_free(umem_array[i]);
+		umem_array[i] = NULL;
 	}
-	pthread_mutex_unlock(&umem_lock);
 
-	pool_exit(&umem_buffer_pool);
-	munmap(umem_buffer_pool_area, BUF_POOL_SIZE);
+	umem_count = 0;
+
+	pthread_mutex_unlock(&umem_lock);
 }
 
 const static struct net_ops_cb net_xdp_ops = {
@@ -883,6 +1561,7 @@ const static struct net_ops_cb net_xdp_ops = {
 		.net_del_multi = net_std_del_multi,
 
 		.net_tx_alloc = net_xdp_tx_alloc,
+		.net_tx_ctx_alloc = net_xdp_tx_ctx_alloc,
 		.net_tx_alloc_multi = net_xdp_tx_alloc_multi,
 		.net_tx_clone = net_xdp_tx_clone,
 		.net_tx_free = net_xdp_tx_free,
@@ -896,22 +1575,28 @@ const static struct net_ops_cb net_xdp_ops = {
 
 int net_xdp_init(struct net_ops_cb *net_ops, struct os_xdp_config *config)
 {
-	int rc;
+	struct net_xdp_umem *umem;
+	int i;
+
+	for (i = 0; i < CFG_MAX_ENDPOINTS; i++) {
+		if ((config->endpoint_queues_rx[i] < 1) || (config->endpoint_queues_rx[i] > XDP_QUEUES_MAX)
+		|| (config->endpoint_queues_tx[i] < 1) || (config->endpoint_queues_tx[i] > XDP_QUEUES_MAX)) {
+			os_log(LOG_ERR, "endpoint(%d) invalid number of queues rx(%d) tx(%d), must be between 1 and %d\n",
+				i, config->endpoint_queues_rx[i], config->endpoint_queues_tx[i], XDP_QUEUES_MAX);
+			goto err;
+		}
+	}
+
+	os_memcpy(&xdp_config, config, sizeof(struct os_xdp_config));
 
-	list_head_init(&umem_list);
 	pthread_mutex_init(&umem_lock, NULL);
 
-	umem_buffer_pool_area = mmap(NULL, BUF_POOL_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
-	if (umem_buffer_pool_area == MAP_FAILED) {
-		os_log(LOG_ERR, "mmap() failed: %s\n", strerror(errno));
+	/* Default umem, for descriptors allocated by threads that didn't transmit yet */
+	pthread_mutex_lock(&umem_lock);
+	umem = net_xdp_umem_lookup_locked(0, xdp_config.endpoint_queue_tx[0]);
+	pthread_mutex_unlock(&umem_lock);
+	if (!umem)
 		goto err;
-	}
-
-	rc = pool_init(&umem_buffer_pool, umem_buffer_pool_area, BUF_POOL_SIZE, BUF_ORDER);
-	if (rc) {
-		os_log(LOG_ERR, "pool_init() failed with error %d\n", rc);
-		goto err_pool;
-	}
 
 	xdpkey_fd = bpf_obj_get(GENAVB_XDPKEY_NAME);
 	if (xdpkey_fd == -1) {
@@ -925,24 +1610,26 @@ int net_xdp_init(struct net_ops_cb *net_ops, struct os_xdp_config *config)
 			goto err_maps;
 		}
 	}
+
+	/* Optional, older XDP programs don't export statistics */
+	xdpstats_fd = bpf_obj_get(GENAVB_XDP_STATS_NAME);
+	if (xdpstats_fd == -1)
+		os_log(LOG_INFO, "Could not find XDP statistics map, statistics disabled\n");
+
 	memset(free_index_bmap, 0xff, sizeof(free_index_bmap));
 
 	/* We copy the entire struct rather than just point to it, to reduce the number of
 	 * indirections in performance-sensitive code.
 	 */
 	os_memcpy(net_ops, &net_xdp_ops, sizeof(struct net_ops_cb));
-	os_memcpy(&xdp_config, config, sizeof(struct os_xdp_config));
 
-	os_log(LOG_INIT, "done, using rx_queue(%d) and tx_queue(%d)\n", xdp_config.endpoint_queue_rx[0], xdp_config.endpoint_queue_tx[0]);
+	os_log(LOG_INIT, "done, using rx_queue(%d) x %d and tx_queue(%d) x %d\n", xdp_config.endpoint_queue_rx[0], xdp_config.endpoint_queues_rx[0],
+		xdp_config.endpoint_queue_tx[0], xdp_config.endpoint_queues_tx[0]);
 
 	return 0;
 
 err_maps:
-	pool_exit(&umem_buffer_pool);
-err_pool:
-	munmap(umem_buffer_pool_area, BUF_POOL_SIZE);
+	net_xdp_exit();
 err:
 	return -1;
 }
-
-
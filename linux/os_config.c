@@ -27,8 +27,12 @@
 #define CLOCK_BRIDGE_GPTP_1_DEFAULT		"sw_clock"		/* domain 1 */
 #define CLOCK_BRIDGE_LOCAL_DEFAULT		"/dev/ptp1"
 
+#define NET_STD_PACKET_MMAP_DEFAULT		0
+
 const int XDP_ENDPOINT_QUEUE_RX_DEFAULT[2] = { 0, 0 };
 const int XDP_ENDPOINT_QUEUE_TX_DEFAULT[2] = { 1, 1 };
+const int XDP_ENDPOINT_QUEUES_RX_DEFAULT[2] = { 1, 1 };
+const int XDP_ENDPOINT_QUEUES_TX_DEFAULT[2] = { 1, 1 };
 
 static int process_section_logical_port(struct _SECTIONENTRY *configtree, struct os_logical_port_config *config)
 {
@@ -75,6 +79,17 @@ err:
 	return -1;
 }
 
+static int process_section_net_std(struct _SECTIONENTRY *configtree, struct os_net_std_config *config)
+{
+	if (cfg_get_uint(configtree, "NET_STD", "packet_mmap", NET_STD_PACKET_MMAP_DEFAULT, 0, 1, &config->packet_mmap) < 0)
+		goto err;
+
+	return 0;
+
+err:
+	return -1;
+}
+
 static int process_section_xdp(struct _SECTIONENTRY *configtree, struct os_xdp_config *config)
 {
 	if (cfg_get_signed_int_list(configtree, "XDP", "endpoint_queue_rx", XDP_ENDPOINT_QUEUE_RX_DEFAULT, config->endpoint_queue_rx, CFG_MAX_ENDPOINTS) < 0)
@@ -83,6 +98,12 @@ static int process_section_xdp(struct _SECTIONENTRY *configtree, struct os_xdp_c
 	if (cfg_get_signed_int_list(configtree, "XDP", "endpoint_queue_tx", XDP_ENDPOINT_QUEUE_TX_DEFAULT, config->endpoint_queue_tx, CFG_MAX_ENDPOINTS) < 0)
 		goto err;
 
+	if (cfg_get_signed_int_list(configtree, "XDP", "endpoint_queues_rx", XDP_ENDPOINT_QUEUES_RX_DEFAULT, config->endpoint_queues_rx, CFG_MAX_ENDPOINTS) < 0)
+		goto err;
+
+	if (cfg_get_signed_int_list(configtree, "XDP", "endpoint_queues_tx", XDP_ENDPOINT_QUEUES_TX_DEFAULT, config->endpoint_queues_tx, CFG_MAX_ENDPOINTS) < 0)
+		goto err;
+
 	return 0;
 
 err:
@@ -102,6 +123,9 @@ static int process_os_config(struct os_config *config, struct _SECTIONENTRY *con
 	if (process_section_clock(configtree, &config->clock_config))
 		goto err;
 
+	if (process_section_net_std(configtree, &config->net_std_config))
+		goto err;
+
 	if (process_section_xdp(configtree, &config->xdp_config))
 		goto err;
 
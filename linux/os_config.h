@@ -19,6 +19,7 @@ typedef enum {
 	NET_AVB = 1,
 	NET_STD,
 	NET_XDP,
+	NET_STD_MMAP,
 } network_mode_t;
 
 struct os_config {
@@ -39,9 +40,15 @@ struct os_config {
 		network_mode_t net_mode;
 	} net_config;
 
+	struct os_net_std_config {
+		unsigned int packet_mmap;	/* use PACKET_MMAP rings instead of plain standard sockets */
+	} net_std_config;
+
 	struct os_xdp_config {
-		int endpoint_queue_rx[CFG_MAX_ENDPOINTS];
-		int endpoint_queue_tx[CFG_MAX_ENDPOINTS];
+		int endpoint_queue_rx[CFG_MAX_ENDPOINTS];	/* first receive queue */
+		int endpoint_queue_tx[CFG_MAX_ENDPOINTS];	/* first transmit queue */
+		int endpoint_queues_rx[CFG_MAX_ENDPOINTS];	/* number of receive queues, starting from endpoint_queue_rx */
+		int endpoint_queues_tx[CFG_MAX_ENDPOINTS];	/* number of transmit queues, starting from endpoint_queue_tx */
 	} xdp_config;
 };
 
@@ -24,10 +24,19 @@
 
 #define DEFAULT_IPC_DATA_SIZE	1024
 
+struct ipc_shm;
+
+/*
+ * With CONFIG_IPC_SHM, fd is the notification fifo (rx) or the shared memory
+ * channel (tx), mmap_baseaddr/pool_size the process local buffer pool
+ */
 struct ipc_rx {
-	int fd;
+	int fd;			/* must match struct ipc_tx */
 	void *mmap_baseaddr;
 	unsigned long pool_size;
+#ifdef CONFIG_IPC_SHM
+	struct ipc_shm *shm;
+#endif
 	int epoll_fd;
 	void (*func)(struct ipc_rx const *, struct ipc_desc *);
 	struct linux_epoll_data epoll_data;
@@ -37,6 +46,9 @@ struct ipc_tx {
 	int fd;
 	void *mmap_baseaddr;
 	unsigned long pool_size;
+#ifdef CONFIG_IPC_SHM
+	struct ipc_shm *shm;
+#endif
 };
 
 #endif /* _LINUX_OSAL_IPC_H_ */
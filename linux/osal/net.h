@@ -34,6 +34,8 @@ struct net_tx {
 	struct linux_epoll_data epoll_data;
 	u8 eth_src[6];
 	os_clock_id_t clock_domain; /* clock domain to which hw timestamps must be converted */
+	bool txtime; /* per frame launch time (SO_TXTIME) enabled */
+	unsigned int launch_offset; /* AVTP presentation time to launch time offset (ns) */
 	void *priv;
 };
 
@@ -46,6 +48,7 @@ struct net_rx {
 	struct linux_epoll_data epoll_data;
 	unsigned int batch;
 	bool is_ptp;
+	bool multi_ts;	/* net_rx_multi() must convert receive timestamps (not required by avtp) */
 	os_clock_id_t clock_domain; /* clock domain to which hw timestamps must be converted */
 	void *priv;
 };
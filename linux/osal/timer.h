@@ -21,13 +21,26 @@
 #define _LINUX_OSAL_TIMER_H_
 
 #include "osal/sys_types.h"
+#include "common/list.h"
 
 #include "epoll.h"
 
+struct timer_wheel;
+
+/*
+ * With CONFIG_TIMER_WHEEL, system timers don't have their own timerfd (fd is -1),
+ * they are queued in the timer wheel shared by all the system timers of the epoll instance
+ */
 struct os_timer {
 	int epoll_fd;
 	int fd;
 	struct linux_epoll_data epoll_data;
+#ifdef CONFIG_TIMER_WHEEL
+	struct timer_wheel *wheel;
+	struct list_head wheel_list;
+	u64 expires;
+	u64 interval;
+#endif
 
 	void (*func)(struct os_timer *t, int count);
 	void (*process)(struct os_timer *t);
@@ -12,7 +12,6 @@
  * or otherwise use the software.
  */
 
-#include <pthread.h>
 #include <errno.h>
 
 #include "os/stdlib.h"
@@ -33,7 +32,8 @@
  * The pool will contain N buffers of fixed size 2^@obj_order and aligned on buffer size.
  * The memory area used for the pool is specified by the caller using @baseaddr and @size.
  * The @pool handle is initialized in this function and must be passed to all other pool functions.
- * The pool maintains a simple linked list of free buffers.
+ * The pool maintains a simple linked list of free buffers, all functions are lock-free and
+ * can be called concurrently from any thread.
  *
  * Return: 0 on success, -1 on error.
  */
@@ -66,13 +66,11 @@ int pool_init(struct pool *pool, void *baseaddr, unsigned int size, unsigned int
 	for (i = 0; i < pool->count_total; i++)
 		pool->list[i].next = i + 1;
 
-	pool->first = 0;
 	pool->list[i - 1].next = POOL_BUFFER_NULL;
+	__atomic_store_n(&pool->head, POOL_HEAD(0, 0), __ATOMIC_RELEASE);
 
 	os_log(LOG_INIT, "pool(%p) [%p-%p], %u %u\n", pool, pool->baseaddr, (unsigned long)pool->end - 1, 1 << pool->obj_order, pool->count_total);
 
-	pthread_mutex_init(&pool->lock, NULL);
-
 	return 0;
 
 err:
@@ -90,16 +88,12 @@ void pool_exit(struct pool *pool)
 
 	os_log(LOG_INIT, "pool(%p)\n", pool);
 
-	pthread_mutex_lock(&pool->lock);
+	__atomic_store_n(&pool->head, POOL_HEAD(POOL_BUFFER_NULL, 0), __ATOMIC_RELEASE);
 
 	for (i = 0; i < pool->count_total; i++)
-		if (pool->list[i].next == POOL_BUFFER_FREE)
+		if (pool_next_get(pool, i) == POOL_BUFFER_FREE)
 			os_log(LOG_ERR, "pool(%p) buffer(%p) %d\n", pool, index_to_addr(pool, i), i);
 
-	pool->first = POOL_BUFFER_NULL;
-
-	pthread_mutex_unlock(&pool->lock);
-
 	os_free(pool->list);
 }
 
@@ -115,6 +109,19 @@ void *pool_alloc(struct pool *pool)
 	return __pool_alloc(pool);
 }
 
+/**
+ * pool_alloc_multi() - Allocates several buffers from the pool
+ * @pool: pointer to the pool handle
+ * @addr: array of kernel virtual buffer addresses, filled by the function
+ * @n: number of buffers to allocate
+ *
+ * Return: number of buffers allocated (may be less than @n), -ENOMEM if the pool is empty.
+ */
+int pool_alloc_multi(struct pool *pool, void **addr, unsigned int n)
+{
+	return __pool_alloc_array(pool, addr, n);
+}
+
 int pool_alloc_shmem(struct pool *pool, unsigned long *addr_shmem)
 {
 	void *addr = __pool_alloc(pool);
@@ -138,6 +145,18 @@ int pool_free(struct pool *pool, void *addr)
 	return __pool_free(pool, addr);
 }
 
+/**
+ * pool_free_multi() - Frees several buffers to the pool
+ * @pool: pointer to the pool handle
+ * @addr: array of kernel virtual buffer addresses to free
+ * @n: number of buffers to free
+ *
+ */
+void pool_free_multi(struct pool *pool, void **addr, unsigned int n)
+{
+	__pool_free_array(pool, addr, n);
+}
+
 void pool_free_shmem(struct pool *pool, unsigned long addr_shmem)
 {
 	void *addr = pool_shmem_to_virt(pool, addr_shmem);
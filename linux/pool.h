@@ -15,7 +15,7 @@
 #ifndef _POOL_H_
 #define _POOL_H_
 
-#include <pthread.h>
+#include <stdint.h>
 #include <errno.h>
 
 #include "common/log.h"
@@ -24,13 +24,25 @@
 #define POOL_BUFFER_FREE	(1 << 16) /* must be outside valid range, above POOL_COUNT_MAX */
 #define POOL_BUFFER_NULL	(1 << 17) /* must be outside valid range, above POOL_COUNT_MAX */
 
+#define POOL_BUFFER_PENDING	(1 << 18) /* must be outside valid range, above POOL_COUNT_MAX */
+
 struct buffer_list {
 	unsigned int next;
 };
 
+/*
+ * The free list is a lock-free (Treiber) stack. The head holds the index of the first free
+ * buffer in the low 32 bits and a tag, incremented on every update, in the high 32 bits.
+ * The tag protects against ABA: a head that didn't change between load and compare-and-swap
+ * guarantees that no other alloc/free completed in between, so that the chain of next indexes
+ * read meanwhile is consistent.
+ */
+#define POOL_HEAD(index, tag)	(((uint64_t)(tag) << 32) | (index))
+#define POOL_HEAD_INDEX(head)	((unsigned int)((head) & 0xffffffff))
+#define POOL_HEAD_TAG(head)	((unsigned int)((head) >> 32))
+
 struct pool {
-	unsigned int first;
-	pthread_mutex_t lock;
+	uint64_t head;
 	void *baseaddr;
 	void *end;
 	unsigned int count_total;
@@ -49,6 +61,9 @@ int pool_free(struct pool *, void *);
 void pool_free_shmem(struct pool *pool, unsigned long addr_shmem);
 void pool_free_virt(void *pool, unsigned long entry);
 
+int pool_alloc_multi(struct pool *pool, void **addr, unsigned int n);
+void pool_free_multi(struct pool *pool, void **addr, unsigned int n);
+
 /**
  * pool_align() - Align an address to the nearest previous pool object boundary
  * @pool: pointer to the pool handle
@@ -106,119 +121,152 @@ static inline unsigned int addr_error(struct pool *pool, void *addr)
 	return 0;
 }
 
+static inline unsigned int pool_next_get(struct pool *pool, unsigned int index)
+{
+	return __atomic_load_n(&pool->list[index].next, __ATOMIC_RELAXED);
+}
+
+static inline void pool_next_set(struct pool *pool, unsigned int index, unsigned int next)
+{
+	__atomic_store_n(&pool->list[index].next, next, __ATOMIC_RELAXED);
+}
+
 /**
- * __pool_alloc_locked() - Allocates one buffer from the pool
+ * __pool_alloc_array() - Allocates up to n buffers from the pool
  * @pool: pointer to the pool handle
+ * @addr: array of kernel virtual buffer addresses, filled by the function
+ * @n: number of buffers to allocate
  *
- * The caller needs to hold the pool lock
+ * Lock-free, the buffers are removed from the free list with a single compare-and-swap.
  *
- * Return: kernel virtual buffer address, or NULL if the pool is empty.
+ * Return: number of buffers allocated, -ENOMEM if the pool is empty.
  */
-static inline void *__pool_alloc_locked(struct pool *pool)
+static inline int __pool_alloc_array(struct pool *pool, void **addr, unsigned int n)
 {
-	unsigned int first = pool->first;
-	void *addr;
+	uint64_t head, new;
+	unsigned int first, next;
+	unsigned int i, j;
 
-	if (unlikely(first == POOL_BUFFER_NULL)) {
-		os_log(LOG_INFO, "pool(%p) empty\n", pool);
-		return NULL;
-	}
+	if (unlikely(!n))
+		return 0;
 
-	addr = index_to_addr(pool, first);
-	pool->first = pool->list[first].next;
-	pool->list[first].next = POOL_BUFFER_FREE;
+	head = __atomic_load_n(&pool->head, __ATOMIC_ACQUIRE);
 
-	return addr;
-}
+	do {
+		first = POOL_HEAD_INDEX(head);
+		if (unlikely(first == POOL_BUFFER_NULL)) {
+			os_log(LOG_INFO, "pool(%p) empty\n", pool);
+			return -ENOMEM;
+		}
 
-static inline void *__pool_alloc(struct pool *pool)
-{
-	void *addr;
+		next = first;
+		for (i = 0; i < n; i++) {
+			addr[i] = index_to_addr(pool, next);
 
-	pthread_mutex_lock(&pool->lock);
+			next = pool_next_get(pool, next);
 
-	addr = __pool_alloc_locked(pool);
+			/* The list changed under us (and the compare-and-swap will fail), or end of list */
+			if (unlikely(next >= pool->count_total)) {
+				next = POOL_BUFFER_NULL;
+				i++;
+				break;
+			}
+		}
 
-	pthread_mutex_unlock(&pool->lock);
+		new = POOL_HEAD(next, POOL_HEAD_TAG(head) + 1);
+	} while (!__atomic_compare_exchange_n(&pool->head, &head, new, true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
 
-	return addr;
+	/* The buffers are now owned by the caller, mark them for double free detection */
+	for (j = 0; j < i; j++)
+		pool_next_set(pool, addr_to_index(pool, addr[j]), POOL_BUFFER_FREE);
+
+	return i;
 }
 
-static inline int __pool_alloc_array(struct pool *pool, void **addr, unsigned int n)
+static inline void *__pool_alloc(struct pool *pool)
 {
-	int i;
-
-	pthread_mutex_lock(&pool->lock);
-
-	for (i = 0; i < n; i++) {
-		addr[i] = __pool_alloc_locked(pool);
-		if (unlikely(!addr[i])) {
-			if (!i)
-				i = -ENOMEM;
-
-			break;
-		}
-	}
+	void *addr;
 
-	pthread_mutex_unlock(&pool->lock);
+	if (__pool_alloc_array(pool, &addr, 1) < 0)
+		return NULL;
 
-	return i;
+	return addr;
 }
 
-
 /**
- * __pool_free_locked() - Frees one buffer to the pool
+ * __pool_free_check() - Takes ownership of a buffer being freed
  * @pool: pointer to the pool handle
  * @addr: kernel virtual buffer address to free
  *
- * The caller needs to hold the pool lock. The function performs some sanity checks
- * to determine if the buffer belongs to the pool.
+ * The function performs some sanity checks to determine if the buffer belongs to the pool,
+ * and if it's not already free (or being freed concurrently).
  *
+ * Return: buffer index, or POOL_BUFFER_NULL on error.
  */
-static inline int __pool_free_locked(struct pool *pool, void *addr)
+static inline unsigned int __pool_free_check(struct pool *pool, void *addr)
 {
-	unsigned int index;
+	unsigned int index, expected = POOL_BUFFER_FREE;
 
 	if (unlikely(addr_error(pool, addr)))
-		return -EFAULT;
+		return POOL_BUFFER_NULL;
 
 	index = addr_to_index(pool, addr);
 
-	if (unlikely(pool->list[index].next != POOL_BUFFER_FREE)) {
+	if (unlikely(!__atomic_compare_exchange_n(&pool->list[index].next, &expected, POOL_BUFFER_PENDING, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))) {
 		os_log(LOG_ERR, "pool(%p) double free error, buffer(%p)\n", pool, addr);
-		return -EFAULT;
+		return POOL_BUFFER_NULL;
 	}
 
-	pool->list[index].next = pool->first;
-	pool->first = index;
+	return index;
+}
 
-	return 0;
+/* Pushes the chain of buffers [first, ..., last] to the free list, with a single compare-and-swap */
+static inline void __pool_free_chain(struct pool *pool, unsigned int first, unsigned int last)
+{
+	uint64_t head = __atomic_load_n(&pool->head, __ATOMIC_RELAXED);
+	uint64_t new;
+
+	do {
+		pool_next_set(pool, last, POOL_HEAD_INDEX(head));
+
+		new = POOL_HEAD(first, POOL_HEAD_TAG(head) + 1);
+	} while (!__atomic_compare_exchange_n(&pool->head, &head, new, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
 }
 
 static inline int __pool_free(struct pool *pool, void *addr)
 {
-	int rc;
-
-	pthread_mutex_lock(&pool->lock);
+	unsigned int index;
 
-	rc = __pool_free_locked(pool, addr);
+	index = __pool_free_check(pool, addr);
+	if (unlikely(index == POOL_BUFFER_NULL))
+		return -EFAULT;
 
-	pthread_mutex_unlock(&pool->lock);
+	__pool_free_chain(pool, index, index);
 
-	return rc;
+	return 0;
 }
 
 static inline void __pool_free_array(struct pool *pool, void **addr, unsigned int n)
 {
+	unsigned int first = POOL_BUFFER_NULL, last = POOL_BUFFER_NULL;
+	unsigned int index;
 	int i;
 
-	pthread_mutex_lock(&pool->lock);
+	for (i = 0; i < n; i++) {
+		index = __pool_free_check(pool, addr[i]);
+		if (unlikely(index == POOL_BUFFER_NULL))
+			continue;
 
-	for (i = 0; i < n; i++)
-		__pool_free_locked(pool, addr[i]);
+		if (last == POOL_BUFFER_NULL)
+			last = index;
+		else
+			pool_next_set(pool, index, first);
 
-	pthread_mutex_unlock(&pool->lock);
-}
+		first = index;
+	}
 
+	if (first != POOL_BUFFER_NULL)
+		__pool_free_chain(pool, first, last);
+}
 
 #endif /* _POOL_H_ */
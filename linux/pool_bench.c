@@ -0,0 +1,311 @@
+/*
+* Copyright 2021 NXP
+*
+* NXP Confidential. This software is owned or controlled by NXP and may only
+* be used strictly in accordance with the applicable license terms.  By expressly
+* accepting such terms or by downloading, installing, activating and/or otherwise
+* using the software, you are agreeing that you have read, and that you agree to
+* comply with and are bound by, such license terms.  If you do not agree to be
+* bound by the applicable license terms, then you may not retain, install, activate
+* or otherwise use the software.
+*/
+
+/**
+ @file
+ @brief GenAVB buffer pool stress test and benchmark
+ @details Several threads allocate and free random bursts of buffers from the same pool, with single
+ and bulk calls. Each thread tags the buffers it owns and checks the tags before freeing them, so that
+ a buffer handed out twice is detected. Once all threads are done, the pool must hold all its buffers
+ again. The cost per buffer (alloc + free) is reported for each thread, optionally with all pool calls
+ serialized by a mutex for comparison.
+ Runs on a plain Linux host, no stack or driver needed.
+*/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "common/log.h"
+
+#include "pool.h"
+
+#define BENCH_THREADS_MAX	64
+#define BENCH_BURST_MAX		64
+#define BENCH_OBJ_ORDER		7
+
+struct bench_thread {
+	pthread_t thread;
+	unsigned int id;
+	unsigned int seed;
+
+	uint64_t buffers;
+	uint64_t empty;
+	uint64_t errors;
+	uint64_t time;
+};
+
+static struct pool bench_pool;
+static pthread_barrier_t bench_barrier;
+static pthread_mutex_t bench_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned int bench_locked = 0;
+static unsigned int bench_burst = 8;
+static unsigned int bench_iterations = 1000000;
+
+static void print_usage(void)
+{
+	printf("\nUsage:\n genavb-pool-bench [options]\n");
+	printf("\nOptions:\n"
+		"\t-t <threads>          number of threads (default 4, max %u)\n"
+		"\t-n <iterations>       number of alloc/free bursts per thread (default 1000000)\n"
+		"\t-b <burst>            maximum number of buffers per burst (default 8, max %u)\n"
+		"\t-c <count>            number of buffers in the pool (default 1024)\n"
+		"\t-l                    serialize all pool calls with a mutex (reference)\n"
+		"\t-h                    print this help text\n", BENCH_THREADS_MAX, BENCH_BURST_MAX);
+}
+
+static uint64_t bench_time(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t)now.tv_sec * NSECS_PER_SEC + now.tv_nsec;
+}
+
+static int bench_alloc(void **buf, unsigned int n)
+{
+	int rc;
+
+	if (bench_locked)
+		pthread_mutex_lock(&bench_lock);
+
+	if (n == 1) {
+		buf[0] = pool_alloc(&bench_pool);
+		rc = buf[0] ? 1 : -ENOMEM;
+	} else {
+		rc = pool_alloc_multi(&bench_pool, buf, n);
+	}
+
+	if (bench_locked)
+		pthread_mutex_unlock(&bench_lock);
+
+	return rc;
+}
+
+static void bench_free(void **buf, unsigned int n)
+{
+	if (bench_locked)
+		pthread_mutex_lock(&bench_lock);
+
+	if (n == 1)
+		pool_free(&bench_pool, buf[0]);
+	else
+		pool_free_multi(&bench_pool, buf, n);
+
+	if (bench_locked)
+		pthread_mutex_unlock(&bench_lock);
+}
+
+static void *bench_thread_main(void *arg)
+{
+	struct bench_thread *t = arg;
+	void *buf[BENCH_BURST_MAX];
+	uint64_t tag, start;
+	unsigned int i, j, n;
+	int rc;
+
+	pthread_barrier_wait(&bench_barrier);
+
+	start = bench_time();
+
+	for (i = 0; i < bench_iterations; i++) {
+		n = 1 + rand_r(&t->seed) % bench_burst;
+
+		rc = bench_alloc(buf, n);
+		if (rc < 0) {
+			t->empty++;
+			continue;
+		}
+
+		/* Tag the buffers, then check no other thread wrote them meanwhile */
+		tag = ((uint64_t)t->id << 32) | i;
+
+		for (j = 0; j < rc; j++)
+			*(volatile uint64_t *)buf[j] = tag + j;
+
+		for (j = 0; j < rc; j++)
+			if (*(volatile uint64_t *)buf[j] != (tag + j))
+				t->errors++;
+
+		bench_free(buf, rc);
+
+		t->buffers += rc;
+	}
+
+	t->time = bench_time() - start;
+
+	return NULL;
+}
+
+/* All threads are done, all buffers must be back in the pool, exactly once */
+static int bench_check(unsigned int count)
+{
+	unsigned char *seen;
+	void **buf;
+	unsigned int total = 0, index;
+	int rc, i, err = 0;
+
+	seen = calloc(count, 1);
+	buf = malloc((count + 1) * sizeof(void *));
+	if (!seen || !buf) {
+		printf("allocation failed\n");
+		err = -1;
+		goto out;
+	}
+
+	while (total <= count) {
+		rc = pool_alloc_multi(&bench_pool, &buf[total], count + 1 - total);
+		if (rc <= 0)
+			break;
+
+		for (i = 0; i < rc; i++) {
+			index = addr_to_index(&bench_pool, buf[total + i]);
+			if (seen[index]) {
+				printf("buffer %u allocated twice\n", index);
+				err = -1;
+			}
+
+			seen[index] = 1;
+		}
+
+		total += rc;
+	}
+
+	if (total != count) {
+		printf("%u buffers in the pool after the test, expected %u\n", total, count);
+		err = -1;
+	}
+
+	pool_free_multi(&bench_pool, buf, total);
+
+out:
+	free(buf);
+	free(seen);
+
+	return err;
+}
+
+int main(int argc, char *argv[])
+{
+	struct bench_thread thread[BENCH_THREADS_MAX];
+	unsigned int threads = 4, count = 1024;
+	uint64_t buffers = 0, errors = 0, empty = 0, time = 0;
+	unsigned int i;
+	void *mem;
+	int option, rc = 1;
+
+	while ((option = getopt(argc, argv, "t:n:b:c:lh")) != -1) {
+		switch (option) {
+		case 't':
+			threads = strtoul(optarg, NULL, 0);
+			break;
+
+		case 'n':
+			bench_iterations = strtoul(optarg, NULL, 0);
+			break;
+
+		case 'b':
+			bench_burst = strtoul(optarg, NULL, 0);
+			break;
+
+		case 'c':
+			count = strtoul(optarg, NULL, 0);
+			break;
+
+		case 'l':
+			bench_locked = 1;
+			break;
+
+		case 'h':
+		default:
+			print_usage();
+			return 0;
+		}
+	}
+
+	if (!threads || (threads > BENCH_THREADS_MAX) || !bench_burst || (bench_burst > BENCH_BURST_MAX) || !bench_iterations
+	    || !count || (count > POOL_COUNT_MAX)) {
+		print_usage();
+		return 1;
+	}
+
+	/* The pool aligns the base address on the buffer size */
+	if (posix_memalign(&mem, 1 << BENCH_OBJ_ORDER, count << BENCH_OBJ_ORDER)) {
+		printf("posix_memalign() failed\n");
+		goto err_malloc;
+	}
+
+	if (pool_init(&bench_pool, mem, count << BENCH_OBJ_ORDER, BENCH_OBJ_ORDER) < 0) {
+		printf("pool_init() failed\n");
+		goto err_pool;
+	}
+
+	if (pthread_barrier_init(&bench_barrier, NULL, threads)) {
+		printf("pthread_barrier_init() failed\n");
+		goto err_barrier;
+	}
+
+	for (i = 0; i < threads; i++) {
+		memset(&thread[i], 0, sizeof(thread[i]));
+		thread[i].id = i;
+		thread[i].seed = i + 1;
+
+		if (pthread_create(&thread[i].thread, NULL, bench_thread_main, &thread[i])) {
+			printf("pthread_create() failed\n");
+			/* The barrier can't complete, the process exits */
+			exit(1);
+		}
+	}
+
+	for (i = 0; i < threads; i++) {
+		pthread_join(thread[i].thread, NULL);
+
+		printf("thread %2u: %llu buffers, %llu ns per buffer (alloc + free), %llu empty, %llu errors\n", i,
+			(unsigned long long)thread[i].buffers,
+			(unsigned long long)(thread[i].buffers ? thread[i].time / thread[i].buffers : 0),
+			(unsigned long long)thread[i].empty, (unsigned long long)thread[i].errors);
+
+		buffers += thread[i].buffers;
+		errors += thread[i].errors;
+		empty += thread[i].empty;
+		if (thread[i].time > time)
+			time = thread[i].time;
+	}
+
+	printf("%s pool, %u threads, %u buffers, bursts of 1-%u: %llu buffers/s, %llu empty, %llu errors\n",
+		bench_locked ? "locked" : "lock-free", threads, count, bench_burst,
+		(unsigned long long)(time ? buffers * NSECS_PER_SEC / time : 0),
+		(unsigned long long)empty, (unsigned long long)errors);
+
+	if (bench_check(count) < 0 || errors)
+		printf("FAILED\n");
+	else
+		rc = 0;
+
+	pthread_barrier_destroy(&bench_barrier);
+
+err_barrier:
+	pool_exit(&bench_pool);
+
+err_pool:
+	free(mem);
+
+err_malloc:
+	return rc;
+}
@@ -30,6 +30,7 @@
 #include "common/timer.h"
 
 #include "timer_media.h"
+#include "timer_wheel.h"
 #include "epoll.h"
 
 static void u64_to_timespec(struct timespec *ts, u64 timeout)
@@ -144,6 +145,22 @@ int os_timer_create(struct os_timer *t, os_clock_id_t id, unsigned int flags, vo
 
 	switch (id) {
 	case OS_CLOCK_SYSTEM_MONOTONIC_COARSE:
+		if (timer_wheel_enabled()) {
+			/* Software timer, sharing a single timerfd with the other system timers of the epoll instance */
+			if (timer_wheel_create(t, CLOCK_MONOTONIC, priv) < 0)
+				goto err_create;
+
+			t->start = timer_wheel_start;
+			t->stop = timer_wheel_stop;
+			t->process = NULL;
+			t->destroy = timer_wheel_destroy;
+			t->func = func;
+
+			os_log(LOG_INFO, "os_timer(%p), timer wheel, epoll_fd: %d\n", t, t->epoll_fd);
+
+			return 0;
+		}
+
 		fd = timer_system_create(t, CLOCK_MONOTONIC);
 		t->start = timer_system_start;
 		t->stop = timer_system_stop;
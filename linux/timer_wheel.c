@@ -0,0 +1,509 @@
+/*
+* Copyright 2021 NXP
+*
+* NXP Confidential. This software is owned or controlled by NXP and may only
+* be used strictly in accordance with the applicable license terms.  By expressly
+* accepting such terms or by downloading, installing, activating and/or otherwise
+* using the software, you are agreeing that you have read, and that you agree to
+* comply with and are bound by, such license terms.  If you do not agree to be
+* bound by the applicable license terms, then you may not retain, install, activate
+* or otherwise use the software.
+*/
+
+/**
+ @file
+ @brief Linux specific timer wheel service implementation
+ @details
+ All the system timers created with the same epoll instance are software timers queued in a
+ hierarchical timer wheel, driven by a single timerfd armed to the next expiration.
+ Timer start and stop are O(1) and don't require any system call, unless the timer becomes the
+ next one to expire. Expirations falling within the configured slack are processed by a single
+ wakeup.
+
+ The wheel has a first level of 256 slots of one tick (~1ms) each, followed by three levels of
+ 64 slots, each slot covering the full range of the previous level. Timers are moved to the
+ lower levels (cascaded) as time advances, so that they end up in the first level slot of their
+ expiration tick. Timers keep their exact expiration time, the tick is only used to select
+ the slot.
+
+ Like the timerfd based timers, the timers of a given wheel must only be used from the thread
+ handling the epoll instance.
+*/
+
+#define _GNU_SOURCE
+
+#include <sys/timerfd.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "common/log.h"
+#include "common/timer.h"
+
+#include "timer_wheel.h"
+#include "epoll.h"
+
+#define TIMER_WHEEL_TICK_SHIFT		20	/* 1.048576 ms */
+#define TIMER_WHEEL_L0_BITS		8
+#define TIMER_WHEEL_LN_BITS		6
+#define TIMER_WHEEL_L0_SIZE		(1 << TIMER_WHEEL_L0_BITS)
+#define TIMER_WHEEL_LN_SIZE		(1 << TIMER_WHEEL_LN_BITS)
+#define TIMER_WHEEL_LEVELS		4
+
+/* Shift of the slot index, in ticks, for level l >= 1 */
+#define TIMER_WHEEL_LEVEL_SHIFT(l)	(TIMER_WHEEL_L0_BITS + ((l) - 1) * TIMER_WHEEL_LN_BITS)
+
+/* Timers further away are queued in the last level and cascaded again */
+#define TIMER_WHEEL_MAX_DELTA		((1ULL << TIMER_WHEEL_LEVEL_SHIFT(TIMER_WHEEL_LEVELS)) - 1)
+
+#define TIMER_WHEEL_NONE		UINT64_MAX
+
+struct timer_wheel {
+	struct os_timer base;		/* timerfd registered in the epoll instance */
+	struct list_head list;
+	clockid_t id;
+	unsigned int users;
+	unsigned int pending;		/* timers queued in the wheel or expired but not yet processed */
+	int processing;
+	u64 tick;			/* current tick, all timers expiring before are processed */
+	u64 armed;			/* timerfd expiration time (ns), TIMER_WHEEL_NONE if disarmed */
+
+	struct list_head l0[TIMER_WHEEL_L0_SIZE];
+	struct list_head ln[TIMER_WHEEL_LEVELS - 1][TIMER_WHEEL_LN_SIZE];
+};
+
+static struct list_head timer_wheel_list = {&timer_wheel_list, &timer_wheel_list};
+static pthread_mutex_t timer_wheel_lock = PTHREAD_MUTEX_INITIALIZER;
+static u64 timer_wheel_slack = (u64)CFG_TIMER_SLACK_DEFAULT * 1000;
+
+void timer_wheel_slack_set(u64 slack)
+{
+	timer_wheel_slack = slack;
+}
+
+static u64 timer_wheel_now(struct timer_wheel *w)
+{
+	struct timespec now;
+
+	clock_gettime(w->id, &now);
+
+	return (u64)now.tv_sec * NSECS_PER_SEC + now.tv_nsec;
+}
+
+static void timer_wheel_arm(struct timer_wheel *w, u64 when)
+{
+	struct itimerspec new_value = {0, };
+
+	if (when == w->armed)
+		return;
+
+	/* A zero it_value disarms the timerfd */
+	if (when != TIMER_WHEEL_NONE) {
+		if (!when)
+			when = 1;
+
+		new_value.it_value.tv_sec = when / NSECS_PER_SEC;
+		new_value.it_value.tv_nsec = when - new_value.it_value.tv_sec * NSECS_PER_SEC;
+	}
+
+	if (timerfd_settime(w->base.fd, TFD_TIMER_ABSTIME, &new_value, NULL) < 0) {
+		os_log(LOG_ERR, "timer_wheel(%p), timerfd_settime() %s\n", w, strerror(errno));
+		return;
+	}
+
+	w->armed = when;
+}
+
+/* Queues the timer in the slot matching its expiration, relative to the current tick.
+ * Returns the time (ns) at which the wheel must be processed for this timer.
+ */
+static u64 timer_wheel_add(struct timer_wheel *w, struct os_timer *t)
+{
+	u64 expires = t->expires >> TIMER_WHEEL_TICK_SHIFT;
+	u64 delta;
+	unsigned int l;
+
+	if (expires < w->tick)
+		expires = w->tick;
+
+	delta = expires - w->tick;
+
+	if (delta < TIMER_WHEEL_L0_SIZE) {
+		list_add_tail(&w->l0[expires & (TIMER_WHEEL_L0_SIZE - 1)], &t->wheel_list);
+
+		return t->expires + timer_wheel_slack;
+	}
+
+	if (delta > TIMER_WHEEL_MAX_DELTA) {
+		delta = TIMER_WHEEL_MAX_DELTA;
+		expires = w->tick + delta;
+	}
+
+	for (l = 1; delta >= (1ULL << TIMER_WHEEL_LEVEL_SHIFT(l + 1)); l++)
+		;
+
+	list_add_tail(&w->ln[l - 1][(expires >> TIMER_WHEEL_LEVEL_SHIFT(l)) & (TIMER_WHEEL_LN_SIZE - 1)], &t->wheel_list);
+
+	/* Slot is cascaded when the tick reaches its start */
+	return (expires & ~((1ULL << TIMER_WHEEL_LEVEL_SHIFT(l)) - 1)) << TIMER_WHEEL_TICK_SHIFT;
+}
+
+/* Returns the first tick, after the current one, at which a non empty slot of the upper levels is cascaded */
+static u64 timer_wheel_next_cascade(struct timer_wheel *w)
+{
+	u64 next = TIMER_WHEEL_NONE;
+	u64 start, tick;
+	unsigned int l, shift, i;
+
+	for (l = 1; l < TIMER_WHEEL_LEVELS; l++) {
+		shift = TIMER_WHEEL_LEVEL_SHIFT(l);
+		start = ((w->tick >> shift) + 1) << shift;
+
+		for (i = 0; i < TIMER_WHEEL_LN_SIZE; i++) {
+			tick = start + ((u64)i << shift);
+
+			if (tick >= next)
+				break;
+
+			if (!list_empty(&w->ln[l - 1][(tick >> shift) & (TIMER_WHEEL_LN_SIZE - 1)])) {
+				next = tick;
+				break;
+			}
+		}
+	}
+
+	return next;
+}
+
+/* Returns the first tick, after the current one, with timers to expire or cascade */
+static u64 timer_wheel_next_tick(struct timer_wheel *w)
+{
+	u64 next = timer_wheel_next_cascade(w);
+	u64 tick;
+	unsigned int i;
+
+	for (i = 1; i < TIMER_WHEEL_L0_SIZE; i++) {
+		tick = w->tick + i;
+
+		if (tick >= next)
+			break;
+
+		if (!list_empty(&w->l0[tick & (TIMER_WHEEL_L0_SIZE - 1)]))
+			return tick;
+	}
+
+	return next;
+}
+
+/* Returns the time (ns) at which the wheel must be processed next */
+static u64 timer_wheel_next_expiry(struct timer_wheel *w)
+{
+	struct list_head *slot, *entry;
+	struct os_timer *t;
+	u64 next, expires = TIMER_WHEEL_NONE;
+	unsigned int i;
+
+	next = timer_wheel_next_cascade(w);
+	if (next != TIMER_WHEEL_NONE)
+		next <<= TIMER_WHEEL_TICK_SHIFT;
+
+	for (i = 0; i < TIMER_WHEEL_L0_SIZE; i++) {
+		slot = &w->l0[(w->tick + i) & (TIMER_WHEEL_L0_SIZE - 1)];
+
+		if (list_empty(slot))
+			continue;
+
+		for (entry = list_first(slot); entry != slot; entry = list_next(entry)) {
+			t = container_of(entry, struct os_timer, wheel_list);
+
+			if (t->expires < expires)
+				expires = t->expires;
+		}
+
+		expires += timer_wheel_slack;
+		if (expires < next)
+			next = expires;
+
+		break;
+	}
+
+	return next;
+}
+
+static void timer_wheel_cascade(struct timer_wheel *w, unsigned int l)
+{
+	struct list_head *slot = &w->ln[l - 1][(w->tick >> TIMER_WHEEL_LEVEL_SHIFT(l)) & (TIMER_WHEEL_LN_SIZE - 1)];
+	struct list_head *entry;
+
+	while (!list_empty(slot)) {
+		entry = list_first(slot);
+		list_del(entry);
+
+		timer_wheel_add(w, container_of(entry, struct os_timer, wheel_list));
+	}
+}
+
+/* Moves the timers of the current tick expired at time now to the expired list */
+static void timer_wheel_tick(struct timer_wheel *w, u64 now, struct list_head *expired)
+{
+	struct list_head *slot, *entry, *next;
+	struct os_timer *t;
+	unsigned int l;
+
+	if (!(w->tick & (TIMER_WHEEL_L0_SIZE - 1))) {
+		for (l = 1; l < TIMER_WHEEL_LEVELS; l++) {
+			timer_wheel_cascade(w, l);
+
+			if ((w->tick >> TIMER_WHEEL_LEVEL_SHIFT(l)) & (TIMER_WHEEL_LN_SIZE - 1))
+				break;
+		}
+	}
+
+	slot = &w->l0[w->tick & (TIMER_WHEEL_L0_SIZE - 1)];
+
+	for (entry = list_first(slot); entry != slot; entry = next) {
+		next = list_next(entry);
+		t = container_of(entry, struct os_timer, wheel_list);
+
+		if (t->expires <= now) {
+			list_del(entry);
+			list_add_tail(expired, entry);
+		}
+	}
+}
+
+static void timer_wheel_free(struct timer_wheel *w)
+{
+	epoll_ctl_del(w->base.epoll_fd, w->base.fd);
+	close(w->base.fd);
+	free(w);
+}
+
+static void timer_wheel_process(struct os_timer *base)
+{
+	struct timer_wheel *w = container_of(base, struct timer_wheel, base);
+	struct list_head expired, *entry;
+	struct os_timer *t;
+	u64 now, now_tick, next, count;
+	int rc;
+
+	rc = read(base->fd, &count, sizeof(count));
+	if (rc == sizeof(count))
+		w->armed = TIMER_WHEEL_NONE;
+	else if (rc < 0 && errno != EAGAIN)
+		os_log(LOG_ERR, "timer_wheel(%p): error %d(%s) reading from timer\n", w, errno, strerror(errno));
+
+	now = timer_wheel_now(w);
+	now_tick = now >> TIMER_WHEEL_TICK_SHIFT;
+
+	list_head_init(&expired);
+
+	/* Advance up to the current tick, skipping the ticks without timers */
+	while (1) {
+		timer_wheel_tick(w, now, &expired);
+
+		if (w->tick >= now_tick)
+			break;
+
+		next = timer_wheel_next_tick(w);
+		if (next > now_tick)
+			next = now_tick;
+
+		w->tick = next;
+	}
+
+	/* Timers may be started, stopped or destroyed from the callbacks */
+	w->processing = 1;
+
+	while (!list_empty(&expired)) {
+		entry = list_first(&expired);
+		list_del(entry);
+		t = container_of(entry, struct os_timer, wheel_list);
+
+		count = 1;
+
+		if (t->interval) {
+			count += (now - t->expires) / t->interval;
+			t->expires += count * t->interval;
+			timer_wheel_add(w, t);
+		} else {
+			w->pending--;
+		}
+
+		t->func(t, (int)count);
+	}
+
+	w->processing = 0;
+
+	/* Last timer destroyed from a callback */
+	if (!w->users) {
+		timer_wheel_free(w);
+		return;
+	}
+
+	timer_wheel_arm(w, timer_wheel_next_expiry(w));
+}
+
+int timer_wheel_start(struct os_timer *t, u64 value, u64 interval_p, u64 interval_q, unsigned int flags)
+{
+	struct timer_wheel *w = t->wheel;
+	u64 now, when;
+
+	/* No support for rational period */
+	if (interval_p && (interval_q != 1))
+		goto err;
+
+	/* Use stop instead */
+	if (!value && !interval_p)
+		goto err;
+
+	timer_wheel_stop(t);
+
+	now = timer_wheel_now(w);
+
+	/* Nothing queued, move the wheel to the current time */
+	if (!w->pending)
+		w->tick = now >> TIMER_WHEEL_TICK_SHIFT;
+
+	/* For periodic timer, first expiration at the end of the first period */
+	value += interval_p;
+
+	if (!(flags & OS_TIMER_FLAGS_ABSOLUTE))
+		value += now;
+
+	t->expires = value;
+	t->interval = interval_p;
+
+	when = timer_wheel_add(w, t);
+	w->pending++;
+
+	/* Wheel is armed at the end of processing */
+	if (!w->processing && (when < w->armed))
+		timer_wheel_arm(w, when);
+
+	return 0;
+
+err:
+	return -1;
+}
+
+void timer_wheel_stop(struct os_timer *t)
+{
+	if (!t->wheel_list.next)
+		return;
+
+	list_del(&t->wheel_list);
+	t->wheel->pending--;
+}
+
+static struct timer_wheel *timer_wheel_alloc(clockid_t id, int epoll_fd)
+{
+	struct timer_wheel *w;
+	unsigned int i, l;
+
+	w = calloc(1, sizeof(*w));
+	if (!w)
+		goto err_alloc;
+
+	w->base.fd = timerfd_create(id, TFD_NONBLOCK);
+	if (w->base.fd < 0) {
+		os_log(LOG_ERR, "timer_wheel(%p), timerfd_create(%u) %s\n", w, id, strerror(errno));
+		goto err_create;
+	}
+
+	w->base.epoll_fd = epoll_fd;
+	w->base.process = timer_wheel_process;
+
+	if (epoll_ctl_add(epoll_fd, w->base.fd, EPOLL_TYPE_TIMER, &w->base, &w->base.epoll_data, EPOLLIN) < 0) {
+		os_log(LOG_ERR, "timer_wheel(%p), epoll_ctl_add() failed\n", w);
+		goto err_add;
+	}
+
+	for (i = 0; i < TIMER_WHEEL_L0_SIZE; i++)
+		list_head_init(&w->l0[i]);
+
+	for (l = 0; l < TIMER_WHEEL_LEVELS - 1; l++)
+		for (i = 0; i < TIMER_WHEEL_LN_SIZE; i++)
+			list_head_init(&w->ln[l][i]);
+
+	w->id = id;
+	w->armed = TIMER_WHEEL_NONE;
+	w->tick = timer_wheel_now(w) >> TIMER_WHEEL_TICK_SHIFT;
+
+	os_log(LOG_INFO, "timer_wheel(%p), fd: %d, epoll_fd: %d, slack: %" PRIu64 " ns\n", w, w->base.fd, epoll_fd, timer_wheel_slack);
+
+	return w;
+
+err_add:
+	close(w->base.fd);
+
+err_create:
+	free(w);
+
+err_alloc:
+	return NULL;
+}
+
+int timer_wheel_create(struct os_timer *t, clockid_t id, int epoll_fd)
+{
+	struct timer_wheel *w;
+	struct list_head *entry;
+
+	pthread_mutex_lock(&timer_wheel_lock);
+
+	for (entry = list_first(&timer_wheel_list); entry != &timer_wheel_list; entry = list_next(entry)) {
+		w = container_of(entry, struct timer_wheel, list);
+
+		if ((w->base.epoll_fd == epoll_fd) && (w->id == id))
+			goto found;
+	}
+
+	w = timer_wheel_alloc(id, epoll_fd);
+	if (!w)
+		goto err;
+
+	list_add_tail(&timer_wheel_list, &w->list);
+
+found:
+	w->users++;
+
+	pthread_mutex_unlock(&timer_wheel_lock);
+
+	t->wheel = w;
+	t->fd = -1;
+	t->epoll_fd = epoll_fd;
+	t->wheel_list.prev = NULL;
+	t->wheel_list.next = NULL;
+
+	return 0;
+
+err:
+	pthread_mutex_unlock(&timer_wheel_lock);
+
+	return -1;
+}
+
+void timer_wheel_destroy(struct os_timer *t)
+{
+	struct timer_wheel *w = t->wheel;
+
+	timer_wheel_stop(t);
+
+	pthread_mutex_lock(&timer_wheel_lock);
+
+	if (!--w->users) {
+		list_del(&w->list);
+
+		/* Freed at the end of processing */
+		if (!w->processing)
+			timer_wheel_free(w);
+	}
+
+	pthread_mutex_unlock(&timer_wheel_lock);
+
+	t->wheel = NULL;
+}
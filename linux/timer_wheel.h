@@ -0,0 +1,61 @@
+/*
+* Copyright 2021 NXP
+*
+* NXP Confidential. This software is owned or controlled by NXP and may only
+* be used strictly in accordance with the applicable license terms.  By expressly
+* accepting such terms or by downloading, installing, activating and/or otherwise
+* using the software, you are agreeing that you have read, and that you agree to
+* comply with and are bound by, such license terms.  If you do not agree to be
+* bound by the applicable license terms, then you may not retain, install, activate
+* or otherwise use the software.
+*/
+
+/**
+ @file
+ @brief Linux specific timer wheel service implementation
+ @details
+*/
+
+#ifndef _LINUX_TIMER_WHEEL_H_
+#define _LINUX_TIMER_WHEEL_H_
+
+#include <time.h>
+
+#include "osal/timer.h"
+
+#define CFG_TIMER_SLACK_DEFAULT		0	/* us */
+#define CFG_TIMER_SLACK_MIN		0	/* us */
+#define CFG_TIMER_SLACK_MAX		100000	/* us */
+
+#if defined(CONFIG_TIMER_WHEEL)
+static inline int timer_wheel_enabled(void) { return 1; }
+
+int timer_wheel_start(struct os_timer *t, u64 value, u64 interval_p, u64 interval_q, unsigned int flags);
+
+void timer_wheel_stop(struct os_timer *t);
+
+int timer_wheel_create(struct os_timer *t, clockid_t id, int epoll_fd);
+
+void timer_wheel_destroy(struct os_timer *t);
+
+/** Sets the timer wheel slack
+ * Timers may expire up to slack nanoseconds late, so that expirations close in time are processed by a single wakeup.
+ * Must be called before any timer is created.
+ * \param slack	slack in nanoseconds
+ */
+void timer_wheel_slack_set(u64 slack);
+#else
+static inline int timer_wheel_enabled(void) { return 0; }
+
+static inline int timer_wheel_start(struct os_timer *t, u64 value, u64 interval_p, u64 interval_q, unsigned int flags) { return -1; }
+
+static inline void timer_wheel_stop(struct os_timer *t) { return; }
+
+static inline int timer_wheel_create(struct os_timer *t, clockid_t id, int epoll_fd) { return -1; }
+
+static inline void timer_wheel_destroy(struct os_timer *t) { return; }
+
+static inline void timer_wheel_slack_set(u64 slack) { return; }
+#endif
+
+#endif /* _LINUX_TIMER_WHEEL_H_ */
@@ -0,0 +1,200 @@
+/*
+* Copyright 2021 NXP
+*
+* NXP Confidential. This software is owned or controlled by NXP and may only
+* be used strictly in accordance with the applicable license terms.  By expressly
+* accepting such terms or by downloading, installing, activating and/or otherwise
+* using the software, you are agreeing that you have read, and that you agree to
+* comply with and are bound by, such license terms.  If you do not agree to be
+* bound by the applicable license terms, then you may not retain, install, activate
+* or otherwise use the software.
+*/
+
+/**
+ @file
+ @brief GenAVB XDP statistics tool
+ @details Reads the statistics exported by the GenAVB XDP program through its pinned maps
+ (see linux/ebpf/genavb_xdp_main.c) and displays, for each flow, the number of frames matched,
+ redirected to AF_XDP sockets and passed to the network stack, followed by the reasons
+ frames didn't take the fast path.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <arpa/inet.h>
+
+#include <bpf/libbpf.h>
+#include <bpf/bpf.h>
+
+#include "genavb/net_types.h"
+#include "genavb/ether.h"
+
+static const char *pass_reason_str[GENAVB_XDP_PASS_MAX] = {
+	[GENAVB_XDP_PASS_TRUNCATED] = "truncated",
+	[GENAVB_XDP_PASS_NO_MATCH] = "no match",
+	[GENAVB_XDP_PASS_REDIRECT_FAILED] = "redirect failed",
+};
+
+static void print_usage(void)
+{
+	printf("\nUsage:\n genavb-xdp-stats [options]\n");
+	printf("\nOptions:\n"
+		"\t-i <interval>         display statistics every <interval> seconds\n"
+		"\t-h                    print this help text\n");
+}
+
+static int stats_get(int fd, uint32_t index, struct genavb_xdp_stats *values, int ncpus, struct genavb_xdp_stats *stats)
+{
+	int i;
+
+	if (bpf_map_lookup_elem(fd, &index, values))
+		return -1;
+
+	memset(stats, 0, sizeof(*stats));
+
+	for (i = 0; i < ncpus; i++) {
+		stats->hits += values[i].hits;
+		stats->redirects += values[i].redirects;
+		stats->redirect_failures += values[i].redirect_failures;
+		stats->passes += values[i].passes;
+	}
+
+	return 0;
+}
+
+static void key_print(struct genavb_xdp_key *key)
+{
+	uint16_t vlan_id = ntohs(key->vlan_id);
+	uint8_t *id = key->stream_id;
+
+	printf("%04x ", ntohs(key->protocol));
+
+	if (vlan_id == VLAN_VID_NONE)
+		printf("vlan(none) ");
+	else
+		printf("vlan(%4u) ", vlan_id);
+
+	if (key->protocol == htons(ETHERTYPE_AVTP) && !key->dst_mac[0] && !key->dst_mac[1] && !key->dst_mac[2] && !key->dst_mac[3] && !key->dst_mac[4] && !key->dst_mac[5])
+		printf("stream_id(%02x%02x%02x%02x%02x%02x%02x%02x)", id[0], id[1], id[2], id[3], id[4], id[5], id[6], id[7]);
+	else
+		printf("dst_mac(%02x:%02x:%02x:%02x:%02x:%02x)", key->dst_mac[0], key->dst_mac[1], key->dst_mac[2], key->dst_mac[3], key->dst_mac[4], key->dst_mac[5]);
+}
+
+static void stats_dump(int key_fd, int stats_fd, int pass_fd, int ncpus)
+{
+	struct genavb_xdp_stats *values, stats;
+	struct genavb_xdp_key key, next_key, *prev = NULL;
+	uint64_t *pass, count;
+	uint32_t index, reason;
+	int i;
+
+	values = calloc(ncpus, sizeof(struct genavb_xdp_stats));
+	pass = calloc(ncpus, sizeof(uint64_t));
+	if (!values || !pass)
+		goto exit;
+
+	printf("%-44s %5s %12s %12s %12s %12s\n", "flow", "index", "hits", "redirects", "redir_fail", "passes");
+
+	while (!bpf_map_get_next_key(key_fd, prev, &next_key)) {
+		key = next_key;
+		prev = &key;
+
+		if (bpf_map_lookup_elem(key_fd, &key, &index))
+			continue;
+
+		if (stats_get(stats_fd, index, values, ncpus, &stats) < 0)
+			continue;
+
+		key_print(&key);
+		printf(" %5u %12llu %12llu %12llu %12llu\n", index, (unsigned long long)stats.hits, (unsigned long long)stats.redirects,
+			(unsigned long long)stats.redirect_failures, (unsigned long long)stats.passes);
+	}
+
+	printf("\npassed to the network stack:\n");
+
+	for (reason = 0; reason < GENAVB_XDP_PASS_MAX; reason++) {
+		if (bpf_map_lookup_elem(pass_fd, &reason, pass))
+			continue;
+
+		count = 0;
+		for (i = 0; i < ncpus; i++)
+			count += pass[i];
+
+		printf("  %-16s %12llu\n", pass_reason_str[reason], (unsigned long long)count);
+	}
+
+	printf("\n");
+
+exit:
+	free(values);
+	free(pass);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int interval = 0;
+	int key_fd, stats_fd, pass_fd;
+	int ncpus;
+	int option;
+
+	while ((option = getopt(argc, argv, "i:h")) != -1) {
+		switch (option) {
+		case 'i':
+			interval = strtoul(optarg, NULL, 0);
+			break;
+
+		case 'h':
+		default:
+			print_usage();
+			return 0;
+		}
+	}
+
+	ncpus = libbpf_num_possible_cpus();
+	if (ncpus <= 0) {
+		printf("Could not get the number of cpus (%d)\n", ncpus);
+		goto err_cpus;
+	}
+
+	key_fd = bpf_obj_get(GENAVB_XDPKEY_NAME);
+	if (key_fd < 0) {
+		printf("Could not open %s, is the GenAVB XDP program loaded?\n", GENAVB_XDPKEY_NAME);
+		goto err_key;
+	}
+
+	stats_fd = bpf_obj_get(GENAVB_XDP_STATS_NAME);
+	if (stats_fd < 0) {
+		printf("Could not open %s\n", GENAVB_XDP_STATS_NAME);
+		goto err_stats;
+	}
+
+	pass_fd = bpf_obj_get(GENAVB_XDP_PASS_NAME);
+	if (pass_fd < 0) {
+		printf("Could not open %s\n", GENAVB_XDP_PASS_NAME);
+		goto err_pass;
+	}
+
+	do {
+		stats_dump(key_fd, stats_fd, pass_fd, ncpus);
+
+		if (interval)
+			sleep(interval);
+	} while (interval);
+
+	close(pass_fd);
+	close(stats_fd);
+	close(key_fd);
+
+	return 0;
+
+err_pass:
+	close(stats_fd);
+err_stats:
+	close(key_fd);
+err_key:
+err_cpus:
+	return 1;
+}
@@ -25,6 +25,7 @@
 #include <sys/epoll.h>
 
 #include "common/log.h"
+#include "linux/log.h"
 #include "common/net.h"
 #include "common/timer.h"
 #include "common/ipc.h"
@@ -68,6 +69,8 @@ void *management_thread_main(void *arg)
 	};
 	int rc;
 
+	log_thread_register();
+
 	rc = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
 	if (rc) {
 		os_log(LOG_ERR, "pthread_setschedparam(), %s\n", strerror(rc));
@@ -37,6 +37,14 @@ struct ipc_desc *ipc_alloc(struct ipc_tx const *tx, unsigned int size);
  */
 void ipc_free(void const *ipc, struct ipc_desc *desc);
 
+/** Free several IPC descriptors at once
+ * \param	ipc		pointer to ipc context (rx or tx).
+ * \param	desc		array of pointers to ipc descriptors to be freed.
+ * \param	n		number of descriptors in the array.
+ * \return	none.
+ */
+void ipc_free_multi(void const *ipc, struct ipc_desc **desc, unsigned int n);
+
 /** Initialize an IPC receive service handle.
  *  and require notifications using OS-specific mechanism.
  * \param	rx		pointer to ipc receive context.
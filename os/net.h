@@ -191,6 +191,18 @@ int net_del_multi(struct net_rx *rx, unsigned int port_id, const unsigned char *
 
 struct net_tx_desc *net_tx_alloc(unsigned int size);
 
+/** Transmit descriptor allocation for a given network context
+ *
+ * Same as net_tx_alloc(), but the descriptor is allocated from the buffers
+ * of the network transmit context, so that it can be sent without copy by
+ * backends with per context buffers (e.g. AF_XDP).
+ *
+ * \return	pointer to the descriptor, NULL on error
+ * \param tx	pointer to network transmit context
+ * \param size	data size
+ */
+struct net_tx_desc *net_tx_ctx_alloc(struct net_tx *tx, unsigned int size);
+
 int net_tx_alloc_multi(struct net_tx_desc **desc, unsigned int n, unsigned int size);
 
 struct net_tx_desc *net_tx_clone(struct net_tx_desc *src);
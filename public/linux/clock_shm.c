@@ -0,0 +1,207 @@
+/*
+ * Copyright 2021 NXP
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *    Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *    Neither the name of NXP Semiconductors nor the
+ *    names of its contributors may be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ @file		clock_shm.c
+ @brief		Shared memory clock helpers
+ @details	Computes GenAVB clocks time from the parameters published by the stack
+		in the shared memory clock page, with a single clock_gettime() call.
+*/
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#include "genavb/clock.h"
+#include "genavb/error.h"
+
+#define CLOCKFD 3
+#define FD_TO_CLOCKID(fd)	((~(clockid_t) (fd) << 3) | CLOCKFD)
+
+#define NSECS_PER_SEC		1000000000ULL
+
+struct genavb_clock_shm {
+	const struct genavb_clock_shm_page *page;
+
+	struct {
+		bool resolved;
+		int fd;
+		clockid_t id;
+	} hw_clock[GENAVB_CLOCK_MAX];
+};
+
+struct genavb_clock_shm *genavb_clock_shm_open(void)
+{
+	struct genavb_clock_shm *shm;
+	void *page;
+	int fd, i;
+
+	shm = malloc(sizeof(struct genavb_clock_shm));
+	if (!shm)
+		goto err_malloc;
+
+	fd = open(GENAVB_CLOCK_SHM_PATH, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		goto err_open;
+
+	page = mmap(NULL, sizeof(struct genavb_clock_shm_page), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if (page == MAP_FAILED)
+		goto err_mmap;
+
+	shm->page = page;
+
+	if (__atomic_load_n(&shm->page->version, __ATOMIC_ACQUIRE) != GENAVB_CLOCK_SHM_VERSION)
+		goto err_version;
+
+	for (i = 0; i < GENAVB_CLOCK_MAX; i++) {
+		shm->hw_clock[i].resolved = false;
+		shm->hw_clock[i].fd = -1;
+	}
+
+	return shm;
+
+err_version:
+	munmap((void *)shm->page, sizeof(struct genavb_clock_shm_page));
+
+err_mmap:
+err_open:
+	free(shm);
+
+err_malloc:
+	return NULL;
+}
+
+void genavb_clock_shm_close(struct genavb_clock_shm *shm)
+{
+	int i;
+
+	if (!shm)
+		return;
+
+	for (i = 0; i < GENAVB_CLOCK_MAX; i++)
+		if (shm->hw_clock[i].fd >= 0)
+			close(shm->hw_clock[i].fd);
+
+	munmap((void *)shm->page, sizeof(struct genavb_clock_shm_page));
+
+	free(shm);
+}
+
+/* Opens the hardware clock backing a GenAVB clock, once */
+static int clock_shm_hw_clock_resolve(struct genavb_clock_shm *shm, genavb_clock_id_t id, const struct genavb_clock_shm_entry *e)
+{
+	int fd;
+
+	if (e->hw_device[0]) {
+		fd = open(e->hw_device, O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+			return -1;
+
+		shm->hw_clock[id].fd = fd;
+		shm->hw_clock[id].id = FD_TO_CLOCKID(fd);
+	} else {
+		shm->hw_clock[id].id = e->hw_clock_id;
+	}
+
+	shm->hw_clock[id].resolved = true;
+
+	return 0;
+}
+
+int genavb_clock_shm_gettime64(struct genavb_clock_shm *shm, genavb_clock_id_t id, uint64_t *ns)
+{
+	const struct genavb_clock_shm_entry *shared;
+	struct genavb_clock_shm_entry e;
+	struct timespec now;
+	uint64_t ns_hw;
+	int64_t delta, adj;
+	uint32_t seq;
+
+	if (!shm || (id >= GENAVB_CLOCK_MAX) || !ns)
+		return -GENAVB_ERR_INVALID;
+
+	shared = &shm->page->entry[id];
+
+	if (!shm->hw_clock[id].resolved) {
+		do {
+			seq = __atomic_load_n(&shared->seq, __ATOMIC_ACQUIRE);
+			memcpy(&e, shared, sizeof(e));
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		} while ((seq & 1) || (seq != __atomic_load_n(&shared->seq, __ATOMIC_RELAXED)));
+
+		if (!(e.flags & GENAVB_CLOCK_SHM_F_VALID))
+			return -GENAVB_ERR_CLOCK;
+
+		if (clock_shm_hw_clock_resolve(shm, id, &e) < 0)
+			return -GENAVB_ERR_CLOCK;
+	}
+
+	if (clock_gettime(shm->hw_clock[id].id, &now) < 0)
+		return -GENAVB_ERR_CLOCK;
+
+	ns_hw = (uint64_t)now.tv_sec * NSECS_PER_SEC + now.tv_nsec;
+
+	do {
+		seq = __atomic_load_n(&shared->seq, __ATOMIC_ACQUIRE);
+
+		e.flags = shared->flags;
+		e.shift = shared->shift;
+		e.mul = shared->mul;
+		e.sw_t0 = shared->sw_t0;
+		e.hw_t0 = shared->hw_t0;
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	} while ((seq & 1) || (seq != __atomic_load_n(&shared->seq, __ATOMIC_RELAXED)));
+
+	if (!(e.flags & GENAVB_CLOCK_SHM_F_VALID))
+		return -GENAVB_ERR_CLOCK;
+
+	/*
+	 * Same conversion as the stack, but split as delta + delta * (mul - 1) so that it
+	 * doesn't overflow if the time base wasn't updated for a while (the stack updates it
+	 * at least on each frequency adjustment).
+	 */
+	delta = (int64_t)(ns_hw - e.hw_t0);
+
+	if (e.mul) {
+		adj = (int64_t)(e.mul - (1ULL << e.shift));
+		*ns = e.sw_t0 + delta + ((delta * adj) >> e.shift);
+	} else {
+		*ns = e.sw_t0 + delta;
+	}
+
+	return GENAVB_SUCCESS;
+}
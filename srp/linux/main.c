@@ -29,6 +29,7 @@
 #include "common/timer.h"
 #include "common/types.h"
 #include "common/log.h"
+#include "linux/log.h"
 
 #include "linux/avb.h"
 
@@ -81,6 +82,8 @@ void *srp_thread_main(void *arg)
 	};
 	int rc;
 
+	log_thread_register();
+
 	rc = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
 	if (rc) {
 		os_log(LOG_ERR, "pthread_setschedparam(), %s\n", strerror(rc));